@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: MIT
+
+#include <string.h>
+
+#include "ili9481_asset.h"
+
+#include "esp_log.h"
+
+
+static const char *TAG = "ili9481_asset";
+
+
+esp_err_t ili9481_asset_parse(const uint8_t *asset, size_t length, ili9481_asset_header_t *header) {
+	if (length < ILI9481_ASSET_HEADER_SIZE) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	// Asset may be unaligned
+	memcpy(header, asset, sizeof(ili9481_asset_header_t));
+	if (header->magic != ILI9481_ASSET_MAGIC) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	if (header->pixel_format != ILI9481_PIXEL_FORMAT_16 && header->pixel_format != ILI9481_PIXEL_FORMAT_18) {
+		return ESP_ERR_NOT_SUPPORTED;
+	}
+	const size_t pixel_size = header->pixel_format == ILI9481_PIXEL_FORMAT_16 ? 2 : 3;
+	if (header->size != (size_t)header->width * header->height * pixel_size || header->size > length - ILI9481_ASSET_HEADER_SIZE) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	return ESP_OK;
+}
+
+
+esp_err_t ili9481_draw_asset(ili9481_driver_t *driver, const uint8_t *asset, size_t length, uint16_t x, uint16_t y) {
+	ili9481_asset_header_t header;
+	esp_err_t ret = ili9481_asset_parse(asset, length, &header);
+	if (ret != ESP_OK) {
+		ESP_LOGE(TAG, "invalid asset");
+		return ret;
+	}
+	if (header.width == 0 || header.height == 0) {
+		return ESP_OK;
+	}
+	if (x + header.width > driver->display_width || y + header.height > driver->display_height) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	if (header.pixel_format != driver->pixel_format) {
+		ili9481_set_pixel_format(driver, header.pixel_format);
+		if (header.pixel_format != driver->pixel_format) {
+			return ESP_ERR_NOT_SUPPORTED;
+		}
+	}
+	// Rows are placed at logical lines, scroll area can split asset
+	const size_t row_size = header.size / header.height;
+	const uint8_t *data = asset + ILI9481_ASSET_HEADER_SIZE;
+	uint16_t gram_y[ILI9481_MAX_LINE_RANGES];
+	uint16_t lines[ILI9481_MAX_LINE_RANGES];
+	const size_t count = ili9481_scroll_map_lines(driver, y, header.height, gram_y, lines);
+	for (size_t i = 0; i < count; ++i) {
+		ili9481_set_window(driver, x, gram_y[i], x + header.width - 1, gram_y[i] + lines[i] - 1);
+		ili9481_write_data(driver, data, row_size * lines[i]);
+		data += row_size * lines[i];
+	}
+	return ESP_OK;
+}
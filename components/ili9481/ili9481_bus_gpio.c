@@ -0,0 +1,403 @@
+// SPDX-License-Identifier: MIT
+
+#include <stdlib.h>
+
+#include "ili9481_priv.h"
+
+#include "driver/gpio.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "soc/gpio_reg.h"
+
+
+static const char *TAG = "ili9481_gpio";
+
+
+// Returns bus width
+static size_t get_data_pins(const ili9481_driver_t *driver, int *data_pins) {
+	data_pins[0] = driver->pin_d0;
+	data_pins[1] = driver->pin_d1;
+	data_pins[2] = driver->pin_d2;
+	data_pins[3] = driver->pin_d3;
+	data_pins[4] = driver->pin_d4;
+	data_pins[5] = driver->pin_d5;
+	data_pins[6] = driver->pin_d6;
+	data_pins[7] = driver->pin_d7;
+	if (driver->bus_width != 16) {
+		return 8;
+	}
+	data_pins[8] = driver->pin_d8;
+	data_pins[9] = driver->pin_d9;
+	data_pins[10] = driver->pin_d10;
+	data_pins[11] = driver->pin_d11;
+	data_pins[12] = driver->pin_d12;
+	data_pins[13] = driver->pin_d13;
+	data_pins[14] = driver->pin_d14;
+	data_pins[15] = driver->pin_d15;
+	return 16;
+}
+
+
+static uint64_t get_data_pin_mask(const ili9481_driver_t *driver) {
+	int data_pins[16];
+	const size_t width = get_data_pins(driver, data_pins);
+	uint64_t mask = 0;
+	for (size_t i = 0; i < width; ++i) {
+		mask |= (1ULL << data_pins[i]);
+	}
+	return mask;
+}
+
+
+static esp_err_t build_data_table(ili9481_driver_t *driver) {
+	int data_pins[16];
+	const size_t width = get_data_pins(driver, data_pins);
+
+	// Whole word has to be written with single W1TS / W1TC pair
+	for (size_t i = 0; i < width; ++i) {
+		if (data_pins[i] < 0 || data_pins[i] >= 32) {
+			ESP_LOGE(TAG, "data pin d%d must be in range 0-31", (int)i);
+			return ESP_ERR_INVALID_ARG;
+		}
+	}
+	if (driver->pin_wr < 0 || driver->pin_wr >= 32) {
+		ESP_LOGE(TAG, "wr pin must be in range 0-31");
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	// Low byte, then high byte on 16-bit bus
+	driver->data_table = (uint32_t *)heap_caps_malloc((width / 8) * 256 * sizeof(uint32_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_32BIT);
+	if (driver->data_table == NULL) {
+		ESP_LOGE(TAG, "data table not allocated");
+		return ESP_ERR_NO_MEM;
+	}
+
+	driver->data_mask = 0;
+	driver->data_shift = driver->pin_d0;
+	for (size_t i = 0; i < width; ++i) {
+		driver->data_mask |= (1U << data_pins[i]);
+		if (data_pins[i] != driver->pin_d0 + (int)i) {
+			driver->data_shift = -1;
+		}
+	}
+	driver->wr_mask = (1U << driver->pin_wr);
+
+	for (size_t value = 0; value < (width / 8) * 256; ++value) {
+		const int *pins = data_pins + (value >> 8) * 8;
+		uint32_t out_data = 0;
+		for (size_t bit = 0; bit < 8; ++bit) {
+			if (value & (1U << bit)) {
+				out_data |= (1U << pins[bit]);
+			}
+		}
+		driver->data_table[value] = out_data;
+	}
+
+	return ESP_OK;
+}
+
+
+esp_err_t ili9481_gpio_bus_init(ili9481_driver_t *driver, bool use_table) {
+	driver->data_table = NULL;
+	if (use_table) {
+		esp_err_t ret = build_data_table(driver);
+		if (ret != ESP_OK) {
+			return ret;
+		}
+	}
+
+	gpio_config_t io_conf;
+	io_conf.intr_type = GPIO_INTR_DISABLE;
+	// Input buffer stays enabled, reads only switch output enable
+	io_conf.mode = GPIO_MODE_INPUT_OUTPUT;
+	io_conf.pin_bit_mask = get_data_pin_mask(driver);
+	io_conf.pull_down_en = 0;
+	io_conf.pull_up_en = 0;
+	gpio_config(&io_conf);
+
+	io_conf.mode = GPIO_MODE_OUTPUT;
+	io_conf.pin_bit_mask = (
+		(1ULL << driver->pin_rd) |
+		(1ULL << driver->pin_wr) |
+		(1ULL << driver->pin_dc)
+	);
+	if (driver->pin_rst >= 0) {
+		io_conf.pin_bit_mask |= (1ULL << driver->pin_rst);
+	}
+	if (driver->pin_cs >= 0) {
+		io_conf.pin_bit_mask |= (1ULL << driver->pin_cs);
+	}
+	io_conf.pull_down_en = 0;
+	io_conf.pull_up_en = 0;
+	gpio_config(&io_conf);
+
+	gpio_set_level(driver->pin_rd, 1);
+	gpio_set_level(driver->pin_wr, 1);
+	gpio_set_level(driver->pin_dc, 1);
+	// Display is only device on bus, chip select is held for whole session
+	if (driver->pin_cs >= 0) {
+		gpio_set_level(driver->pin_cs, 0);
+	}
+
+	return ESP_OK;
+}
+
+
+void ili9481_gpio_bus_deinit(ili9481_driver_t *driver) {
+	if (driver->pin_cs >= 0) {
+		gpio_set_level(driver->pin_cs, 1);
+	}
+	if (driver->data_table != NULL) {
+		heap_caps_free(driver->data_table);
+		driver->data_table = NULL;
+	}
+}
+
+
+static inline void __attribute__((always_inline)) write_bits(ili9481_driver_t *driver, uint8_t data) {
+	const uint32_t out_data = driver->data_table[data];
+	REG_WRITE(GPIO_OUT_W1TS_REG, out_data);
+	REG_WRITE(GPIO_OUT_W1TC_REG, (out_data ^ driver->data_mask) | driver->wr_mask);
+	REG_WRITE(GPIO_OUT_W1TS_REG, driver->wr_mask);
+}
+
+
+void ili9481_gpio_write_bytes(ili9481_driver_t *driver, const uint8_t *data, size_t length) {
+	const uint32_t data_mask = driver->data_mask;
+	const uint32_t wr_mask = driver->wr_mask;
+	if (driver->data_shift >= 0) {
+		const uint8_t shift = driver->data_shift;
+		while (length--) {
+			const uint32_t out_data = ((uint32_t)*data++) << shift;
+			REG_WRITE(GPIO_OUT_W1TS_REG, out_data);
+			REG_WRITE(GPIO_OUT_W1TC_REG, (out_data ^ data_mask) | wr_mask);
+			REG_WRITE(GPIO_OUT_W1TS_REG, wr_mask);
+		}
+	}
+	else {
+		while (length--) {
+			write_bits(driver, *data++);
+		}
+	}
+}
+
+
+// Big endian 16-bit words, one strobe per word
+void ili9481_gpio_write_words(ili9481_driver_t *driver, const uint8_t *data, size_t length) {
+	const uint32_t data_mask = driver->data_mask;
+	const uint32_t wr_mask = driver->wr_mask;
+	length /= 2;
+	if (driver->data_shift >= 0) {
+		const uint8_t shift = driver->data_shift;
+		while (length--) {
+			const uint32_t out_data = (((uint32_t)data[0] << 8) | data[1]) << shift;
+			data += 2;
+			REG_WRITE(GPIO_OUT_W1TS_REG, out_data);
+			REG_WRITE(GPIO_OUT_W1TC_REG, (out_data ^ data_mask) | wr_mask);
+			REG_WRITE(GPIO_OUT_W1TS_REG, wr_mask);
+		}
+	}
+	else {
+		const uint32_t *table = driver->data_table;
+		while (length--) {
+			const uint32_t out_data = table[256 + data[0]] | table[data[1]];
+			data += 2;
+			REG_WRITE(GPIO_OUT_W1TS_REG, out_data);
+			REG_WRITE(GPIO_OUT_W1TC_REG, (out_data ^ data_mask) | wr_mask);
+			REG_WRITE(GPIO_OUT_W1TS_REG, wr_mask);
+		}
+	}
+}
+
+
+void ili9481_gpio_set_dc(ili9481_driver_t *driver, bool data) {
+	gpio_set_level(driver->pin_dc, data ? 1 : 0);
+}
+
+
+// Data pins are gathered from single GPIO_IN_REG load, used only with data table
+static inline uint8_t __attribute__((always_inline)) gather_bits(uint32_t in, int8_t shift, const int *data_pins) {
+	if (shift >= 0) {
+		return (in >> shift) & 0xff;
+	}
+	uint8_t data = 0;
+	for (size_t bit = 0; bit < 8; ++bit) {
+		data |= ((in >> data_pins[bit]) & 0x01) << bit;
+	}
+	return data;
+}
+
+
+// Only low byte is read on 16-bit bus
+static void read_bytes_reg(ili9481_driver_t *driver, uint8_t *data, size_t length) {
+	int data_pins[16];
+	get_data_pins(driver, data_pins);
+	const int8_t shift = driver->data_shift;
+	const uint32_t rd_mask = 1U << (driver->pin_rd & 0x1f);
+	const uint32_t rd_set = driver->pin_rd < 32 ? GPIO_OUT_W1TS_REG : GPIO_OUT1_W1TS_REG;
+	const uint32_t rd_clear = driver->pin_rd < 32 ? GPIO_OUT_W1TC_REG : GPIO_OUT1_W1TC_REG;
+
+	REG_WRITE(GPIO_ENABLE_W1TC_REG, driver->data_mask);
+	while (length--) {
+		REG_WRITE(rd_clear, rd_mask);
+		// Frame memory read access time is longer than single register read
+		REG_READ(GPIO_IN_REG);
+		REG_READ(GPIO_IN_REG);
+		const uint32_t in = REG_READ(GPIO_IN_REG);
+		REG_WRITE(rd_set, rd_mask);
+		*data++ = gather_bits(in, shift, data_pins);
+	}
+	REG_WRITE(GPIO_ENABLE_W1TS_REG, driver->data_mask);
+}
+
+
+static void read_bytes_gpio(ili9481_driver_t *driver, uint8_t *data, size_t length) {
+	int data_pins[16];
+	const size_t width = get_data_pins(driver, data_pins);
+
+	for (size_t bit = 0; bit < width; ++bit) {
+		gpio_set_direction(data_pins[bit], GPIO_MODE_INPUT);
+	}
+	while (length--) {
+		uint8_t value = 0;
+		gpio_set_level(driver->pin_rd, 0);
+		for (size_t bit = 0; bit < 8; ++bit) {
+			value |= gpio_get_level(data_pins[bit]) << bit;
+		}
+		gpio_set_level(driver->pin_rd, 1);
+		*data++ = value;
+	}
+	for (size_t bit = 0; bit < width; ++bit) {
+		gpio_set_direction(data_pins[bit], GPIO_MODE_INPUT_OUTPUT);
+	}
+}
+
+
+// Bus direction is switched once for whole read
+void ili9481_gpio_read_bytes(ili9481_driver_t *driver, uint8_t *data, size_t length) {
+	if (length == 0) {
+		return;
+	}
+	if (driver->data_table != NULL) {
+		read_bytes_reg(driver, data, length);
+	}
+	else {
+		read_bytes_gpio(driver, data, length);
+	}
+}
+
+
+static void gpio_write_bits(ili9481_driver_t *driver, uint16_t data) {
+	if (driver->bus_width == 16) {
+		gpio_set_level(driver->pin_d8, ((data >> 8) & 0x01));
+		gpio_set_level(driver->pin_d9, ((data >> 9) & 0x01));
+		gpio_set_level(driver->pin_d10, ((data >> 10) & 0x01));
+		gpio_set_level(driver->pin_d11, ((data >> 11) & 0x01));
+		gpio_set_level(driver->pin_d12, ((data >> 12) & 0x01));
+		gpio_set_level(driver->pin_d13, ((data >> 13) & 0x01));
+		gpio_set_level(driver->pin_d14, ((data >> 14) & 0x01));
+		gpio_set_level(driver->pin_d15, ((data >> 15) & 0x01));
+	}
+	gpio_set_level(driver->pin_d0, ((data >> 0) & 0x01));
+	gpio_set_level(driver->pin_d1, ((data >> 1) & 0x01));
+	gpio_set_level(driver->pin_d2, ((data >> 2) & 0x01));
+	gpio_set_level(driver->pin_d3, ((data >> 3) & 0x01));
+	gpio_set_level(driver->pin_d4, ((data >> 4) & 0x01));
+	gpio_set_level(driver->pin_d5, ((data >> 5) & 0x01));
+	gpio_set_level(driver->pin_d6, ((data >> 6) & 0x01));
+	gpio_set_level(driver->pin_d7, ((data >> 7) & 0x01));
+	gpio_set_level(driver->pin_wr, 0);
+	gpio_set_level(driver->pin_wr, 1);
+}
+
+
+static esp_err_t bus_gpio_init(ili9481_driver_t *driver) {
+	return ili9481_gpio_bus_init(driver, false);
+}
+
+
+static void bus_gpio_write_command(ili9481_driver_t *driver, uint8_t command) {
+	ili9481_gpio_set_dc(driver, false);
+	gpio_write_bits(driver, command);
+	ili9481_gpio_set_dc(driver, true);
+}
+
+
+static void bus_gpio_write_bytes(ili9481_driver_t *driver, const uint8_t *data, size_t length) {
+	while (length--) {
+		gpio_write_bits(driver, *data++);
+	}
+}
+
+
+static void bus_gpio_write_data(ili9481_driver_t *driver, const uint8_t *data, size_t length) {
+	if (ili9481_is_word_data(driver)) {
+		for (size_t i = 0; i + 1 < length; i += 2) {
+			gpio_write_bits(driver, (data[i] << 8) | data[i + 1]);
+		}
+	}
+	else {
+		bus_gpio_write_bytes(driver, data, length);
+	}
+}
+
+
+static void bus_gpio_write_burst(ili9481_driver_t *driver, const uint8_t *burst, size_t length) {
+	ili9481_split_burst(driver, burst, length, bus_gpio_write_command, bus_gpio_write_bytes);
+}
+
+
+static esp_err_t bus_reg_init(ili9481_driver_t *driver) {
+	return ili9481_gpio_bus_init(driver, true);
+}
+
+
+static void bus_reg_write_command(ili9481_driver_t *driver, uint8_t command) {
+	ili9481_gpio_set_dc(driver, false);
+	ili9481_gpio_write_bytes(driver, &command, 1);
+	ili9481_gpio_set_dc(driver, true);
+}
+
+
+static void bus_reg_write_data(ili9481_driver_t *driver, const uint8_t *data, size_t length) {
+	if (ili9481_is_word_data(driver)) {
+		ili9481_gpio_write_words(driver, data, length);
+	}
+	else {
+		ili9481_gpio_write_bytes(driver, data, length);
+	}
+}
+
+
+static void bus_reg_write_burst(ili9481_driver_t *driver, const uint8_t *burst, size_t length) {
+	ili9481_split_burst(driver, burst, length, bus_reg_write_command, ili9481_gpio_write_bytes);
+}
+
+
+static void bus_wait_idle(ili9481_driver_t *driver) {
+	// Writes are synchronous
+}
+
+
+const ili9481_bus_t ili9481_bus_gpio = {
+	.name = "gpio",
+	.init = bus_gpio_init,
+	.deinit = ili9481_gpio_bus_deinit,
+	.write_command = bus_gpio_write_command,
+	.write_data = bus_gpio_write_data,
+	.read_data = ili9481_gpio_read_bytes,
+	.write_burst = bus_gpio_write_burst,
+	.wait_idle = bus_wait_idle,
+};
+
+
+const ili9481_bus_t ili9481_bus_reg = {
+	.name = "reg",
+	.init = bus_reg_init,
+	.deinit = ili9481_gpio_bus_deinit,
+	.write_command = bus_reg_write_command,
+	.write_data = bus_reg_write_data,
+	.read_data = ili9481_gpio_read_bytes,
+	.write_burst = bus_reg_write_burst,
+	.wait_idle = bus_wait_idle,
+};
@@ -0,0 +1,398 @@
+// SPDX-License-Identifier: MIT
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "ili9481_priv.h"
+#include "ili9481_i2s.h"
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "soc/soc_memory_layout.h"
+
+
+#define I2S_DEV (&I2S1)
+#define I2S_BUFFER_COUNT 2
+#define I2S_BUFFER_SIZE (I2S_DMA_MAX_LENGTH * 2)
+// Transaction slot of caller memory, follows bounce buffers
+#define I2S_USER_INDEX I2S_BUFFER_COUNT
+#define I2S_TRANSACTION_COUNT (I2S_BUFFER_COUNT + 1)
+
+
+static const char *TAG = "ili9481_i2s";
+
+
+typedef struct bus_i2s {
+	uint8_t *buffers[I2S_BUFFER_COUNT];
+	i2s_transaction_t transactions[I2S_TRANSACTION_COUNT];
+	bool pending[I2S_TRANSACTION_COUNT];
+	lldesc_t *user_desc; // Chain pointing to caller memory
+	size_t user_desc_count;
+	uint8_t *stream_buffer; // Ring buffer being filled by caller
+	size_t current; // Buffer being filled
+	size_t fill;
+	bool attached;
+	bool wide; // 16-bit bus, buffers contain only pixel data
+} bus_i2s_t;
+
+
+static void wait_buffer(bus_i2s_t *bus, size_t index) {
+	while (bus->pending[index]) {
+		i2s_transaction_t *done;
+		i2s_trans_get_result(I2S_DEV, &done, portMAX_DELAY);
+		bus->pending[(size_t)done->user_data] = false;
+	}
+}
+
+
+static void wait_all(bus_i2s_t *bus) {
+	for (size_t i = 0; i < I2S_TRANSACTION_COUNT; ++i) {
+		wait_buffer(bus, i);
+	}
+}
+
+
+// Bus order to FIFO order
+static void swap_data(bus_i2s_t *bus, void *data, size_t length) {
+	if (bus->wide) {
+		i2s_swap_bytes(data, length);
+	}
+	else {
+		i2s_swap_halfwords(data, length);
+	}
+}
+
+
+static void enqueue(bus_i2s_t *bus, size_t index) {
+	if (!bus->attached) {
+		i2s_attach_pins(I2S_DEV);
+		bus->attached = true;
+	}
+	bus->pending[index] = true;
+	i2s_trans_enqueue(I2S_DEV, &bus->transactions[index], portMAX_DELAY);
+}
+
+
+// Data in current buffer are already in FIFO order if swap is false
+static void submit(bus_i2s_t *bus, size_t length, bool swap) {
+	const size_t index = bus->current;
+	if (swap) {
+		swap_data(bus, bus->buffers[index], length);
+	}
+	bus->transactions[index].length = length;
+	enqueue(bus, index);
+	bus->current = (index + 1) % I2S_BUFFER_COUNT;
+	bus->fill = 0;
+}
+
+
+// Pins are switched back to GPIO for commands, reads and bytes not filling
+// whole word, after last words left FIFO
+static void detach(bus_i2s_t *bus) {
+	wait_all(bus);
+	i2s_wait_idle(I2S_DEV);
+	if (bus->attached) {
+		i2s_detach_pins(I2S_DEV);
+		bus->attached = false;
+	}
+}
+
+
+static void flush(ili9481_driver_t *driver) {
+	bus_i2s_t *bus = (bus_i2s_t *)driver->bus_data;
+	const size_t tail = bus->fill & 0x03;
+	const size_t words = bus->fill - tail;
+	uint8_t tail_data[4];
+	memcpy(tail_data, bus->buffers[bus->current] + words, tail);
+
+	if (words > 0) {
+		submit(bus, words, true);
+	}
+	bus->fill = 0;
+
+	if (tail > 0) {
+		detach(bus);
+		if (bus->wide) {
+			ili9481_gpio_write_words(driver, tail_data, tail);
+		}
+		else {
+			ili9481_gpio_write_bytes(driver, tail_data, tail);
+		}
+	}
+}
+
+
+static void bus_i2s_deinit(ili9481_driver_t *driver) {
+	bus_i2s_t *bus = (bus_i2s_t *)driver->bus_data;
+	if (bus != NULL) {
+		detach(bus);
+		i2s_deinit(I2S_DEV);
+		for (size_t i = 0; i < I2S_BUFFER_COUNT; ++i) {
+			heap_caps_free(bus->buffers[i]);
+		}
+		heap_caps_free(bus->user_desc);
+		free(bus);
+		driver->bus_data = NULL;
+	}
+	ili9481_gpio_bus_deinit(driver);
+}
+
+
+static esp_err_t bus_i2s_init(ili9481_driver_t *driver) {
+	esp_err_t ret = ili9481_gpio_bus_init(driver, true);
+	if (ret != ESP_OK) {
+		return ret;
+	}
+
+	bus_i2s_t *bus = (bus_i2s_t *)calloc(1, sizeof(bus_i2s_t));
+	if (bus == NULL) {
+		ESP_LOGE(TAG, "bus not allocated");
+		ili9481_gpio_bus_deinit(driver);
+		return ESP_ERR_NO_MEM;
+	}
+	driver->bus_data = bus;
+	bus->wide = driver->bus_width == 16;
+
+	for (size_t i = 0; i < I2S_BUFFER_COUNT; ++i) {
+		bus->buffers[i] = (uint8_t *)heap_caps_malloc(I2S_BUFFER_SIZE, MALLOC_CAP_DMA);
+		if (bus->buffers[i] == NULL) {
+			ESP_LOGE(TAG, "DMA buffer not allocated");
+			bus_i2s_deinit(driver);
+			return ESP_ERR_NO_MEM;
+		}
+		bus->transactions[i].data = bus->buffers[i];
+		bus->transactions[i].length = 0;
+		bus->transactions[i].user_data = (void *)i;
+	}
+	bus->transactions[I2S_USER_INDEX].user_data = (void *)I2S_USER_INDEX;
+
+	i2s_driver_config_t config = {
+		.queue_size = I2S_BUFFER_COUNT,
+		.pre_cb = NULL,
+		.post_cb = NULL,
+		.max_transfer_size = I2S_BUFFER_SIZE,
+		.clock_div = driver->clock_div,
+		.data_bits = driver->bus_width,
+		.pin_wr = driver->pin_wr,
+		.pin_data = {
+			driver->pin_d0,
+			driver->pin_d1,
+			driver->pin_d2,
+			driver->pin_d3,
+			driver->pin_d4,
+			driver->pin_d5,
+			driver->pin_d6,
+			driver->pin_d7,
+			driver->pin_d8,
+			driver->pin_d9,
+			driver->pin_d10,
+			driver->pin_d11,
+			driver->pin_d12,
+			driver->pin_d13,
+			driver->pin_d14,
+			driver->pin_d15,
+		},
+	};
+	ret = i2s_init(I2S_DEV, &config);
+	if (ret != ESP_OK) {
+		bus_i2s_deinit(driver);
+		return ret;
+	}
+	bus->attached = true;
+
+	return ESP_OK;
+}
+
+
+static void bus_gpio_write_command(ili9481_driver_t *driver, uint8_t command) {
+	ili9481_gpio_set_dc(driver, false);
+	ili9481_gpio_write_bytes(driver, &command, 1);
+	ili9481_gpio_set_dc(driver, true);
+}
+
+
+static void bus_i2s_write_command(ili9481_driver_t *driver, uint8_t command) {
+	bus_i2s_t *bus = (bus_i2s_t *)driver->bus_data;
+	flush(driver);
+	detach(bus);
+	bus_gpio_write_command(driver, command);
+}
+
+
+static void bus_i2s_write_data(ili9481_driver_t *driver, const uint8_t *data, size_t length) {
+	bus_i2s_t *bus = (bus_i2s_t *)driver->bus_data;
+	// Parameters on 16-bit bus are bytes, they can't be mixed with pixel words in DMA buffer
+	if (bus->wide && !driver->memory_write) {
+		flush(driver);
+		detach(bus);
+		ili9481_gpio_write_bytes(driver, data, length);
+		return;
+	}
+	while (length > 0) {
+		if (bus->fill == 0) {
+			wait_buffer(bus, bus->current);
+		}
+		const size_t chunk = MIN(length, I2S_BUFFER_SIZE - bus->fill);
+		memcpy(bus->buffers[bus->current] + bus->fill, data, chunk);
+		bus->fill += chunk;
+		data += chunk;
+		length -= chunk;
+		if (bus->fill == I2S_BUFFER_SIZE) {
+			submit(bus, bus->fill, true);
+		}
+	}
+}
+
+
+static void bus_i2s_read_data(ili9481_driver_t *driver, uint8_t *data, size_t length) {
+	bus_i2s_t *bus = (bus_i2s_t *)driver->bus_data;
+	flush(driver);
+	detach(bus);
+	ili9481_gpio_read_bytes(driver, data, length);
+}
+
+
+// Whole burst is sent with single switch from DMA to GPIO, DMA transaction
+// per command would cost more than writing few bytes directly
+static void bus_i2s_write_burst(ili9481_driver_t *driver, const uint8_t *burst, size_t length) {
+	bus_i2s_t *bus = (bus_i2s_t *)driver->bus_data;
+	flush(driver);
+	detach(bus);
+	ili9481_split_burst(driver, burst, length, bus_gpio_write_command, ili9481_gpio_write_bytes);
+}
+
+
+static void bus_i2s_wait_idle(ili9481_driver_t *driver) {
+	bus_i2s_t *bus = (bus_i2s_t *)driver->bus_data;
+	flush(driver);
+	wait_all(bus);
+	i2s_wait_idle(I2S_DEV);
+}
+
+
+static esp_err_t bus_i2s_set_clock_div(ili9481_driver_t *driver, uint8_t clock_div) {
+	bus_i2s_t *bus = (bus_i2s_t *)driver->bus_data;
+	flush(driver);
+	wait_all(bus);
+	return i2s_set_clock_div(I2S_DEV, clock_div > 0 ? clock_div : I2S_CLOCK_DIV_DEFAULT);
+}
+
+
+static void bus_i2s_prepare_dma(ili9481_driver_t *driver, void *data, size_t length) {
+	swap_data((bus_i2s_t *)driver->bus_data, data, length);
+}
+
+
+// Data in FIFO order are copied without swap
+static void write_bounce(bus_i2s_t *bus, const uint8_t *data, size_t length) {
+	while (length > 0) {
+		wait_buffer(bus, bus->current);
+		const size_t chunk = MIN(length, I2S_BUFFER_SIZE);
+		memcpy(bus->buffers[bus->current], data, chunk);
+		submit(bus, chunk, false);
+		data += chunk;
+		length -= chunk;
+	}
+}
+
+
+static esp_err_t bus_i2s_write_dma(ili9481_driver_t *driver, const void *data, size_t length) {
+	bus_i2s_t *bus = (bus_i2s_t *)driver->bus_data;
+	if (length == 0) {
+		return ESP_OK;
+	}
+	if ((length & 0x03) != 0 || ((uintptr_t)data & 0x03) != 0) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	if (bus->wide && !driver->memory_write) {
+		return ESP_ERR_INVALID_STATE;
+	}
+	flush(driver);
+
+	// I2S DMA reads only internal memory
+	if (!esp_ptr_dma_capable(data)) {
+		write_bounce(bus, (const uint8_t *)data, length);
+		return ESP_OK;
+	}
+
+	// Descriptors are reused, previous caller transfer has to be finished
+	wait_buffer(bus, I2S_USER_INDEX);
+	const size_t desc_count = i2s_dma_desc_count(length);
+	if (desc_count > bus->user_desc_count) {
+		heap_caps_free(bus->user_desc);
+		bus->user_desc_count = 0;
+		bus->user_desc = (lldesc_t *)heap_caps_malloc(desc_count * sizeof(lldesc_t), MALLOC_CAP_DMA);
+		if (bus->user_desc == NULL) {
+			ESP_LOGE(TAG, "DMA descriptors not allocated");
+			return ESP_ERR_NO_MEM;
+		}
+		bus->user_desc_count = desc_count;
+	}
+
+	i2s_transaction_t *transaction = &bus->transactions[I2S_USER_INDEX];
+	transaction->data = data;
+	transaction->length = length;
+	transaction->desc = i2s_build_dma_chain(bus->user_desc, bus->user_desc_count, data, length);
+	enqueue(bus, I2S_USER_INDEX);
+	return ESP_OK;
+}
+
+
+static esp_err_t bus_i2s_stream_begin(ili9481_driver_t *driver, const ili9481_stream_config_t *config) {
+	bus_i2s_t *bus = (bus_i2s_t *)driver->bus_data;
+	if (bus->wide && !driver->memory_write) {
+		return ESP_ERR_INVALID_STATE;
+	}
+	flush(driver);
+	wait_all(bus);
+	if (!bus->attached) {
+		i2s_attach_pins(I2S_DEV);
+		bus->attached = true;
+	}
+	const i2s_ring_config_t ring_config = {
+		.desc_count = config->buffer_count,
+		.buffer_size = config->buffer_size,
+		.prefill = config->prefill,
+	};
+	return i2s_ring_start(I2S_DEV, &ring_config);
+}
+
+
+static uint8_t *bus_i2s_stream_get_buffer(ili9481_driver_t *driver) {
+	bus_i2s_t *bus = (bus_i2s_t *)driver->bus_data;
+	bus->stream_buffer = i2s_ring_get_buffer(I2S_DEV, portMAX_DELAY);
+	return bus->stream_buffer;
+}
+
+
+// Ring buffers belong to bus, they are swapped in place
+static void bus_i2s_stream_submit(ili9481_driver_t *driver, size_t length) {
+	bus_i2s_t *bus = (bus_i2s_t *)driver->bus_data;
+	swap_data(bus, bus->stream_buffer, length);
+	i2s_ring_submit(I2S_DEV, length);
+}
+
+
+static void bus_i2s_stream_end(ili9481_driver_t *driver) {
+	i2s_ring_stop(I2S_DEV);
+}
+
+
+const ili9481_bus_t ili9481_bus_i2s = {
+	.name = "i2s",
+	.init = bus_i2s_init,
+	.deinit = bus_i2s_deinit,
+	.write_command = bus_i2s_write_command,
+	.write_data = bus_i2s_write_data,
+	.read_data = bus_i2s_read_data,
+	.write_burst = bus_i2s_write_burst,
+	.wait_idle = bus_i2s_wait_idle,
+	.set_clock_div = bus_i2s_set_clock_div,
+	.prepare_dma = bus_i2s_prepare_dma,
+	.write_dma = bus_i2s_write_dma,
+	.stream_begin = bus_i2s_stream_begin,
+	.stream_get_buffer = bus_i2s_stream_get_buffer,
+	.stream_submit = bus_i2s_stream_submit,
+	.stream_end = bus_i2s_stream_end,
+};
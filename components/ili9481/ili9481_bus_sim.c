@@ -0,0 +1,308 @@
+// SPDX-License-Identifier: MIT
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "ili9481_priv.h"
+
+#include "esp_log.h"
+
+
+static const char *TAG = "ili9481_sim";
+
+static const uint8_t device_code[] = {0x00, 0x02, 0x04, 0x94, 0x81, 0xFF};
+
+
+static void reset_window(ili9481_driver_t *driver, ili9481_sim_t *sim) {
+	sim->start_x = 0;
+	sim->end_x = driver->display_width - 1;
+	sim->start_y = 0;
+	sim->end_y = driver->display_height - 1;
+	sim->x = 0;
+	sim->y = 0;
+}
+
+
+static void reset_scroll(ili9481_driver_t *driver, ili9481_sim_t *sim) {
+	sim->scroll_top = 0;
+	sim->scroll_height = driver->display_height;
+	sim->scroll_start = 0;
+}
+
+
+uint16_t ili9481_sim_display_line(const ili9481_sim_t *sim, uint16_t row) {
+	if (row < sim->scroll_top || row >= sim->scroll_top + sim->scroll_height || sim->scroll_start < sim->scroll_top) {
+		return row;
+	}
+	return sim->scroll_top + (row - sim->scroll_top + sim->scroll_start - sim->scroll_top) % sim->scroll_height;
+}
+
+
+static void advance(ili9481_sim_t *sim) {
+	if (sim->x < sim->end_x) {
+		sim->x++;
+		return;
+	}
+	sim->x = sim->start_x;
+	if (sim->y < sim->end_y) {
+		sim->y++;
+	}
+	else {
+		sim->y = sim->start_y;
+	}
+}
+
+
+static void scan(ili9481_driver_t *driver, ili9481_sim_t *sim, size_t bytes) {
+	if (sim->scan_bytes == 0) {
+		return;
+	}
+	sim->scan_progress += bytes;
+	while (sim->scan_progress >= sim->scan_bytes) {
+		sim->scan_progress -= sim->scan_bytes;
+		const uint32_t generation = sim->line_generation[ili9481_sim_display_line(sim, sim->scanline)];
+		if (sim->scanline == 0) {
+			sim->pass_min = generation;
+			sim->pass_max = generation;
+		}
+		else {
+			sim->pass_min = MIN(sim->pass_min, generation);
+			sim->pass_max = MAX(sim->pass_max, generation);
+		}
+		sim->scanline++;
+		if (sim->scanline == driver->display_height) {
+			sim->scanline = 0;
+			sim->frames_scanned++;
+			if (sim->pass_min != sim->pass_max) {
+				sim->tears++;
+			}
+		}
+	}
+}
+
+
+static void store_pixel(ili9481_driver_t *driver, ili9481_sim_t *sim) {
+	if (sim->x < driver->display_width && sim->y < driver->display_height) {
+		uint8_t *target = sim->gram + (sim->y * driver->display_width + sim->x) * 3;
+		if ((sim->pixel_format & 0x07) == 0x05) {
+			// 16-bit pixel is expanded to 18-bit GRAM
+			const uint16_t color = (sim->pixel[0] << 8) | sim->pixel[1];
+			target[0] = (color >> 8) & 0xf8;
+			target[1] = (color >> 3) & 0xfc;
+			target[2] = (color << 3) & 0xf8;
+		}
+		else {
+			memcpy(target, sim->pixel, 3);
+		}
+		if (sim->x == sim->end_x) {
+			sim->line_generation[sim->y]++;
+		}
+	}
+	sim->pixels_written++;
+	advance(sim);
+}
+
+
+static void bus_sim_deinit(ili9481_driver_t *driver) {
+	ili9481_sim_t *sim = (ili9481_sim_t *)driver->bus_data;
+	if (sim != NULL) {
+		free(sim->gram);
+		free(sim->line_generation);
+		free(sim);
+		driver->bus_data = NULL;
+	}
+}
+
+
+static esp_err_t bus_sim_init(ili9481_driver_t *driver) {
+	ili9481_sim_t *sim = (ili9481_sim_t *)calloc(1, sizeof(ili9481_sim_t));
+	if (sim == NULL) {
+		ESP_LOGE(TAG, "simulator not allocated");
+		return ESP_ERR_NO_MEM;
+	}
+	driver->bus_data = sim;
+	sim->gram = (uint8_t *)calloc((size_t)driver->display_width * driver->display_height, 3);
+	sim->line_generation = (uint32_t *)calloc(driver->display_height, sizeof(uint32_t));
+	if (sim->gram == NULL || sim->line_generation == NULL) {
+		ESP_LOGE(TAG, "gram not allocated");
+		bus_sim_deinit(driver);
+		return ESP_ERR_NO_MEM;
+	}
+	sim->command = ILI9481_NOP;
+	sim->pixel_format = 0x66;
+	reset_window(driver, sim);
+	reset_scroll(driver, sim);
+	return ESP_OK;
+}
+
+
+static void bus_sim_write_command(ili9481_driver_t *driver, uint8_t command) {
+	ili9481_sim_t *sim = (ili9481_sim_t *)driver->bus_data;
+	sim->command = command;
+	sim->param_count = 0;
+	sim->pixel_pos = 0;
+	sim->commands++;
+	scan(driver, sim, 1);
+
+	switch (command) {
+		case ILI9481_SOFT_RESET:
+			sim->pixel_format = 0x66;
+			reset_window(driver, sim);
+			reset_scroll(driver, sim);
+			break;
+		case ILI9481_WRITE_MEMORY_START:
+		case ILI9481_READ_MEMORY_START:
+			sim->x = sim->start_x;
+			sim->y = sim->start_y;
+			sim->dummy_read = true;
+			break;
+		case ILI9481_READ_MEMORY_CONTINUE:
+		case ILI9481_DEVICE_CODE_READ:
+		case ILI9481_GET_PIXEL_FORMAT:
+		case ILI9481_GET_SCANLINE:
+			sim->dummy_read = true;
+			break;
+		default:
+			break;
+	}
+}
+
+
+static void bus_sim_write_parameter(ili9481_driver_t *driver, ili9481_sim_t *sim, uint8_t data) {
+	if (sim->param_count < sizeof(sim->params)) {
+		sim->params[sim->param_count] = data;
+	}
+	sim->param_count++;
+
+	switch (sim->command) {
+		case ILI9481_SET_COLUMN_ADDRESS:
+			if (sim->param_count == 4) {
+				sim->start_x = (sim->params[0] << 8) | sim->params[1];
+				sim->end_x = (sim->params[2] << 8) | sim->params[3];
+			}
+			break;
+		case ILI9481_SET_PAGE_ADDRESS:
+			if (sim->param_count == 4) {
+				sim->start_y = (sim->params[0] << 8) | sim->params[1];
+				sim->end_y = (sim->params[2] << 8) | sim->params[3];
+			}
+			break;
+		case ILI9481_SET_SCROLL_AREA:
+			// Areas, which do not add up to display height, are ignored
+			if (sim->param_count == 6) {
+				const uint16_t top = (sim->params[0] << 8) | sim->params[1];
+				const uint16_t height = (sim->params[2] << 8) | sim->params[3];
+				const uint16_t bottom = (sim->params[4] << 8) | sim->params[5];
+				if (top + height + bottom == driver->display_height && height > 0) {
+					sim->scroll_top = top;
+					sim->scroll_height = height;
+				}
+			}
+			break;
+		case ILI9481_SET_SCROLL_START:
+			if (sim->param_count == 2) {
+				sim->scroll_start = (sim->params[0] << 8) | sim->params[1];
+			}
+			break;
+		case ILI9481_SET_PIXEL_FORMAT:
+			if (sim->param_count == 1) {
+				sim->pixel_format = data;
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+
+static void bus_sim_write_data(ili9481_driver_t *driver, const uint8_t *data, size_t length) {
+	ili9481_sim_t *sim = (ili9481_sim_t *)driver->bus_data;
+	sim->bytes_written += length;
+
+	if (sim->command == ILI9481_WRITE_MEMORY_START || sim->command == ILI9481_WRITE_MEMORY_CONTINUE) {
+		const size_t pixel_size = (sim->pixel_format & 0x07) == 0x05 ? 2 : 3;
+		while (length--) {
+			scan(driver, sim, 1);
+			sim->pixel[sim->pixel_pos++] = *data++;
+			if (sim->pixel_pos == pixel_size) {
+				sim->pixel_pos = 0;
+				store_pixel(driver, sim);
+			}
+		}
+		return;
+	}
+
+	scan(driver, sim, length);
+	while (length--) {
+		bus_sim_write_parameter(driver, sim, *data++);
+	}
+}
+
+
+static uint8_t bus_sim_read_byte(ili9481_driver_t *driver, ili9481_sim_t *sim) {
+	if (sim->dummy_read) {
+		sim->dummy_read = false;
+		return 0x00;
+	}
+
+	switch (sim->command) {
+		case ILI9481_READ_MEMORY_START:
+		case ILI9481_READ_MEMORY_CONTINUE: {
+			uint8_t value = 0x00;
+			if (sim->x < driver->display_width && sim->y < driver->display_height) {
+				value = sim->gram[(sim->y * driver->display_width + sim->x) * 3 + sim->pixel_pos];
+			}
+			sim->pixel_pos++;
+			if (sim->pixel_pos == 3) {
+				sim->pixel_pos = 0;
+				advance(sim);
+			}
+			return value;
+		}
+		case ILI9481_DEVICE_CODE_READ:
+			if (sim->param_count < sizeof(device_code)) {
+				return device_code[sim->param_count++];
+			}
+			return 0xFF;
+		case ILI9481_GET_PIXEL_FORMAT:
+			return sim->pixel_format;
+		case ILI9481_GET_SCANLINE:
+			return sim->param_count++ == 0 ? (sim->scanline >> 8) & 0x03 : sim->scanline & 0xff;
+		default:
+			return 0x00;
+	}
+}
+
+
+static void bus_sim_read_data(ili9481_driver_t *driver, uint8_t *data, size_t length) {
+	ili9481_sim_t *sim = (ili9481_sim_t *)driver->bus_data;
+	sim->bytes_read += length;
+	scan(driver, sim, length);
+	while (length--) {
+		*data++ = bus_sim_read_byte(driver, sim);
+	}
+}
+
+
+static void bus_sim_write_burst(ili9481_driver_t *driver, const uint8_t *burst, size_t length) {
+	ili9481_sim_t *sim = (ili9481_sim_t *)driver->bus_data;
+	sim->bursts++;
+	ili9481_split_burst(driver, burst, length, bus_sim_write_command, bus_sim_write_data);
+}
+
+
+static void bus_sim_wait_idle(ili9481_driver_t *driver) {
+}
+
+
+const ili9481_bus_t ili9481_bus_sim = {
+	.name = "sim",
+	.init = bus_sim_init,
+	.deinit = bus_sim_deinit,
+	.write_command = bus_sim_write_command,
+	.write_data = bus_sim_write_data,
+	.read_data = bus_sim_read_data,
+	.write_burst = bus_sim_write_burst,
+	.wait_idle = bus_sim_wait_idle,
+};
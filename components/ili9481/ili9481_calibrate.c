@@ -0,0 +1,199 @@
+// SPDX-License-Identifier: MIT
+
+#include <stdlib.h>
+#include <sys/param.h>
+
+#include "ili9481_calibrate.h"
+
+#include "esp_log.h"
+#include "nvs.h"
+
+
+#define PATTERN_PIXELS 64
+#define PATTERN_SIZE (PATTERN_PIXELS * 3)
+#define PATTERN_SIZE_16 (PATTERN_PIXELS * 2)
+#define NVS_KEY "wr_clock_div"
+
+
+static const char *TAG = "ili9481_calibrate";
+
+
+// Walking ones, alternating bits and values changing every data line on each
+// strobe, only 6 upper bits are stored in 18-bit mode
+static void build_pattern_18(uint8_t *pattern, uint8_t seed) {
+	for (size_t i = 0; i < PATTERN_SIZE; ++i) {
+		uint8_t value;
+		switch ((i + seed) & 0x03) {
+			case 0:
+				value = 0x04 << ((i / 4 + seed) % 6);
+				break;
+			case 1:
+				value = (i & 0x04) ? 0xa8 : 0x54;
+				break;
+			case 2:
+				value = (i & 0x08) ? 0xfc : 0x00;
+				break;
+			default:
+				value = (uint8_t)((i * 73 + seed * 151) & 0xfc);
+				break;
+		}
+		pattern[i] = value;
+	}
+}
+
+
+// Same kinds of values for RGB565 words, every bit of word is stored, so
+// pattern toggles also D0 and D1
+static void build_pattern_16(uint8_t *pattern, uint8_t seed) {
+	for (size_t i = 0; i < PATTERN_PIXELS; ++i) {
+		uint16_t value;
+		switch ((i + seed) & 0x03) {
+			case 0:
+				value = 0x0001 << ((i / 4 + seed) % 16);
+				break;
+			case 1:
+				value = (i & 0x04) ? 0xaaaa : 0x5555;
+				break;
+			case 2:
+				value = (i & 0x08) ? 0xffff : 0x0000;
+				break;
+			default:
+				value = (uint16_t)(i * 40503 + seed * 9973);
+				break;
+		}
+		pattern[i * 2] = value >> 8;
+		pattern[i * 2 + 1] = value & 0xff;
+	}
+}
+
+
+static void set_pattern_window(ili9481_driver_t *driver, uint8_t command) {
+	const uint16_t end_x = PATTERN_PIXELS - 1;
+	const uint8_t burst[] = {
+		ILI9481_SET_COLUMN_ADDRESS, 4, 0, 0, end_x >> 8, end_x & 0xff,
+		ILI9481_SET_PAGE_ADDRESS, 4, 0, 0, 0, 0,
+		command, 0,
+	};
+	ili9481_write_burst(driver, burst, sizeof(burst));
+}
+
+
+// Pattern is read back as 18-bit pixels
+static void write_pattern(ili9481_driver_t *driver, uint8_t pixel_format, const uint8_t *pattern, size_t length, uint8_t *readback) {
+	ili9481_set_pixel_format(driver, pixel_format);
+	set_pattern_window(driver, ILI9481_WRITE_MEMORY_START);
+	ili9481_write_data(driver, pattern, length);
+	ili9481_wait_until_queue_empty(driver);
+
+	ili9481_set_pixel_format(driver, ILI9481_PIXEL_FORMAT_18);
+	set_pattern_window(driver, ILI9481_READ_MEMORY_START);
+	ili9481_read_data(driver, readback, 1); // Dummy read
+	ili9481_read_data(driver, readback, PATTERN_SIZE);
+}
+
+
+// 18-bit pass covers D2 to D7 with 6 bits of every byte, 16-bit pass covers
+// also D0 and D1, lowest bit of expanded red and blue is not checked
+static bool verify_clock(ili9481_driver_t *driver, const ili9481_calibration_config_t *config, uint8_t *pattern, uint8_t *readback) {
+	for (uint8_t i = 0; i < MAX(config->repeat, 1); ++i) {
+		build_pattern_18(pattern, i);
+		write_pattern(driver, ILI9481_PIXEL_FORMAT_18, pattern, PATTERN_SIZE, readback);
+		for (size_t pos = 0; pos < PATTERN_SIZE; ++pos) {
+			if ((readback[pos] & 0xfc) != pattern[pos]) {
+				return false;
+			}
+		}
+
+		build_pattern_16(pattern, i);
+		write_pattern(driver, ILI9481_PIXEL_FORMAT_16, pattern, PATTERN_SIZE_16, readback);
+		for (size_t pixel = 0; pixel < PATTERN_PIXELS; ++pixel) {
+			const uint16_t value = (pattern[pixel * 2] << 8) | pattern[pixel * 2 + 1];
+			const uint8_t *color = readback + pixel * 3;
+			if ((color[0] & 0xf8) != ((value >> 8) & 0xf8) || (color[1] & 0xfc) != ((value >> 3) & 0xfc) || (color[2] & 0xf8) != ((value << 3) & 0xf8)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+
+static esp_err_t load_cached(const char *nvs_namespace, uint8_t *clock_div) {
+	nvs_handle_t handle;
+	esp_err_t ret = nvs_open(nvs_namespace, NVS_READONLY, &handle);
+	if (ret != ESP_OK) {
+		return ret;
+	}
+	ret = nvs_get_u8(handle, NVS_KEY, clock_div);
+	nvs_close(handle);
+	return ret;
+}
+
+
+static void store_cached(const char *nvs_namespace, uint8_t clock_div) {
+	nvs_handle_t handle;
+	if (nvs_open(nvs_namespace, NVS_READWRITE, &handle) != ESP_OK) {
+		ESP_LOGW(TAG, "NVS namespace %s not opened", nvs_namespace);
+		return;
+	}
+	if (nvs_set_u8(handle, NVS_KEY, clock_div) != ESP_OK || nvs_commit(handle) != ESP_OK) {
+		ESP_LOGW(TAG, "clock divider not stored");
+	}
+	nvs_close(handle);
+}
+
+
+esp_err_t ili9481_calibrate_clock(ili9481_driver_t *driver, const ili9481_calibration_config_t *config) {
+	// Readback uses 18-bit pixel format
+	if (driver->bus->set_clock_div == NULL || driver->bus_width == 16) {
+		return ESP_ERR_NOT_SUPPORTED;
+	}
+	if (config->min_div > config->max_div) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	uint8_t clock_div;
+	if (config->nvs_namespace != NULL && !config->force && load_cached(config->nvs_namespace, &clock_div) == ESP_OK) {
+		ESP_LOGI(TAG, "cached clock divider %d", clock_div);
+		return ili9481_set_clock_div(driver, clock_div);
+	}
+
+	uint8_t *pattern = (uint8_t *)malloc(PATTERN_SIZE * 2);
+	if (pattern == NULL) {
+		return ESP_ERR_NO_MEM;
+	}
+	uint8_t *readback = pattern + PATTERN_SIZE;
+
+	const uint8_t previous_div = driver->clock_div;
+	const uint8_t previous_format = driver->pixel_format;
+
+	// Readback runs over GPIO, only write clock is tested
+	esp_err_t ret = ESP_ERR_NOT_FOUND;
+	for (unsigned int div = config->min_div; div <= config->max_div; ++div) {
+		if (ili9481_set_clock_div(driver, div) != ESP_OK) {
+			continue;
+		}
+		if (verify_clock(driver, config, pattern, readback)) {
+			clock_div = (uint8_t)MIN(div + config->margin, 255U);
+			ret = ESP_OK;
+			break;
+		}
+		ESP_LOGD(TAG, "clock divider %d failed", div);
+	}
+
+	free(pattern);
+	ili9481_set_pixel_format(driver, previous_format);
+
+	if (ret != ESP_OK) {
+		ESP_LOGE(TAG, "no stable clock divider found");
+		ili9481_set_clock_div(driver, previous_div);
+		return ret;
+	}
+
+	ESP_LOGI(TAG, "clock divider %d", clock_div);
+	ret = ili9481_set_clock_div(driver, clock_div);
+	if (ret == ESP_OK && config->nvs_namespace != NULL) {
+		store_cached(config->nvs_namespace, clock_div);
+	}
+	return ret;
+}
@@ -0,0 +1,169 @@
+// SPDX-License-Identifier: MIT
+
+#include <stdlib.h>
+#include <sys/param.h>
+
+#include "ili9481_dirty.h"
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+
+// CASET + PASET + RAMWR burst
+#define WINDOW_BYTES 14
+
+
+static const char *TAG = "ili9481_dirty";
+
+
+struct ili9481_dirty {
+	ili9481_driver_t *driver;
+	ili9481_dirty_config_t config;
+	ili9481_color_t *buffer;
+	ili9481_rect_t rects[ILI9481_DIRTY_MAX_RECTS];
+	size_t count;
+};
+
+
+static inline uint32_t rect_area(const ili9481_rect_t *rect) {
+	return (uint32_t)rect->width * rect->height;
+}
+
+
+static ili9481_rect_t rect_union(const ili9481_rect_t *a, const ili9481_rect_t *b) {
+	const uint16_t x = MIN(a->x, b->x);
+	const uint16_t y = MIN(a->y, b->y);
+	const ili9481_rect_t result = {
+		.x = x,
+		.y = y,
+		.width = MAX(a->x + a->width, b->x + b->width) - x,
+		.height = MAX(a->y + a->height, b->y + b->height) - y,
+	};
+	return result;
+}
+
+
+// Pixels added by merge minus saved window setup, overlapping pixels of
+// separate rectangles are written twice
+static int32_t merge_cost(const ili9481_dirty_t *dirty, const ili9481_rect_t *a, const ili9481_rect_t *b) {
+	const ili9481_rect_t merged = rect_union(a, b);
+	return (int32_t)rect_area(&merged) - (int32_t)rect_area(a) - (int32_t)rect_area(b) - (int32_t)dirty->config.window_cost;
+}
+
+
+static void remove_rect(ili9481_dirty_t *dirty, size_t index) {
+	dirty->rects[index] = dirty->rects[--dirty->count];
+}
+
+
+// Merge rectangle with cheapest partner while merge is not more expensive
+// than extra window, merged rectangle can absorb further ones
+static void insert_rect(ili9481_dirty_t *dirty, ili9481_rect_t rect) {
+	while (dirty->count > 0) {
+		size_t best = 0;
+		int32_t best_cost = merge_cost(dirty, &rect, &dirty->rects[0]);
+		for (size_t i = 1; i < dirty->count; ++i) {
+			const int32_t cost = merge_cost(dirty, &rect, &dirty->rects[i]);
+			if (cost < best_cost) {
+				best = i;
+				best_cost = cost;
+			}
+		}
+		if (best_cost > 0 && dirty->count < ILI9481_DIRTY_MAX_RECTS) {
+			break;
+		}
+		rect = rect_union(&rect, &dirty->rects[best]);
+		remove_rect(dirty, best);
+	}
+	dirty->rects[dirty->count++] = rect;
+}
+
+
+esp_err_t ili9481_dirty_create(ili9481_driver_t *driver, const ili9481_dirty_config_t *config, ili9481_dirty_t **dirty_out) {
+	if (config->render == NULL || config->buffer_pixels < driver->display_width) {
+		ESP_LOGE(TAG, "invalid configuration");
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	ili9481_dirty_t *dirty = (ili9481_dirty_t *)calloc(1, sizeof(ili9481_dirty_t));
+	if (dirty == NULL) {
+		ESP_LOGE(TAG, "tracker not allocated");
+		return ESP_ERR_NO_MEM;
+	}
+	dirty->driver = driver;
+	dirty->config = *config;
+	dirty->buffer = (ili9481_color_t *)heap_caps_malloc(config->buffer_pixels * sizeof(ili9481_color_t), MALLOC_CAP_8BIT);
+	if (dirty->buffer == NULL) {
+		ESP_LOGE(TAG, "render buffer not allocated");
+		free(dirty);
+		return ESP_ERR_NO_MEM;
+	}
+
+	*dirty_out = dirty;
+	return ESP_OK;
+}
+
+
+void ili9481_dirty_destroy(ili9481_dirty_t *dirty) {
+	heap_caps_free(dirty->buffer);
+	free(dirty);
+}
+
+
+void ili9481_dirty_invalidate(ili9481_dirty_t *dirty, uint16_t x, uint16_t y, uint16_t width, uint16_t height) {
+	const ili9481_driver_t *driver = dirty->driver;
+	if (x >= driver->display_width || y >= driver->display_height) {
+		return;
+	}
+	width = MIN(width, driver->display_width - x);
+	height = MIN(height, driver->display_height - y);
+	if (width == 0 || height == 0) {
+		return;
+	}
+	const ili9481_rect_t rect = {x, y, width, height};
+	insert_rect(dirty, rect);
+}
+
+
+void ili9481_dirty_invalidate_all(ili9481_dirty_t *dirty) {
+	dirty->count = 0;
+	ili9481_dirty_invalidate(dirty, 0, 0, dirty->driver->display_width, dirty->driver->display_height);
+}
+
+
+void ili9481_dirty_flush(ili9481_dirty_t *dirty, ili9481_dirty_report_t *report) {
+	ili9481_driver_t *driver = dirty->driver;
+	const size_t pixel_size = (driver->pixel_format & 0x07) == 0x05 ? 2 : 3;
+	uint32_t pixels = 0;
+	uint32_t windows = 0;
+
+	for (size_t i = 0; i < dirty->count; ++i) {
+		const ili9481_rect_t *rect = &dirty->rects[i];
+		const uint16_t strip_lines = MIN(dirty->config.buffer_pixels / rect->width, rect->height);
+		// Rectangle is in logical lines, scroll area can split it in GRAM
+		uint16_t gram_y[ILI9481_MAX_LINE_RANGES];
+		uint16_t range_lines[ILI9481_MAX_LINE_RANGES];
+		const size_t ranges = ili9481_scroll_map_lines(driver, rect->y, rect->height, gram_y, range_lines);
+		uint16_t y = rect->y;
+		for (size_t range = 0; range < ranges; ++range) {
+			ili9481_set_window(driver, rect->x, gram_y[range], rect->x + rect->width - 1, gram_y[range] + range_lines[range] - 1);
+			for (uint16_t line = 0; line < range_lines[range]; line += strip_lines) {
+				const uint16_t lines = MIN(strip_lines, range_lines[range] - line);
+				dirty->config.render(driver, dirty->buffer, rect->x, y + line, rect->width, lines, dirty->config.user_data);
+				ili9481_write_pixels(driver, dirty->buffer, (size_t)rect->width * lines);
+			}
+			y += range_lines[range];
+		}
+		pixels += rect_area(rect);
+		windows += ranges;
+	}
+
+	if (report != NULL) {
+		const size_t frame_bytes = (size_t)driver->display_width * driver->display_height * pixel_size + WINDOW_BYTES;
+		report->rects = windows;
+		report->pixels = pixels;
+		report->bytes_written = (size_t)pixels * pixel_size + windows * WINDOW_BYTES;
+		report->bytes_saved = frame_bytes > report->bytes_written ? frame_bytes - report->bytes_written : 0;
+	}
+	dirty->count = 0;
+}
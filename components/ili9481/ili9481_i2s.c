@@ -0,0 +1,722 @@
+// SPDX-License-Identifier: MIT
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "ili9481_i2s.h"
+
+#include "driver/gpio.h"
+#include "driver/periph_ctrl.h"
+#include "esp32/rom/gpio.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "soc/gpio_sig_map.h"
+#include "soc/i2s_reg.h"
+
+
+static const char *TAG = "ili9481_i2s";
+
+
+static i2s_driver_t i2s_drivers[2] = {
+	{
+		.chains = NULL,
+		.chain_count = 0,
+		.chain_head = 0,
+		.chain_tail = 0,
+		.chain_queued = 0,
+		.running = false,
+		.ret_queue = 0,
+		.tx_semaphore = 0,
+		.slot_semaphore = 0,
+		.pre_cb = NULL,
+		.post_cb = NULL,
+		.intr_handle = NULL,
+		.dma = NULL,
+		.dma_count = 0,
+		.ring = NULL,
+		.lock = portMUX_INITIALIZER_UNLOCKED,
+		.hw = &I2S0
+	},
+	{
+		.chains = NULL,
+		.chain_count = 0,
+		.chain_head = 0,
+		.chain_tail = 0,
+		.chain_queued = 0,
+		.running = false,
+		.ret_queue = 0,
+		.tx_semaphore = 0,
+		.slot_semaphore = 0,
+		.pre_cb = NULL,
+		.post_cb = NULL,
+		.intr_handle = NULL,
+		.dma = NULL,
+		.dma_count = 0,
+		.ring = NULL,
+		.lock = portMUX_INITIALIZER_UNLOCKED,
+		.hw = &I2S1
+	}
+};
+
+
+static inline i2s_driver_t *get_driver(i2s_dev_t *dev) {
+	return &(i2s_drivers[(dev == &I2S0) ? 0 : 1]);
+}
+
+
+static void i2s_reset_fifo(i2s_dev_t *dev) {
+	dev->conf.tx_reset = 1;
+	dev->conf.tx_fifo_reset = 1;
+	dev->conf.rx_fifo_reset = 1;
+	dev->conf.tx_reset = 0;
+	dev->conf.tx_fifo_reset = 0;
+	dev->conf.rx_fifo_reset = 0;
+}
+
+
+static void i2s_configure_dma(i2s_dev_t *dev) {
+	dev->lc_conf.in_rst = 1;
+	dev->lc_conf.out_rst = 1;
+	dev->lc_conf.ahbm_rst = 1;
+	dev->lc_conf.ahbm_fifo_rst = 1;
+	dev->lc_conf.in_rst = 0;
+	dev->lc_conf.out_rst = 0;
+	dev->lc_conf.ahbm_rst = 0;
+	dev->lc_conf.ahbm_fifo_rst = 0;
+
+	dev->lc_conf.check_owner = 1;
+	dev->lc_conf.out_data_burst_en = 1;
+	dev->lc_conf.outdscr_burst_en = 1;
+}
+
+
+// 8-bit samples are written with doubled WR clock, 16-bit samples use one
+// WR cycle per sample
+static void i2s_set_lcd_mode(i2s_dev_t *dev, int data_bits) {
+	dev->conf2.val = 0;
+	dev->conf2.lcd_en = 1;
+	dev->conf2.lcd_tx_wrx2_en = data_bits == 8 ? 1 : 0;
+	dev->conf2.lcd_tx_sdx2_en = 0;
+}
+
+
+static void i2s_set_speed(i2s_dev_t *dev, int clock_div, int data_bits) {
+	dev->sample_rate_conf.val = 0;
+	dev->sample_rate_conf.rx_bits_mod = data_bits == 8 ? 4 : 16;
+	dev->sample_rate_conf.tx_bits_mod = data_bits == 8 ? 4 : 16;
+	dev->sample_rate_conf.rx_bck_div_num = 2;
+	dev->sample_rate_conf.tx_bck_div_num = 2;
+
+	dev->clkm_conf.val = 0;
+	dev->clkm_conf.clka_en = 0;
+	dev->clkm_conf.clkm_div_a = 63;
+	dev->clkm_conf.clkm_div_b = 0;
+	dev->clkm_conf.clkm_div_num = clock_div;
+	dev->clkm_conf.clk_en = 1;
+
+	dev->timing.val = 0;
+}
+
+
+static void i2s_configure_tx(i2s_dev_t *dev) {
+	dev->fifo_conf.val = 0;
+	dev->fifo_conf.rx_fifo_mod_force_en = 1;
+	dev->fifo_conf.tx_fifo_mod_force_en = 1;
+	dev->fifo_conf.rx_fifo_mod = 1;
+	dev->fifo_conf.tx_fifo_mod = 1;
+	dev->fifo_conf.dscr_en = 1;
+
+	dev->conf1.val = 0;
+	dev->conf1.tx_stop_en = 1;
+	dev->conf1.tx_pcm_bypass = 1;
+
+	dev->conf_chan.val = 0;
+	dev->conf_chan.tx_chan_mod = 2;
+	dev->conf_chan.rx_chan_mod = 2;
+}
+
+
+lldesc_t * IRAM_ATTR i2s_build_dma_chain(lldesc_t *desc, size_t count, const void *data, size_t length) {
+	const size_t needed = i2s_dma_desc_count(length);
+	if (needed == 0 || needed > count) {
+		return NULL;
+	}
+
+	const uint8_t *buf = (const uint8_t *)data;
+	for (size_t i = 0; i < needed; ++i) {
+		const size_t chunk = MIN(length, I2S_DMA_MAX_LENGTH);
+		lldesc_t *current = &desc[i];
+		current->size = chunk;
+		current->length = chunk;
+		current->buf = (uint8_t *)buf;
+		current->offset = 0;
+		current->sosf = 0;
+		current->owner = 1;
+		current->eof = (i == needed - 1) ? 1 : 0;
+		current->qe.stqe_next = current->eof ? NULL : &desc[i + 1];
+		buf += chunk;
+		length -= chunk;
+	}
+
+	return desc;
+}
+
+
+void i2s_swap_halfwords(void *data, size_t length) {
+	uint32_t *words = (uint32_t *)data;
+	for (size_t i = 0; i < length / 4; ++i) {
+		words[i] = (words[i] >> 16) | (words[i] << 16);
+	}
+}
+
+
+void i2s_swap_bytes(void *data, size_t length) {
+	uint32_t *words = (uint32_t *)data;
+	for (size_t i = 0; i < length / 4; ++i) {
+		words[i] = __builtin_bswap32(words[i]);
+	}
+}
+
+
+static void IRAM_ATTR i2s_trans_dma_start(i2s_driver_t *drv, const lldesc_t *desc) {
+	i2s_dev_t *dev = drv->hw;
+
+	dev->lc_conf.out_rst = 1;
+	dev->lc_conf.out_rst = 0;
+	dev->conf.tx_reset = 1;
+	dev->conf.tx_reset = 0;
+	dev->conf.tx_fifo_reset = 1;
+	dev->conf.tx_fifo_reset = 0;
+
+	dev->out_link.addr = ((uint32_t)(uintptr_t)desc) & 0xfffff;
+	dev->out_link.start = 1;
+	dev->conf.tx_start = 1;
+}
+
+
+// Must be called with drv->lock held and FIFO drained, continues from oldest
+// descriptor owned by DMA
+static void IRAM_ATTR i2s_ring_restart(i2s_driver_t *drv) {
+	i2s_ring_t *ring = drv->ring;
+	i2s_dev_t *dev = drv->hw;
+	dev->conf.tx_start = 0;
+	ring->running = true;
+	i2s_trans_dma_start(drv, &ring->desc[ring->tail]);
+}
+
+
+static void IRAM_ATTR i2s_ring_isr(i2s_driver_t *drv) {
+	i2s_dev_t *dev = drv->hw;
+
+	const bool eof = dev->int_st.out_eof;
+	const bool stalled = dev->int_st.out_dscr_err;
+	dev->int_clr.val = dev->int_st.val;
+
+	// Words fetched before stall leave FIFO, before lock is taken
+	if (stalled) {
+		while (!dev->state.tx_idle);
+	}
+
+	BaseType_t higher_priority_task_woken = pdFALSE;
+
+	portENTER_CRITICAL_ISR(&drv->lock);
+	// Ring can be stopped and freed from other core after mode was checked
+	i2s_ring_t *ring = drv->ring;
+	if (ring == NULL) {
+		portEXIT_CRITICAL_ISR(&drv->lock);
+		return;
+	}
+	if (eof) {
+		// Interrupts can be merged, every descriptor up to last finished one is returned
+		const uint32_t last = dev->out_eof_des_addr;
+		while (ring->queued > 0) {
+			const lldesc_t *desc = &ring->desc[ring->tail];
+			ring->tail = (ring->tail + 1) % ring->desc_count;
+			ring->queued--;
+			xSemaphoreGiveFromISR(ring->free_semaphore, &higher_priority_task_woken);
+			if ((uint32_t)(uintptr_t)desc == last) {
+				break;
+			}
+		}
+	}
+	if (stalled) {
+		// DMA reached descriptor with owner 0, it could be submitted
+		// after DMA checked it
+		ring->running = false;
+		if (ring->queued > 0) {
+			i2s_ring_restart(drv);
+		}
+	}
+	portEXIT_CRITICAL_ISR(&drv->lock);
+
+	if (higher_priority_task_woken) {
+		portYIELD_FROM_ISR();
+	}
+}
+
+
+// Returns number of transactions up to chain ending with descriptor, 0 if
+// descriptor is not last one of unfinished transaction
+static size_t IRAM_ATTR i2s_count_finished(i2s_driver_t *drv, uint32_t last) {
+	for (size_t i = 0; i < drv->chain_queued; ++i) {
+		const i2s_chain_t *chain = &drv->chains[(drv->chain_tail + i) % drv->chain_count];
+		if ((uint32_t)(uintptr_t)chain->last == last) {
+			return i + 1;
+		}
+	}
+	return 0;
+}
+
+
+static void IRAM_ATTR i2s_isr(void *const params) {
+	i2s_driver_t *drv = (i2s_driver_t *)(params);
+	i2s_dev_t *dev = drv->hw;
+
+	if (drv->ring != NULL) {
+		i2s_ring_isr(drv);
+		return;
+	}
+
+	const bool eof = dev->int_st.out_eof;
+	const bool total_eof = dev->int_st.out_total_eof;
+	dev->int_clr.val = dev->int_st.val;
+
+	// DMA reached end of chain, remaining words are still in FIFO (max 64
+	// words). Transactions linked in meantime are restarted after that.
+	if (total_eof) {
+		while (!dev->state.tx_idle);
+		dev->conf.tx_start = 0;
+	}
+
+	portENTER_CRITICAL_ISR(&drv->lock);
+	// Interrupts can be merged, every transaction up to last finished one is
+	// done. Descriptor can belong to transaction, which was already counted.
+	const size_t finished = eof ? i2s_count_finished(drv, dev->out_eof_des_addr) : 0;
+	const size_t first = drv->chain_tail;
+	drv->chain_tail = (drv->chain_tail + finished) % drv->chain_count;
+	drv->chain_queued -= finished;
+	bool idle = false;
+	if (total_eof) {
+		if (drv->chain_queued > 0) {
+			i2s_trans_dma_start(drv, drv->chains[drv->chain_tail].first);
+		}
+		else {
+			drv->running = false;
+			idle = true;
+		}
+	}
+	portEXIT_CRITICAL_ISR(&drv->lock);
+
+	// Entries stay valid until slots of their transactions are returned
+	BaseType_t higher_priority_task_woken = pdFALSE;
+	for (size_t i = 0; i < finished; ++i) {
+		i2s_transaction_t *done = drv->chains[(first + i) % drv->chain_count].transaction;
+		if (drv->post_cb) {
+			drv->post_cb(done);
+			xSemaphoreGiveFromISR(drv->slot_semaphore, &higher_priority_task_woken);
+		}
+		else {
+			xQueueSendFromISR(drv->ret_queue, &done, &higher_priority_task_woken);
+		}
+	}
+	if (idle) {
+		xSemaphoreGiveFromISR(drv->tx_semaphore, &higher_priority_task_woken);
+	}
+	if (higher_priority_task_woken) {
+		portYIELD_FROM_ISR();
+	}
+}
+
+
+static esp_err_t i2s_intr_init(i2s_dev_t *dev) {
+	const int dev_num = (dev == &I2S0) ? 0 : 1;
+	i2s_driver_t *drv = get_driver(dev);
+
+	dev->int_ena.val = 0;
+	dev->int_clr.val = dev->int_st.val;
+
+	const esp_err_t ret = esp_intr_alloc(
+		dev_num == 0 ? ETS_I2S0_INTR_SOURCE : ETS_I2S1_INTR_SOURCE,
+		0,
+		i2s_isr,
+		drv,
+		&drv->intr_handle
+	);
+	if (ret != ESP_OK) {
+		ESP_LOGE(TAG, "Interrupt handler not allocated");
+		return ESP_FAIL;
+	}
+
+	dev->int_ena.out_eof = 1;
+	dev->int_ena.out_total_eof = 1;
+	esp_intr_enable(drv->intr_handle);
+	return ESP_OK;
+}
+
+
+esp_err_t i2s_init(i2s_dev_t *dev, const i2s_driver_config_t *config) {
+	i2s_driver_t *drv = get_driver(dev);
+	if (config->clock_div != 0 && (config->clock_div < I2S_CLOCK_DIV_MIN || config->clock_div > 255)) {
+		ESP_LOGE(TAG, "Invalid clock divider %d", config->clock_div);
+		return ESP_ERR_INVALID_ARG;
+	}
+	const int data_bits = config->data_bits > 0 ? config->data_bits : 8;
+	if (data_bits != 8 && data_bits != 16) {
+		ESP_LOGE(TAG, "Invalid data width %d", data_bits);
+		return ESP_ERR_INVALID_ARG;
+	}
+	drv->pre_cb = config->pre_cb;
+	drv->post_cb = config->post_cb;
+	drv->chain_head = 0;
+	drv->chain_tail = 0;
+	drv->chain_queued = 0;
+	drv->running = false;
+
+	drv->chains = NULL;
+	drv->ret_queue = NULL;
+	drv->tx_semaphore = NULL;
+	drv->slot_semaphore = NULL;
+	drv->intr_handle = NULL;
+	drv->dma = NULL;
+	drv->dma_count = MAX(i2s_dma_desc_count(config->max_transfer_size), 1);
+
+	// Queued transactions and one on bus, chains and result queue can hold
+	// all of them
+	drv->chain_count = config->queue_size + 1;
+	drv->chains = (i2s_chain_t *)calloc(drv->chain_count, sizeof(i2s_chain_t));
+	if (drv->chains == NULL) {
+		ESP_LOGE(TAG, "I2S queue not allocated");
+		goto cleanup;
+	}
+	drv->ret_queue = xQueueCreate(config->queue_size + 1, sizeof(i2s_transaction_t *));
+	if (drv->ret_queue == NULL) {
+		ESP_LOGE(TAG, "I2S result queue not allocated");
+		goto cleanup;
+	}
+	drv->tx_semaphore = xSemaphoreCreateBinary();
+	drv->slot_semaphore = xSemaphoreCreateCounting(config->queue_size + 1, config->queue_size + 1);
+	if (drv->tx_semaphore == NULL || drv->slot_semaphore == NULL) {
+		ESP_LOGE(TAG, "I2S semaphore not allocated");
+		goto cleanup;
+	}
+
+	drv->dma = (lldesc_t *)heap_caps_calloc(drv->dma_count * drv->chain_count, sizeof(lldesc_t), MALLOC_CAP_DMA);
+	if (drv->dma == NULL) {
+		ESP_LOGE(TAG, "I2S dma not allocated");
+		goto cleanup;
+	}
+
+	periph_module_enable(dev == &I2S0 ? PERIPH_I2S0_MODULE : PERIPH_I2S1_MODULE);
+
+	i2s_reset_fifo(dev);
+	i2s_set_lcd_mode(dev, data_bits);
+	i2s_set_speed(dev, config->clock_div > 0 ? config->clock_div : I2S_CLOCK_DIV_DEFAULT, data_bits);
+	i2s_configure_tx(dev);
+	i2s_configure_dma(dev);
+
+	if (i2s_intr_init(dev) != ESP_OK) {
+		goto cleanup;
+	}
+
+	drv->data_bits = data_bits;
+	drv->pin_wr = config->pin_wr;
+	for (int i = 0; i < data_bits; ++i) {
+		drv->pin_data[i] = config->pin_data[i];
+		// Input stays enabled for reads with detached pins
+		gpio_set_direction(drv->pin_data[i], GPIO_MODE_INPUT_OUTPUT);
+	}
+	gpio_set_direction(drv->pin_wr, GPIO_MODE_OUTPUT);
+	i2s_attach_pins(dev);
+
+	return ESP_OK;
+
+cleanup:
+	i2s_deinit(dev);
+	return ESP_FAIL;
+}
+
+
+void i2s_deinit(i2s_dev_t *dev) {
+	i2s_driver_t *drv = get_driver(dev);
+	if (drv->intr_handle != NULL) {
+		dev->int_ena.val = 0;
+		esp_intr_free(drv->intr_handle);
+		drv->intr_handle = NULL;
+	}
+	if (drv->dma != NULL) {
+		heap_caps_free(drv->dma);
+		drv->dma = NULL;
+		drv->dma_count = 0;
+	}
+	if (drv->slot_semaphore != NULL) {
+		vSemaphoreDelete(drv->slot_semaphore);
+		drv->slot_semaphore = NULL;
+	}
+	if (drv->tx_semaphore != NULL) {
+		vSemaphoreDelete(drv->tx_semaphore);
+		drv->tx_semaphore = NULL;
+	}
+	if (drv->ret_queue != NULL) {
+		vQueueDelete(drv->ret_queue);
+		drv->ret_queue = NULL;
+	}
+	free(drv->chains);
+	drv->chains = NULL;
+	drv->chain_count = 0;
+	drv->chain_queued = 0;
+	drv->running = false;
+}
+
+
+esp_err_t i2s_trans_enqueue(i2s_dev_t *dev, i2s_transaction_t *transaction, TickType_t ticks_to_wait) {
+	i2s_driver_t *drv = get_driver(dev);
+	if (transaction->length == 0 || (transaction->length & 0x03) != 0 || (transaction->desc == NULL && i2s_dma_desc_count(transaction->length) > drv->dma_count)) {
+		ESP_LOGE(TAG, "Invalid transaction length %d", (int)transaction->length);
+		return ESP_ERR_INVALID_SIZE;
+	}
+
+	// Slot is returned when result is retrieved, or after post_cb
+	if (xSemaphoreTake(drv->slot_semaphore, ticks_to_wait) != pdTRUE) {
+		return ESP_ERR_TIMEOUT;
+	}
+
+	portENTER_CRITICAL(&drv->lock);
+	// Entry and its descriptors are free, transactions finish in order of
+	// entries and only queue_size + 1 transactions hold slots
+	i2s_chain_t *chain = &drv->chains[drv->chain_head];
+	chain->transaction = transaction;
+	if (transaction->desc == NULL) {
+		chain->first = i2s_build_dma_chain(drv->dma + drv->chain_head * drv->dma_count, drv->dma_count, transaction->data, transaction->length);
+	}
+	else {
+		chain->first = transaction->desc;
+	}
+	// Caller chain can still be linked to chain of its previous use
+	chain->last = chain->first;
+	while (!chain->last->eof) {
+		chain->last = chain->last->qe.stqe_next;
+	}
+	chain->last->qe.stqe_next = NULL;
+	if (drv->pre_cb) {
+		drv->pre_cb(transaction);
+	}
+
+	if (!drv->running) {
+		drv->running = true;
+		i2s_trans_dma_start(drv, chain->first);
+	}
+	else if (drv->chain_queued > 0) {
+		// DMA continues to this chain, unless it has already fetched end of
+		// previous one, interrupt restarts it then
+		drv->chains[(drv->chain_head + drv->chain_count - 1) % drv->chain_count].last->qe.stqe_next = chain->first;
+	}
+	drv->chain_head = (drv->chain_head + 1) % drv->chain_count;
+	drv->chain_queued++;
+	portEXIT_CRITICAL(&drv->lock);
+
+	return ESP_OK;
+}
+
+
+esp_err_t i2s_trans_get_result(i2s_dev_t *dev, i2s_transaction_t **transaction, TickType_t ticks_to_wait) {
+	i2s_driver_t *drv = get_driver(dev);
+	if (drv->post_cb) {
+		return ESP_ERR_INVALID_STATE;
+	}
+	if (xQueueReceive(drv->ret_queue, transaction, ticks_to_wait) != pdTRUE) {
+		return ESP_ERR_TIMEOUT;
+	}
+	xSemaphoreGive(drv->slot_semaphore);
+	return ESP_OK;
+}
+
+
+void i2s_wait_idle(i2s_dev_t *dev) {
+	i2s_driver_t *drv = get_driver(dev);
+	while (1) {
+		portENTER_CRITICAL(&drv->lock);
+		const bool idle = !drv->running;
+		portEXIT_CRITICAL(&drv->lock);
+		if (idle) {
+			return;
+		}
+		xSemaphoreTake(drv->tx_semaphore, portMAX_DELAY);
+	}
+}
+
+
+void i2s_attach_pins(i2s_dev_t *dev) {
+	i2s_driver_t *drv = get_driver(dev);
+	const int sig_data_base = (dev == &I2S0) ? I2S0O_DATA_OUT0_IDX : I2S1O_DATA_OUT0_IDX;
+	const int sig_wr = (dev == &I2S0) ? I2S0O_WS_OUT_IDX : I2S1O_WS_OUT_IDX;
+
+	// I2Sx_DATA_OUT0..15, 8-bit LCD mode drives only first 8 signals
+	for (int i = 0; i < drv->data_bits; ++i) {
+		gpio_matrix_out(drv->pin_data[i], sig_data_base + i, false, false);
+	}
+	gpio_matrix_out(drv->pin_wr, sig_wr, true, false);
+}
+
+
+void i2s_detach_pins(i2s_dev_t *dev) {
+	i2s_driver_t *drv = get_driver(dev);
+	for (int i = 0; i < drv->data_bits; ++i) {
+		gpio_matrix_out(drv->pin_data[i], SIG_GPIO_OUT_IDX, false, false);
+	}
+	gpio_matrix_out(drv->pin_wr, SIG_GPIO_OUT_IDX, false, false);
+}
+
+
+esp_err_t i2s_set_clock_div(i2s_dev_t *dev, int clock_div) {
+	if (clock_div < I2S_CLOCK_DIV_MIN || clock_div > 255) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	i2s_wait_idle(dev);
+	dev->clkm_conf.clkm_div_num = clock_div;
+	return ESP_OK;
+}
+
+
+static void i2s_ring_free(i2s_ring_t *ring) {
+	if (ring->free_semaphore != NULL) {
+		vSemaphoreDelete(ring->free_semaphore);
+	}
+	heap_caps_free(ring->desc);
+	heap_caps_free(ring->buffers);
+	free(ring);
+}
+
+
+esp_err_t i2s_ring_start(i2s_dev_t *dev, const i2s_ring_config_t *config) {
+	i2s_driver_t *drv = get_driver(dev);
+	if (config->desc_count < 2 || config->buffer_size == 0 || (config->buffer_size & 0x03) != 0 || config->buffer_size > I2S_DMA_MAX_LENGTH || config->prefill > config->desc_count) {
+		ESP_LOGE(TAG, "Invalid ring configuration");
+		return ESP_ERR_INVALID_ARG;
+	}
+	if (drv->ring != NULL) {
+		return ESP_ERR_INVALID_STATE;
+	}
+	i2s_wait_idle(dev);
+
+	i2s_ring_t *ring = (i2s_ring_t *)calloc(1, sizeof(i2s_ring_t));
+	if (ring == NULL) {
+		ESP_LOGE(TAG, "I2S ring not allocated");
+		return ESP_ERR_NO_MEM;
+	}
+	ring->desc_count = config->desc_count;
+	ring->buffer_size = config->buffer_size;
+	ring->prefill = MAX(config->prefill, 1);
+	ring->desc = (lldesc_t *)heap_caps_calloc(config->desc_count, sizeof(lldesc_t), MALLOC_CAP_DMA);
+	ring->buffers = (uint8_t *)heap_caps_malloc(config->desc_count * config->buffer_size, MALLOC_CAP_DMA);
+	ring->free_semaphore = xSemaphoreCreateCounting(config->desc_count, config->desc_count);
+	if (ring->desc == NULL || ring->buffers == NULL || ring->free_semaphore == NULL) {
+		ESP_LOGE(TAG, "I2S ring buffers not allocated");
+		i2s_ring_free(ring);
+		return ESP_ERR_NO_MEM;
+	}
+
+	// Every descriptor raises out_eof, owner 0 marks descriptor owned by CPU
+	for (size_t i = 0; i < ring->desc_count; ++i) {
+		lldesc_t *desc = &ring->desc[i];
+		desc->size = ring->buffer_size;
+		desc->length = ring->buffer_size;
+		desc->buf = ring->buffers + i * ring->buffer_size;
+		desc->offset = 0;
+		desc->sosf = 0;
+		desc->owner = 0;
+		desc->eof = 1;
+		desc->qe.stqe_next = &ring->desc[(i + 1) % ring->desc_count];
+	}
+
+	portENTER_CRITICAL(&drv->lock);
+	dev->int_ena.val = 0;
+	dev->int_clr.val = dev->int_st.val;
+	drv->ring = ring;
+	dev->lc_conf.out_auto_wrback = 1;
+	dev->int_ena.out_eof = 1;
+	dev->int_ena.out_dscr_err = 1;
+	portEXIT_CRITICAL(&drv->lock);
+
+	return ESP_OK;
+}
+
+
+uint8_t *i2s_ring_get_buffer(i2s_dev_t *dev, TickType_t ticks_to_wait) {
+	i2s_ring_t *ring = get_driver(dev)->ring;
+	if (xSemaphoreTake(ring->free_semaphore, ticks_to_wait) != pdTRUE) {
+		return NULL;
+	}
+	return ring->buffers + ring->head * ring->buffer_size;
+}
+
+
+// Restart from task, when DMA is stopped or wasn't started and interrupt
+// won't restart it. FIFO drains without lock held, interrupt can restart
+// ring in meantime.
+static void i2s_ring_resume(i2s_driver_t *drv, size_t min_queued) {
+	i2s_ring_t *ring = drv->ring;
+	i2s_dev_t *dev = drv->hw;
+	while (!dev->state.tx_idle);
+	portENTER_CRITICAL(&drv->lock);
+	if (!ring->running && ring->queued >= min_queued) {
+		i2s_ring_restart(drv);
+	}
+	portEXIT_CRITICAL(&drv->lock);
+}
+
+
+void i2s_ring_submit(i2s_dev_t *dev, size_t length) {
+	i2s_driver_t *drv = get_driver(dev);
+	i2s_ring_t *ring = drv->ring;
+	lldesc_t *desc = &ring->desc[ring->head];
+	desc->length = MIN(length, ring->buffer_size);
+
+	portENTER_CRITICAL(&drv->lock);
+	desc->owner = 1;
+	ring->head = (ring->head + 1) % ring->desc_count;
+	ring->queued++;
+	const bool resume = !ring->running && ring->queued >= ring->prefill;
+	portEXIT_CRITICAL(&drv->lock);
+
+	if (resume) {
+		i2s_ring_resume(drv, ring->prefill);
+	}
+}
+
+
+void i2s_ring_stop(i2s_dev_t *dev) {
+	i2s_driver_t *drv = get_driver(dev);
+	i2s_ring_t *ring = drv->ring;
+	if (ring == NULL) {
+		return;
+	}
+
+	// Start remaining buffers, which didn't reach prefill
+	portENTER_CRITICAL(&drv->lock);
+	const bool resume = !ring->running && ring->queued > 0;
+	portEXIT_CRITICAL(&drv->lock);
+	if (resume) {
+		i2s_ring_resume(drv, 1);
+	}
+
+	// All descriptors are returned to CPU, DMA stops on the next one and
+	// isn't restarted
+	for (size_t i = 0; i < ring->desc_count; ++i) {
+		xSemaphoreTake(ring->free_semaphore, portMAX_DELAY);
+	}
+	while (!dev->state.tx_idle);
+
+	portENTER_CRITICAL(&drv->lock);
+	dev->conf.tx_start = 0;
+	dev->out_link.stop = 1;
+	dev->int_ena.val = 0;
+	dev->int_clr.val = dev->int_st.val;
+	dev->lc_conf.out_auto_wrback = 0;
+	dev->int_ena.out_eof = 1;
+	dev->int_ena.out_total_eof = 1;
+	drv->ring = NULL;
+	portEXIT_CRITICAL(&drv->lock);
+
+	i2s_ring_free(ring);
+}
@@ -0,0 +1,254 @@
+// SPDX-License-Identifier: MIT
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "ili9481_pipeline.h"
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+
+#define PIPELINE_STACK_SIZE 4096
+
+
+static const char *TAG = "ili9481_pipeline";
+
+
+typedef struct strip {
+	ili9481_color_t *buffer;
+	uint16_t y;
+	uint16_t lines; // 0 stops task
+} strip_t;
+
+struct ili9481_pipeline {
+	ili9481_driver_t *driver;
+	ili9481_pipeline_config_t config;
+	ili9481_color_t *buffers;
+	QueueHandle_t free_queue; // Buffers ready for rendering
+	QueueHandle_t ready_queue; // Rendered strips
+	SemaphoreHandle_t frame_request;
+	SemaphoreHandle_t frame_rendered;
+	SemaphoreHandle_t frame_transferred;
+	SemaphoreHandle_t stopped;
+	TaskHandle_t render_task;
+	TaskHandle_t bus_task;
+	volatile bool running;
+	volatile uint32_t frames_requested;
+	volatile uint32_t frames_transferred;
+	portMUX_TYPE lock;
+	ili9481_pipeline_stats_t stats;
+	int64_t start_time;
+};
+
+
+static void render_task(void *arg) {
+	ili9481_pipeline_t *pipeline = (ili9481_pipeline_t *)arg;
+	ili9481_driver_t *driver = pipeline->driver;
+	const uint16_t strip_lines = pipeline->config.strip_lines;
+
+	while (1) {
+		xSemaphoreTake(pipeline->frame_request, portMAX_DELAY);
+		if (!pipeline->running) {
+			break;
+		}
+		for (uint16_t y = 0; y < driver->display_height; y += strip_lines) {
+			strip_t strip;
+			int64_t time = esp_timer_get_time();
+			xQueueReceive(pipeline->free_queue, &strip.buffer, portMAX_DELAY);
+			const int64_t wait_end = esp_timer_get_time();
+			strip.y = y;
+			strip.lines = MIN(strip_lines, driver->display_height - y);
+			pipeline->config.render(driver, strip.buffer, strip.y, strip.lines, pipeline->config.user_data);
+			const int64_t render_end = esp_timer_get_time();
+			xQueueSend(pipeline->ready_queue, &strip, portMAX_DELAY);
+
+			portENTER_CRITICAL(&pipeline->lock);
+			pipeline->stats.render_wait_us += wait_end - time;
+			pipeline->stats.render_busy_us += render_end - wait_end;
+			portEXIT_CRITICAL(&pipeline->lock);
+		}
+		xSemaphoreGive(pipeline->frame_rendered);
+	}
+
+	xSemaphoreGive(pipeline->stopped);
+	vTaskDelete(NULL);
+}
+
+
+static void bus_task(void *arg) {
+	ili9481_pipeline_t *pipeline = (ili9481_pipeline_t *)arg;
+	ili9481_driver_t *driver = pipeline->driver;
+	bool in_frame = false;
+
+	while (1) {
+		strip_t strip;
+		const int64_t wait_start = esp_timer_get_time();
+		xQueueReceive(pipeline->ready_queue, &strip, portMAX_DELAY);
+		if (strip.lines == 0) {
+			break;
+		}
+		const int64_t wait_end = esp_timer_get_time();
+
+		if (strip.y == 0) {
+			if (pipeline->config.pixel_format != 0 && pipeline->config.pixel_format != driver->pixel_format) {
+				ili9481_set_pixel_format(driver, pipeline->config.pixel_format);
+			}
+			ili9481_set_window(driver, 0, 0, driver->display_width - 1, driver->display_height - 1);
+		}
+		// Data are copied to bus buffers, strip is free after write returns
+		ili9481_write_pixels(driver, strip.buffer, (size_t)driver->display_width * strip.lines);
+		const bool last = strip.y + strip.lines >= driver->display_height;
+		if (last) {
+			ili9481_wait_until_queue_empty(driver);
+		}
+		xQueueSend(pipeline->free_queue, &strip.buffer, portMAX_DELAY);
+		const int64_t write_end = esp_timer_get_time();
+
+		portENTER_CRITICAL(&pipeline->lock);
+		if (in_frame) {
+			pipeline->stats.bus_wait_us += wait_end - wait_start;
+		}
+		pipeline->stats.bus_busy_us += write_end - wait_end;
+		pipeline->stats.strips++;
+		if (last) {
+			pipeline->stats.frames++;
+		}
+		portEXIT_CRITICAL(&pipeline->lock);
+
+		in_frame = !last;
+		if (last) {
+			pipeline->frames_transferred++;
+			xSemaphoreGive(pipeline->frame_transferred);
+		}
+	}
+
+	xSemaphoreGive(pipeline->stopped);
+	vTaskDelete(NULL);
+}
+
+
+static void pipeline_free(ili9481_pipeline_t *pipeline) {
+	if (pipeline->free_queue != NULL) {
+		vQueueDelete(pipeline->free_queue);
+	}
+	if (pipeline->ready_queue != NULL) {
+		vQueueDelete(pipeline->ready_queue);
+	}
+	if (pipeline->frame_request != NULL) {
+		vSemaphoreDelete(pipeline->frame_request);
+	}
+	if (pipeline->frame_rendered != NULL) {
+		vSemaphoreDelete(pipeline->frame_rendered);
+	}
+	if (pipeline->frame_transferred != NULL) {
+		vSemaphoreDelete(pipeline->frame_transferred);
+	}
+	if (pipeline->stopped != NULL) {
+		vSemaphoreDelete(pipeline->stopped);
+	}
+	heap_caps_free(pipeline->buffers);
+	free(pipeline);
+}
+
+
+esp_err_t ili9481_pipeline_create(ili9481_driver_t *driver, const ili9481_pipeline_config_t *config, ili9481_pipeline_t **pipeline_out) {
+	if (config->buffer_count < 2 || config->strip_lines == 0 || config->render == NULL) {
+		ESP_LOGE(TAG, "invalid configuration");
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	ili9481_pipeline_t *pipeline = (ili9481_pipeline_t *)calloc(1, sizeof(ili9481_pipeline_t));
+	if (pipeline == NULL) {
+		ESP_LOGE(TAG, "pipeline not allocated");
+		return ESP_ERR_NO_MEM;
+	}
+	pipeline->driver = driver;
+	pipeline->config = *config;
+	pipeline->lock = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+
+	const size_t strip_size = (size_t)driver->display_width * config->strip_lines;
+	pipeline->buffers = (ili9481_color_t *)heap_caps_malloc(strip_size * config->buffer_count * sizeof(ili9481_color_t), MALLOC_CAP_8BIT);
+	pipeline->free_queue = xQueueCreate(config->buffer_count, sizeof(ili9481_color_t *));
+	pipeline->ready_queue = xQueueCreate(config->buffer_count + 1, sizeof(strip_t));
+	pipeline->frame_request = xSemaphoreCreateBinary();
+	pipeline->frame_rendered = xSemaphoreCreateBinary();
+	pipeline->frame_transferred = xSemaphoreCreateBinary();
+	pipeline->stopped = xSemaphoreCreateCounting(2, 0);
+	if (pipeline->buffers == NULL || pipeline->free_queue == NULL || pipeline->ready_queue == NULL || pipeline->frame_request == NULL || pipeline->frame_rendered == NULL || pipeline->frame_transferred == NULL || pipeline->stopped == NULL) {
+		ESP_LOGE(TAG, "pipeline resources not allocated");
+		pipeline_free(pipeline);
+		return ESP_ERR_NO_MEM;
+	}
+
+	for (size_t i = 0; i < config->buffer_count; ++i) {
+		ili9481_color_t *buffer = pipeline->buffers + i * strip_size;
+		xQueueSend(pipeline->free_queue, &buffer, 0);
+	}
+
+	pipeline->running = true;
+	pipeline->start_time = esp_timer_get_time();
+	if (xTaskCreatePinnedToCore(render_task, "ili9481_render", PIPELINE_STACK_SIZE, pipeline, config->priority, &pipeline->render_task, config->render_core) != pdPASS) {
+		ESP_LOGE(TAG, "render task not created");
+		pipeline_free(pipeline);
+		return ESP_ERR_NO_MEM;
+	}
+	if (xTaskCreatePinnedToCore(bus_task, "ili9481_bus", PIPELINE_STACK_SIZE, pipeline, config->priority, &pipeline->bus_task, config->bus_core) != pdPASS) {
+		ESP_LOGE(TAG, "bus task not created");
+		pipeline->running = false;
+		xSemaphoreGive(pipeline->frame_request);
+		xSemaphoreTake(pipeline->stopped, portMAX_DELAY);
+		pipeline_free(pipeline);
+		return ESP_ERR_NO_MEM;
+	}
+
+	*pipeline_out = pipeline;
+	return ESP_OK;
+}
+
+
+void ili9481_pipeline_destroy(ili9481_pipeline_t *pipeline) {
+	ili9481_pipeline_wait_transferred(pipeline);
+	pipeline->running = false;
+	xSemaphoreGive(pipeline->frame_request);
+	const strip_t stop = {NULL, 0, 0};
+	xQueueSend(pipeline->ready_queue, &stop, portMAX_DELAY);
+	xSemaphoreTake(pipeline->stopped, portMAX_DELAY);
+	xSemaphoreTake(pipeline->stopped, portMAX_DELAY);
+	pipeline_free(pipeline);
+}
+
+
+void ili9481_pipeline_render_frame(ili9481_pipeline_t *pipeline) {
+	pipeline->frames_requested++;
+	xSemaphoreGive(pipeline->frame_request);
+	xSemaphoreTake(pipeline->frame_rendered, portMAX_DELAY);
+}
+
+
+void ili9481_pipeline_wait_transferred(ili9481_pipeline_t *pipeline) {
+	while (pipeline->frames_transferred != pipeline->frames_requested) {
+		xSemaphoreTake(pipeline->frame_transferred, portMAX_DELAY);
+	}
+}
+
+
+void ili9481_pipeline_get_stats(ili9481_pipeline_t *pipeline, ili9481_pipeline_stats_t *stats) {
+	portENTER_CRITICAL(&pipeline->lock);
+	*stats = pipeline->stats;
+	portEXIT_CRITICAL(&pipeline->lock);
+	stats->elapsed_us = esp_timer_get_time() - pipeline->start_time;
+}
+
+
+void ili9481_pipeline_reset_stats(ili9481_pipeline_t *pipeline) {
+	portENTER_CRITICAL(&pipeline->lock);
+	memset(&pipeline->stats, 0, sizeof(pipeline->stats));
+	pipeline->start_time = esp_timer_get_time();
+	portEXIT_CRITICAL(&pipeline->lock);
+}
@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: MIT
+
+#include <stdlib.h>
+
+#include "ili9481_power.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+
+static const char *TAG = "ili9481_power";
+
+
+struct ili9481_power {
+	ili9481_driver_t *driver;
+	ili9481_power_config_t config;
+	ili9481_power_mode_t mode;
+	int64_t mode_start;
+	ili9481_power_stats_t stats;
+};
+
+
+esp_err_t ili9481_power_create(ili9481_driver_t *driver, const ili9481_power_config_t *config, ili9481_power_t **power_out) {
+	if (config->partial_start > config->partial_end || config->partial_end >= driver->display_height) {
+		ESP_LOGE(TAG, "invalid partial area");
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	ili9481_power_t *power = (ili9481_power_t *)calloc(1, sizeof(ili9481_power_t));
+	if (power == NULL) {
+		ESP_LOGE(TAG, "power manager not allocated");
+		return ESP_ERR_NO_MEM;
+	}
+	power->driver = driver;
+	power->config = *config;
+	power->mode = ILI9481_POWER_NORMAL;
+
+	// Partial area is set once, entering partial mode is single command
+	const uint8_t burst[] = {
+		ILI9481_SET_PARTIAL_AREA, 4,
+		(uint8_t)(config->partial_start >> 8),
+		(uint8_t)(config->partial_start & 0xff),
+		(uint8_t)(config->partial_end >> 8),
+		(uint8_t)(config->partial_end & 0xff),
+	};
+	ili9481_write_burst(driver, burst, sizeof(burst));
+	if (config->setup != NULL) {
+		ili9481_run_commands(driver, config->setup);
+	}
+	ili9481_wait_until_queue_empty(driver);
+
+	power->mode_start = esp_timer_get_time();
+	*power_out = power;
+	return ESP_OK;
+}
+
+
+void ili9481_power_destroy(ili9481_power_t *power) {
+	ili9481_power_set_mode(power, ILI9481_POWER_NORMAL);
+	free(power);
+}
+
+
+void ili9481_power_set_mode(ili9481_power_t *power, ili9481_power_mode_t mode) {
+	if (mode == power->mode) {
+		return;
+	}
+	const int64_t start = esp_timer_get_time();
+
+	// Both changes are sent as one burst
+	uint8_t burst[4];
+	size_t length = 0;
+	const bool partial = mode & ILI9481_POWER_PARTIAL;
+	const bool idle = mode & ILI9481_POWER_IDLE;
+	if (partial != (bool)(power->mode & ILI9481_POWER_PARTIAL)) {
+		burst[length++] = partial ? ILI9481_ENTER_PARTIAL_MODE : ILI9481_ENTER_NORMAL_MODE;
+		burst[length++] = 0;
+	}
+	if (idle != (bool)(power->mode & ILI9481_POWER_IDLE)) {
+		burst[length++] = idle ? ILI9481_ENTER_IDLE_MODE : ILI9481_EXIT_IDLE_MODE;
+		burst[length++] = 0;
+	}
+	ili9481_write_burst(power->driver, burst, length);
+	ili9481_wait_until_queue_empty(power->driver);
+
+	const int64_t end = esp_timer_get_time();
+	const int64_t latency = end - start;
+	power->stats.time_us[power->mode] += start - power->mode_start;
+	power->stats.transitions[mode]++;
+	power->stats.last_us[mode] = latency;
+	if (latency > power->stats.max_us[mode]) {
+		power->stats.max_us[mode] = latency;
+	}
+	power->mode = mode;
+	power->mode_start = end;
+	ESP_LOGD(TAG, "mode %d, %d us", mode, (int)latency);
+}
+
+
+ili9481_power_mode_t ili9481_power_get_mode(ili9481_power_t *power) {
+	return power->mode;
+}
+
+
+ili9481_power_mode_t ili9481_power_select(ili9481_power_t *power, bool band_only, bool primary_colors) {
+	const ili9481_power_mode_t mode = (band_only ? ILI9481_POWER_PARTIAL : ILI9481_POWER_NORMAL) | (primary_colors ? ILI9481_POWER_IDLE : ILI9481_POWER_NORMAL);
+	ili9481_power_set_mode(power, mode);
+	return mode;
+}
+
+
+void ili9481_power_get_stats(ili9481_power_t *power, ili9481_power_stats_t *stats) {
+	*stats = power->stats;
+	stats->time_us[power->mode] += esp_timer_get_time() - power->mode_start;
+}
@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+// Helpers shared between bus implementations, not part of public API
+
+#include "ili9481.h"
+
+
+// Configure control and data pins, build data table if use_table is set
+esp_err_t ili9481_gpio_bus_init(ili9481_driver_t *driver, bool use_table);
+void ili9481_gpio_bus_deinit(ili9481_driver_t *driver);
+// Table driven writer, pins must be configured with use_table
+void ili9481_gpio_write_bytes(ili9481_driver_t *driver, const uint8_t *data, size_t length);
+// Pairs of bytes (high, low) written to 16-bit bus
+void ili9481_gpio_write_words(ili9481_driver_t *driver, const uint8_t *data, size_t length);
+void ili9481_gpio_set_dc(ili9481_driver_t *driver, bool data);
+void ili9481_gpio_read_bytes(ili9481_driver_t *driver, uint8_t *data, size_t length);
+
+
+// Pixel data on 16-bit bus are written as words, commands and parameters as bytes
+static inline bool ili9481_is_word_data(const ili9481_driver_t *driver) {
+	return driver->bus_width == 16 && driver->memory_write;
+}
+
+
+// Split burst to command and parameter writes, parameters are always bytes
+static inline void ili9481_split_burst(ili9481_driver_t *driver, const uint8_t *burst, size_t length, void (*write_command)(ili9481_driver_t *, uint8_t), void (*write_data)(ili9481_driver_t *, const uint8_t *, size_t)) {
+	const uint8_t *end = burst + length;
+	while (burst + 2 <= end) {
+		const uint8_t command = burst[0];
+		const uint8_t data_size = burst[1];
+		burst += 2;
+		write_command(driver, command);
+		if (data_size > 0) {
+			write_data(driver, burst, data_size);
+			burst += data_size;
+		}
+	}
+}
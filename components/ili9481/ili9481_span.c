@@ -0,0 +1,303 @@
+// SPDX-License-Identifier: MIT
+
+#include <sys/param.h>
+
+#include "ili9481_span.h"
+
+
+#define IS_ALIGNED(ptr) ((((uintptr_t)(ptr)) & 0x03) == 0)
+
+
+static inline uint8_t color_b(ili9481_color_t color) {
+	return (color >> 8) & 0xf8;
+}
+
+
+static inline uint8_t color_g(ili9481_color_t color) {
+	return (color >> 3) & 0xfc;
+}
+
+
+static inline uint8_t color_r(ili9481_color_t color) {
+	return (color << 3) & 0xf8;
+}
+
+
+void ili9481_span_fill(ili9481_color_t *dst, ili9481_color_t color, size_t count) {
+	if (count > 0 && !IS_ALIGNED(dst)) {
+		*dst++ = color;
+		count--;
+	}
+	const uint32_t pattern = color | ((uint32_t)color << 16);
+	uint32_t *out = (uint32_t *)dst;
+	for (; count >= 8; count -= 8) {
+		out[0] = pattern;
+		out[1] = pattern;
+		out[2] = pattern;
+		out[3] = pattern;
+		out += 4;
+	}
+	for (; count >= 2; count -= 2) {
+		*out++ = pattern;
+	}
+	if (count > 0) {
+		*(ili9481_color_t *)out = color;
+	}
+}
+
+
+void ili9481_span_fill_packed16(uint8_t *dst, ili9481_color_t color, size_t count) {
+	// Pixels don't match word boundary on odd address
+	if (((uintptr_t)dst & 0x01) != 0) {
+		while (count--) {
+			*dst++ = color >> 8;
+			*dst++ = color & 0xff;
+		}
+		return;
+	}
+	if (count > 0 && !IS_ALIGNED(dst)) {
+		*dst++ = color >> 8;
+		*dst++ = color & 0xff;
+		count--;
+	}
+
+	const uint32_t half = (color >> 8) | ((color & 0xff) << 8);
+	const uint32_t pattern = half | (half << 16);
+	uint32_t *out = (uint32_t *)dst;
+	for (; count >= 8; count -= 8) {
+		out[0] = pattern;
+		out[1] = pattern;
+		out[2] = pattern;
+		out[3] = pattern;
+		out += 4;
+	}
+	for (; count >= 2; count -= 2) {
+		*out++ = pattern;
+	}
+	if (count > 0) {
+		dst = (uint8_t *)out;
+		dst[0] = color >> 8;
+		dst[1] = color & 0xff;
+	}
+}
+
+
+// 4 pixels are 12 bytes, pattern repeats every 3 words
+void ili9481_span_fill_packed18(uint8_t *dst, ili9481_color_t color, size_t count) {
+	const uint8_t b = color_b(color);
+	const uint8_t g = color_g(color);
+	const uint8_t r = color_r(color);
+
+	while (count > 0 && !IS_ALIGNED(dst)) {
+		*dst++ = b;
+		*dst++ = g;
+		*dst++ = r;
+		count--;
+	}
+
+	const uint32_t w0 = b | (g << 8) | (r << 16) | ((uint32_t)b << 24);
+	const uint32_t w1 = g | (r << 8) | (b << 16) | ((uint32_t)g << 24);
+	const uint32_t w2 = r | (b << 8) | (g << 16) | ((uint32_t)r << 24);
+	uint32_t *out = (uint32_t *)dst;
+	for (; count >= 8; count -= 8) {
+		out[0] = w0;
+		out[1] = w1;
+		out[2] = w2;
+		out[3] = w0;
+		out[4] = w1;
+		out[5] = w2;
+		out += 6;
+	}
+	for (; count >= 4; count -= 4) {
+		out[0] = w0;
+		out[1] = w1;
+		out[2] = w2;
+		out += 3;
+	}
+
+	dst = (uint8_t *)out;
+	while (count--) {
+		*dst++ = b;
+		*dst++ = g;
+		*dst++ = r;
+	}
+}
+
+
+size_t ili9481_span_pack16(uint8_t *dst, const ili9481_color_t *src, size_t count) {
+	const size_t length = count * 2;
+	if (!IS_ALIGNED(dst) || !IS_ALIGNED(src)) {
+		while (count--) {
+			const ili9481_color_t color = *src++;
+			*dst++ = color >> 8;
+			*dst++ = color & 0xff;
+		}
+		return length;
+	}
+
+	// Swap bytes of both halfwords
+	const uint32_t *in = (const uint32_t *)src;
+	uint32_t *out = (uint32_t *)dst;
+	for (; count >= 4; count -= 4) {
+		const uint32_t a = in[0];
+		const uint32_t b = in[1];
+		out[0] = ((a & 0x00ff00ff) << 8) | ((a >> 8) & 0x00ff00ff);
+		out[1] = ((b & 0x00ff00ff) << 8) | ((b >> 8) & 0x00ff00ff);
+		in += 2;
+		out += 2;
+	}
+	if (count >= 2) {
+		const uint32_t a = *in++;
+		*out++ = ((a & 0x00ff00ff) << 8) | ((a >> 8) & 0x00ff00ff);
+		count -= 2;
+	}
+	if (count > 0) {
+		const ili9481_color_t color = *(const ili9481_color_t *)in;
+		dst = (uint8_t *)out;
+		dst[0] = color >> 8;
+		dst[1] = color & 0xff;
+	}
+	return length;
+}
+
+
+size_t ili9481_span_pack18(uint8_t *dst, const ili9481_color_t *src, size_t count) {
+	const size_t length = count * 3;
+	while (count > 0 && !IS_ALIGNED(dst)) {
+		const ili9481_color_t color = *src++;
+		*dst++ = color_b(color);
+		*dst++ = color_g(color);
+		*dst++ = color_r(color);
+		count--;
+	}
+
+	uint32_t *out = (uint32_t *)dst;
+	for (; count >= 4; count -= 4) {
+		const ili9481_color_t c0 = src[0];
+		const ili9481_color_t c1 = src[1];
+		const ili9481_color_t c2 = src[2];
+		const ili9481_color_t c3 = src[3];
+		out[0] = color_b(c0) | (color_g(c0) << 8) | (color_r(c0) << 16) | ((uint32_t)color_b(c1) << 24);
+		out[1] = color_g(c1) | (color_r(c1) << 8) | (color_b(c2) << 16) | ((uint32_t)color_g(c2) << 24);
+		out[2] = color_r(c2) | (color_b(c3) << 8) | (color_g(c3) << 16) | ((uint32_t)color_r(c3) << 24);
+		src += 4;
+		out += 3;
+	}
+
+	dst = (uint8_t *)out;
+	while (count--) {
+		const ili9481_color_t color = *src++;
+		*dst++ = color_b(color);
+		*dst++ = color_g(color);
+		*dst++ = color_r(color);
+	}
+	return length;
+}
+
+
+// Green is moved to upper halfword, all channels are multiplied at once
+// with 5 spare bits per channel
+static inline uint32_t expand_color(ili9481_color_t color) {
+	return (color | ((uint32_t)color << 16)) & 0x07e0f81f;
+}
+
+
+static inline ili9481_color_t blend_color(ili9481_color_t dst, ili9481_color_t src, uint32_t alpha, uint32_t inverse) {
+	const uint32_t mixed = ((expand_color(src) * alpha + expand_color(dst) * inverse) >> 5) & 0x07e0f81f;
+	return mixed | (mixed >> 16);
+}
+
+
+void ili9481_span_blend(ili9481_color_t *dst, const ili9481_color_t *src, uint8_t alpha, size_t count) {
+	const uint32_t alpha5 = (alpha + 4) >> 3;
+	const uint32_t inverse = 32 - alpha5;
+	for (; count >= 2; count -= 2) {
+		dst[0] = blend_color(dst[0], src[0], alpha5, inverse);
+		dst[1] = blend_color(dst[1], src[1], alpha5, inverse);
+		dst += 2;
+		src += 2;
+	}
+	if (count > 0) {
+		*dst = blend_color(*dst, *src, alpha5, inverse);
+	}
+}
+
+
+// Mask value scaled to 0..32
+static inline uint32_t mask_alpha(uint32_t value, uint32_t scale) {
+	return (value * scale * 33 + 16) >> 8;
+}
+
+
+// Mask values are mapped to alpha 0..32 by levels, first level must be 0 and
+// last one 32
+static void draw_mask(const uint8_t *src_buf, uint8_t bits, const uint8_t *levels, ili9481_color_t *target_buf, ili9481_color_t color, int x, int y, int src_w, int src_h, int target_w, int target_h) {
+	if (x >= target_w || y >= target_h || x + src_w <= 0 || y + src_h <= 0) {
+		return;
+	}
+
+	const uint32_t value_mask = (1U << bits) - 1;
+	const size_t pixels_per_byte = 8 / bits;
+	const size_t line_w = MIN(src_w + x, target_w) - MAX(x, 0);
+	const int first_line = MAX(-y, 0);
+	const int last_line = MIN(src_h, target_h - y);
+
+	// Color multiplied by every alpha level
+	uint32_t premultiplied[33];
+	const uint32_t expanded = expand_color(color);
+	for (uint32_t alpha = 0; alpha <= 32; ++alpha) {
+		premultiplied[alpha] = expanded * alpha;
+	}
+
+	for (int line = first_line; line < last_line; ++line) {
+		size_t src_pos = (size_t)line * src_w + MAX(-x, 0);
+		ili9481_color_t *target = target_buf + (size_t)(y + line) * target_w + MAX(x, 0);
+		size_t remaining = line_w;
+		while (remaining > 0) {
+			const size_t bit = src_pos * bits;
+			const uint8_t byte = src_buf[bit >> 3];
+			if ((bit & 0x07) == 0 && remaining >= pixels_per_byte && (byte == 0x00 || byte == 0xff)) {
+				if (byte == 0xff) {
+					ili9481_span_fill(target, color, pixels_per_byte);
+				}
+				src_pos += pixels_per_byte;
+				target += pixels_per_byte;
+				remaining -= pixels_per_byte;
+				continue;
+			}
+
+			const uint32_t alpha = levels[(byte >> (bit & 0x07)) & value_mask];
+			if (alpha == 32) {
+				*target = color;
+			}
+			else if (alpha > 0) {
+				const uint32_t mixed = ((premultiplied[alpha] + expand_color(*target) * (32 - alpha)) >> 5) & 0x07e0f81f;
+				*target = mixed | (mixed >> 16);
+			}
+			src_pos++;
+			target++;
+			remaining--;
+		}
+	}
+}
+
+
+void ili9481_draw_alpha_bitmap(const uint8_t *src_buf, uint8_t bits, ili9481_color_t *target_buf, ili9481_color_t color, int x, int y, int src_w, int src_h, int target_w, int target_h) {
+	if (bits != 1 && bits != 2 && bits != 4 && bits != 8) {
+		return;
+	}
+	const uint32_t value_mask = (1U << bits) - 1;
+	const uint32_t scale = 255 / value_mask;
+	uint8_t levels[256];
+	for (uint32_t value = 0; value <= value_mask; ++value) {
+		levels[value] = mask_alpha(value, scale);
+	}
+	draw_mask(src_buf, bits, levels, target_buf, color, x, y, src_w, src_h, target_w, target_h);
+}
+
+
+// Levels of original gray2 renderer, which blended 1 and 2 at 1/2 and 3/4
+void ili9481_draw_gray2_bitmap(uint8_t *src_buf, ili9481_color_t *target_buf, uint8_t r, uint8_t g, uint8_t b, int x, int y, int src_w, int src_h, int target_w, int target_h) {
+	static const uint8_t levels[4] = {0, 16, 24, 32};
+	draw_mask(src_buf, 2, levels, target_buf, ili9481_rgb_to_color(r, g, b), x, y, src_w, src_h, target_w, target_h);
+}
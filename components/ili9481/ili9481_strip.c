@@ -0,0 +1,229 @@
+// SPDX-License-Identifier: MIT
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "ili9481_strip.h"
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "soc/cpu.h"
+
+
+#define STRIP_BUFFER_COUNT 2
+#define STRIP_MAX_LINES 64
+
+
+static const char *TAG = "ili9481_strip";
+
+
+struct ili9481_strip_renderer {
+	ili9481_driver_t *driver;
+	ili9481_color_t *buffers[STRIP_BUFFER_COUNT];
+	uint16_t strip_lines;
+	size_t current;
+	uint32_t frame_period_us;
+	ili9481_strip_stats_t stats;
+};
+
+
+static uint16_t auto_strip_lines(ili9481_driver_t *driver, const ili9481_strip_renderer_config_t *config) {
+	size_t memory = config->max_memory;
+	if (memory == 0) {
+		memory = heap_caps_get_largest_free_block(MALLOC_CAP_DMA) / 4;
+	}
+	const size_t line_size = (size_t)driver->display_width * sizeof(ili9481_color_t) * STRIP_BUFFER_COUNT;
+	const size_t lines = memory / line_size;
+	return MAX(MIN(lines, MIN(STRIP_MAX_LINES, driver->display_height)), 1);
+}
+
+
+static bool layer_visible(const ili9481_layer_t *layer, const ili9481_strip_t *strip) {
+	if (layer->height == 0) {
+		return true;
+	}
+	return layer->y < strip->y + strip->lines && layer->y + layer->height > strip->y;
+}
+
+
+static bool layer_covers(const ili9481_layer_t *layer, const ili9481_strip_t *strip) {
+	if (layer->height == 0) {
+		return true;
+	}
+	return layer->y <= strip->y && layer->y + layer->height >= strip->y + strip->lines;
+}
+
+
+static void send_events(ili9481_driver_t *driver, const ili9481_layer_t *layers, ili9481_layer_event_t event, const ili9481_frame_info_t *frame) {
+	for (const ili9481_layer_t *layer = layers; layer->draw != NULL; ++layer) {
+		if (layer->event != NULL) {
+			layer->event(driver, event, frame, layer->user_data);
+		}
+	}
+}
+
+
+esp_err_t ili9481_strip_renderer_create(ili9481_driver_t *driver, const ili9481_strip_renderer_config_t *config, ili9481_strip_renderer_t **renderer_out) {
+	ili9481_strip_renderer_t *renderer = (ili9481_strip_renderer_t *)calloc(1, sizeof(ili9481_strip_renderer_t));
+	if (renderer == NULL) {
+		ESP_LOGE(TAG, "renderer not allocated");
+		return ESP_ERR_NO_MEM;
+	}
+	renderer->driver = driver;
+	renderer->frame_period_us = config->frame_period_us;
+	renderer->strip_lines = config->strip_lines > 0 ? MIN(config->strip_lines, driver->display_height) : auto_strip_lines(driver, config);
+
+	const size_t strip_size = (size_t)driver->display_width * renderer->strip_lines * sizeof(ili9481_color_t);
+	for (size_t i = 0; i < STRIP_BUFFER_COUNT; ++i) {
+		renderer->buffers[i] = (ili9481_color_t *)heap_caps_malloc(strip_size, MALLOC_CAP_DMA);
+		if (renderer->buffers[i] == NULL) {
+			ESP_LOGE(TAG, "strip buffer not allocated");
+			ili9481_strip_renderer_destroy(renderer);
+			return ESP_ERR_NO_MEM;
+		}
+	}
+
+	ESP_LOGI(TAG, "%d lines per strip", renderer->strip_lines);
+	*renderer_out = renderer;
+	return ESP_OK;
+}
+
+
+void ili9481_strip_renderer_destroy(ili9481_strip_renderer_t *renderer) {
+	for (size_t i = 0; i < STRIP_BUFFER_COUNT; ++i) {
+		heap_caps_free(renderer->buffers[i]);
+	}
+	free(renderer);
+}
+
+
+uint16_t ili9481_strip_renderer_get_lines(ili9481_strip_renderer_t *renderer) {
+	return renderer->strip_lines;
+}
+
+
+// Strip is converted in place and sent without copy, previous strip is still
+// on bus while next one is rendered
+static void write_strip(ili9481_strip_renderer_t *renderer, ili9481_strip_t *strip) {
+	ili9481_driver_t *driver = renderer->driver;
+	const size_t pixels = (size_t)strip->width * strip->lines;
+	ili9481_wait_until_queue_empty(driver);
+	if ((pixels & 0x01) == 0 && ili9481_prepare_dma_pixels(driver, strip->buffer, pixels) == ESP_OK) {
+		ili9481_write_dma(driver, strip->buffer, pixels * sizeof(ili9481_color_t));
+	}
+	else {
+		ili9481_write_pixels(driver, strip->buffer, pixels);
+	}
+}
+
+
+void ili9481_strip_render_frame(ili9481_strip_renderer_t *renderer, const ili9481_layer_t *layers, const ili9481_frame_info_t *frame) {
+	ili9481_driver_t *driver = renderer->driver;
+	const ili9481_frame_info_t empty_frame = {0, 0, 0, 0};
+	if (frame == NULL) {
+		frame = &empty_frame;
+	}
+
+	ili9481_wait_until_queue_empty(driver);
+	if (driver->pixel_format != ILI9481_PIXEL_FORMAT_16) {
+		ili9481_set_pixel_format(driver, ILI9481_PIXEL_FORMAT_16);
+	}
+	ili9481_set_window(driver, 0, 0, driver->display_width - 1, driver->display_height - 1);
+
+	for (uint16_t y = 0; y < driver->display_height; y += renderer->strip_lines) {
+		ili9481_strip_t strip = {
+			.buffer = renderer->buffers[renderer->current],
+			.width = driver->display_width,
+			.y = y,
+			.lines = MIN(renderer->strip_lines, driver->display_height - y),
+		};
+		// Buffer still holds older strip already converted for bus, it is
+		// cleared unless bottom layer draws all lines of strip
+		bool cleared = false;
+		for (const ili9481_layer_t *layer = layers; layer->draw != NULL; ++layer) {
+			if (layer_visible(layer, &strip)) {
+				if (!cleared && !layer_covers(layer, &strip)) {
+					memset(strip.buffer, 0, (size_t)strip.width * strip.lines * sizeof(ili9481_color_t));
+				}
+				cleared = true;
+				layer->draw(driver, &strip, frame, layer->user_data);
+			}
+		}
+		if (!cleared) {
+			memset(strip.buffer, 0, (size_t)strip.width * strip.lines * sizeof(ili9481_color_t));
+		}
+		write_strip(renderer, &strip);
+		renderer->current = (renderer->current + 1) % STRIP_BUFFER_COUNT;
+	}
+}
+
+
+// Sleep until next frame is due, returns number of next frame. Late frames
+// are merged, frame numbers keep wall clock speed.
+static uint64_t pace_frame(ili9481_strip_renderer_t *renderer, int64_t step_start, uint64_t frame) {
+	const int64_t period = renderer->frame_period_us;
+	const int64_t elapsed = esp_timer_get_time() - step_start;
+	const uint64_t due = elapsed / period;
+	if (due > frame + 1) {
+		renderer->stats.frames_skipped += due - frame - 1;
+		return due;
+	}
+	const int64_t wait_us = (int64_t)(frame + 1) * period - elapsed;
+	const TickType_t ticks = wait_us / 1000 / portTICK_PERIOD_MS;
+	if (ticks > 0) {
+		vTaskDelay(ticks);
+	}
+	return frame + 1;
+}
+
+
+static void render_paced_frame(ili9481_strip_renderer_t *renderer, const ili9481_layer_t *layers, const ili9481_frame_info_t *frame) {
+	// Step without layers keeps content
+	if (layers->draw == NULL) {
+		return;
+	}
+	const uint32_t start_cycles = esp_cpu_get_ccount();
+	ili9481_strip_render_frame(renderer, layers, frame);
+	const uint32_t cycles = esp_cpu_get_ccount() - start_cycles;
+	renderer->stats.frames_rendered++;
+	renderer->stats.last_cycles = cycles;
+	renderer->stats.max_cycles = MAX(renderer->stats.max_cycles, cycles);
+}
+
+
+void ili9481_strip_run_animation(ili9481_strip_renderer_t *renderer, const ili9481_animation_step_t *animation) {
+	ili9481_driver_t *driver = renderer->driver;
+	ili9481_frame_info_t frame = {0, 0, 0, 0};
+
+	for (const ili9481_animation_step_t *step = animation; step->layers != NULL; ++step) {
+		const int64_t step_start = esp_timer_get_time();
+		frame.frame = 0;
+		frame.duration = step->duration;
+		frame.time_us = 0;
+		send_events(driver, step->layers, ILI9481_LAYER_EVENT_START, &frame);
+		while (frame.frame < step->duration) {
+			frame.time_us = esp_timer_get_time() - step_start;
+			send_events(driver, step->layers, ILI9481_LAYER_EVENT_FRAME_START, &frame);
+			render_paced_frame(renderer, step->layers, &frame);
+			send_events(driver, step->layers, ILI9481_LAYER_EVENT_FRAME_END, &frame);
+			frame.total_frame++;
+			if (renderer->frame_period_us > 0) {
+				frame.frame = pace_frame(renderer, step_start, frame.frame);
+			}
+			else {
+				frame.frame++;
+			}
+		}
+		send_events(driver, step->layers, ILI9481_LAYER_EVENT_END, &frame);
+	}
+	ili9481_wait_until_queue_empty(driver);
+}
+
+
+void ili9481_strip_renderer_get_stats(ili9481_strip_renderer_t *renderer, ili9481_strip_stats_t *stats) {
+	*stats = renderer->stats;
+}
@@ -0,0 +1,175 @@
+// SPDX-License-Identifier: MIT
+
+#include <stdlib.h>
+
+#include "ili9481_tear.h"
+
+#include "driver/gpio.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+
+// Longer than refresh period at lowest frame rate
+#define VSYNC_TIMEOUT_MS 100
+
+
+static const char *TAG = "ili9481_tear";
+
+
+struct ili9481_tear {
+	ili9481_driver_t *driver;
+	ili9481_tear_config_t config;
+	SemaphoreHandle_t vsync;
+};
+
+
+static void IRAM_ATTR te_isr(void *arg) {
+	ili9481_tear_t *tear = (ili9481_tear_t *)arg;
+	BaseType_t task_woken = pdFALSE;
+	xSemaphoreGiveFromISR(tear->vsync, &task_woken);
+	if (task_woken) {
+		portYIELD_FROM_ISR();
+	}
+}
+
+
+static esp_err_t init_te_pin(ili9481_tear_t *tear) {
+	tear->vsync = xSemaphoreCreateBinary();
+	if (tear->vsync == NULL) {
+		return ESP_ERR_NO_MEM;
+	}
+
+	const gpio_config_t io_conf = {
+		.pin_bit_mask = 1ULL << tear->config.pin_te,
+		.mode = GPIO_MODE_INPUT,
+		.intr_type = GPIO_INTR_POSEDGE,
+	};
+	esp_err_t ret = gpio_config(&io_conf);
+	if (ret != ESP_OK) {
+		return ret;
+	}
+	// Service may be already installed by application
+	ret = gpio_install_isr_service(0);
+	if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+		return ret;
+	}
+	return gpio_isr_handler_add(tear->config.pin_te, te_isr, tear);
+}
+
+
+esp_err_t ili9481_tear_create(ili9481_driver_t *driver, const ili9481_tear_config_t *config, ili9481_tear_t **tear_out) {
+	ili9481_tear_t *tear = (ili9481_tear_t *)calloc(1, sizeof(ili9481_tear_t));
+	if (tear == NULL) {
+		ESP_LOGE(TAG, "tear sync not allocated");
+		return ESP_ERR_NO_MEM;
+	}
+	tear->driver = driver;
+	tear->config = *config;
+
+	if (config->pin_te >= 0) {
+		esp_err_t ret = init_te_pin(tear);
+		if (ret != ESP_OK) {
+			ESP_LOGE(TAG, "TE pin not initialized");
+			if (tear->vsync != NULL) {
+				vSemaphoreDelete(tear->vsync);
+			}
+			free(tear);
+			return ret;
+		}
+	}
+
+	// TE pulses only in vertical blank, mid frame timing is polled
+	const uint8_t burst[] = {
+		ILI9481_SET_TEAR_ON, 1, 0x00,
+	};
+	ili9481_write_burst(driver, burst, sizeof(burst));
+	ili9481_wait_until_queue_empty(driver);
+
+	*tear_out = tear;
+	return ESP_OK;
+}
+
+
+void ili9481_tear_destroy(ili9481_tear_t *tear) {
+	ili9481_write_command(tear->driver, ILI9481_SET_TEAR_OFF);
+	ili9481_wait_until_queue_empty(tear->driver);
+	if (tear->vsync != NULL) {
+		gpio_isr_handler_remove(tear->config.pin_te);
+		vSemaphoreDelete(tear->vsync);
+	}
+	free(tear);
+}
+
+
+uint16_t ili9481_tear_get_scanline(ili9481_tear_t *tear) {
+	uint8_t data[3];
+	ili9481_write_command(tear->driver, ILI9481_GET_SCANLINE);
+	ili9481_read_data(tear->driver, data, sizeof(data)); // First byte is dummy
+	return ((data[1] & 0x03) << 8) | data[2];
+}
+
+
+esp_err_t ili9481_tear_wait_scanline(ili9481_tear_t *tear, uint16_t line) {
+	const int64_t deadline = esp_timer_get_time() + VSYNC_TIMEOUT_MS * 1000;
+	uint16_t previous = ili9481_tear_get_scanline(tear);
+	for (;;) {
+		const uint16_t current = ili9481_tear_get_scanline(tear);
+		// Line was passed between two reads, refresh may have wrapped
+		const bool passed = previous <= current ?
+			(previous < line && line <= current) :
+			(previous < line || line <= current);
+		if (passed) {
+			return ESP_OK;
+		}
+		if (esp_timer_get_time() > deadline) {
+			return ESP_ERR_TIMEOUT;
+		}
+		previous = current;
+	}
+}
+
+
+esp_err_t ili9481_tear_wait_vsync(ili9481_tear_t *tear) {
+	if (tear->vsync == NULL) {
+		return ili9481_tear_wait_scanline(tear, 0);
+	}
+	// Drop pulse of frame, which is already in progress
+	xSemaphoreTake(tear->vsync, 0);
+	if (xSemaphoreTake(tear->vsync, pdMS_TO_TICKS(VSYNC_TIMEOUT_MS)) != pdTRUE) {
+		return ESP_ERR_TIMEOUT;
+	}
+	return ESP_OK;
+}
+
+
+esp_err_t ili9481_tear_present(ili9481_tear_t *tear, ili9481_tear_draw_t draw, void *user_data) {
+	ili9481_driver_t *driver = tear->driver;
+	const uint16_t half = driver->display_height / 2;
+
+	esp_err_t ret = ili9481_tear_wait_vsync(tear);
+	if (ret != ESP_OK) {
+		ESP_LOGW(TAG, "vsync timeout");
+		return ret;
+	}
+
+	if (tear->config.mode == ILI9481_TEAR_FULL) {
+		draw(driver, 0, driver->display_height, user_data);
+		return ESP_OK;
+	}
+
+	// Both halves are shown first in same refresh pass
+	ret = ili9481_tear_wait_scanline(tear, half);
+	if (ret == ESP_OK) {
+		draw(driver, 0, half, user_data);
+		ret = ili9481_tear_wait_vsync(tear);
+	}
+	if (ret != ESP_OK) {
+		ESP_LOGW(TAG, "scanline timeout");
+		return ret;
+	}
+	draw(driver, half, driver->display_height - half, user_data);
+	return ESP_OK;
+}
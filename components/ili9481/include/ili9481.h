@@ -3,142 +3,133 @@
 #pragma once
 
 
-#include "driver/spi_master.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
 #include "esp_err.h"
 
 
-#define ILI9481_WRITE_QUEUE_SIZE 2
-
-#define   SET_COL_ADDRESS                 0x2AU
-#define   SET_PAGE_ADDRESS                0x2BU
-#define   WRITE_MEMORY_START              0x2CU
-#define   WRITE_MEMORY_CONTINUE           0x3CU
-#define   READ_MEMORY_START               0x2EU
-#define   SET_DISPLAY_OFF                 0x28U
-#define   SET_DISPLAY_ON                  0x29U
-#define   SET_ADDRESS_MODE                0x36U
-#define   EXIT_INVERT_MODE                0x20U
-#define   ENTER_INVERT_MODE               0x21U
-#define   ENTER_NORMAL_MODE               0x13U //0 param
-#define   EXIT_SLEEP_MODE                 0x11U
-#define   SET_TEAR_OFF                    0x34U //0 param
-#define   SET_TEAR_ON                     0x35U //1 param
-#define   SET_PIXEL_FORMAT                0x3AU
-#define   SET_TEAR_SCANLINE               0x44U //2 param
-#define   FRAME_MEMORY_ACCESS_SETTING     0xB3U //4 param
-#define   SET_DISPLAY_MODE                0xB4U //1 param
-#define   PANEL_DRIVE_SETTING             0xC0U //6 param
-#define   TIMING_SETTING_NORMAL           0xC1U //3 param
-#define   TIMING_SETTING_PARTIAL          0xC2U //3 param
-#define   FRAME_RATE_CONTROL              0xC5U //1 param
-#define   INTERFACE_CONTROL               0xC6U //1 param
-#define   POWER_SETTING                   0xD0U //3 param
-#define   VCOM_CONTROL                    0xD1U //3 param
-#define   POWER_SETTING_NORMAL            0xD2U //2 param
-#define   POWER_SETTING_PARTIAL           0xD3U //2 param
-#define   GAMMA_SETTING                   0xC8U //12 param
-
-
-// System Function Command Table 1
-//#define ILI9481_CMD_NOP               0x00 // No operation
-//#define ILI9481_CMD_SWRESET           0x01 // Software reset
-//#define ILI9481_CMD_RDDID             0x04 // Read display ID
-//#define ILI9481_CMD_RDDST             0x09 // Read display status
-//#define ILI9481_CMD_RDDPM             0x0a // Read display power
-//#define ILI9481_CMD_RDDMADCTL         0x0b // Read display
-//#define ILI9481_CMD_RDDCOLMOD         0x0c // Read display pixel
-//#define ILI9481_CMD_RDDIM             0x0d // Read display image
-//#define ILI9481_CMD_RDDSM             0x0e // Read display signal
-//#define ILI9481_CMD_RDDSDR            0x0f // Read display self-diagnostic result
-//#define ILI9481_CMD_SLPIN             0x10 // Sleep in
-//#define ILI9481_CMD_SLPOUT            0x11 // Sleep out
-//#define ILI9481_CMD_PTLON             0x12 // Partial mode on
-//#define ILI9481_CMD_NORON             0x13 // Partial off (Normal)
-//#define ILI9481_CMD_INVOFF            0x20 // Display inversion off
-//#define ILI9481_CMD_INVON             0x21 // Display inversion on
-//#define ILI9481_CMD_GAMSET            0x26 // Gamma set
-//#define ILI9481_CMD_DISPOFF           0x28 // Display off
-//#define ILI9481_CMD_DISPON            0x29 // Display on
-//#define ILI9481_CMD_CASET             0x2a // Column address set
-//#define ILI9481_CMD_RASET             0x2b // Row address set
-//#define ILI9481_CMD_RAMWR             0x2c // Memory write
-//#define ILI9481_CMD_RAMRD             0x2e // Memory read
-//#define ILI9481_CMD_PTLAR             0x30 // Partial start/end address set
-//#define ILI9481_CMD_VSCRDEF           0x33 // Vertical scrolling definition
-//#define ILI9481_CMD_TEOFF             0x34 // Tearing line effect off
-//#define ILI9481_CMD_TEON              0x35 // Tearing line effect on
-//#define ILI9481_CMD_MADCTL            0x36 // Memory data access control
-//#define ILI9481_CMD_VSCRSADD          0x37 // Vertical address scrolling
-//#define ILI9481_CMD_IDMOFF            0x38 // Idle mode off
-//#define ILI9481_CMD_IDMON             0x39 // Idle mode on
-//#define ILI9481_CMD_COLMOD            0x3a // Interface pixel format
-//#define ILI9481_CMD_RAMWRC            0x3c // Memory write continue
-//#define ILI9481_CMD_RAMRDC            0x3e // Memory read continue
-//#define ILI9481_CMD_TESCAN            0x44 // Set tear scanline
-//#define ILI9481_CMD_RDTESCAN          0x45 // Get scanline
-//#define ILI9481_CMD_WRDISBV           0x51 // Write display brightness
-//#define ILI9481_CMD_RDDISBV           0x52 // Read display brightness value
-//#define ILI9481_CMD_WRCTRLD           0x53 // Write CTRL display
-//#define ILI9481_CMD_RDCTRLD           0x54 // Read CTRL value display
-//#define ILI9481_CMD_WRCACE            0x55 // Write content adaptive brightness control and Color enhancemnet
-//#define ILI9481_CMD_RDCABC            0x56 // Read content adaptive brightness control
-//#define ILI9481_CMD_WRCABCMB          0x5e // Write CABC minimum brightness
-//#define ILI9481_CMD_RDCABCMB          0x5f // Read CABC minimum brightness
-//#define ILI9481_CMD_RDABCSDR          0x68 // Read Automatic Brightness Control Self-Diagnostic Result
-//#define ILI9481_CMD_RDID1             0xda // Read ID1
-//#define ILI9481_CMD_RDID2             0xdb // Read ID2
-//#define ILI9481_CMD_RDID3             0xdc // Read ID3
-//
-//// System Function Command Table 2
-//#define ILI9481_CMD_RAMCTRL           0xb0 // RAM Control
-//#define ILI9481_CMD_RGBCTRL           0xb1 // RGB Control
-//#define ILI9481_CMD_PORCTRL           0xb2 // Porch control
-//#define ILI9481_CMD_FRCTRL1           0xb3 // Frame Rate Control 1
-//#define ILI9481_CMD_GCTRL             0xb7 // Gate control
-//#define ILI9481_CMD_DGMEN             0xba // Digital Gamma Enable
-//#define ILI9481_CMD_VCOMS             0xbb // VCOM Setting
-//#define ILI9481_CMD_LCMCTRL           0xc0 // LCM Control
-//#define ILI9481_CMD_IDSET             0xc1 // ID Setting
-//#define ILI9481_CMD_VDVVRHEN          0xc2 // VDV and VRH Command enable
-//#define ILI9481_CMD_VRHSET            0xc3 // VRH Set
-//#define ILI9481_CMD_VDVSET            0xc4 // VDV Set
-//#define ILI9481_CMD_VCMOFSET          0xc5 // VCOM Offset Set
-//#define ILI9481_CMD_FRCTR2            0xc6 // FR Control 2
-//#define ILI9481_CMD_CABCCTRL          0xc7 // CABC Control
-//#define ILI9481_CMD_REGSEL1           0xc8 // Register value selection 1
-//#define ILI9481_CMD_REGSEL2           0xca // Register value selection 2
-//#define ILI9481_CMD_PWMFRSEL          0xcc // PWM Frequency Selection
-//#define ILI9481_CMD_PWCTRL1           0xd0 // Power Control 1
-//#define ILI9481_CMD_VAPVANEN          0xd2 // Enable VAP/VAN signal output
-//#define ILI9481_CMD_CMD2EN            0xdf // Command 2 Enable
-//#define ILI9481_CMD_PVGAMCTRL         0xe0 // Positive Voltage Gamma Control
-//#define ILI9481_CMD_NVGAMCTRL         0xe1 // Negative voltage Gamma Control
-//#define ILI9481_CMD_DGMLUTR           0xe2 // Digital Gamma Look-up Table for Red
-//#define ILI9481_CMD_DGMLUTB           0xe3 // Digital Gamma Look-up Table for Blue
-//#define ILI9481_CMD_GATECTRL          0xe4 // Gate control
-//#define ILI9481_CMD_PWCTRL2           0xe8 // Power Control 2
-//#define ILI9481_CMD_EQCTRL            0xe9 // Equalize Time Control
-//#define ILI9481_CMD_PROMCTRL          0xec // Program Control
-//#define ILI9481_CMD_PROMEN            0xfa // Program Mode Enable
-//#define ILI9481_CMD_NVMSET            0xfc // NVM Setting
-//#define ILI9481_CMD_PROMACT           0xfe // Program Action
-//
-//#define ILI9481_CMDLIST_END           0xff // End command (used for command list)
+#define ILI9481_NOP 0x00
+#define ILI9481_SOFT_RESET 0x01
+#define ILI9481_GET_RED_CHANNEL 0x06
+#define ILI9481_GET_GREEN_CHANNEL 0x07
+#define ILI9481_GET_BLUE_CHANNEL 0x08
+#define ILI9481_GET_POWER_MODE 0x0A
+#define ILI9481_GET_ADDRESS_MODE 0x0B
+#define ILI9481_GET_PIXEL_FORMAT 0x0C
+#define ILI9481_GET_DISPLAY_MODE 0x0D
+#define ILI9481_GET_SIGNAL_MODE 0x0E
+#define ILI9481_GET_DIAGNOSTIC_RESULT 0x0F
+#define ILI9481_ENTER_SLEEP_MODE 0x10
+#define ILI9481_EXIT_SLEEP_MODE 0x11
+#define ILI9481_ENTER_PARTIAL_MODE 0x12
+#define ILI9481_ENTER_NORMAL_MODE 0x13
+#define ILI9481_EXIT_INVERT_MODE 0x20
+#define ILI9481_ENTER_INVERT_MODE 0x21
+#define ILI9481_SET_GAMMA_CURVE 0x26
+#define ILI9481_SET_DISPLAY_OFF 0x28
+#define ILI9481_SET_DISPLAY_ON 0x29
+#define ILI9481_SET_COLUMN_ADDRESS 0x2A
+#define ILI9481_SET_PAGE_ADDRESS 0x2B
+#define ILI9481_WRITE_MEMORY_START 0x2C
+#define ILI9481_WRITE_LUT 0x2D
+#define ILI9481_READ_MEMORY_START 0x2E
+#define ILI9481_SET_PARTIAL_AREA 0x30
+#define ILI9481_SET_SCROLL_AREA 0x33
+#define ILI9481_SET_TEAR_OFF 0x34
+#define ILI9481_SET_TEAR_ON 0x35
+#define ILI9481_SET_ADDRESS_MODE 0x36
+#define ILI9481_SET_SCROLL_START 0x37
+#define ILI9481_EXIT_IDLE_MODE 0x38
+#define ILI9481_ENTER_IDLE_MODE 0x39
+#define ILI9481_SET_PIXEL_FORMAT 0x3A
+#define ILI9481_WRITE_MEMORY_CONTINUE 0x3C
+#define ILI9481_READ_MEMORY_CONTINUE 0x3E
+#define ILI9481_SET_TEAR_SCANLINE 0x44
+#define ILI9481_GET_SCANLINE 0x45
+#define ILI9481_READ_DDB_START 0xA1
+#define ILI9481_COMMAND_ACCESS_PROTECT 0xB0
+#define ILI9481_FRAME_MEMORY_ACCESS_SETTING 0xB3
+#define ILI9481_DISPLAY_MODE 0xB4
+#define ILI9481_DEVICE_CODE_READ 0xBF
+#define ILI9481_PANEL_DRIVING_SETTING 0xC0
+#define ILI9481_DISPLAY_TIMING_SETTING_NORMAL 0xC1
+#define ILI9481_DISPLAY_TIMING_SETTING_PARTIAL 0xC2
+#define ILI9481_DISPLAY_TIMING_SETTING_IDLE 0xC3
+#define ILI9481_FRAME_RATE_CONTROL 0xC5
+#define ILI9481_INTERFACE_CONTROL 0xC6
+#define ILI9481_GAMMA_SETTING 0xC8
+#define ILI9481_POWER_SETTING 0xD0
+#define ILI9481_VCOM_CONTROL 0xD1
+#define ILI9481_POWER_SETTING_NORMAL 0xD2
+#define ILI9481_POWER_SETTING_PARTIAL 0xD3
+#define ILI9481_POWER_SETTING_IDLE 0xD4
+#define ILI9481_NV_MEMORY_WRITE 0xE0
+#define ILI9481_NV_MEMORY_CONTROL 0xE1
+#define ILI9481_NV_MEMORY_STATUS 0xE2
+#define ILI9481_NV_MEMORY_PROTECTION 0xE3
+
+#define ILI9481_CMDLIST_END 0xFF // Not a valid command, terminates command lists
+
+#define ILI9481_BURST_MAX_LENGTH 64
+
+// Fixed top, scroll area before and after wrap, fixed bottom
+#define ILI9481_MAX_LINE_RANGES 4
+
+// Values of SET_PIXEL_FORMAT parameter
+#define ILI9481_PIXEL_FORMAT_16 0x55 // RGB565, 2 bytes per pixel
+#define ILI9481_PIXEL_FORMAT_18 0x66 // RGB666, 3 bytes per pixel
+
 
 struct ili9481_driver;
 
-typedef struct ili9481_transaction_data {
-	struct ili9481_driver *driver;
-	bool data;
-} ili9481_transaction_data_t;
+typedef struct ili9481_stream_config {
+	size_t buffer_count; // Buffers in ring, at least 2
+	size_t buffer_size; // Bytes per buffer, multiple of 4, at most 4092 on i2s bus
+	size_t prefill; // Buffers filled before transfer starts, 0 for 1
+} ili9481_stream_config_t;
+
+// Transport used to talk to display, all drawing functions go through it
+typedef struct ili9481_bus {
+	const char *name;
+	esp_err_t (*init)(struct ili9481_driver *driver);
+	void (*deinit)(struct ili9481_driver *driver);
+	// Command byte (DC low)
+	void (*write_command)(struct ili9481_driver *driver, uint8_t command);
+	// Parameters or pixel data (DC high), data can be reused after call returns
+	void (*write_data)(struct ili9481_driver *driver, const uint8_t *data, size_t length);
+	void (*read_data)(struct ili9481_driver *driver, uint8_t *data, size_t length);
+	// Sequence of commands with parameters as one submission, see ili9481_write_burst
+	void (*write_burst)(struct ili9481_driver *driver, const uint8_t *burst, size_t length);
+	// Block until everything written is on display
+	void (*wait_idle)(struct ili9481_driver *driver);
+	// Change write clock divider, NULL if bus has fixed clock
+	esp_err_t (*set_clock_div)(struct ili9481_driver *driver, uint8_t clock_div);
+	// Convert data in place from bus order (as in write_data) to order of write_dma, NULL if bus has no DMA
+	void (*prepare_dma)(struct ili9481_driver *driver, void *data, size_t length);
+	// Queue caller memory for DMA without copy, data must stay unchanged until wait_idle
+	esp_err_t (*write_dma)(struct ili9481_driver *driver, const void *data, size_t length);
+	// Continuous streaming through ring of buffers, NULL if bus has no DMA
+	esp_err_t (*stream_begin)(struct ili9481_driver *driver, const ili9481_stream_config_t *config);
+	uint8_t *(*stream_get_buffer)(struct ili9481_driver *driver);
+	void (*stream_submit)(struct ili9481_driver *driver, size_t length);
+	void (*stream_end)(struct ili9481_driver *driver);
+} ili9481_bus_t;
+
+extern const ili9481_bus_t ili9481_bus_gpio; // gpio_set_level for every pin, works with any pins
+extern const ili9481_bus_t ili9481_bus_reg; // GPIO_OUT_W1TS / W1TC writes, data and WR pins must be < 32
+extern const ili9481_bus_t ili9481_bus_i2s; // I2S1 LCD mode with DMA, commands are sent using reg bus
+extern const ili9481_bus_t ili9481_bus_sim; // In memory model of display controller, set pin_rst to -1 to avoid any hardware access
 
 typedef uint16_t ili9481_color_t;
 
 typedef struct ili9481_driver {
-	int pin_rst;
+	const ili9481_bus_t *bus; // Defaults to ili9481_bus_reg
+	int pin_rst; // -1 if not connected, software reset is used
 	int pin_rd;
 	int pin_wr;
-	int pin_cs;
+	int pin_cs; // -1 if tied to ground
 	int pin_dc;
 	int pin_d0;
 	int pin_d1;
@@ -148,20 +139,33 @@ typedef struct ili9481_driver {
 	int pin_d5;
 	int pin_d6;
 	int pin_d7;
-	int dma_chan;
-	uint8_t queue_fill;
+	int pin_d8; // d8..d15 used only on 16-bit bus
+	int pin_d9;
+	int pin_d10;
+	int pin_d11;
+	int pin_d12;
+	int pin_d13;
+	int pin_d14;
+	int pin_d15;
+	uint8_t bus_width; // 8 (default) or 16, 16-bit bus supports only ILI9481_PIXEL_FORMAT_16
 	uint16_t display_width;
 	uint16_t display_height;
-	//spi_device_handle_t spi;
-	size_t buffer_size;
-	ili9481_transaction_data_t data;
-	ili9481_transaction_data_t command;
+	uint8_t pixel_format; // ILI9481_PIXEL_FORMAT_16 or ILI9481_PIXEL_FORMAT_18 (default)
+	uint8_t clock_div; // Write clock divider of clocked buses, 0 for default
+	size_t buffer_size; // Pixels in each of two strip buffers, 0 to disable
 	ili9481_color_t *buffer;
 	ili9481_color_t *buffer_a;
 	ili9481_color_t *buffer_b;
 	ili9481_color_t *current_buffer;
-	//spi_transaction_t trans_a;
-	//spi_transaction_t trans_b;
+	bool memory_write; // Last command was memory write, data are pixels
+	uint16_t scroll_top; // Fixed lines above scroll area
+	uint16_t scroll_height; // Lines of scroll area, 0 if scrolling is off
+	uint16_t scroll_offset; // Logical line scroll_top is GRAM line scroll_top + scroll_offset
+	void *bus_data; // Private data of bus
+	uint32_t data_mask;
+	uint32_t wr_mask;
+	int8_t data_shift; // first data pin when data pins are contiguous, -1 otherwise
+	uint32_t *data_table; // GPIO_OUT_W1TS value for each byte, second half for high byte on 16-bit bus
 } ili9481_driver_t;
 
 typedef struct ili9481_command {
@@ -171,19 +175,104 @@ typedef struct ili9481_command {
 	const uint8_t *data;
 } ili9481_command_t;
 
+// Simulated display state, available as driver->bus_data with ili9481_bus_sim
+typedef struct ili9481_sim {
+	uint8_t *gram; // display_width * display_height pixels, 3 bytes per pixel in bus order
+	uint8_t command;
+	uint8_t params[16];
+	size_t param_count;
+	uint16_t start_x;
+	uint16_t end_x;
+	uint16_t start_y;
+	uint16_t end_y;
+	uint16_t x;
+	uint16_t y;
+	uint8_t pixel_format;
+	uint8_t pixel[3];
+	size_t pixel_pos;
+	bool dummy_read;
+	uint32_t commands;
+	uint32_t bursts;
+	uint64_t bytes_written;
+	uint64_t bytes_read;
+	uint64_t pixels_written;
+	// Refresh pointer advances one line per scan_bytes of bus traffic, 0 stops it
+	uint32_t scan_bytes;
+	uint32_t scan_progress;
+	uint16_t scanline; // Returned by ILI9481_GET_SCANLINE
+	uint32_t *line_generation; // Completed writes of every GRAM line
+	uint32_t pass_min; // Lowest and highest generation seen in current refresh pass
+	uint32_t pass_max;
+	uint32_t frames_scanned;
+	uint32_t tears; // Refresh passes showing lines of different generations, valid for full frame updates
+	// Vertical scrolling set by ILI9481_SET_SCROLL_AREA and ILI9481_SET_SCROLL_START
+	uint16_t scroll_top;
+	uint16_t scroll_height;
+	uint16_t scroll_start;
+} ili9481_sim_t;
+
 esp_err_t ili9481_init(ili9481_driver_t *driver);
+void ili9481_deinit(ili9481_driver_t *driver);
 void ili9481_reset(ili9481_driver_t *driver);
 void ili9481_lcd_init(ili9481_driver_t *driver);
-void ili9481_start_command(ili9481_driver_t *driver);
-void ili9481_start_data(ili9481_driver_t *driver);
+void ili9481_write_command(ili9481_driver_t *driver, uint8_t command);
+void ili9481_write_data(ili9481_driver_t *driver, const uint8_t *data, size_t length);
+void ili9481_read_data(ili9481_driver_t *driver, uint8_t *data, size_t length);
+// Burst is list of commands encoded as command, parameter count and parameters
+void ili9481_write_burst(ili9481_driver_t *driver, const uint8_t *burst, size_t length);
+// GRAM line shown on display row by ili9481_bus_sim
+uint16_t ili9481_sim_display_line(const ili9481_sim_t *sim, uint16_t row);
 void ili9481_run_command(ili9481_driver_t *driver, const ili9481_command_t *command);
 void ili9481_run_commands(ili9481_driver_t *driver, const ili9481_command_t *sequence);
 void ili9481_clear(ili9481_driver_t *driver, ili9481_color_t color);
+// Area functions use logical lines, which are mapped to GRAM lines of scroll area
 void ili9481_fill_area(ili9481_driver_t *driver, ili9481_color_t color, uint16_t start_x, uint16_t start_y, uint16_t width, uint16_t height);
-void ili9481_fill_area(ili9481_driver_t *driver, ili9481_color_t color, uint16_t start_x, uint16_t start_y, uint16_t width, uint16_t height);
+void ili9481_draw_area(ili9481_driver_t *driver, uint16_t start_x, uint16_t start_y, uint16_t width, uint16_t height, ili9481_color_t *pixels);
+// Hardware vertical scrolling between fixed top and bottom lines, 0 and 0
+// scroll whole display. Scroll offset is reset.
+esp_err_t ili9481_set_scroll_area(ili9481_driver_t *driver, uint16_t top_fixed, uint16_t bottom_fixed);
+// Move content of scroll area up by lines (down if negative), returns
+// logical lines, which have to be redrawn
+void ili9481_scroll(ili9481_driver_t *driver, int lines, uint16_t *exposed_y, uint16_t *exposed_height);
+// GRAM line of logical line
+uint16_t ili9481_scroll_map_line(const ili9481_driver_t *driver, uint16_t y);
+// Split logical lines y .. y + height - 1 to at most ILI9481_MAX_LINE_RANGES
+// ranges, which are contiguous in GRAM, returns number of ranges
+size_t ili9481_scroll_map_lines(const ili9481_driver_t *driver, uint16_t y, uint16_t height, uint16_t *gram_y, uint16_t *lines);
+// Format of following pixel writes, display memory keeps 18-bit pixels, so
+// regions drawn in different formats can be combined
+void ili9481_set_pixel_format(ili9481_driver_t *driver, uint8_t pixel_format);
+// Window in GRAM coordinates
 void ili9481_set_window(ili9481_driver_t *driver, uint16_t start_x, uint16_t start_y, uint16_t end_x, uint16_t end_y);
 void ili9481_write_pixels(ili9481_driver_t *driver, ili9481_color_t *pixels, size_t length);
+// Read rectangle from display memory, data bus switches direction once per chunk of pixels.
+// Display returns 18-bit pixels in both pixel formats.
+void ili9481_read_pixels(ili9481_driver_t *driver, uint16_t start_x, uint16_t start_y, uint16_t width, uint16_t height, ili9481_color_t *pixels);
 void ili9481_wait_until_queue_empty(ili9481_driver_t *driver);
+// Zero-copy writes from application framebuffers. Data are converted once by
+// ili9481_prepare_dma (or rendered directly in that order), buffer must be
+// word aligned, length multiple of 4 and it must not be modified until
+// ili9481_wait_until_queue_empty returns. Memory, which can't be read by DMA
+// (PSRAM on ESP32), is copied through bus buffers. Both return
+// ESP_ERR_NOT_SUPPORTED if bus has no DMA.
+esp_err_t ili9481_prepare_dma(ili9481_driver_t *driver, void *data, size_t length);
+// Same as ili9481_prepare_dma for ili9481_color_t pixels in 16-bit pixel format
+esp_err_t ili9481_prepare_dma_pixels(ili9481_driver_t *driver, ili9481_color_t *pixels, size_t length);
+esp_err_t ili9481_write_dma(ili9481_driver_t *driver, const void *data, size_t length);
+// Stream data (in bus order, as ili9481_write_data) without stopping DMA
+// between buffers, for video or procedural content written after
+// memory write command. Transfer stalls instead of repeating old data when
+// buffers aren't refilled in time and continues with next submit. No other
+// driver calls are allowed until ili9481_stream_end. Returns
+// ESP_ERR_NOT_SUPPORTED if bus has no DMA.
+esp_err_t ili9481_stream_begin(ili9481_driver_t *driver, const ili9481_stream_config_t *config);
+// Wait for free buffer (buffer_size bytes), it has to be passed to ili9481_stream_submit
+uint8_t *ili9481_stream_get_buffer(ili9481_driver_t *driver);
+void ili9481_stream_submit(ili9481_driver_t *driver, size_t length);
+// Wait until all submitted buffers are on display
+void ili9481_stream_end(ili9481_driver_t *driver);
+// Returns ESP_ERR_NOT_SUPPORTED if bus has fixed clock
+esp_err_t ili9481_set_clock_div(ili9481_driver_t *driver, uint8_t clock_div);
 void ili9481_swap_buffers(ili9481_driver_t *driver);
 /*
 inline ili9481_color_t ili9481_rgb_to_color(uint8_t r, uint8_t g, uint8_t b) {
@@ -214,14 +303,16 @@ inline ili9481_color_t __attribute__((always_inline)) ili9481_rgb_to_color_dithe
 }
 
 inline void __attribute__((always_inline)) ili9481_color_to_rgb(ili9481_color_t color, uint8_t *r, uint8_t *g, uint8_t *b) {
-	*b = (color << 3);
+	*r = (color << 3);
 	color >>= 5;
 	color <<= 2;
 	*g = color;
 	color >>= 8;
-	*r = color << 3;
+	*b = color << 3;
 }
 
 //void ili9481_color_to_rgb(ili9481_color_t color, uint8_t *r, uint8_t *g, uint8_t *b);
 //ili9481_color_t ili9481_rgb_to_color_dither(uint8_t r, uint8_t g, uint8_t b, uint16_t x, uint16_t y);
+// 2-bit mask, levels 1 and 2 blend color at 1/2 and 3/4 (unlike linear levels
+// of ili9481_draw_alpha_bitmap), result is not dithered
 void ili9481_draw_gray2_bitmap(uint8_t *src_buf, ili9481_color_t *target_buf, uint8_t r, uint8_t g, uint8_t b, int x, int y, int src_w, int src_h, int target_w, int target_h);
@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "ili9481.h"
+
+
+// Compiled by tools/convert_image.py, header is followed by pixels in bus
+// order of pixel format, multibyte values are little endian
+#define ILI9481_ASSET_MAGIC 0x31413949 // "I9A1"
+#define ILI9481_ASSET_HEADER_SIZE 16
+
+typedef struct ili9481_asset_header {
+	uint32_t magic;
+	uint16_t width;
+	uint16_t height;
+	uint8_t pixel_format; // ILI9481_PIXEL_FORMAT_16 or ILI9481_PIXEL_FORMAT_18
+	uint8_t reserved[3];
+	uint32_t size; // Bytes of pixel data
+} ili9481_asset_header_t;
+
+// Validate asset and fill header
+esp_err_t ili9481_asset_parse(const uint8_t *asset, size_t length, ili9481_asset_header_t *header);
+// Pixels are streamed without conversion, display is switched to pixel
+// format of asset. Position is in logical lines like ili9481_draw_area.
+esp_err_t ili9481_draw_asset(ili9481_driver_t *driver, const uint8_t *asset, size_t length, uint16_t x, uint16_t y);
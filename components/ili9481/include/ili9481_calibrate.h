@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "ili9481.h"
+
+
+typedef struct ili9481_calibration_config {
+	uint8_t min_div; // Fastest divider tried, at least 2
+	uint8_t max_div; // Slowest divider tried
+	uint8_t margin; // Added to fastest stable divider
+	uint8_t repeat; // Pattern writes verified at every step
+	const char *nvs_namespace; // Cache for result, NULL disables cache
+	bool force; // Ignore cached result
+} ili9481_calibration_config_t;
+
+// Find fastest write clock, which passes readback of test pattern. Pattern is
+// drawn at top of display in 18-bit and 16-bit pixel formats, so that all 8
+// data lines are verified. On success clock is set and stored to
+// driver->clock_div. NVS must be initialized when cache is used.
+esp_err_t ili9481_calibrate_clock(ili9481_driver_t *driver, const ili9481_calibration_config_t *config);
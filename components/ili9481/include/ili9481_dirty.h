@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "ili9481.h"
+
+
+#define ILI9481_DIRTY_MAX_RECTS 16
+
+
+typedef struct ili9481_rect {
+	uint16_t x;
+	uint16_t y;
+	uint16_t width;
+	uint16_t height;
+} ili9481_rect_t;
+
+// Render lines of rectangle starting at y into buffer (width * lines pixels)
+typedef void (*ili9481_dirty_render_cb_t)(ili9481_driver_t *driver, ili9481_color_t *buffer, uint16_t x, uint16_t y, uint16_t width, uint16_t lines, void *user_data);
+
+typedef struct ili9481_dirty_config {
+	uint32_t window_cost; // Cost of set_window in pixels, rectangles are merged when union adds fewer pixels
+	size_t buffer_pixels; // Render buffer, at least display_width
+	ili9481_dirty_render_cb_t render;
+	void *user_data;
+} ili9481_dirty_config_t;
+
+typedef struct ili9481_dirty_report {
+	uint32_t rects; // Windows written
+	uint32_t pixels;
+	size_t bytes_written; // Pixel data and window setup
+	size_t bytes_saved; // Compared to full frame
+} ili9481_dirty_report_t;
+
+typedef struct ili9481_dirty ili9481_dirty_t;
+
+esp_err_t ili9481_dirty_create(ili9481_driver_t *driver, const ili9481_dirty_config_t *config, ili9481_dirty_t **dirty);
+void ili9481_dirty_destroy(ili9481_dirty_t *dirty);
+// Mark area for repaint, it's clipped to display. Lines are logical like in
+// ili9481_draw_area.
+void ili9481_dirty_invalidate(ili9481_dirty_t *dirty, uint16_t x, uint16_t y, uint16_t width, uint16_t height);
+void ili9481_dirty_invalidate_all(ili9481_dirty_t *dirty);
+// Render and write invalidated areas in current pixel format, report can be NULL
+void ili9481_dirty_flush(ili9481_dirty_t *dirty, ili9481_dirty_report_t *report);
@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp32/rom/lldesc.h"
+#include "esp_err.h"
+#include "esp_intr_alloc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "soc/i2s_struct.h"
+
+
+// Largest word aligned length, which fits to 12 bit lldesc_t size field
+// (4092 is divisible by 3, so RGB666 pixels are never split between
+// descriptors)
+#define I2S_DMA_MAX_LENGTH 4092
+// Data pins of 16-bit bus, 8-bit bus uses first 8
+#define I2S_DATA_PINS 16
+// WR clock is 160 MHz / clock_div / 2 (tx_bck_div_num)
+#define I2S_CLOCK_DIV_DEFAULT 8
+#define I2S_CLOCK_DIV_MIN 2
+
+
+struct i2s_transaction_t;
+typedef void(*transaction_cb_t)(struct i2s_transaction_t *trans);
+
+typedef struct i2s_transaction_t {
+	const void *data;
+	size_t length;
+	void *user_data;
+	lldesc_t *desc; // Chain built by caller (i2s_build_dma_chain), NULL to use driver descriptors
+} i2s_transaction_t;
+
+typedef struct {
+	int queue_size; // Maximum number of transactions waiting for transfer, without post_cb also finished ones not retrieved yet
+	transaction_cb_t pre_cb; // Called from i2s_trans_enqueue before transaction is passed to DMA
+	transaction_cb_t post_cb; // Called from interrupt when DMA has read all data, results are not queued if set
+	size_t max_transfer_size; // Longest transaction in bytes, determines number of DMA descriptors
+	int clock_div; // clkm_div_num, 0 for I2S_CLOCK_DIV_DEFAULT
+	int data_bits; // 8 or 16, 0 for 8
+	int pin_wr;
+	int pin_data[I2S_DATA_PINS];
+} i2s_driver_config_t;
+
+typedef struct {
+	size_t desc_count; // Descriptors in ring, at least 2
+	size_t buffer_size; // Bytes per descriptor, multiple of 4, at most I2S_DMA_MAX_LENGTH
+	size_t prefill; // Filled descriptors needed before DMA (re)starts, 0 for 1
+} i2s_ring_config_t;
+
+// Circular chain, CPU fills descriptors with owner 0, DMA clears owner after
+// sending (auto write back) and stops on descriptor, which is not refilled yet
+typedef struct {
+	lldesc_t *desc;
+	uint8_t *buffers;
+	size_t desc_count;
+	size_t buffer_size;
+	size_t prefill;
+	size_t head; // Next descriptor filled by CPU
+	size_t tail; // Oldest descriptor owned by DMA
+	size_t queued; // Descriptors owned by DMA
+	bool running;
+	SemaphoreHandle_t free_semaphore; // Counts descriptors owned by CPU
+} i2s_ring_t;
+
+// Transaction passed to DMA, its chain is linked after chain of previous one
+typedef struct {
+	i2s_transaction_t *transaction;
+	lldesc_t *first;
+	lldesc_t *last;
+} i2s_chain_t;
+
+typedef struct {
+	i2s_chain_t *chains; // queue_size + 1 entries, driver descriptors of entry follow in same order in dma
+	size_t chain_count;
+	size_t chain_head; // Next entry used by enqueue
+	size_t chain_tail; // Oldest unfinished transaction
+	size_t chain_queued; // Transactions not finished yet
+	bool running; // DMA started and FIFO not drained yet
+	QueueHandle_t ret_queue;
+	SemaphoreHandle_t tx_semaphore; // Given when bus becomes idle
+	SemaphoreHandle_t slot_semaphore; // Counts transactions, which can be enqueued, result queue can't overflow
+	transaction_cb_t pre_cb;
+	transaction_cb_t post_cb;
+	intr_handle_t intr_handle;
+	lldesc_t *dma;
+	size_t dma_count; // Per transaction
+	i2s_ring_t *ring; // Ring streaming active, transactions are not used
+	portMUX_TYPE lock;
+	int data_bits;
+	int pin_wr;
+	int pin_data[I2S_DATA_PINS];
+	i2s_dev_t *hw;
+} i2s_driver_t;
+
+// Number of descriptors needed for transfer of length bytes
+static inline size_t i2s_dma_desc_count(size_t length) {
+	return (length + I2S_DMA_MAX_LENGTH - 1) / I2S_DMA_MAX_LENGTH;
+}
+
+// Fill descriptor chain with data, returns first descriptor or NULL if count is too small
+lldesc_t *i2s_build_dma_chain(lldesc_t *desc, size_t count, const void *data, size_t length);
+// Convert bytes to order, in which they leave 8-bit LCD mode FIFO (swap 16-bit halves of every word)
+void i2s_swap_halfwords(void *data, size_t length);
+// Convert big endian 16-bit samples to order, in which they leave 16-bit LCD mode FIFO (reverse bytes of every word)
+void i2s_swap_bytes(void *data, size_t length);
+
+esp_err_t i2s_init(i2s_dev_t *dev, const i2s_driver_config_t *config);
+void i2s_deinit(i2s_dev_t *dev);
+// Queue transaction, data must be DMA capable, word aligned and length must be
+// multiple of 4. Transaction, data and caller descriptors must stay valid
+// until it's finished. Chain of transaction is linked to end of running
+// chain, so DMA continues without stop, last caller descriptor is changed for
+// that and caller chain can't be queued again before it's finished.
+// Returns ESP_ERR_TIMEOUT if queue is still full after ticks_to_wait, results
+// not retrieved yet occupy queue.
+esp_err_t i2s_trans_enqueue(i2s_dev_t *dev, i2s_transaction_t *transaction, TickType_t ticks_to_wait);
+// Get finished transaction (in order of enqueue), each transaction has to be
+// retrieved unless driver has post_cb. Data of finished transaction are read
+// by DMA, but can still be in FIFO, i2s_wait_idle waits for bus.
+esp_err_t i2s_trans_get_result(i2s_dev_t *dev, i2s_transaction_t **transaction, TickType_t ticks_to_wait);
+// Wait until all queued transactions are finished and FIFO is empty
+void i2s_wait_idle(i2s_dev_t *dev);
+// Connect data and WR pins to I2S (done by i2s_init)
+void i2s_attach_pins(i2s_dev_t *dev);
+// Give data and WR pins back to GPIO, bus must be idle
+void i2s_detach_pins(i2s_dev_t *dev);
+// Change WR clock, bus must be idle
+esp_err_t i2s_set_clock_div(i2s_dev_t *dev, int clock_div);
+
+// Stream data through descriptor ring without stopping between buffers,
+// transaction queue must be idle and pins attached
+esp_err_t i2s_ring_start(i2s_dev_t *dev, const i2s_ring_config_t *config);
+// Wait for free buffer of buffer_size bytes, every call has to be followed by i2s_ring_submit
+uint8_t *i2s_ring_get_buffer(i2s_dev_t *dev, TickType_t ticks_to_wait);
+// Pass buffer in FIFO order to DMA, length must be multiple of 4
+void i2s_ring_submit(i2s_dev_t *dev, size_t length);
+// Wait until all submitted buffers are sent and free ring
+void i2s_ring_stop(i2s_dev_t *dev);
@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#include "ili9481.h"
+
+
+// Render strip of lines starting at y into buffer (display_width * lines pixels)
+typedef void (*ili9481_render_cb_t)(ili9481_driver_t *driver, ili9481_color_t *buffer, uint16_t y, uint16_t lines, void *user_data);
+
+typedef struct ili9481_pipeline_config {
+	size_t buffer_count; // Strip buffers in ring, at least 2
+	uint16_t strip_lines;
+	int render_core;
+	int bus_core;
+	UBaseType_t priority;
+	uint8_t pixel_format; // Set before every frame, 0 keeps driver pixel format
+	ili9481_render_cb_t render;
+	void *user_data;
+} ili9481_pipeline_config_t;
+
+typedef struct ili9481_pipeline_stats {
+	uint32_t frames;
+	uint32_t strips;
+	int64_t elapsed_us; // Time since pipeline start
+	int64_t render_busy_us; // Time spent in render callback
+	int64_t render_wait_us; // Render task waiting for free buffer
+	int64_t bus_busy_us; // Time spent writing strips to display
+	int64_t bus_wait_us; // Bus task waiting for rendered strip, while frame is in progress
+} ili9481_pipeline_stats_t;
+
+typedef struct ili9481_pipeline ili9481_pipeline_t;
+
+// Driver must not be used by other tasks while pipeline is running
+esp_err_t ili9481_pipeline_create(ili9481_driver_t *driver, const ili9481_pipeline_config_t *config, ili9481_pipeline_t **pipeline);
+void ili9481_pipeline_destroy(ili9481_pipeline_t *pipeline);
+// Render whole frame, returns when last strip is rendered, transfer continues in background
+void ili9481_pipeline_render_frame(ili9481_pipeline_t *pipeline);
+// Wait until all rendered frames are on display
+void ili9481_pipeline_wait_transferred(ili9481_pipeline_t *pipeline);
+void ili9481_pipeline_get_stats(ili9481_pipeline_t *pipeline, ili9481_pipeline_stats_t *stats);
+void ili9481_pipeline_reset_stats(ili9481_pipeline_t *pipeline);
@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "ili9481.h"
+
+
+typedef enum ili9481_power_mode {
+	ILI9481_POWER_NORMAL = 0,
+	ILI9481_POWER_PARTIAL = 1, // Only lines of partial area are driven
+	ILI9481_POWER_IDLE = 2, // 8 colors, only MSB of every channel is shown
+	ILI9481_POWER_PARTIAL_IDLE = 3,
+} ili9481_power_mode_t;
+
+#define ILI9481_POWER_MODE_COUNT 4
+
+typedef struct ili9481_power_config {
+	uint16_t partial_start; // First line of status band
+	uint16_t partial_end; // Last line of status band
+	const ili9481_command_t *setup; // Optional timing and power settings of partial and idle modes, run at create
+} ili9481_power_config_t;
+
+// Time from request until commands are on display, indexed by target mode
+typedef struct ili9481_power_stats {
+	uint32_t transitions[ILI9481_POWER_MODE_COUNT];
+	int64_t last_us[ILI9481_POWER_MODE_COUNT];
+	int64_t max_us[ILI9481_POWER_MODE_COUNT];
+	int64_t time_us[ILI9481_POWER_MODE_COUNT]; // Time spent in mode
+} ili9481_power_stats_t;
+
+typedef struct ili9481_power ili9481_power_t;
+
+// Display must be in normal mode
+esp_err_t ili9481_power_create(ili9481_driver_t *driver, const ili9481_power_config_t *config, ili9481_power_t **power);
+// Restores normal mode
+void ili9481_power_destroy(ili9481_power_t *power);
+void ili9481_power_set_mode(ili9481_power_t *power, ili9481_power_mode_t mode);
+ili9481_power_mode_t ili9481_power_get_mode(ili9481_power_t *power);
+// Switch to lowest power mode allowed by content, band_only if nothing
+// outside of status band has to be visible, primary_colors if content uses
+// only colors of ili9481_power_color_is_primary
+ili9481_power_mode_t ili9481_power_select(ili9481_power_t *power, bool band_only, bool primary_colors);
+void ili9481_power_get_stats(ili9481_power_t *power, ili9481_power_stats_t *stats);
+
+// Color is shown without change in idle mode
+static inline bool ili9481_power_color_is_primary(ili9481_color_t color) {
+	const uint16_t r = color & 0x1f;
+	const uint16_t g = (color >> 5) & 0x3f;
+	const uint16_t b = color >> 11;
+	return (r == 0 || r == 0x1f) && (g == 0 || g == 0x3f) && (b == 0 || b == 0x1f);
+}
@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ili9481.h"
+
+
+// Span kernels write 32-bit words with unrolled loops, unaligned heads and
+// tails are handled per pixel. Packed spans are in bus order of
+// ILI9481_PIXEL_FORMAT_16 (big endian) or ILI9481_PIXEL_FORMAT_18 (blue,
+// green, red bytes).
+
+void ili9481_span_fill(ili9481_color_t *dst, ili9481_color_t color, size_t count);
+void ili9481_span_fill_packed16(uint8_t *dst, ili9481_color_t color, size_t count);
+void ili9481_span_fill_packed18(uint8_t *dst, ili9481_color_t color, size_t count);
+// Returns bytes written
+size_t ili9481_span_pack16(uint8_t *dst, const ili9481_color_t *src, size_t count);
+size_t ili9481_span_pack18(uint8_t *dst, const ili9481_color_t *src, size_t count);
+// Blend src over dst, alpha 0 keeps dst, 255 copies src
+void ili9481_span_blend(ili9481_color_t *dst, const ili9481_color_t *src, uint8_t alpha, size_t count);
+// Blend color through alpha mask with 1, 2, 4 or 8 bits per pixel (packed
+// from least significant bits, lines are not padded) into target buffer at
+// x, y. Transparent and opaque mask bytes are skipped or filled at once.
+void ili9481_draw_alpha_bitmap(const uint8_t *src_buf, uint8_t bits, ili9481_color_t *target_buf, ili9481_color_t color, int x, int y, int src_w, int src_h, int target_w, int target_h);
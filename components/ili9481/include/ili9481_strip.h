@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "ili9481.h"
+
+
+typedef enum ili9481_layer_event {
+	ILI9481_LAYER_EVENT_START, // Animation step starts
+	ILI9481_LAYER_EVENT_END,
+	ILI9481_LAYER_EVENT_FRAME_START,
+	ILI9481_LAYER_EVENT_FRAME_END,
+} ili9481_layer_event_t;
+
+typedef struct ili9481_frame_info {
+	uint64_t frame; // Frame in current animation step
+	uint64_t total_frame;
+	uint64_t duration; // Frames of current animation step
+	int64_t time_us; // Time since start of animation step
+} ili9481_frame_info_t;
+
+// Strip of full display lines, pixel (x, y) is buffer[(y - strip->y) * width + x]
+typedef struct ili9481_strip {
+	ili9481_color_t *buffer;
+	uint16_t width;
+	uint16_t y;
+	uint16_t lines;
+} ili9481_strip_t;
+
+typedef void (*ili9481_layer_draw_cb_t)(ili9481_driver_t *driver, const ili9481_strip_t *strip, const ili9481_frame_info_t *frame, void *user_data);
+typedef void (*ili9481_layer_event_cb_t)(ili9481_driver_t *driver, ili9481_layer_event_t event, const ili9481_frame_info_t *frame, void *user_data);
+
+// Layers are drawn bottom to top, layer is skipped for strips outside of its
+// lines. Lines y .. y + height - 1, height 0 covers whole display. Bottom
+// visible layer must fill every pixel of its lines in strip, other pixels are
+// black.
+typedef struct ili9481_layer {
+	ili9481_layer_draw_cb_t draw; // NULL terminates list of layers
+	ili9481_layer_event_cb_t event; // Optional
+	void *user_data;
+	uint16_t y;
+	uint16_t height;
+} ili9481_layer_t;
+
+// Step without layers only waits, use it with frame_period_us
+typedef struct ili9481_animation_step {
+	uint64_t duration; // Frames, step lasts duration * frame_period_us when paced
+	const ili9481_layer_t *layers; // NULL terminates animation
+} ili9481_animation_step_t;
+
+typedef struct ili9481_strip_renderer_config {
+	uint16_t strip_lines; // 0 sizes strips from free DMA memory
+	size_t max_memory; // Limit of both strip buffers in bytes with automatic strip_lines, 0 for quarter of largest free DMA block
+	uint32_t frame_period_us; // Target frame period, 0 renders frames back to back
+} ili9481_strip_renderer_config_t;
+
+typedef struct ili9481_strip_stats {
+	uint32_t frames_rendered;
+	uint32_t frames_skipped; // Frames merged into later frame, because previous frame was over budget
+	uint32_t last_cycles; // CPU cycles of last frame
+	uint32_t max_cycles;
+} ili9481_strip_stats_t;
+
+typedef struct ili9481_strip_renderer ili9481_strip_renderer_t;
+
+// Two strip buffers, one is rendered while other one is sent by DMA (buses
+// without DMA copy strip). Frames are written in 16-bit pixel format.
+esp_err_t ili9481_strip_renderer_create(ili9481_driver_t *driver, const ili9481_strip_renderer_config_t *config, ili9481_strip_renderer_t **renderer);
+void ili9481_strip_renderer_destroy(ili9481_strip_renderer_t *renderer);
+uint16_t ili9481_strip_renderer_get_lines(ili9481_strip_renderer_t *renderer);
+// Draw one frame of layers, frame can be NULL
+void ili9481_strip_render_frame(ili9481_strip_renderer_t *renderer, const ili9481_layer_t *layers, const ili9481_frame_info_t *frame);
+// Run all steps with their events, returns when last step is finished. With
+// frame_period_us frame numbers follow wall clock, task sleeps between frames
+// and frames are skipped when rendering is late.
+void ili9481_strip_run_animation(ili9481_strip_renderer_t *renderer, const ili9481_animation_step_t *animation);
+void ili9481_strip_renderer_get_stats(ili9481_strip_renderer_t *renderer, ili9481_strip_stats_t *stats);
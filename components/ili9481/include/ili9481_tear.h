@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "ili9481.h"
+
+
+typedef enum ili9481_tear_mode {
+	// Whole frame is written after vertical blank, write must take less than
+	// two refresh periods and must not run at same speed as refresh
+	ILI9481_TEAR_FULL = 0,
+	// Top half is written while refresh is in bottom half, bottom half after
+	// next vertical blank, each half must take less than half of refresh period
+	ILI9481_TEAR_SPLIT = 1,
+} ili9481_tear_mode_t;
+
+typedef struct ili9481_tear_config {
+	int pin_te; // -1 if not connected, ILI9481_GET_SCANLINE is polled
+	ili9481_tear_mode_t mode;
+} ili9481_tear_config_t;
+
+// Writes GRAM lines y .. y + height - 1 of frame, including window setup.
+// Lines are not mapped through scroll area, callback uses ili9481_set_window.
+typedef void (*ili9481_tear_draw_t)(ili9481_driver_t *driver, uint16_t y, uint16_t height, void *user_data);
+
+typedef struct ili9481_tear ili9481_tear_t;
+
+// Lines are counted in refresh order, address mode must keep GRAM rows in
+// refresh order and scroll start must be at top of scroll area
+esp_err_t ili9481_tear_create(ili9481_driver_t *driver, const ili9481_tear_config_t *config, ili9481_tear_t **tear);
+// Turns tear effect output off
+void ili9481_tear_destroy(ili9481_tear_t *tear);
+uint16_t ili9481_tear_get_scanline(ili9481_tear_t *tear);
+esp_err_t ili9481_tear_wait_vsync(ili9481_tear_t *tear);
+// Wait until refresh reaches line
+esp_err_t ili9481_tear_wait_scanline(ili9481_tear_t *tear, uint16_t line);
+esp_err_t ili9481_tear_present(ili9481_tear_t *tear, ili9481_tear_draw_t draw, void *user_data);
@@ -0,0 +1,25 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "glyph_cache.h"
+
+
+#define BITMAP_FONT_MAX_SCALE 4
+#define BITMAP_FONT_WIDTH 5
+#define BITMAP_FONT_HEIGHT 7
+
+
+// Built-in 5x7 ASCII font enlarged by integer scale, other codepoints are
+// drawn as box. Pointer to font is face of glyph cache.
+typedef struct bitmap_font {
+	uint8_t scale; // 1 .. BITMAP_FONT_MAX_SCALE
+	uint8_t bitmap[(BITMAP_FONT_WIDTH * BITMAP_FONT_HEIGHT * BITMAP_FONT_MAX_SCALE * BITMAP_FONT_MAX_SCALE * 2 + 7) / 8];
+} bitmap_font_t;
+
+// Rasterize callback for glyph cache, user_data is bitmap_font_t
+esp_err_t bitmap_font_rasterize(uint32_t codepoint, glyph_t *glyph, void *user_data);
@@ -0,0 +1,240 @@
+// SPDX-License-Identifier: MIT
+#include <stdlib.h>
+#include <string.h>
+
+#include "glyph_cache.h"
+
+
+#define NONE -1
+
+
+typedef struct cache_entry {
+	const void *face;
+	uint32_t codepoint;
+	uint16_t pixel_size;
+	glyph_t glyph;
+	size_t offset; // Bitmap position in arena
+	size_t size;
+	int32_t prev; // Least recently used list, head is most recent
+	int32_t next; // Also list of free entries
+	int32_t hash_next;
+} cache_entry_t;
+
+struct glyph_cache {
+	uint8_t *arena;
+	size_t arena_size;
+	size_t arena_end; // Bitmaps are appended, gaps are removed by compaction
+	cache_entry_t *entries;
+	int32_t *order; // Scratch for compaction
+	size_t max_glyphs;
+	int32_t *buckets;
+	uint32_t bucket_mask;
+	int32_t lru_head;
+	int32_t lru_tail;
+	int32_t free_head;
+	glyph_t uncached; // Glyph larger than arena
+	glyph_cache_stats_t stats;
+};
+
+
+static uint32_t hash_key(const void *face, uint16_t pixel_size, uint32_t codepoint) {
+	uint32_t hash = (uint32_t)(uintptr_t)face ^ ((uint32_t)pixel_size << 21) ^ codepoint;
+	hash ^= hash >> 16;
+	hash *= 0x45d9f3b;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+
+static void lru_unlink(glyph_cache_t *cache, int32_t index) {
+	cache_entry_t *entry = &cache->entries[index];
+	if (entry->prev != NONE) {
+		cache->entries[entry->prev].next = entry->next;
+	}
+	else {
+		cache->lru_head = entry->next;
+	}
+	if (entry->next != NONE) {
+		cache->entries[entry->next].prev = entry->prev;
+	}
+	else {
+		cache->lru_tail = entry->prev;
+	}
+}
+
+
+static void lru_push_head(glyph_cache_t *cache, int32_t index) {
+	cache_entry_t *entry = &cache->entries[index];
+	entry->prev = NONE;
+	entry->next = cache->lru_head;
+	if (cache->lru_head != NONE) {
+		cache->entries[cache->lru_head].prev = index;
+	}
+	cache->lru_head = index;
+	if (cache->lru_tail == NONE) {
+		cache->lru_tail = index;
+	}
+}
+
+
+static void evict(glyph_cache_t *cache, int32_t index) {
+	cache_entry_t *entry = &cache->entries[index];
+	int32_t *link = &cache->buckets[hash_key(entry->face, entry->pixel_size, entry->codepoint) & cache->bucket_mask];
+	while (*link != index) {
+		link = &cache->entries[*link].hash_next;
+	}
+	*link = entry->hash_next;
+	lru_unlink(cache, index);
+	cache->stats.used -= entry->size;
+	cache->stats.evictions++;
+	entry->next = cache->free_head;
+	cache->free_head = index;
+}
+
+
+// Move live bitmaps to start of arena in their order
+static void compact(glyph_cache_t *cache) {
+	size_t count = 0;
+	for (int32_t index = cache->lru_head; index != NONE; index = cache->entries[index].next) {
+		// Insertion sort by offset, compaction is rare
+		size_t pos = count++;
+		while (pos > 0 && cache->entries[cache->order[pos - 1]].offset > cache->entries[index].offset) {
+			cache->order[pos] = cache->order[pos - 1];
+			pos--;
+		}
+		cache->order[pos] = index;
+	}
+
+	size_t end = 0;
+	for (size_t i = 0; i < count; ++i) {
+		cache_entry_t *entry = &cache->entries[cache->order[i]];
+		memmove(cache->arena + end, cache->arena + entry->offset, entry->size);
+		entry->offset = end;
+		entry->glyph.bitmap = cache->arena + end;
+		end += entry->size;
+	}
+	cache->arena_end = end;
+	cache->stats.compactions++;
+}
+
+
+// Returns free entry with bitmap space of size bytes
+static int32_t allocate(glyph_cache_t *cache, size_t size) {
+	if (cache->free_head == NONE) {
+		evict(cache, cache->lru_tail);
+	}
+	if (cache->arena_size - cache->arena_end < size) {
+		while (cache->arena_size - cache->stats.used < size) {
+			evict(cache, cache->lru_tail);
+		}
+		compact(cache);
+	}
+	const int32_t index = cache->free_head;
+	cache_entry_t *entry = &cache->entries[index];
+	cache->free_head = entry->next;
+	entry->offset = cache->arena_end;
+	entry->size = size;
+	cache->arena_end += size;
+	cache->stats.used += size;
+	return index;
+}
+
+
+esp_err_t glyph_cache_create(size_t arena_size, size_t max_glyphs, glyph_cache_t **cache_out) {
+	if (max_glyphs == 0 || max_glyphs > INT32_MAX) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	glyph_cache_t *cache = (glyph_cache_t *)calloc(1, sizeof(glyph_cache_t));
+	if (cache == NULL) {
+		return ESP_ERR_NO_MEM;
+	}
+	size_t bucket_count = 1;
+	while (bucket_count < max_glyphs) {
+		bucket_count <<= 1;
+	}
+	cache->arena = (uint8_t *)malloc(arena_size);
+	cache->entries = (cache_entry_t *)malloc(max_glyphs * sizeof(cache_entry_t));
+	cache->order = (int32_t *)malloc(max_glyphs * sizeof(int32_t));
+	cache->buckets = (int32_t *)malloc(bucket_count * sizeof(int32_t));
+	if (cache->arena == NULL || cache->entries == NULL || cache->order == NULL || cache->buckets == NULL) {
+		glyph_cache_destroy(cache);
+		return ESP_ERR_NO_MEM;
+	}
+	cache->arena_size = arena_size;
+	cache->max_glyphs = max_glyphs;
+	cache->bucket_mask = bucket_count - 1;
+	glyph_cache_clear(cache);
+	*cache_out = cache;
+	return ESP_OK;
+}
+
+
+void glyph_cache_destroy(glyph_cache_t *cache) {
+	free(cache->arena);
+	free(cache->entries);
+	free(cache->order);
+	free(cache->buckets);
+	free(cache);
+}
+
+
+const glyph_t *glyph_cache_get(glyph_cache_t *cache, const void *face, uint16_t pixel_size, uint32_t codepoint, glyph_rasterize_cb_t rasterize, void *user_data) {
+	const uint32_t bucket = hash_key(face, pixel_size, codepoint) & cache->bucket_mask;
+	for (int32_t index = cache->buckets[bucket]; index != NONE; index = cache->entries[index].hash_next) {
+		cache_entry_t *entry = &cache->entries[index];
+		if (entry->codepoint == codepoint && entry->face == face && entry->pixel_size == pixel_size) {
+			cache->stats.hits++;
+			if (cache->lru_head != index) {
+				lru_unlink(cache, index);
+				lru_push_head(cache, index);
+			}
+			return &entry->glyph;
+		}
+	}
+
+	cache->stats.misses++;
+	glyph_t glyph;
+	if (rasterize(codepoint, &glyph, user_data) != ESP_OK) {
+		return NULL;
+	}
+	const size_t size = ((size_t)glyph.bitmap_width * glyph.bitmap_height * 2 + 7) / 8;
+	if (size > cache->arena_size) {
+		cache->uncached = glyph;
+		return &cache->uncached;
+	}
+
+	const int32_t index = allocate(cache, size);
+	cache_entry_t *entry = &cache->entries[index];
+	entry->face = face;
+	entry->pixel_size = pixel_size;
+	entry->codepoint = codepoint;
+	entry->glyph = glyph;
+	entry->glyph.bitmap = cache->arena + entry->offset;
+	if (size > 0) {
+		memcpy(cache->arena + entry->offset, glyph.bitmap, size);
+	}
+	entry->hash_next = cache->buckets[bucket];
+	cache->buckets[bucket] = index;
+	lru_push_head(cache, index);
+	return &entry->glyph;
+}
+
+
+void glyph_cache_clear(glyph_cache_t *cache) {
+	for (size_t i = 0; i <= cache->bucket_mask; ++i) {
+		cache->buckets[i] = NONE;
+	}
+	for (size_t i = 0; i < cache->max_glyphs; ++i) {
+		cache->entries[i].next = i + 1 < cache->max_glyphs ? (int32_t)(i + 1) : NONE;
+	}
+	cache->free_head = 0;
+	cache->lru_head = NONE;
+	cache->lru_tail = NONE;
+	cache->arena_end = 0;
+	memset(&cache->stats, 0, sizeof(cache->stats));
+}
+
+
+void glyph_cache_get_stats(glyph_cache_t *cache, glyph_cache_stats_t *stats) {
+	*stats = cache->stats;
+}
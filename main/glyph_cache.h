@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+
+// Coverage bitmap with 2 bits per pixel (ili9481_draw_gray2_bitmap layout)
+// and metrics of rendered glyph
+typedef struct glyph {
+	const uint8_t *bitmap;
+	int16_t bitmap_left;
+	int16_t bitmap_top;
+	uint16_t bitmap_width;
+	uint16_t bitmap_height;
+	int16_t advance;
+} glyph_t;
+
+typedef struct glyph_cache_stats {
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t evictions;
+	uint32_t compactions;
+	size_t used; // Bytes of bitmaps in arena
+} glyph_cache_stats_t;
+
+// Fill glyph, bitmap has to be valid only until copied to cache
+typedef esp_err_t (*glyph_rasterize_cb_t)(uint32_t codepoint, glyph_t *glyph, void *user_data);
+
+typedef struct glyph_cache glyph_cache_t;
+
+// Bitmaps are stored in arena of arena_size bytes, least recently used glyphs
+// are evicted when arena or max_glyphs is full
+esp_err_t glyph_cache_create(size_t arena_size, size_t max_glyphs, glyph_cache_t **cache);
+void glyph_cache_destroy(glyph_cache_t *cache);
+// Glyph is keyed by face, pixel size and codepoint, rasterize is called on
+// miss. Returned glyph is valid until next call.
+const glyph_t *glyph_cache_get(glyph_cache_t *cache, const void *face, uint16_t pixel_size, uint32_t codepoint, glyph_rasterize_cb_t rasterize, void *user_data);
+// Drop all glyphs and reset statistics, required when face is destroyed
+void glyph_cache_clear(glyph_cache_t *cache);
+void glyph_cache_get_stats(glyph_cache_t *cache, glyph_cache_stats_t *stats);
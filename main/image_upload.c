@@ -0,0 +1,259 @@
+// SPDX-License-Identifier: MIT
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "image_upload.h"
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+
+// Ring buffer of UART driver holds whole window of frames
+#define RX_BUFFER_SIZE ((IMAGE_UPLOAD_MAX_PAYLOAD + IMAGE_UPLOAD_FRAME_OVERHEAD) * (IMAGE_UPLOAD_WINDOW + 1))
+#define READ_CHUNK 1024
+#define IDLE_TIMEOUT_MS 5000
+
+#define HEADER_PAYLOAD 13
+
+
+enum {
+	STATE_SYNC,
+	STATE_HEAD,
+	STATE_PAYLOAD,
+};
+
+
+static const char *TAG = "image_upload";
+
+
+static const uint16_t crc_table[16] = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+	0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+};
+
+
+uint16_t image_upload_crc(uint16_t crc, const uint8_t *data, size_t length) {
+	while (length--) {
+		crc = (crc << 4) ^ crc_table[(crc >> 12) ^ (*data >> 4)];
+		crc = (crc << 4) ^ crc_table[(crc >> 12) ^ (*data & 0x0f)];
+		data++;
+	}
+	return crc;
+}
+
+
+static uint16_t read_u16(const uint8_t *data) {
+	return data[0] | (data[1] << 8);
+}
+
+
+static uint32_t read_u32(const uint8_t *data) {
+	return read_u16(data) | ((uint32_t)read_u16(data + 2) << 16);
+}
+
+
+static void send_reply(image_upload_t *upload, uint8_t type) {
+	uint8_t frame[IMAGE_UPLOAD_FRAME_OVERHEAD] = {IMAGE_UPLOAD_SYNC, type, upload->expected_seq, 0, 0};
+	const uint16_t crc = image_upload_crc(0xffff, frame + 1, 4);
+	frame[5] = crc & 0xff;
+	frame[6] = crc >> 8;
+	upload->reply(frame, sizeof(frame), upload->user_data);
+}
+
+
+static bool start_image(image_upload_t *upload, const uint8_t *payload, size_t length) {
+	ili9481_driver_t *driver = upload->driver;
+	if (length != HEADER_PAYLOAD) {
+		return false;
+	}
+	const uint16_t x = read_u16(payload);
+	const uint16_t y = read_u16(payload + 2);
+	const uint16_t width = read_u16(payload + 4);
+	const uint16_t height = read_u16(payload + 6);
+	const uint8_t pixel_format = payload[8];
+	const uint32_t size = read_u32(payload + 9);
+	const size_t pixel_size = pixel_format == ILI9481_PIXEL_FORMAT_16 ? 2 : 3;
+	if (pixel_format != ILI9481_PIXEL_FORMAT_16 && pixel_format != ILI9481_PIXEL_FORMAT_18) {
+		return false;
+	}
+	if (width == 0 || height == 0 || x + width > driver->display_width || y + height > driver->display_height) {
+		return false;
+	}
+	if (size != (uint32_t)width * height * pixel_size) {
+		return false;
+	}
+	if (pixel_format != driver->pixel_format) {
+		ili9481_set_pixel_format(driver, pixel_format);
+		// Rejected by 16-bit bus
+		if (pixel_format != driver->pixel_format) {
+			return false;
+		}
+	}
+
+	ili9481_set_window(driver, x, y, x + width - 1, y + height - 1);
+	upload->remaining = size;
+	return true;
+}
+
+
+static void process_frame(image_upload_t *upload) {
+	const uint8_t *payload = upload->frame + 5;
+	const uint16_t crc = image_upload_crc(0xffff, upload->frame + 1, upload->length + 4);
+	if (crc != read_u16(payload + upload->length)) {
+		upload->errors++;
+		send_reply(upload, IMAGE_UPLOAD_NAK);
+		return;
+	}
+
+	// Frames following lost frame are dropped until it is sent again, repeated
+	// ack lets sender recover from lost ack
+	if (upload->seq != upload->expected_seq) {
+		send_reply(upload, IMAGE_UPLOAD_ACK);
+		return;
+	}
+
+	bool valid;
+	if (upload->type == IMAGE_UPLOAD_HEADER) {
+		valid = start_image(upload, payload, upload->length);
+	}
+	else {
+		valid = upload->type == IMAGE_UPLOAD_DATA && upload->remaining > 0 && upload->length <= upload->remaining;
+		if (valid) {
+			// Driver copies data to bus, frame buffer is free after call
+			ili9481_write_data(upload->driver, payload, upload->length);
+			upload->remaining -= upload->length;
+			upload->done = upload->remaining == 0;
+		}
+	}
+	if (!valid) {
+		upload->errors++;
+		send_reply(upload, IMAGE_UPLOAD_NAK);
+		return;
+	}
+	upload->expected_seq++;
+	send_reply(upload, IMAGE_UPLOAD_ACK);
+}
+
+
+void image_upload_init(image_upload_t *upload, ili9481_driver_t *driver, image_upload_reply_cb_t reply, void *user_data) {
+	memset(upload, 0, offsetof(image_upload_t, frame));
+	upload->driver = driver;
+	upload->reply = reply;
+	upload->user_data = user_data;
+	upload->state = STATE_SYNC;
+}
+
+
+bool image_upload_feed(image_upload_t *upload, const uint8_t *data, size_t length) {
+	const uint8_t *end = data + length;
+	while (data < end && !upload->done) {
+		switch (upload->state) {
+			case STATE_SYNC: {
+				const uint8_t *sync = memchr(data, IMAGE_UPLOAD_SYNC, end - data);
+				if (sync == NULL) {
+					return false;
+				}
+				data = sync + 1;
+				upload->frame[0] = IMAGE_UPLOAD_SYNC;
+				upload->pos = 1;
+				upload->state = STATE_HEAD;
+				break;
+			}
+			case STATE_HEAD:
+				upload->frame[upload->pos++] = *data++;
+				if (upload->pos == 5) {
+					upload->type = upload->frame[1];
+					upload->seq = upload->frame[2];
+					upload->length = read_u16(upload->frame + 3);
+					// Invalid length is noise, next sync is searched
+					upload->state = upload->length <= IMAGE_UPLOAD_MAX_PAYLOAD ? STATE_PAYLOAD : STATE_SYNC;
+				}
+				break;
+			case STATE_PAYLOAD: {
+				const size_t frame_size = upload->length + IMAGE_UPLOAD_FRAME_OVERHEAD;
+				const size_t count = MIN((size_t)(end - data), frame_size - upload->pos);
+				memcpy(upload->frame + upload->pos, data, count);
+				upload->pos += count;
+				data += count;
+				if (upload->pos == frame_size) {
+					upload->state = STATE_SYNC;
+					process_frame(upload);
+				}
+				break;
+			}
+		}
+	}
+	return upload->done;
+}
+
+
+static void uart_reply(const uint8_t *data, size_t length, void *user_data) {
+	uart_write_bytes(*(uart_port_t *)user_data, data, length);
+}
+
+
+esp_err_t image_upload_receive(ili9481_driver_t *driver, uart_port_t uart_num, uint32_t baud_rate) {
+	uint32_t previous_baud_rate = 0;
+	uart_get_baudrate(uart_num, &previous_baud_rate);
+
+	image_upload_t *upload = (image_upload_t *)malloc(sizeof(image_upload_t));
+	uint8_t *chunk = (uint8_t *)malloc(READ_CHUNK);
+	if (upload == NULL || chunk == NULL) {
+		free(upload);
+		free(chunk);
+		return ESP_ERR_NO_MEM;
+	}
+	esp_err_t ret = uart_driver_install(uart_num, RX_BUFFER_SIZE, 0, 0, NULL, 0);
+	if (ret != ESP_OK) {
+		free(upload);
+		free(chunk);
+		return ret;
+	}
+	if (baud_rate != 0) {
+		uart_set_baudrate(uart_num, baud_rate);
+	}
+
+	// No logs until transfer ends, console may share UART
+	image_upload_init(upload, driver, uart_reply, &uart_num);
+	TickType_t idle_ticks = 0;
+	ret = ESP_OK;
+	while (1) {
+		size_t available = 0;
+		uart_get_buffered_data_len(uart_num, &available);
+		const int count = uart_read_bytes(uart_num, chunk, MAX(MIN(available, READ_CHUNK), 1), pdMS_TO_TICKS(10));
+		if (count < 0) {
+			ret = ESP_FAIL;
+			break;
+		}
+		if (count == 0) {
+			idle_ticks += pdMS_TO_TICKS(10);
+			if (idle_ticks > pdMS_TO_TICKS(IDLE_TIMEOUT_MS)) {
+				ret = ESP_ERR_TIMEOUT;
+				break;
+			}
+			continue;
+		}
+		idle_ticks = 0;
+		if (image_upload_feed(upload, chunk, count)) {
+			break;
+		}
+	}
+	ili9481_wait_until_queue_empty(driver);
+
+	if (baud_rate != 0) {
+		uart_wait_tx_done(uart_num, pdMS_TO_TICKS(100));
+		uart_set_baudrate(uart_num, previous_baud_rate);
+	}
+	uart_driver_delete(uart_num);
+	if (ret == ESP_OK) {
+		ESP_LOGI(TAG, "image received, %d errors", (int)upload->errors);
+	}
+	else {
+		ESP_LOGW(TAG, "upload failed, %d errors", (int)upload->errors);
+	}
+	free(upload);
+	free(chunk);
+	return ret;
+}
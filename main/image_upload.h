@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "driver/uart.h"
+#include "esp_err.h"
+
+#include "ili9481.h"
+
+
+// Frame: sync, type, seq, length (2 bytes), payload, CRC-16/CCITT (2 bytes)
+// of type .. payload, multibyte values are little endian
+#define IMAGE_UPLOAD_SYNC 0xa5
+#define IMAGE_UPLOAD_FRAME_OVERHEAD 7
+#define IMAGE_UPLOAD_MAX_PAYLOAD 4096
+// Data frames sent without ack
+#define IMAGE_UPLOAD_WINDOW 4
+
+typedef enum image_upload_frame_type {
+	IMAGE_UPLOAD_HEADER = 0x01, // x, y, width, height (2 bytes), pixel format (1 byte), payload bytes (4 bytes), seq 0
+	IMAGE_UPLOAD_DATA = 0x02, // Pixels in bus order of pixel format, seq 1, 2, ...
+	IMAGE_UPLOAD_ACK = 0x80, // Reply, seq of next expected frame
+	IMAGE_UPLOAD_NAK = 0x81, // Reply, frames have to be sent again from seq
+} image_upload_frame_type_t;
+
+typedef void (*image_upload_reply_cb_t)(const uint8_t *data, size_t length, void *user_data);
+
+typedef struct image_upload {
+	ili9481_driver_t *driver;
+	image_upload_reply_cb_t reply;
+	void *user_data;
+	uint8_t state;
+	uint8_t type;
+	uint8_t seq;
+	uint8_t expected_seq;
+	size_t length;
+	size_t pos;
+	uint32_t remaining; // Payload bytes of image not yet written
+	bool done;
+	uint32_t errors;
+	uint8_t frame[IMAGE_UPLOAD_MAX_PAYLOAD + IMAGE_UPLOAD_FRAME_OVERHEAD];
+} image_upload_t;
+
+uint16_t image_upload_crc(uint16_t crc, const uint8_t *data, size_t length);
+void image_upload_init(image_upload_t *upload, ili9481_driver_t *driver, image_upload_reply_cb_t reply, void *user_data);
+// Parse received bytes, verified frames are written to display, returns true
+// when whole image is written
+bool image_upload_feed(image_upload_t *upload, const uint8_t *data, size_t length);
+// Receive one image using UART driver, baud_rate 0 keeps current speed
+esp_err_t image_upload_receive(ili9481_driver_t *driver, uart_port_t uart_num, uint32_t baud_rate);
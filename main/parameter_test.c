@@ -1,118 +1,75 @@
+#include <stdlib.h>
+#include <sys/param.h>
+
 #include "driver/gpio.h"
-#include "driver/periph_ctrl.h"
-#include "esp32/rom/lldesc.h"
 #include "esp32/rom/uart.h"
+#include "esp_heap_caps.h"
 #include "esp_log.h"
-#include "esp_intr_alloc.h"
-#include "hal/i2s_ll.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/semphr.h"
-#include "freertos/queue.h"
-#include "soc/i2s_reg.h"
-#include "soc/i2s_struct.h"
+#include "nvs_flash.h"
+#include "sdkconfig.h"
+
+#include "bitmap_font.h"
+#include "glyph_cache.h"
+#include "ili9481.h"
+#include "ili9481_calibrate.h"
+#include "ili9481_dirty.h"
+#include "ili9481_pipeline.h"
+#include "ili9481_power.h"
+#include "ili9481_span.h"
+#include "ili9481_strip.h"
+#include "ili9481_tear.h"
+#include "image_upload.h"
+#include "text_layout.h"
 
 const char *TAG = "ili9481";
 
 
 #define ILI9481_DISPLAY_WIDTH 320
 #define ILI9481_DISPLAY_HEIGHT 480
-
-#define CS_ACTIVE    gpio_set_level(driver->pin_cs, 0);
-#define CS_IDLE      gpio_set_level(driver->pin_cs, 1);
-#define CD_COMMAND   gpio_set_level(driver->pin_dc, 0);
-#define CD_DATA      gpio_set_level(driver->pin_dc, 1);
-#define RD_ACTIVE    gpio_set_level(driver->pin_rd, 0);
-#define RD_IDLE      gpio_set_level(driver->pin_rd, 1);
-#define WR_ACTIVE    gpio_set_level(driver->pin_wr, 0);
-#define WR_IDLE      gpio_set_level(driver->pin_wr, 1);
-#define RST_ACTIVE   gpio_set_level(driver->pin_rst, 0);
-#define RST_IDLE     gpio_set_level(driver->pin_rst, 1);
-
-#define ILI9481_NOP 0x00
-#define ILI9481_SOFT_RESET 0x01
-#define ILI9481_GET_RED_CHANNEL 0x06
-#define ILI9481_GET_GREEN_CHANNEL 0x07
-#define ILI9481_GET_BLUE_CHANNEL 0x08
-#define ILI9481_GET_POWER_MODE 0x0A
-#define ILI9481_GET_ADDRESS_MODE 0x0B
-#define ILI9481_GET_PIXEL_FORMAT 0x0C
-#define ILI9481_GET_DISPLAY_MODE 0x0D
-#define ILI9481_GET_SIGNAL_MODE 0x0E
-#define ILI9481_GET_DIAGNOSTIC_RESULT 0x0F
-#define ILI9481_ENTER_SLEEP_MODE 0x10
-#define ILI9481_EXIT_SLEEP_MODE 0x11
-#define ILI9481_ENTER_PARTIAL_MODE 0x12
-#define ILI9481_ENTER_NORMAL_MODE 0x13
-#define ILI9481_EXIT_INVERT_MODE 0x20
-#define ILI9481_ENTER_INVERT_MODE 0x21
-#define ILI9481_SET_GAMMA_CURVE 0x26
-#define ILI9481_SET_DISPLAY_OFF 0x28
-#define ILI9481_SET_DISPLAY_ON 0x29
-#define ILI9481_SET_COLUMN_ADDRESS 0x2A
-#define ILI9481_SET_PAGE_ADDRESS 0x2B
-#define ILI9481_WRITE_MEMORY_START 0x2C
-#define ILI9481_WRITE_LUT 0x2D
-#define ILI9481_READ_MEMORY_START 0x2E
-#define ILI9481_SET_PARTIAL_AREA 0x30
-#define ILI9481_SET_SCROLL_AREA 0x33
-#define ILI9481_SET_TEAR_OFF 0x34
-#define ILI9481_SET_TEAR_ON 0x35
-#define ILI9481_SET_ADDRESS_MODE 0x36
-#define ILI9481_SET_SCROLL_START 0x37
-#define ILI9481_EXIT_IDLE_MODE 0x38
-#define ILI9481_ENTER_IDLE_MODE 0x39
-#define ILI9481_SET_PIXEL_FORMAT 0x3A
-#define ILI9481_WRITE_MEMORY_CONTINUE 0x3C
-#define ILI9481_READ_MEMORY_CONTINUE 0x3E
-#define ILI9481_SET_TEAR_SCANLINE 0x44
-#define ILI9481_GET_SCANLINE 0x45
-#define ILI9481_READ_DDB_START 0xA1
-#define ILI9481_COMMAND_ACCESS_PROTECT 0xB0
-#define ILI9481_FRAME_MEMORY_ACCESS_SETTING 0xB3
-#define ILI9481_DISPLAY_MODE 0xB4
-#define ILI9481_DEVICE_CODE_READ 0xBF
-#define ILI9481_PANEL_DRIVING_SETTING 0xC0
-#define ILI9481_DISPLAY_TIMING_SETTING_NORMAL 0xC1
-#define ILI9481_DISPLAY_TIMING_SETTING_PARTIAL 0xC2
-#define ILI9481_DISPLAY_TIMING_SETTING_IDLE 0xC3
-#define ILI9481_FRAME_RATE_CONTROL 0xC5
-#define ILI9481_INTERFACE_CONTROL 0xC6
-#define ILI9481_GAMMA_SETTING 0xC8
-#define ILI9481_POWER_SETTING 0xD0
-#define ILI9481_VCOM_CONTROL 0xD1
-#define ILI9481_POWER_SETTING_NORMAL 0xD2
-#define ILI9481_POWER_SETTING_PARTIAL 0xD3
-#define ILI9481_POWER_SETTING_IDLE 0xD4
-#define ILI9481_NV_MEMORY_WRITE 0xE0
-#define ILI9481_NV_MEMORY_CONTROL 0xE1
-#define ILI9481_NV_MEMORY_STATUS 0xE2
-#define ILI9481_NV_MEMORY_PROTECTION 0xE3
-
-#define ILI9481_CMDLIST_END 0x00
-
-
-#define ili9481_rgb_to_color(r, g, b) ((r << 16) | (g << 8) | b)
-
-
-typedef struct ili9481_driver {
-	uint8_t pin_rst;
-	uint8_t pin_rd;
-	uint8_t pin_wr;
-	uint8_t pin_cs;
-	uint8_t pin_dc;
-	uint8_t pin_d0;
-	uint8_t pin_d1;
-	uint8_t pin_d2;
-	uint8_t pin_d3;
-	uint8_t pin_d4;
-	uint8_t pin_d5;
-	uint8_t pin_d6;
-	uint8_t pin_d7;
-	uint16_t display_width;
-	uint16_t display_height;
-	uint32_t data_mask;
-} ili9481_driver_t;
+#define UPLOAD_BAUD_RATE 921600
+
+
+typedef enum demo {
+	DEMO_PIPELINE,
+	DEMO_STRIP,
+	DEMO_STREAM,
+	DEMO_LAYERS,
+	DEMO_DIRTY,
+	DEMO_SCROLL,
+	DEMO_TEAR,
+	DEMO_POWER,
+	DEMO_TEXT,
+	DEMO_COMMAND_LOOP,
+} demo_t;
+
+// Selected in menuconfig, every demo is compiled
+#if CONFIG_ILI9481_DEMO_STRIP
+#define SELECTED_DEMO DEMO_STRIP
+#elif CONFIG_ILI9481_DEMO_STREAM
+#define SELECTED_DEMO DEMO_STREAM
+#elif CONFIG_ILI9481_DEMO_LAYERS
+#define SELECTED_DEMO DEMO_LAYERS
+#elif CONFIG_ILI9481_DEMO_DIRTY
+#define SELECTED_DEMO DEMO_DIRTY
+#elif CONFIG_ILI9481_DEMO_SCROLL
+#define SELECTED_DEMO DEMO_SCROLL
+#elif CONFIG_ILI9481_DEMO_TEAR
+#define SELECTED_DEMO DEMO_TEAR
+#elif CONFIG_ILI9481_DEMO_POWER
+#define SELECTED_DEMO DEMO_POWER
+#elif CONFIG_ILI9481_DEMO_TEXT
+#define SELECTED_DEMO DEMO_TEXT
+#elif CONFIG_ILI9481_DEMO_COMMAND_LOOP
+#define SELECTED_DEMO DEMO_COMMAND_LOOP
+#else
+#define SELECTED_DEMO DEMO_PIPELINE
+#endif
+
+
+#define rgb_to_color24(r, g, b) ((r << 16) | (g << 8) | b)
 
 
 typedef struct ili9481_config {
@@ -156,119 +113,34 @@ typedef struct ili9481_config {
 	uint8_t fra;
 } ili9481_config_t;
 
-typedef struct ili9481_command {
-	uint8_t command;
-	uint8_t data_size;
-	const uint8_t *data;
-} ili9481_command_t;
-
-
-static inline void __attribute__((always_inline)) write_bits(ili9481_driver_t *driver, uint8_t data) {
-	/*
-	gpio_set_level(driver->pin_wr, 0);
-	gpio_set_level(driver->pin_d0, ((data >> 0) & 0x01));
-	gpio_set_level(driver->pin_d1, ((data >> 1) & 0x01));
-	gpio_set_level(driver->pin_d2, ((data >> 2) & 0x01));
-	gpio_set_level(driver->pin_d3, ((data >> 3) & 0x01));
-	gpio_set_level(driver->pin_d4, ((data >> 4) & 0x01));
-	gpio_set_level(driver->pin_d5, ((data >> 5) & 0x01));
-	gpio_set_level(driver->pin_d6, ((data >> 6) & 0x01));
-	gpio_set_level(driver->pin_d7, ((data >> 7) & 0x01));
-	gpio_set_level(driver->pin_wr, 1);
-	*/
-
-	uint32_t out_data = 0;
-	out_data |= ((data >> 0) & 0x01) << driver->pin_d0;
-	out_data |= ((data >> 1) & 0x01) << driver->pin_d1;
-	out_data |= ((data >> 2) & 0x01) << driver->pin_d2;
-	out_data |= ((data >> 3) & 0x01) << driver->pin_d3;
-	out_data |= ((data >> 4) & 0x01) << driver->pin_d4;
-	out_data |= ((data >> 5) & 0x01) << driver->pin_d5;
-	out_data |= ((data >> 6) & 0x01) << driver->pin_d6;
-	out_data |= ((data >> 7) & 0x01) << driver->pin_d7;
-
-	REG_WRITE(GPIO_OUT_W1TS_REG, out_data);
-	out_data = (out_data ^ driver->data_mask);
-	REG_WRITE(GPIO_OUT_W1TC_REG, out_data | (1 << driver->pin_wr));
-	REG_WRITE(GPIO_OUT_W1TS_REG, (1 << driver->pin_wr));
-}
-
-
-static uint8_t read_bits(ili9481_driver_t *driver) {
-	gpio_config_t io_conf;
-	io_conf.intr_type = GPIO_INTR_DISABLE;
-	io_conf.mode = GPIO_MODE_INPUT;
-	io_conf.pin_bit_mask = (
-		(1ULL << driver->pin_d0) |
-		(1ULL << driver->pin_d1) |
-		(1ULL << driver->pin_d2) |
-		(1ULL << driver->pin_d3) |
-		(1ULL << driver->pin_d4) |
-		(1ULL << driver->pin_d5) |
-		(1ULL << driver->pin_d6) |
-		(1ULL << driver->pin_d7)
-	);
-	io_conf.pull_down_en = 0;
-	io_conf.pull_up_en = 0;
-	gpio_config(&io_conf);
-
-	uint8_t data = 0;
-
-	RD_ACTIVE
-	data |= gpio_get_level(driver->pin_d0) << 0;
-	data |= gpio_get_level(driver->pin_d1) << 1;
-	data |= gpio_get_level(driver->pin_d2) << 2;
-	data |= gpio_get_level(driver->pin_d3) << 3;
-	data |= gpio_get_level(driver->pin_d4) << 4;
-	data |= gpio_get_level(driver->pin_d5) << 5;
-	data |= gpio_get_level(driver->pin_d6) << 6;
-	data |= gpio_get_level(driver->pin_d7) << 7;
-	RD_IDLE
-
-	io_conf.mode = GPIO_MODE_OUTPUT;
-	gpio_config(&io_conf);
-
-	return data;
-}
-
 
 static void write_command(ili9481_driver_t *driver, uint8_t command) {
-	CD_COMMAND;
-	write_bits(driver, command);
-	CD_DATA;
+	ili9481_write_command(driver, command);
 }
 
 
-static inline void __attribute__((always_inline)) write_data_8(ili9481_driver_t *driver, uint8_t data) {
-	write_bits(driver, data);
+static void write_data_8(ili9481_driver_t *driver, uint8_t data) {
+	ili9481_write_data(driver, &data, 1);
 }
 
 
-static inline void __attribute__((always_inline)) write_data_24(ili9481_driver_t *driver, uint32_t data) {
-	write_bits(driver, (data & 0x00FF));
-	write_bits(driver, ((data >> 8) & 0x00FF));
-	write_bits(driver, ((data >> 16) & 0x00FF));
+static void write_data_24(ili9481_driver_t *driver, uint32_t data) {
+	const uint8_t bytes[3] = {
+		data & 0x00FF,
+		(data >> 8) & 0x00FF,
+		(data >> 16) & 0x00FF,
+	};
+	ili9481_write_data(driver, bytes, sizeof(bytes));
 }
 
 
-static uint8_t read_data_8(ili9481_driver_t *driver) {
-	CD_DATA;
-	uint8_t data = read_bits(driver);
-	return data;
-}
-
-static void execute_commands(ili9481_driver_t *driver, ili9481_command_t *sequence) {
-	while (sequence->command != ILI9481_CMDLIST_END) {
-		write_command(driver, sequence->command);
-		for (uint8_t i = 0; i < sequence->data_size; ++i) {
-			write_data_8(driver, sequence->data[i]);
-		}
-		sequence++;
-	}
+static void set_addr_window(ili9481_driver_t *driver, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1) {
+	ili9481_set_window(driver, x0, y0, x1, y1);
 }
 
 
-static void set_addr_window(ili9481_driver_t *driver, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1) {
+// Unbatched window setup, reference for benchmark
+static void set_addr_window_single(ili9481_driver_t *driver, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1) {
 	write_command(driver, ILI9481_SET_COLUMN_ADDRESS);
 	write_data_8(driver, x0 >> 8);
 	write_data_8(driver, x0 & 0xFF);
@@ -285,74 +157,11 @@ static void set_addr_window(ili9481_driver_t *driver, uint16_t x0, uint16_t y0,
 }
 
 
-esp_err_t ili9481_init(ili9481_driver_t *driver) {
-	driver->data_mask = 0x00000000;
-	driver->data_mask |= (1 << driver->pin_d0);
-	driver->data_mask |= (1 << driver->pin_d1);
-	driver->data_mask |= (1 << driver->pin_d2);
-	driver->data_mask |= (1 << driver->pin_d3);
-	driver->data_mask |= (1 << driver->pin_d4);
-	driver->data_mask |= (1 << driver->pin_d5);
-	driver->data_mask |= (1 << driver->pin_d6);
-	driver->data_mask |= (1 << driver->pin_d7);
-
-	gpio_config_t io_conf;
-	io_conf.intr_type = GPIO_INTR_DISABLE;
-	io_conf.mode = GPIO_MODE_OUTPUT;
-	io_conf.pin_bit_mask = (
-		(1ULL << driver->pin_rst) |
-		(1ULL << driver->pin_rd) |
-		(1ULL << driver->pin_wr) |
-		(1ULL << driver->pin_cs) |
-		(1ULL << driver->pin_dc) |
-		(1ULL << driver->pin_d0) |
-		(1ULL << driver->pin_d1) |
-		(1ULL << driver->pin_d2) |
-		(1ULL << driver->pin_d3) |
-		(1ULL << driver->pin_d4) |
-		(1ULL << driver->pin_d5) |
-		(1ULL << driver->pin_d6) |
-		(1ULL << driver->pin_d7)
-	);
-	io_conf.pull_down_en = 0;
-	io_conf.pull_up_en = 0;
-	gpio_config(&io_conf);
-
-	ESP_LOGI(TAG, "GPIO initialized");
-
-	RD_IDLE
-	WR_IDLE
-	CD_DATA
-	CS_ACTIVE
-	RST_ACTIVE
-	vTaskDelay(100 / portTICK_PERIOD_MS);
-	RST_IDLE
-	vTaskDelay(100 / portTICK_PERIOD_MS);
-	write_command(driver, ILI9481_EXIT_SLEEP_MODE);
-	vTaskDelay(120 / portTICK_PERIOD_MS);
-
-	ESP_LOGI(TAG, "Display initialized");
-
-	return ESP_OK;
-}
-
-
 static void write_init_message(ili9481_driver_t *driver) {
-	printf("ILI9881 initialized, device code is:");
-
-	uint8_t data;
-	write_command(driver, 0xBF);
-	data = read_data_8(driver);
-	data = read_data_8(driver);
-	printf(" %02x", data);
-	data = read_data_8(driver);
-	printf(" %02x", data);
-	data = read_data_8(driver);
-	printf(" %02x", data);
-	data = read_data_8(driver);
-	printf(" %02x", data);
-	data = read_data_8(driver);
-	printf(" %02x\n", data);
+	uint8_t data[6];
+	write_command(driver, ILI9481_DEVICE_CODE_READ);
+	ili9481_read_data(driver, data, sizeof(data));
+	printf("ILI9881 initialized, device code is: %02x %02x %02x %02x %02x\n", data[1], data[2], data[3], data[4], data[5]);
 }
 
 
@@ -416,83 +225,17 @@ static void configure_display(ili9481_driver_t *driver, ili9481_config_t *config
 }
 
 
-static uint8_t htoi(int c) {
-	switch (c) {
-		case '0': return 0;
-		case '1': return 1;
-		case '2': return 2;
-		case '3': return 3;
-		case '4': return 4;
-		case '5': return 5;
-		case '6': return 6;
-		case '7': return 7;
-		case '8': return 8;
-		case '9': return 9;
-		case 'a': return 10;
-		case 'b': return 11;
-		case 'c': return 12;
-		case 'd': return 13;
-		case 'e': return 14;
-		case 'f': return 15;
-		default: return 0xff;
-	}
-}
-
-
-static void transfer_image(ili9481_driver_t *driver) {
-	size_t pixels_count = driver->display_height * driver->display_width;
-	size_t current_pixel = 0;
-	STATUS s;
-	uint8_t color[3] = {0, 0, 0};
-	int component = 0;
-	int top = 0;
-	uint8_t c;
-	while (1) {
-		s = uart_rx_one_char(&c);
-		if (s != OK) {
-			continue;
-		}
-		if (c == 0xff) {
-			c = 0x00;
-		}
-		if (top) {
-			color[component] |= htoi(c);
-		}
-		else {
-			color[component] = (htoi(c) << 4);
-		}
-		if (component == 2 && top == 1) {
-			write_data_24(driver, ili9481_rgb_to_color(color[0], color[1], color[2]));
-			color[0] = 0;
-			color[1] = 0;
-			color[2] = 0;
-			current_pixel++;
-			if (current_pixel >= pixels_count) {
-				return;
-			}
-		}
-		if (top == 1) {
-			component = (component + 1) % 3;
-			top = 0;
-		}
-		else {
-			top = 1;
-		}
-	}
-}
-
-
 #define NUM_PATTERNS 5
 
 
 static void draw_vertical_gradient(ili9481_driver_t *driver, int x, int y) {
 	int col = y * 255 / driver->display_height;
-	write_data_24(driver, ili9481_rgb_to_color(col, col, col));
+	write_data_24(driver, rgb_to_color24(col, col, col));
 }
 
 static void draw_horizontal_gradient(ili9481_driver_t *driver, int x, int y) {
 	int col = x * 255 / driver->display_width;
-	write_data_24(driver, ili9481_rgb_to_color(col, col, col));
+	write_data_24(driver, rgb_to_color24(col, col, col));
 }
 
 static void draw_combined_gradient(ili9481_driver_t *driver, int x, int y) {
@@ -503,7 +246,7 @@ static void draw_combined_gradient(ili9481_driver_t *driver, int x, int y) {
 	else {
 		col = y * 255 / driver->display_height;
 	}
-	write_data_24(driver, ili9481_rgb_to_color(col, col, col));
+	write_data_24(driver, rgb_to_color24(col, col, col));
 }
 
 static void draw_combined_gradient2(ili9481_driver_t *driver, int x, int y) {
@@ -519,7 +262,7 @@ static void draw_combined_gradient2(ili9481_driver_t *driver, int x, int y) {
 			col = y * 255 / driver->display_height;
 		}
 	}
-	write_data_24(driver, ili9481_rgb_to_color(col, col, col));
+	write_data_24(driver, rgb_to_color24(col, col, col));
 }
 
 
@@ -533,7 +276,7 @@ static void draw_rainbow(ili9481_driver_t *driver, int x, int y) {
 	if (g < 0) { g = 0; }
 	if (b > 255) { b = 255; }
 	if (b < 0) { b = 0; }
-	write_data_24(driver, ili9481_rgb_to_color(r, g, b));
+	write_data_24(driver, rgb_to_color24(r, g, b));
 }
 
 static void draw_pattern(ili9481_driver_t *driver, int pattern) {
@@ -670,7 +413,7 @@ static void main_loop(ili9481_driver_t *driver, ili9481_config_t *config) {
 					config->bp0 = (config->bp0 + 1) % 16;
 					break;
 				case 'U':
-					transfer_image(driver);
+					image_upload_receive(driver, UART_NUM_0, UPLOAD_BAUD_RATE);
 					configure = 0;
 					break;
 				case 'X':
@@ -691,480 +434,530 @@ static void main_loop(ili9481_driver_t *driver, ili9481_config_t *config) {
 }
 
 
-static void i2s_reset_fifo(i2s_dev_t *dev) {
-	dev->conf.tx_reset = 1;
-	dev->conf.tx_fifo_reset = 1;
-	dev->conf.rx_fifo_reset = 1;
-	dev->conf.tx_reset = 0;
-	dev->conf.tx_fifo_reset = 0;
-	dev->conf.rx_fifo_reset = 0;
+#define STRIP_PATTERN_LINES 40
+
+
+static void draw_strip_pattern(ili9481_driver_t *driver) {
+	const size_t strip_size = driver->display_width * STRIP_PATTERN_LINES * 3;
+	uint8_t *buf = (uint8_t *)heap_caps_malloc(strip_size, MALLOC_CAP_DMA);
+	if (buf == NULL) {
+		ESP_LOGE(TAG, "strip buffer not allocated");
+		return;
+	}
+	for (size_t line = 0; line < STRIP_PATTERN_LINES; ++line) {
+		uint8_t *line_buf = buf + line * driver->display_width * 3;
+		for (size_t i = 0; i < 320; ++i) {
+			line_buf[i*3] = (i < 107) ? (i * 256 / 107) : 0;
+			line_buf[i*3+1] = (i < 107) ? 0 : (i < 214 ? (((i-107) * 256 / 107)) : 0);
+			line_buf[i*3+2] = (i < 214) ? 0 : ((i-106) * 256 / 106);
+		}
+	}
+
+	// Strip is converted once and sent without copy, buses without DMA copy it
+	const bool dma = ili9481_prepare_dma(driver, buf, strip_size) == ESP_OK;
+
+	// Window wraps around, every strip continues where previous ended
+	while (1) {
+		for (size_t y = 0; y < driver->display_height; y += STRIP_PATTERN_LINES) {
+			if (dma) {
+				ili9481_write_dma(driver, buf, strip_size);
+			}
+			else {
+				ili9481_write_data(driver, buf, strip_size);
+			}
+		}
+		ili9481_wait_until_queue_empty(driver);
+		vTaskDelay(50);
+	}
 }
 
 
-static void i2s_configure_dma(i2s_dev_t *dev) {
-	dev->lc_conf.in_rst = 1;
-	dev->lc_conf.out_rst = 1;
-	dev->lc_conf.ahbm_rst = 1;
-	dev->lc_conf.ahbm_fifo_rst = 1;
-	dev->lc_conf.in_rst = 0;
-	dev->lc_conf.out_rst = 0;
-	dev->lc_conf.ahbm_rst = 0;
-	dev->lc_conf.ahbm_fifo_rst = 0;
+#define PIPELINE_STRIP_LINES 16
+#define PIPELINE_BUFFERS 4
+
 
-	dev->lc_conf.check_owner = 1;
-	dev->lc_conf.out_data_burst_en = 1;
-	dev->lc_conf.outdscr_burst_en = 1;
+static void render_moving_gradient(ili9481_driver_t *driver, ili9481_color_t *buffer, uint16_t y, uint16_t lines, void *user_data) {
+	const uint32_t frame = *(uint32_t *)user_data;
+	for (uint16_t line = 0; line < lines; ++line) {
+		const uint8_t g = (y + line + frame) & 0xff;
+		for (uint16_t x = 0; x < driver->display_width; ++x) {
+			*buffer++ = ili9481_rgb_to_color(x * 255 / driver->display_width, g, 255 - g);
+		}
+	}
 }
 
 
-static void i2s_set_lcd_mode(i2s_dev_t *dev) {
-	dev->conf2.val = 0;
-	dev->conf2.lcd_en = 1;
-	dev->conf2.lcd_tx_wrx2_en = 1;
-	dev->conf2.lcd_tx_sdx2_en = 0;
+static void draw_pipeline_pattern(ili9481_driver_t *driver) {
+	uint32_t frame = 0;
+	ili9481_pipeline_config_t config = {
+		.buffer_count = PIPELINE_BUFFERS,
+		.strip_lines = PIPELINE_STRIP_LINES,
+		.render_core = 1,
+		.bus_core = 0,
+		.priority = 5,
+		.pixel_format = ILI9481_PIXEL_FORMAT_16,
+		.render = render_moving_gradient,
+		.user_data = &frame,
+	};
+	ili9481_pipeline_t *pipeline;
+	ESP_ERROR_CHECK(ili9481_pipeline_create(driver, &config, &pipeline));
+
+	while (1) {
+		// Frame state can change once rendering is done, transfer runs in background
+		ili9481_pipeline_render_frame(pipeline);
+		frame++;
+
+		if (frame % 100 == 0) {
+			ili9481_pipeline_stats_t stats;
+			ili9481_pipeline_get_stats(pipeline, &stats);
+			printf("frames: %d, fps: %.1f, render: %d%%, bus: %d%%\n",
+				(int)stats.frames,
+				stats.frames * 1000000.0 / stats.elapsed_us,
+				(int)(stats.render_busy_us * 100 / stats.elapsed_us),
+				(int)(stats.bus_busy_us * 100 / stats.elapsed_us)
+			);
+			ili9481_pipeline_reset_stats(pipeline);
+		}
+	}
 }
 
 
-static void i2s_set_speed(i2s_dev_t *dev) {
-	dev->sample_rate_conf.val = 0;
-	dev->sample_rate_conf.rx_bits_mod = 4;
-	dev->sample_rate_conf.tx_bits_mod = 4;
-	dev->sample_rate_conf.rx_bck_div_num = 2;
-	dev->sample_rate_conf.tx_bck_div_num = 2;
+#define STREAM_LINES 4
+#define STREAM_BUFFERS 8
 
-	dev->clkm_conf.val = 0;
-	dev->clkm_conf.clka_en = 0;
-	dev->clkm_conf.clkm_div_a = 63;
-	dev->clkm_conf.clkm_div_b = 0;
-	dev->clkm_conf.clkm_div_num = 8;
-	dev->clkm_conf.clk_en = 1;
 
-	dev->timing.val = 0;
+// Endless procedural background, DMA never stops between lines
+static void draw_stream_pattern(ili9481_driver_t *driver) {
+	const size_t line_size = driver->display_width * 3;
+	const ili9481_stream_config_t config = {
+		.buffer_count = STREAM_BUFFERS,
+		.buffer_size = line_size * STREAM_LINES,
+		.prefill = STREAM_BUFFERS / 2,
+	};
+	ili9481_set_pixel_format(driver, ILI9481_PIXEL_FORMAT_18);
+	set_addr_window(driver, 0, 0, driver->display_width - 1, driver->display_height - 1);
+	if (ili9481_stream_begin(driver, &config) != ESP_OK) {
+		ESP_LOGE(TAG, "streaming not supported");
+		return;
+	}
+
+	uint32_t frame = 0;
+	while (1) {
+		for (size_t y = 0; y < driver->display_height; y += STREAM_LINES) {
+			uint8_t *buf = ili9481_stream_get_buffer(driver);
+			for (size_t line = 0; line < STREAM_LINES; ++line) {
+				const uint8_t g = (y + line + frame) & 0xfc;
+				for (size_t x = 0; x < driver->display_width; ++x) {
+					*buf++ = (x + frame) & 0xfc;
+					*buf++ = g;
+					*buf++ = 0xfc - g;
+				}
+			}
+			ili9481_stream_submit(driver, config.buffer_size);
+		}
+		frame++;
+	}
 }
 
 
-static void i2s_configure_tx(i2s_dev_t *dev) {
-	dev->fifo_conf.val = 0;
-	dev->fifo_conf.rx_fifo_mod_force_en = 1;
-	dev->fifo_conf.tx_fifo_mod_force_en = 1;
-	dev->fifo_conf.rx_fifo_mod = 1;
-	dev->fifo_conf.tx_fifo_mod = 1;
-	dev->fifo_conf.dscr_en = 1;
+#define KIOSK_BAND_START 440
+#define KIOSK_BAND_END 479
 
-	dev->conf1.val = 0;
-	dev->conf1.tx_stop_en = 1;
-	dev->conf1.tx_pcm_bypass = 1;
 
-	dev->conf_chan.val = 0;
-	dev->conf_chan.tx_chan_mod = 2;
-	dev->conf_chan.rx_chan_mod = 2;
+// Status band in 8 colors most of the time, full content every 10 seconds
+static void draw_power_kiosk(ili9481_driver_t *driver) {
+	const ili9481_power_config_t config = {
+		.partial_start = KIOSK_BAND_START,
+		.partial_end = KIOSK_BAND_END,
+		.setup = NULL,
+	};
+	ili9481_power_t *power;
+	ESP_ERROR_CHECK(ili9481_power_create(driver, &config, &power));
+
+	for (uint32_t seconds = 0;; ++seconds) {
+		const bool full_content = seconds % 10 == 0;
+		if (full_content) {
+			ili9481_power_select(power, false, false);
+			ili9481_clear(driver, ili9481_rgb_to_color(seconds * 8, 128, 255 - seconds * 8));
+		}
+		else {
+			ili9481_power_select(power, true, true);
+		}
+		const ili9481_color_t band_color = (seconds & 1) ? ili9481_rgb_to_color(255, 255, 0) : ili9481_rgb_to_color(0, 0, 255);
+		ili9481_fill_area(driver, band_color, 0, KIOSK_BAND_START, driver->display_width, KIOSK_BAND_END - KIOSK_BAND_START + 1);
+
+		if (seconds % 60 == 59) {
+			ili9481_power_stats_t stats;
+			ili9481_power_get_stats(power, &stats);
+			for (size_t mode = 0; mode < ILI9481_POWER_MODE_COUNT; ++mode) {
+				printf("mode %d: %d transitions, last %d us, max %d us, %d s\n", (int)mode, (int)stats.transitions[mode], (int)stats.last_us[mode], (int)stats.max_us[mode], (int)(stats.time_us[mode] / 1000000));
+			}
+		}
+		vTaskDelay(1000 / portTICK_PERIOD_MS);
+	}
 }
 
 
-struct i2s_transaction_t;
-typedef void(*transaction_cb_t)(struct i2s_transaction_t *trans);
-
-typedef struct {
-	int queue_size;
-	transaction_cb_t pre_cb;
-} i2s_driver_config_t;
-
-typedef struct {
-	QueueHandle_t tx_queue;
-	SemaphoreHandle_t tx_semaphore;
-	transaction_cb_t pre_cb;
-	intr_handle_t intr_handle;
-	lldesc_t *dma;
-	i2s_dev_t *hw;
-} i2s_driver_t;
-
-typedef struct {
-	void *data;
-	size_t length;
-	void *user_data;
-} i2s_transaction_t;
-
-static i2s_driver_t i2s_drivers[2] = {
-	{
-		.tx_queue = 0,
-		.tx_semaphore = 0,
-		.pre_cb = NULL,
-		.intr_handle = NULL,
-		.dma = NULL,
-		.hw = &I2S0
-	},
-	{
-		.tx_queue = 0,
-		.tx_semaphore = 0,
-		.pre_cb = NULL,
-		.intr_handle = NULL,
-		.dma = NULL,
-		.hw = &I2S1
-	}
-};
+#define CONSOLE_HEADER_LINES 40
+#define CONSOLE_LINE_HEIGHT 16
 
 
-uint8_t *buf = NULL;
+// Log console below fixed header, every new line costs one text line of bandwidth
+static void draw_scroll_console(ili9481_driver_t *driver) {
+	ili9481_clear(driver, ili9481_rgb_to_color(0, 0, 0));
+	ili9481_fill_area(driver, ili9481_rgb_to_color(0, 64, 128), 0, 0, driver->display_width, CONSOLE_HEADER_LINES);
+	ESP_ERROR_CHECK(ili9481_set_scroll_area(driver, CONSOLE_HEADER_LINES, 0));
 
-static void IRAM_ATTR i2s_isr(void *const params) {
-	const i2s_driver_t *drv = (i2s_driver_t *)(params);
-	i2s_dev_t *dev = drv->hw;
-	int done = 0;
-	//ESP_EARLY_LOGE(TAG, "interrupt status: 0x%08x", dev->int_st.val);
+	uint32_t line = 0;
+	while (1) {
+		uint16_t y, height;
+		ili9481_scroll(driver, CONSOLE_LINE_HEIGHT, &y, &height);
+		const uint16_t text_width = 40 + (line * 37) % (driver->display_width - 40);
+		ili9481_fill_area(driver, ili9481_rgb_to_color(0, 0, 0), 0, y, driver->display_width, height);
+		ili9481_fill_area(driver, ili9481_rgb_to_color(0, 255, 0), 4, y + 4, text_width, height - 8);
+		line++;
+		vTaskDelay(100 / portTICK_PERIOD_MS);
+	}
+}
 
-    if (dev->int_st.out_eof || dev->int_st.out_total_eof)
-    {
-    	 		while (!dev->state.tx_idle);
 
-        dev->conf.tx_start = 0;
-        dev->conf.tx_reset = 1;
-        dev->conf.tx_reset = 0;
-        done = 1;
+#define LAYER_BAR_Y 200
+#define LAYER_BAR_HEIGHT 40
 
-    }
 
-	dev->int_clr.val = dev->int_st.val;
+static void draw_sweep(ili9481_driver_t *driver, uint16_t y, uint16_t height, void *user_data) {
+	// Vertical bar moving horizontally shows tearing as broken edge
+	const uint16_t bar_x = *(uint16_t *)user_data;
+	const uint16_t bar_width = 32;
+	ili9481_fill_area(driver, ili9481_rgb_to_color(0, 0, 64), 0, y, bar_x, height);
+	ili9481_fill_area(driver, ili9481_rgb_to_color(255, 255, 255), bar_x, y, bar_width, height);
+	ili9481_fill_area(driver, ili9481_rgb_to_color(0, 0, 64), bar_x + bar_width, y, driver->display_width - bar_x - bar_width, height);
+}
 
-	if (done) {
-		dev->out_link.start = 1;
-		dev->conf.tx_start = 1;
-	}
 
-		/*
-	if (dev->int_st.out_total_eof) {
-		ESP_EARLY_LOGE(TAG, "interrupt status: 0x%08x", dev->int_st.val);
-		dev->int_clr.val = dev->int_st.val;
-		while (!dev->state.tx_idle);
-
-		dma_descriptor->size = 320*3;
-		dma_descriptor->length = 320*3;
-		dma_descriptor->buf = buf;
-		dma_descriptor->owner = 1;
-		dma_descriptor->sosf = 0;
-		dma_descriptor->eof = 1;
-		dma_descriptor->empty = 0;
-		dma_descriptor->qe.stqe_next = NULL;
-
-		dev->lc_conf.in_rst = 1;
-		dev->lc_conf.out_rst = 1;
-		dev->lc_conf.ahbm_rst = 1;
-		dev->lc_conf.ahbm_fifo_rst = 1;
-		dev->lc_conf.in_rst = 0;
-		dev->lc_conf.out_rst = 0;
-		dev->lc_conf.ahbm_rst = 0;
-		dev->lc_conf.ahbm_fifo_rst = 0;
-
-		dev->conf.tx_reset = 1;
-		dev->conf.tx_reset = 0;
-
-		dev->lc_conf.check_owner = 1;
-		dev->lc_conf.out_data_burst_en = 1;
-		dev->lc_conf.outdscr_burst_en = 1;
-
-		dev->out_link.addr = (uint32_t)dma_descriptor;
-
-		dev->fifo_conf.dscr_en = 1;
-		dev->out_link.start = 1;
-		dev->conf.tx_start = 1;
-	}
-	uint32_t status = dev->int_st.val;
-	if (status == 0) {
-		return;
-	}
+static void draw_tear_sweep(ili9481_driver_t *driver) {
+	const ili9481_tear_config_t config = {
+		.pin_te = -1,
+		.mode = ILI9481_TEAR_SPLIT,
+	};
+	ili9481_tear_t *tear;
+	ESP_ERROR_CHECK(ili9481_tear_create(driver, &config, &tear));
 
+	uint16_t bar_x = 0;
+	for (;;) {
+		ili9481_tear_present(tear, draw_sweep, &bar_x);
+		bar_x = (bar_x + 8) % (driver->display_width - 32);
+	}
+}
 
-	dev->int_clr.val = dev->int_st.val;
 
-	if (status == BIT(16)) {
-		I2S1.out_link.start = 1;
-		I2S1.conf.tx_start = 1;
+static void draw_background_layer(ili9481_driver_t *driver, const ili9481_strip_t *strip, const ili9481_frame_info_t *frame, void *user_data) {
+	ili9481_color_t *buffer = strip->buffer;
+	for (uint16_t y = strip->y; y < strip->y + strip->lines; ++y) {
+		for (uint16_t x = 0; x < strip->width; ++x) {
+			*buffer++ = ili9481_rgb_to_color_dither(0, (y + frame->time_us / 20000) & 0xff, x * 255 / strip->width, x, y);
+		}
 	}
-	else {
-		ESP_EARLY_LOGE(TAG, "interrupt status: 0x%08x", status);
+}
+
+
+// Drawn only into strips, which contain bar lines
+static void draw_bar_layer(ili9481_driver_t *driver, const ili9481_strip_t *strip, const ili9481_frame_info_t *frame, void *user_data) {
+	const uint16_t bar_width = frame->frame * strip->width / MAX(frame->duration, 1);
+	const uint16_t start = MAX(strip->y, LAYER_BAR_Y);
+	const uint16_t end = MIN(strip->y + strip->lines, LAYER_BAR_Y + LAYER_BAR_HEIGHT);
+	for (uint16_t y = start; y < end; ++y) {
+		ili9481_color_t *line = strip->buffer + (y - strip->y) * strip->width;
+		for (uint16_t x = 0; x < bar_width; ++x) {
+			line[x] = ili9481_rgb_to_color(255, 255, 255);
+		}
 	}
-	I2S1.int_clr.val = I2S1.int_st.val;
-	esp_intr_disable(i2s_drivers[1].intr_handle);
+}
 
-	I2S1.conf.tx_start = 0;
 
+static void dither_layer_event(ili9481_driver_t *driver, ili9481_layer_event_t event, const ili9481_frame_info_t *frame, void *user_data) {
+	if (event == ILI9481_LAYER_EVENT_FRAME_START) {
+		ili9481_randomize_dither_table();
+	}
+}
 
-	esp_intr_enable(i2s_drivers[1].intr_handle);
 
-	dma_descriptor->size = 320*3;
-	dma_descriptor->length = 320*3;
-	dma_descriptor->buf = buf;
-	dma_descriptor->owner = 1;
-	dma_descriptor->sosf = 0;
-	dma_descriptor->eof = 1;
-	dma_descriptor->qe.stqe_next = NULL;
-	I2S1.out_link.addr = (uint32_t)dma_descriptor;
+static void draw_layer_animation(ili9481_driver_t *driver) {
+	const ili9481_strip_renderer_config_t config = {
+		.strip_lines = 0,
+		.max_memory = 0,
+		.frame_period_us = 1000000 / 25,
+	};
+	ili9481_strip_renderer_t *renderer;
+	ESP_ERROR_CHECK(ili9481_strip_renderer_create(driver, &config, &renderer));
 
-	*/
-	//I2S1.out_link.start = 1;
-	//I2S1.conf.tx_start = 1;
+	const ili9481_layer_t pause_layers[] = {
+		{ NULL, NULL, NULL, 0, 0 },
+	};
+	const ili9481_layer_t background_layers[] = {
+		{ draw_background_layer, dither_layer_event, NULL, 0, 0 },
+		{ NULL, NULL, NULL, 0, 0 },
+	};
+	const ili9481_layer_t progress_layers[] = {
+		{ draw_background_layer, dither_layer_event, NULL, 0, 0 },
+		{ draw_bar_layer, NULL, NULL, LAYER_BAR_Y, LAYER_BAR_HEIGHT },
+		{ NULL, NULL, NULL, 0, 0 },
+	};
+	const ili9481_animation_step_t animation[] = {
+		{ 100, background_layers },
+		{ 200, progress_layers },
+		{ 25, pause_layers },
+		{ 0, NULL },
+	};
+	while (1) {
+		ili9481_strip_run_animation(renderer, animation);
+		ili9481_strip_stats_t stats;
+		ili9481_strip_renderer_get_stats(renderer, &stats);
+		printf("%d frames, %d skipped, last %d cycles, max %d cycles\n", (int)stats.frames_rendered, (int)stats.frames_skipped, (int)stats.last_cycles, (int)stats.max_cycles);
+	}
 }
 
-static esp_err_t i2s_init(i2s_dev_t *dev, i2s_driver_config_t *config) {
-	int dev_num = (dev == &I2S0) ? 0 : 1;
-	i2s_driver_t *drv = &(i2s_drivers[dev_num]);
-	drv->pre_cb = config->pre_cb;
 
-	drv->tx_queue = NULL;
-	drv->tx_semaphore = NULL;
-	drv->dma = NULL;
+#define DASHBOARD_DIGIT_X 200
+#define DASHBOARD_DIGIT_Y 32
+#define DASHBOARD_DIGIT_WIDTH 24
+#define DASHBOARD_DIGIT_HEIGHT 40
 
-	drv->tx_queue = xQueueCreate(config->queue_size, sizeof(i2s_transaction_t));
-	if (drv->tx_queue == NULL) {
-		ESP_LOGE(TAG, "I2S queue not allocated");
-		goto cleanup;
-	}
-	drv->tx_semaphore = xSemaphoreCreateBinary();
-	if (drv->tx_semaphore == NULL) {
-		ESP_LOGE(TAG, "I2S semaphore not allocated");
-		goto cleanup;
-	}
 
-	drv->dma = (lldesc_t *)heap_caps_malloc(sizeof(lldesc_t), MALLOC_CAP_DMA);
-	if (drv->dma == NULL) {
-		ESP_LOGE(TAG, "I2S dma not allocated");
-		goto cleanup;
+// Background gradient with one "digit" block, which changes color every second
+static void render_dashboard(ili9481_driver_t *driver, ili9481_color_t *buffer, uint16_t x, uint16_t y, uint16_t width, uint16_t lines, void *user_data) {
+	const uint32_t seconds = *(uint32_t *)user_data;
+	for (uint16_t line = y; line < y + lines; ++line) {
+		for (uint16_t col = x; col < x + width; ++col) {
+			const bool digit = col >= DASHBOARD_DIGIT_X && col < DASHBOARD_DIGIT_X + DASHBOARD_DIGIT_WIDTH && line >= DASHBOARD_DIGIT_Y && line < DASHBOARD_DIGIT_Y + DASHBOARD_DIGIT_HEIGHT;
+			*buffer++ = digit ? ili9481_rgb_to_color(255, (seconds * 25) & 0xff, 0) : ili9481_rgb_to_color(0, line / 2, col * 255 / driver->display_width);
+		}
 	}
+}
 
-	return ESP_OK;
 
-cleanup:
-	if (drv->dma != NULL) {
-		heap_caps_free(drv->dma);
-		drv->dma = NULL;
-	}
-	if (drv->tx_semaphore != NULL) {
-		vSemaphoreDelete(drv->tx_semaphore);
-		drv->tx_semaphore = NULL;
-	}
-	if (drv->tx_queue != NULL) {
-		vSemaphoreDelete(drv->tx_queue);
-		drv->tx_queue = NULL;
+static void draw_dirty_dashboard(ili9481_driver_t *driver) {
+	uint32_t seconds = 0;
+	const ili9481_dirty_config_t config = {
+		.window_cost = 64,
+		.buffer_pixels = driver->display_width * 8,
+		.render = render_dashboard,
+		.user_data = &seconds,
+	};
+	ili9481_dirty_t *dirty;
+	ESP_ERROR_CHECK(ili9481_dirty_create(driver, &config, &dirty));
+
+	ili9481_dirty_invalidate_all(dirty);
+	while (1) {
+		ili9481_dirty_report_t report;
+		ili9481_dirty_flush(dirty, &report);
+		ili9481_wait_until_queue_empty(driver);
+		printf("rects: %d, pixels: %d, written: %d B, saved: %d B\n", (int)report.rects, (int)report.pixels, (int)report.bytes_written, (int)report.bytes_saved);
+
+		vTaskDelay(1000 / portTICK_PERIOD_MS);
+		seconds++;
+		ili9481_dirty_invalidate(dirty, DASHBOARD_DIGIT_X, DASHBOARD_DIGIT_Y, DASHBOARD_DIGIT_WIDTH, DASHBOARD_DIGIT_HEIGHT);
 	}
-	return ESP_FAIL;
 }
 
 
-static esp_err_t i2s_intr_init(i2s_dev_t *dev) {
-	int dev_num = (dev == &I2S0) ? 0 : 1;
-	i2s_driver_t *drv = &(i2s_drivers[dev_num]);
-	const esp_err_t ret = esp_intr_alloc(
-		dev_num == 0 ? ETS_I2S0_INTR_SOURCE : ETS_I2S1_INTR_SOURCE,
-		0,
-		i2s_isr,
-		drv,
-		&drv->intr_handle
-	);
-	if (ret == ESP_OK) {
-		//esp_intr_set_in_iram(drv->intr_handle, true);
-		esp_intr_enable(drv->intr_handle);
-	}
-	else {
-		ESP_LOGE(TAG, "Interrupt handler not allocated");
-		return ESP_FAIL;
-	}
+#define TEXT_SCALE 2
+#define TEXT_MARGIN 8
+#define TEXT_LINE_HEIGHT 20
+#define TEXT_SCROLL_FRAMES 400
 
-	dev->int_ena.out_total_eof = 1;
-	//dev->int_ena.out_dscr_err = 1;
-	//dev->int_ena.out_eof = 1;
-	//dev->int_ena.out_done = 1;
 
-	//dev->int_ena.in_err_eof = 1;
-	//dev->int_ena.out_eof = 1;
-	//dev->int_ena.out_dscr_err = 1;
-	//dev->int_ena.out_eof = 1;
-	return ESP_OK;
-}
+static const char *const credits =
+	"Lorem ipsum dolor sit amet,\n"
+	"consectetur adipiscing elit.\n"
+	"Pellentesque tristique quam sit\n"
+	"amet dolor sagittis lacinia.\n"
+	"Phasellus non dui sed orci\n"
+	"vehicula faucibus ut vitae dui.\n"
+	"Duis pulvinar sem risus, quis\n"
+	"bibendum elit consequat vel.\n"
+	"Cras eget fermentum magna.\n"
+	"Maecenas eu pretium diam,\n"
+	"sed tempor ex.";
+
+
+typedef struct text_blit {
+	const ili9481_strip_t *strip;
+	ili9481_color_t color;
+} text_blit_t;
 
-static void i2s_trans_dma_start(i2s_driver_t *drv, i2s_transaction_t *transaction) {
-	i2s_dev_t *dev = drv->hw;
-
-
-	/*
-	dev->conf.tx_reset = 1;
-	dev->conf.tx_fifo_reset = 1;
-	dev->conf.rx_fifo_reset = 1;
-	dev->conf.tx_reset = 0;
-	dev->conf.tx_fifo_reset = 0;
-	dev->conf.rx_fifo_reset = 0;
-	*/
-
-	//i2s_configure_dma(dev);
-	//i2s_set_lcd_mode(dev);
-	//i2s_set_speed(dev);
-	//i2s_configure_tx(dev);
-
-	drv->dma->size = 320*3;
-	drv->dma->length = 320*3;
-	drv->dma->buf = buf;
-	drv->dma->owner = 1;
-	drv->dma->sosf = 0;
-	drv->dma->eof = 1;
-	drv->dma->empty = 0;
-	drv->dma->qe.stqe_next = NULL;
-
-	//dev->out_link.addr = 0;
-	dev->out_link.addr = ((uint32_t)drv->dma) & 0xfffff;
-	dev->out_link.start = 1;
-	dev->conf.tx_start = 1;
-}
 
-static void i2s_trans_enqueue(i2s_dev_t *dev, i2s_transaction_t *transaction) {
-	int dev_num = (dev == &I2S0) ? 0 : 1;
-	i2s_driver_t *drv = &(i2s_drivers[dev_num]);
-	i2s_trans_dma_start(drv, transaction);
-	//xQueueSend(drv->tx_queue, transaction, portMAX_DELAY);
+static void blit_glyph(const glyph_t *glyph, int x, int y, void *user_data) {
+	const text_blit_t *blit = (const text_blit_t *)user_data;
+	const ili9481_strip_t *strip = blit->strip;
+	ili9481_draw_alpha_bitmap(glyph->bitmap, 2, strip->buffer, blit->color, x, y - strip->y, glyph->bitmap_width, glyph->bitmap_height, strip->width, strip->lines);
 }
 
-int line = 0;
 
-	/*
-	line++;
-	if (line < 10) {
-		i2s_dev_t *dev = &I2S1;
-		dev->out_link.start = 1;
-		dev->conf.tx_start = 1;
-	}
-	*/
+// Text is shaped once, every strip visits only glyphs in its lines
+static void draw_credits_layer(ili9481_driver_t *driver, const ili9481_strip_t *strip, const ili9481_frame_info_t *frame, void *user_data) {
+	text_layout_t *layout = (text_layout_t *)user_data;
+	const text_blit_t blit = {strip, ili9481_rgb_to_color(255, 255, 255)};
+	const int top = driver->display_height - (int)(frame->frame * 2);
+	text_layout_draw(layout, TEXT_MARGIN, top, strip->y, strip->lines, blit_glyph, (void *)&blit);
+}
 
-static void draw_dma_pattern(ili9481_driver_t *driver) {
-	i2s_driver_config_t config = {
-		.queue_size = 2,
-		.pre_cb = NULL
-	};
-	i2s_init(&I2S1, &config);
-
-	const int sig_data_base = I2S1O_DATA_OUT0_IDX;
-	const int sig_wr = I2S1O_WS_OUT_IDX;
-	i2s_dev_t *dev = &I2S1;
-
-	gpio_matrix_out(driver->pin_d0, sig_data_base+0, false, false);
-	gpio_matrix_out(driver->pin_d1, sig_data_base+1, false, false);
-	gpio_matrix_out(driver->pin_d2, sig_data_base+2, false, false);
-	gpio_matrix_out(driver->pin_d3, sig_data_base+3, false, false);
-	gpio_matrix_out(driver->pin_d4, sig_data_base+4, false, false);
-	gpio_matrix_out(driver->pin_d5, sig_data_base+5, false, false);
-	gpio_matrix_out(driver->pin_d6, sig_data_base+6, false, false);
-	gpio_matrix_out(driver->pin_d7, sig_data_base+7, false, false);
-
-	periph_module_enable(PERIPH_I2S1_MODULE);
-
-	i2s_reset_fifo(dev);
-	i2s_set_lcd_mode(dev);
-	i2s_set_speed(dev);
-	i2s_configure_tx(dev);
-
-	buf = (uint8_t *)heap_caps_malloc(320*3, MALLOC_CAP_DMA);
-	for (size_t i = 0; i < 320; ++i) {
-		buf[i*3] = (i < 107) ? (i * 256 / 107) : 0;
-		buf[i*3+1] = (i < 107) ? 0 : (i < 214 ? (((i-107) * 256 / 107)) : 0);
-		buf[i*3+2] = (i < 214) ? 0 : ((i-106) * 256 / 106);
-	}
-	/*
-	int pos = 0;
-	buf[pos+0] = 255;
-	buf[pos+1] = 255;
-	buf[pos+2] = 255;
-	pos = 107*3;
-	buf[pos+0] = 255;
-	buf[pos+1] = 255;
-	buf[pos+2] = 255;
-	pos = 214*3;
-	buf[pos+0] = 255;
-	buf[pos+1] = 255;
-	buf[pos+2] = 255;
-	pos = 319*3;
-	buf[pos+0] = 255;
-	buf[pos+1] = 255;
-	buf[pos+2] = 255;
-	*/
-
-	uint32_t *rotate_buf = (uint32_t *)buf;
-	for (size_t i = 0; i < 320*3/4; ++i) {
-		rotate_buf[i] = (rotate_buf[i] >> 16) | (rotate_buf[i] << 16);
-	}
 
-	/*
-	dma_descriptor = (lldesc_t *)heap_caps_malloc(sizeof(lldesc_t), MALLOC_CAP_DMA);
-	dma_descriptor->size = 320*3;
-	dma_descriptor->length = 320*3;
-	dma_descriptor->buf = buf;
-	dma_descriptor->owner = 1;
-	dma_descriptor->sosf = 0;
-	dma_descriptor->eof = 1;
-	dma_descriptor->empty = 0;
-	dma_descriptor->qe.stqe_next = NULL;
-	*/
-
-	i2s_intr_init(&I2S1);
-	i2s_configure_dma(dev);
-
-	//dev->out_link.addr = (uint32_t)dma_descriptor;
-
-	gpio_matrix_out(driver->pin_wr, sig_wr, true, false);
-
-	i2s_transaction_t trans = {
-		.data = buf,
-		.length = 320*3,
-		.user_data = NULL
+static void draw_text_credits(ili9481_driver_t *driver) {
+	const ili9481_strip_renderer_config_t config = {
+		.strip_lines = 0,
+		.max_memory = 0,
+		.frame_period_us = 1000000 / 25,
 	};
-	i2s_trans_enqueue(&I2S1, &trans);
+	ili9481_strip_renderer_t *renderer;
+	ESP_ERROR_CHECK(ili9481_strip_renderer_create(driver, &config, &renderer));
+	bitmap_font_t font = {.scale = TEXT_SCALE};
+	glyph_cache_t *cache;
+	text_layout_t *layout;
+	ESP_ERROR_CHECK(glyph_cache_create(4096, 128, &cache));
+	ESP_ERROR_CHECK(text_layout_create(cache, &layout));
+	const text_layout_font_t layout_font = {
+		.face = &font,
+		.pixel_size = BITMAP_FONT_HEIGHT * TEXT_SCALE,
+		.ascent = BITMAP_FONT_HEIGHT * TEXT_SCALE,
+		.line_height = TEXT_LINE_HEIGHT,
+		.rasterize = bitmap_font_rasterize,
+		.user_data = &font,
+	};
+	ESP_ERROR_CHECK(text_layout_set_text(layout, &layout_font, credits));
 
-	/*
+	const ili9481_layer_t layers[] = {
+		{ draw_background_layer, dither_layer_event, NULL, 0, 0 },
+		{ draw_credits_layer, NULL, layout, 0, 0 },
+		{ NULL, NULL, NULL, 0, 0 },
+	};
+	const ili9481_animation_step_t animation[] = {
+		{ TEXT_SCROLL_FRAMES, layers },
+		{ 0, NULL },
+	};
 	while (1) {
-		vTaskDelay(1);
-		i2s_trans_enqueue(&I2S1, &trans);
-		//printf("ook\n");
+		ili9481_strip_run_animation(renderer, animation);
+		glyph_cache_stats_t stats;
+		glyph_cache_get_stats(cache, &stats);
+		printf("glyph cache: %d hits, %d misses, %d evictions, %d B\n", (int)stats.hits, (int)stats.misses, (int)stats.evictions, (int)stats.used);
 	}
-	*/
+}
 
-	/*
-	while (1) {
-		printf("queue\n");
-	}
-	*/
 
-	//esp_intr_enable(i2s_drivers[1].intr_handle);
+#define BENCHMARK_REPEAT 16
 
-	/*
-	dev->out_link.start = 1;
-	dev->conf.tx_start = 1;
 
-	dma_descriptor->eof = 0;
-	dma_descriptor->qe.stqe_next = NULL;
-	*/
-	/*
-	while(1) {
+static void benchmark_window(ili9481_driver_t *driver, uint16_t width, uint16_t height, bool batched) {
+	uint8_t *line = (uint8_t *)heap_caps_calloc(width, 3, MALLOC_CAP_8BIT);
+	if (line == NULL) {
+		return;
 	}
-	*/
-	//vTaskDelay(10);
-	while (1) {
-		vTaskDelay(50);
-		for (size_t i = 0; i < 320*3/4; ++i) {
-			rotate_buf[i] = (rotate_buf[i] >> 16) | (rotate_buf[i] << 16);
+	const int64_t start = esp_timer_get_time();
+	for (size_t i = 0; i < BENCHMARK_REPEAT; ++i) {
+		if (batched) {
+			set_addr_window(driver, 0, 0, width - 1, height - 1);
+		}
+		else {
+			set_addr_window_single(driver, 0, 0, width - 1, height - 1);
+		}
+		for (size_t y = 0; y < height; ++y) {
+			ili9481_write_data(driver, line, width * 3);
 		}
 	}
+	ili9481_wait_until_queue_empty(driver);
+	const int64_t elapsed = esp_timer_get_time() - start;
+	free(line);
+	printf("%3dx%-3d %s: %6d us / update\n", width, height, batched ? "burst " : "single", (int)(elapsed / BENCHMARK_REPEAT));
+}
 
-	printf("done\n");
-	vTaskDelay(portMAX_DELAY);
+
+static void benchmark_pixel_format(ili9481_driver_t *driver, uint8_t pixel_format) {
+	const uint8_t previous_format = driver->pixel_format;
+	ili9481_set_pixel_format(driver, pixel_format);
+	const int64_t start = esp_timer_get_time();
+	for (size_t i = 0; i < BENCHMARK_REPEAT; ++i) {
+		ili9481_clear(driver, ili9481_rgb_to_color(i * 16, 0, 255 - i * 16));
+	}
+	ili9481_wait_until_queue_empty(driver);
+	const int64_t elapsed = esp_timer_get_time() - start;
+	ili9481_set_pixel_format(driver, previous_format);
+	printf("clear %s: %6d us / frame\n", pixel_format == ILI9481_PIXEL_FORMAT_16 ? "16 bpp" : "18 bpp", (int)(elapsed / BENCHMARK_REPEAT));
+}
+
+
+static void benchmark_windows(ili9481_driver_t *driver) {
+	const uint16_t sizes[][2] = {
+		{8, 8},
+		{32, 32},
+		{driver->display_width, driver->display_height},
+	};
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+		benchmark_window(driver, sizes[i][0], sizes[i][1], false);
+		benchmark_window(driver, sizes[i][0], sizes[i][1], true);
+	}
+	benchmark_pixel_format(driver, ILI9481_PIXEL_FORMAT_18);
+	benchmark_pixel_format(driver, ILI9481_PIXEL_FORMAT_16);
 }
 
 
 static void parameter_test(ili9481_driver_t *driver, ili9481_command_t *commands) {
-	execute_commands(driver, commands);
+	ili9481_run_commands(driver, commands);
+
+	const ili9481_calibration_config_t calibration = {
+		.min_div = 2,
+		.max_div = 16,
+		.margin = 1,
+		.repeat = 4,
+		.nvs_namespace = "ili9481",
+		.force = false,
+	};
+	if (ili9481_calibrate_clock(driver, &calibration) != ESP_OK) {
+		ESP_LOGW(TAG, "clock not calibrated, using default");
+	}
+	benchmark_windows(driver);
 	set_addr_window(driver, 0, 0,  driver->display_width - 1, driver->display_height - 1);
+}
+
 
-	draw_dma_pattern(driver);
-	//draw_pattern(driver, 0);
+static void run_demo(ili9481_driver_t *driver, ili9481_config_t *config, demo_t demo) {
+	switch (demo) {
+		case DEMO_PIPELINE:
+			draw_pipeline_pattern(driver);
+			break;
+		case DEMO_STRIP:
+			draw_strip_pattern(driver);
+			break;
+		case DEMO_STREAM:
+			draw_stream_pattern(driver);
+			break;
+		case DEMO_LAYERS:
+			draw_layer_animation(driver);
+			break;
+		case DEMO_DIRTY:
+			draw_dirty_dashboard(driver);
+			break;
+		case DEMO_SCROLL:
+			draw_scroll_console(driver);
+			break;
+		case DEMO_TEAR:
+			draw_tear_sweep(driver);
+			break;
+		case DEMO_POWER:
+			draw_power_kiosk(driver);
+			break;
+		case DEMO_TEXT:
+			draw_text_credits(driver);
+			break;
+		case DEMO_COMMAND_LOOP:
+			main_loop(driver, config);
+			break;
+	}
 }
 
 
 void app_main(void) {
 	ili9481_driver_t display = {
+		.bus = &ili9481_bus_i2s,
 		.pin_rst = GPIO_NUM_23,
 		.pin_rd = GPIO_NUM_32,
 		.pin_wr = GPIO_NUM_5,
@@ -1181,7 +974,6 @@ void app_main(void) {
 		.display_width = ILI9481_DISPLAY_WIDTH,
 		.display_height = ILI9481_DISPLAY_HEIGHT,
 	};
-	/*
 	ili9481_config_t config = {
 		.kp0 = 0x0,
 		.kp1 = 0x0,
@@ -1222,29 +1014,28 @@ void app_main(void) {
 
 		.fra = 0x3
 	};
-	*/
 
+	ESP_ERROR_CHECK(nvs_flash_init());
 	ESP_ERROR_CHECK(ili9481_init(&display));
 	write_init_message(&display);
 
 	ili9481_command_t init_sequence[] = {
-		{ILI9481_COMMAND_ACCESS_PROTECT, 1, (const uint8_t *)"\x00"},
-		{ILI9481_POWER_SETTING, 3, (const uint8_t *)"\x07\x41\x1d"},
-		{ILI9481_VCOM_CONTROL, 3, (const uint8_t *)"\x00\x2b\x1f"},
-		{ILI9481_POWER_SETTING_NORMAL, 2, (const uint8_t *)"\x01\x11"},
-		{ILI9481_DISPLAY_TIMING_SETTING_NORMAL, 3, (const uint8_t *)"\x10\x10\x88"},
-		{ILI9481_PANEL_DRIVING_SETTING, 5, (const uint8_t *)"\x00\x3b\x00\x02\x11"},
-		{ILI9481_FRAME_RATE_CONTROL, 1, (const uint8_t *)"\x00"},
-		{ILI9481_GAMMA_SETTING, 12, (const uint8_t *)"\x00\x14\x33\x10\x00\x16\x44\x36\x77\x00\x0f\x00"},
-		{ILI9481_SET_PIXEL_FORMAT, 1, (const uint8_t *)"\x66"},
-		{ILI9481_SET_ADDRESS_MODE, 1, (const uint8_t *)"\x40"},
-		{ILI9481_SET_DISPLAY_ON, 0, NULL},
-		{ILI9481_CMDLIST_END, 0, NULL},
+		{ILI9481_COMMAND_ACCESS_PROTECT, 0, 1, (const uint8_t *)"\x00"},
+		{ILI9481_POWER_SETTING, 0, 3, (const uint8_t *)"\x07\x41\x1d"},
+		{ILI9481_VCOM_CONTROL, 0, 3, (const uint8_t *)"\x00\x2b\x1f"},
+		{ILI9481_POWER_SETTING_NORMAL, 0, 2, (const uint8_t *)"\x01\x11"},
+		{ILI9481_DISPLAY_TIMING_SETTING_NORMAL, 0, 3, (const uint8_t *)"\x10\x10\x88"},
+		{ILI9481_PANEL_DRIVING_SETTING, 0, 5, (const uint8_t *)"\x00\x3b\x00\x02\x11"},
+		{ILI9481_FRAME_RATE_CONTROL, 0, 1, (const uint8_t *)"\x00"},
+		{ILI9481_GAMMA_SETTING, 0, 12, (const uint8_t *)"\x00\x14\x33\x10\x00\x16\x44\x36\x77\x00\x0f\x00"},
+		{ILI9481_SET_PIXEL_FORMAT, 0, 1, (const uint8_t *)"\x66"},
+		{ILI9481_SET_ADDRESS_MODE, 0, 1, (const uint8_t *)"\x40"},
+		{ILI9481_SET_DISPLAY_ON, 0, 0, NULL},
+		{ILI9481_CMDLIST_END, 0, 0, NULL},
 	};
 
 	parameter_test(&display, init_sequence);
-
-	//main_loop(&display, &config);
+	run_demo(&display, &config, SELECTED_DEMO);
 
 	vTaskDelay(portMAX_DELAY);
 	vTaskDelete(NULL);
@@ -0,0 +1,153 @@
+// SPDX-License-Identifier: MIT
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "text_layout.h"
+#include "unicode.h"
+
+
+#define DECODE_CHUNK 32
+
+
+typedef struct positioned_glyph {
+	uint32_t codepoint;
+	int16_t x;
+	int16_t top;
+	uint16_t height;
+} positioned_glyph_t;
+
+struct text_layout {
+	glyph_cache_t *cache;
+	text_layout_font_t font;
+	char *text;
+	bool valid;
+	positioned_glyph_t *glyphs; // Vertical index, sorted by top
+	size_t count;
+	uint16_t max_height;
+};
+
+
+static int compare_top(const void *a, const void *b) {
+	return ((const positioned_glyph_t *)a)->top - ((const positioned_glyph_t *)b)->top;
+}
+
+
+static bool same_font(const text_layout_font_t *a, const text_layout_font_t *b) {
+	return a->face == b->face && a->pixel_size == b->pixel_size && a->ascent == b->ascent && a->line_height == b->line_height;
+}
+
+
+esp_err_t text_layout_create(glyph_cache_t *cache, text_layout_t **layout_out) {
+	text_layout_t *layout = (text_layout_t *)calloc(1, sizeof(text_layout_t));
+	if (layout == NULL) {
+		return ESP_ERR_NO_MEM;
+	}
+	layout->cache = cache;
+	*layout_out = layout;
+	return ESP_OK;
+}
+
+
+void text_layout_destroy(text_layout_t *layout) {
+	free(layout->text);
+	free(layout->glyphs);
+	free(layout);
+}
+
+
+esp_err_t text_layout_set_text(text_layout_t *layout, const text_layout_font_t *font, const char *text) {
+	if (layout->valid && same_font(&layout->font, font) && strcmp(layout->text, text) == 0) {
+		layout->font.user_data = font->user_data;
+		return ESP_OK;
+	}
+
+	// Every glyph takes at least one byte
+	const size_t length = strlen(text);
+	char *text_copy = strdup(text);
+	positioned_glyph_t *glyphs = (positioned_glyph_t *)malloc(MAX(length, 1) * sizeof(positioned_glyph_t));
+	if (text_copy == NULL || glyphs == NULL) {
+		free(text_copy);
+		free(glyphs);
+		return ESP_ERR_NO_MEM;
+	}
+	free(layout->text);
+	free(layout->glyphs);
+	layout->text = text_copy;
+	layout->glyphs = glyphs;
+	layout->font = *font;
+	layout->count = 0;
+	layout->max_height = 0;
+
+	int pen_x = 0;
+	int line_top = 0;
+	uint32_t codepoints[DECODE_CHUNK];
+	const char *end = text + length;
+	while (text < end) {
+		size_t consumed;
+		const size_t count = u8_decode_chunk(codepoints, DECODE_CHUNK, text, end - text, true, &consumed);
+		text += consumed;
+		for (size_t i = 0; i < count; ++i) {
+			const uint32_t codepoint = codepoints[i];
+			if (codepoint == '\n') {
+				pen_x = 0;
+				line_top += font->line_height;
+				continue;
+			}
+			const glyph_t *glyph = glyph_cache_get(layout->cache, font->face, font->pixel_size, codepoint, font->rasterize, font->user_data);
+			if (glyph == NULL) {
+				continue;
+			}
+			// Empty glyphs only move pen
+			if (glyph->bitmap_width > 0 && glyph->bitmap_height > 0) {
+				positioned_glyph_t *target = &glyphs[layout->count++];
+				target->codepoint = codepoint;
+				target->x = pen_x + glyph->bitmap_left;
+				target->top = line_top + font->ascent - glyph->bitmap_top;
+				target->height = glyph->bitmap_height;
+				layout->max_height = MAX(layout->max_height, glyph->bitmap_height);
+			}
+			pen_x += glyph->advance;
+		}
+	}
+	qsort(glyphs, layout->count, sizeof(positioned_glyph_t), compare_top);
+	layout->valid = true;
+	return ESP_OK;
+}
+
+
+void text_layout_invalidate(text_layout_t *layout) {
+	layout->valid = false;
+}
+
+
+void text_layout_draw(text_layout_t *layout, int x, int y, int band_y, int band_height, text_layout_blit_cb_t blit, void *user_data) {
+	const text_layout_font_t *font = &layout->font;
+	const int band_start = band_y - y;
+	const int band_end = band_start + band_height;
+
+	// First glyph, which can reach band
+	size_t low = 0;
+	size_t high = layout->count;
+	while (low < high) {
+		const size_t middle = (low + high) / 2;
+		if (layout->glyphs[middle].top + layout->max_height <= band_start) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+
+	for (size_t i = low; i < layout->count && layout->glyphs[i].top < band_end; ++i) {
+		const positioned_glyph_t *positioned = &layout->glyphs[i];
+		if (positioned->top + positioned->height <= band_start) {
+			continue;
+		}
+		const glyph_t *glyph = glyph_cache_get(layout->cache, font->face, font->pixel_size, positioned->codepoint, font->rasterize, font->user_data);
+		if (glyph != NULL) {
+			blit(glyph, x + positioned->x, y + positioned->top, user_data);
+		}
+	}
+}
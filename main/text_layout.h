@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "glyph_cache.h"
+
+
+typedef struct text_layout_font {
+	const void *face;
+	uint16_t pixel_size;
+	int16_t ascent; // Baseline below top of line
+	int16_t line_height;
+	glyph_rasterize_cb_t rasterize;
+	void *user_data;
+} text_layout_font_t;
+
+// Bitmap of glyph has top left corner at x, y
+typedef void (*text_layout_blit_cb_t)(const glyph_t *glyph, int x, int y, void *user_data);
+
+typedef struct text_layout text_layout_t;
+
+esp_err_t text_layout_create(glyph_cache_t *cache, text_layout_t **layout);
+void text_layout_destroy(text_layout_t *layout);
+// Lines are separated by '\n'. Text is shaped only when text or font differ
+// from previous call.
+esp_err_t text_layout_set_text(text_layout_t *layout, const text_layout_font_t *font, const char *text);
+// Force shaping on next text_layout_set_text, required when face is reused
+void text_layout_invalidate(text_layout_t *layout);
+// Blit glyphs of layout placed at x, y overlapping lines band_y .. band_y +
+// band_height - 1, only glyphs in band are visited
+void text_layout_draw(text_layout_t *layout, int x, int y, int band_y, int band_height, text_layout_blit_cb_t blit, void *user_data);
@@ -1,4 +1,6 @@
 // SPDX-License-Identifier: MIT
+#include <string.h>
+
 #include "unicode.h"
 
 
@@ -31,32 +33,117 @@ uint8_t u8_encode(char *str, uint32_t ucode) {
 	}
 }
 
+// Decode one sequence from at most available bytes, malformed sequence is
+// replaced by U+FFFD and only its longest valid prefix is consumed. Returns 0
+// when input ends inside of valid sequence and more input may follow.
+static size_t decode_sequence(uint32_t *ucode, const uint8_t *str, size_t available, bool final) {
+	const uint8_t lead = str[0];
+	if (lead < 0x80) {
+		*ucode = lead;
+		return 1;
+	}
+
+	size_t length;
+	uint8_t low = 0x80;
+	uint8_t high = 0xbf;
+	if (lead >= 0xc2 && lead <= 0xdf) {
+		length = 2;
+		*ucode = lead & 0x1f;
+	}
+	else if (lead >= 0xe0 && lead <= 0xef) {
+		length = 3;
+		*ucode = lead & 0x0f;
+		// Overlong forms and surrogates
+		if (lead == 0xe0) {
+			low = 0xa0;
+		}
+		else if (lead == 0xed) {
+			high = 0x9f;
+		}
+	}
+	else if (lead >= 0xf0 && lead <= 0xf4) {
+		length = 4;
+		*ucode = lead & 0x07;
+		// Overlong forms and values above U+10FFFF
+		if (lead == 0xf0) {
+			low = 0x90;
+		}
+		else if (lead == 0xf4) {
+			high = 0x8f;
+		}
+	}
+	else {
+		*ucode = U8_REPLACEMENT;
+		return 1;
+	}
+
+	for (size_t pos = 1; pos < length; ++pos) {
+		if (pos == available) {
+			if (!final) {
+				return 0;
+			}
+			*ucode = U8_REPLACEMENT;
+			return pos;
+		}
+		// Terminator fails here, input is not read past it
+		const uint8_t c = str[pos];
+		if (c < low || c > high) {
+			*ucode = U8_REPLACEMENT;
+			return pos;
+		}
+		*ucode = (*ucode << 6) | (c & 0x3f);
+		low = 0x80;
+		high = 0xbf;
+	}
+	return length;
+}
+
+
 uint8_t u8_decode(uint32_t *ucode, const char *str) {
 	*ucode = 0;
 	if (*str == 0) {
 		return 0;
 	}
-	else if (*str < 0x80) {
-		*ucode = *str;
-		return 1;
-	}
-	else if (*str < 0xe0) {
-		*ucode = *str & 0x1f;
-		*ucode = (*ucode << 6) | (*++str & 0x3f);
-		return 2;
-	}
-	else if (*str < 0xf0) {
-		*ucode = *str & 0x0f;
-		*ucode = (*ucode << 6) | (*++str & 0x3f);
-		*ucode = (*ucode << 6) | (*++str & 0x3f);
-		return 3;
+	return decode_sequence(ucode, (const uint8_t *)str, 4, true);
+}
+
+
+size_t u8_decode_chunk(uint32_t *ucodes, size_t max_count, const char *str, size_t length, bool final, size_t *consumed) {
+	const uint8_t *src = (const uint8_t *)str;
+	const uint8_t *end = src + length;
+	size_t count = 0;
+	while (count < max_count && src < end) {
+		// ASCII runs are copied word at a time
+		while (max_count - count >= 4 && end - src >= 4) {
+			uint32_t word;
+			memcpy(&word, src, sizeof(word));
+			if (word & 0x80808080) {
+				break;
+			}
+			ucodes[count] = src[0];
+			ucodes[count + 1] = src[1];
+			ucodes[count + 2] = src[2];
+			ucodes[count + 3] = src[3];
+			count += 4;
+			src += 4;
+		}
+		if (count == max_count || src == end) {
+			break;
+		}
+		const size_t size = decode_sequence(&ucodes[count], src, end - src, final);
+		if (size == 0) {
+			break;
+		}
+		src += size;
+		count++;
 	}
-	else if (*str < 0xf5) {
-		*ucode = *str & 0x07;
-		*ucode = (*ucode << 6) | (*++str & 0x3f);
-		*ucode = (*ucode << 6) | (*++str & 0x3f);
-		*ucode = (*ucode << 6) | (*++str & 0x3f);
-		return 4;
+	if (consumed != NULL) {
+		*consumed = src - (const uint8_t *)str;
 	}
-	return 0;
+	return count;
+}
+
+
+size_t u8_decode_string(uint32_t *ucodes, size_t max_count, const char *str) {
+	return u8_decode_chunk(ucodes, max_count, str, strlen(str), true, NULL);
 }
@@ -2,10 +2,23 @@
 
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 
+#define U8_REPLACEMENT 0xfffd
+
+
 // Encode utf code and saves to str, returns length of utf-8 string
 uint8_t u8_encode(char *str, uint32_t ucode);
-// Decode utf code and saves to ucode, returns length of utf-8 string
+// Decode utf code and saves to ucode, returns length of utf-8 string, 0 at
+// terminator. Malformed sequence is decoded as U8_REPLACEMENT.
 uint8_t u8_decode(uint32_t *ucode, const char *str);
+// Decode at most length bytes to at most max_count codes, returns number of
+// codes. Malformed sequences are replaced by U8_REPLACEMENT. Without final,
+// sequence cut by end of chunk is left for next chunk. Consumed bytes are
+// stored to consumed, if not NULL.
+size_t u8_decode_chunk(uint32_t *ucodes, size_t max_count, const char *str, size_t length, bool final, size_t *consumed);
+// Decode whole string without terminator, returns number of codes
+size_t u8_decode_string(uint32_t *ucodes, size_t max_count, const char *str);
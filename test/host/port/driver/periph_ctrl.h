@@ -0,0 +1,11 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+typedef enum {
+	PERIPH_I2S0_MODULE,
+	PERIPH_I2S1_MODULE,
+} periph_module_t;
+
+void periph_module_enable(periph_module_t periph);
@@ -0,0 +1,10 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+// Route peripheral signal to pin, SIG_GPIO_OUT_IDX gives pin back to GPIO
+void gpio_matrix_out(uint32_t gpio, uint32_t signal_idx, bool out_inv, bool oen_inv);
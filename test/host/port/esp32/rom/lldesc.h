@@ -0,0 +1,23 @@
+// SPDX-License-Identifier: MIT
+// Host port of linked list DMA descriptor, next pointer has host size
+
+#pragma once
+
+#include <stdint.h>
+
+
+typedef struct lldesc_s {
+	volatile uint32_t size: 12;
+	volatile uint32_t length: 12;
+	volatile uint32_t offset: 5;
+	volatile uint32_t sosf: 1;
+	volatile uint32_t eof: 1;
+	volatile uint32_t owner: 1;
+	volatile uint8_t *buf;
+	union {
+		uint32_t empty;
+		struct {
+			struct lldesc_s *stqe_next;
+		} qe;
+	};
+} lldesc_t;
@@ -0,0 +1,7 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+#define IRAM_ATTR
+#define DRAM_ATTR
@@ -0,0 +1,24 @@
+// SPDX-License-Identifier: MIT
+// Host port of capability allocator, DMA capable memory comes from arena
+// in 1 MB window as internal memory of ESP32, other capabilities are served
+// by malloc
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+#define MALLOC_CAP_32BIT (1 << 1)
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_DMA (1 << 3)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+void *heap_caps_malloc(size_t size, uint32_t caps);
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps);
+void heap_caps_free(void *ptr);
+size_t heap_caps_get_largest_free_block(uint32_t caps);
+// DMA capable memory at low 20 bits of address, as DMA descriptor address
+// registers hold, aborts if it isn't allocated
+void *host_heap_dma_address(uint32_t address);
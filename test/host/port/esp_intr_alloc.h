@@ -0,0 +1,17 @@
+// SPDX-License-Identifier: MIT
+// Host port of interrupt allocator, handlers are called by peripheral models
+
+#pragma once
+
+#include "esp_err.h"
+
+
+#define ETS_I2S0_INTR_SOURCE 32
+#define ETS_I2S1_INTR_SOURCE 33
+
+typedef void (*intr_handler_t)(void *arg);
+typedef struct host_intr *intr_handle_t;
+
+esp_err_t esp_intr_alloc(int source, int flags, intr_handler_t handler, void *arg, intr_handle_t *handle);
+esp_err_t esp_intr_enable(intr_handle_t handle);
+esp_err_t esp_intr_free(intr_handle_t handle);
@@ -0,0 +1,13 @@
+// SPDX-License-Identifier: MIT
+// Host port of ESP-IDF logging, errors and warnings go to stderr
+
+#pragma once
+
+
+void host_log(char level, const char *tag, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+#define ESP_LOGE(tag, format, ...) host_log('E', tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) host_log('W', tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) host_log('I', tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) host_log('D', tag, format, ##__VA_ARGS__)
+#define ESP_EARLY_LOGE(tag, format, ...) host_log('E', tag, format, ##__VA_ARGS__)
@@ -0,0 +1,9 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdint.h>
+
+
+// Monotonic time in microseconds
+int64_t esp_timer_get_time(void);
@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: MIT
+// Host port of FreeRTOS types, tasks are threads and critical sections share
+// one recursive mutex
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_attr.h"
+
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdFAIL 0
+#define pdPASS 1
+#define portMAX_DELAY ((TickType_t)0xffffffffU)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms) / portTICK_PERIOD_MS)
+
+typedef struct {
+	int unused;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0}
+
+void host_enter_critical(void);
+void host_exit_critical(void);
+
+#define portENTER_CRITICAL(mux) host_enter_critical()
+#define portEXIT_CRITICAL(mux) host_exit_critical()
+#define portENTER_CRITICAL_ISR(mux) host_enter_critical()
+#define portEXIT_CRITICAL_ISR(mux) host_exit_critical()
+#define portYIELD_FROM_ISR() do {} while (0)
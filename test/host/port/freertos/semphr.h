@@ -0,0 +1,17 @@
+// SPDX-License-Identifier: MIT
+// Semaphores are queues of empty items like in FreeRTOS
+
+#pragma once
+
+#include "freertos/queue.h"
+
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count);
+
+#define xSemaphoreCreateBinary() xSemaphoreCreateCounting(1, 0)
+#define xSemaphoreTake(semaphore, ticks) xQueueReceive((semaphore), NULL, (ticks))
+#define xSemaphoreGive(semaphore) xQueueSend((semaphore), NULL, 0)
+#define xSemaphoreGiveFromISR(semaphore, woken) xQueueSendFromISR((semaphore), NULL, (woken))
+#define vSemaphoreDelete(semaphore) vQueueDelete(semaphore)
@@ -0,0 +1,273 @@
+// SPDX-License-Identifier: MIT
+// Mocked GPIO register file with 8080 bus decoder
+
+#include <string.h>
+
+#include "esp32/rom/gpio.h"
+#include "host_gpio.h"
+#include "soc/gpio_reg.h"
+#include "soc/gpio_sig_map.h"
+
+
+#define PIN_COUNT 40
+
+
+typedef struct isr_handler {
+	gpio_isr_t handler;
+	void *arg;
+} isr_handler_t;
+
+static struct {
+	host_gpio_bus_t bus;
+	bool has_bus;
+	uint64_t out;
+	uint64_t enable;
+	uint64_t input;
+	uint32_t *strobes;
+	size_t capacity;
+	size_t count;
+	size_t accesses;
+	isr_handler_t handlers[PIN_COUNT];
+	uint32_t signals[PIN_COUNT]; // Output signal of GPIO matrix
+} gpio;
+
+
+static inline bool level(uint64_t value, int pin) {
+	return pin >= 0 && ((value >> pin) & 0x01);
+}
+
+
+static void record(uint32_t strobe) {
+	if (gpio.count < gpio.capacity) {
+		gpio.strobes[gpio.count] = strobe;
+	}
+	gpio.count++;
+}
+
+
+// Data pin driven by other source than WR pin makes strobe invalid
+static void latch(void) {
+	uint32_t strobe = level(gpio.out, gpio.bus.pin_dc) ? HOST_GPIO_STROBE_DC : 0;
+	for (int bit = 0; bit < gpio.bus.width; ++bit) {
+		const int pin = gpio.bus.data_pins[bit];
+		if (level(gpio.out, pin)) {
+			strobe |= 1U << bit;
+		}
+		if (gpio.signals[pin] != SIG_GPIO_OUT_IDX) {
+			strobe |= HOST_GPIO_STROBE_INVALID;
+		}
+	}
+	record(strobe);
+}
+
+
+static void set_output(uint64_t out) {
+	const uint64_t previous = gpio.out;
+	gpio.out = out;
+	if (gpio.has_bus && gpio.signals[gpio.bus.pin_wr] == SIG_GPIO_OUT_IDX && !level(previous, gpio.bus.pin_wr) && level(out, gpio.bus.pin_wr)) {
+		latch();
+	}
+}
+
+
+void host_gpio_reset(const host_gpio_bus_t *bus) {
+	memset(&gpio, 0, sizeof(gpio));
+	for (int pin = 0; pin < PIN_COUNT; ++pin) {
+		gpio.signals[pin] = SIG_GPIO_OUT_IDX;
+	}
+	if (bus != NULL) {
+		gpio.bus = *bus;
+		gpio.has_bus = true;
+	}
+}
+
+
+void host_gpio_record(uint32_t *strobes, size_t capacity) {
+	gpio.strobes = strobes;
+	gpio.capacity = capacity;
+	gpio.count = 0;
+	gpio.accesses = 0;
+}
+
+
+size_t host_gpio_get_strobes(void) {
+	return gpio.count;
+}
+
+
+size_t host_gpio_get_accesses(void) {
+	return gpio.accesses;
+}
+
+
+void host_gpio_set_input(uint64_t levels) {
+	gpio.input = levels;
+}
+
+
+uint64_t host_gpio_get_output(void) {
+	return gpio.out;
+}
+
+
+bool host_gpio_signal_strobe(uint32_t wr_signal, uint32_t data_signal, uint32_t value) {
+	if (!gpio.has_bus || gpio.signals[gpio.bus.pin_wr] != wr_signal) {
+		return false;
+	}
+	uint32_t strobe = level(gpio.out, gpio.bus.pin_dc) ? HOST_GPIO_STROBE_DC : 0;
+	for (int bit = 0; bit < gpio.bus.width; ++bit) {
+		const uint32_t signal = gpio.signals[gpio.bus.data_pins[bit]];
+		if (signal >= data_signal && signal < data_signal + 16) {
+			strobe |= ((value >> (signal - data_signal)) & 0x01) << bit;
+		}
+		else {
+			strobe |= HOST_GPIO_STROBE_INVALID;
+		}
+	}
+	record(strobe);
+	return true;
+}
+
+
+void host_gpio_trigger(gpio_num_t pin) {
+	if (pin >= 0 && pin < PIN_COUNT && gpio.handlers[pin].handler != NULL) {
+		gpio.handlers[pin].handler(gpio.handlers[pin].arg);
+	}
+}
+
+
+void host_gpio_reg_write(uint32_t address, uint32_t value) {
+	gpio.accesses++;
+	switch (address) {
+		case GPIO_OUT_REG:
+			set_output((gpio.out & ~0xffffffffULL) | value);
+			break;
+		case GPIO_OUT_W1TS_REG:
+			set_output(gpio.out | value);
+			break;
+		case GPIO_OUT_W1TC_REG:
+			set_output(gpio.out & ~(uint64_t)value);
+			break;
+		case GPIO_OUT1_REG:
+			set_output((gpio.out & 0xffffffffULL) | ((uint64_t)value << 32));
+			break;
+		case GPIO_OUT1_W1TS_REG:
+			set_output(gpio.out | ((uint64_t)value << 32));
+			break;
+		case GPIO_OUT1_W1TC_REG:
+			set_output(gpio.out & ~((uint64_t)value << 32));
+			break;
+		case GPIO_ENABLE_W1TS_REG:
+			gpio.enable |= value;
+			break;
+		case GPIO_ENABLE_W1TC_REG:
+			gpio.enable &= ~(uint64_t)value;
+			break;
+		case GPIO_ENABLE1_W1TS_REG:
+			gpio.enable |= (uint64_t)value << 32;
+			break;
+		case GPIO_ENABLE1_W1TC_REG:
+			gpio.enable &= ~((uint64_t)value << 32);
+			break;
+		default:
+			break;
+	}
+}
+
+
+// Output pins read back their level
+static uint64_t get_input(void) {
+	return (gpio.out & gpio.enable) | (gpio.input & ~gpio.enable);
+}
+
+
+uint32_t host_gpio_reg_read(uint32_t address) {
+	gpio.accesses++;
+	switch (address) {
+		case GPIO_OUT_REG:
+			return (uint32_t)gpio.out;
+		case GPIO_OUT1_REG:
+			return (uint32_t)(gpio.out >> 32);
+		case GPIO_IN_REG:
+			return (uint32_t)get_input();
+		case GPIO_IN1_REG:
+			return (uint32_t)(get_input() >> 32);
+		default:
+			return 0;
+	}
+}
+
+
+esp_err_t gpio_config(const gpio_config_t *config) {
+	if (config->mode & GPIO_MODE_OUTPUT) {
+		gpio.enable |= config->pin_bit_mask;
+	}
+	else {
+		gpio.enable &= ~config->pin_bit_mask;
+	}
+	return ESP_OK;
+}
+
+
+esp_err_t gpio_set_level(gpio_num_t pin, uint32_t value) {
+	if (pin < 0 || pin >= PIN_COUNT) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	gpio.accesses++;
+	set_output(value ? gpio.out | (1ULL << pin) : gpio.out & ~(1ULL << pin));
+	return ESP_OK;
+}
+
+
+int gpio_get_level(gpio_num_t pin) {
+	if (pin < 0 || pin >= PIN_COUNT) {
+		return 0;
+	}
+	gpio.accesses++;
+	return level(get_input(), pin);
+}
+
+
+esp_err_t gpio_set_direction(gpio_num_t pin, gpio_mode_t mode) {
+	if (pin < 0 || pin >= PIN_COUNT) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	if (mode & GPIO_MODE_OUTPUT) {
+		gpio.enable |= 1ULL << pin;
+	}
+	else {
+		gpio.enable &= ~(1ULL << pin);
+	}
+	return ESP_OK;
+}
+
+
+esp_err_t gpio_install_isr_service(int flags) {
+	return ESP_OK;
+}
+
+
+esp_err_t gpio_isr_handler_add(gpio_num_t pin, gpio_isr_t handler, void *arg) {
+	if (pin < 0 || pin >= PIN_COUNT) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	gpio.handlers[pin].handler = handler;
+	gpio.handlers[pin].arg = arg;
+	return ESP_OK;
+}
+
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t pin) {
+	if (pin < 0 || pin >= PIN_COUNT) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	gpio.handlers[pin].handler = NULL;
+	return ESP_OK;
+}
+
+
+void gpio_matrix_out(uint32_t gpio_num, uint32_t signal_idx, bool out_inv, bool oen_inv) {
+	if (gpio_num < PIN_COUNT) {
+		gpio.signals[gpio_num] = signal_idx;
+	}
+}
@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: MIT
+// Mocked GPIO register file with 8080 bus decoder. Rising edge of WR latches
+// data pins, every strobe is counted and optionally recorded.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "driver/gpio.h"
+
+
+// Recorded strobe, DC level in bit 16, data in low bits
+#define HOST_GPIO_STROBE_DC (1U << 16)
+// Some data pins were not driven by source of WR
+#define HOST_GPIO_STROBE_INVALID (1U << 17)
+
+typedef struct host_gpio_bus {
+	int pin_wr;
+	int pin_dc;
+	int data_pins[16];
+	int width; // 8 or 16
+} host_gpio_bus_t;
+
+// Reset all pins, handlers and counters, bus can be NULL
+void host_gpio_reset(const host_gpio_bus_t *bus);
+// Strobes are stored until capacity is full, count is still incremented,
+// strobe and access counts start from zero
+void host_gpio_record(uint32_t *strobes, size_t capacity);
+size_t host_gpio_get_strobes(void);
+// Register reads and writes, gpio_set_level and gpio_get_level count as one
+size_t host_gpio_get_accesses(void);
+// Level of pins configured as input
+void host_gpio_set_input(uint64_t levels);
+uint64_t host_gpio_get_output(void);
+// Strobe of peripheral routed by GPIO matrix, data bit n is sent on signal
+// data_signal + n, returns false if WR pin is not routed to wr_signal
+bool host_gpio_signal_strobe(uint32_t wr_signal, uint32_t data_signal, uint32_t value);
+// Call interrupt handler of pin as GPIO ISR service would
+void host_gpio_trigger(gpio_num_t pin);
@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: MIT
+// Model of I2S LCD mode DMA. DMA moves data only in host_i2s_run and
+// interrupt handler is called only by host_i2s_interrupt, so tests choose
+// interleaving of DMA, interrupt and CPU, or run both from background
+// thread. Samples are latched as WR strobes by mocked GPIO, when pins are
+// routed to I2S.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "soc/i2s_struct.h"
+
+
+typedef struct host_i2s_stats {
+	uint32_t starts; // Chains started by out_link.start
+	uint32_t descriptors; // Descriptors sent
+	uint32_t owner_errors; // Descriptors owned by CPU reached by DMA
+	size_t bytes;
+	size_t detached_bytes; // Sent while WR pin was routed to GPIO
+} host_i2s_stats_t;
+
+// Reset registers, interrupt handlers and statistics of both devices
+void host_i2s_reset(void);
+// Returns bytes sent, stops after max_bytes, at end of chain or on
+// descriptor owned by CPU
+size_t host_i2s_run(i2s_dev_t *dev, size_t max_bytes);
+// Call interrupt handler if enabled interrupt is pending, returns true if it
+// was called
+bool host_i2s_interrupt(i2s_dev_t *dev);
+// Chain is being sent or start is requested
+bool host_i2s_is_active(i2s_dev_t *dev);
+void host_i2s_get_stats(i2s_dev_t *dev, host_i2s_stats_t *stats);
+// Run DMA and interrupt handler from background thread, as on other core,
+// until host_i2s_stop_dma. Every step of at most step_bytes is done in
+// critical section, so it's atomic to critical sections of driver. Unlike on
+// hardware, interrupt handler doesn't preempt task of its core and can still
+// run after task got last result, so thread has to be stopped before driver
+// is deinitialized.
+void host_i2s_start_dma(i2s_dev_t *dev, size_t step_bytes);
+void host_i2s_stop_dma(i2s_dev_t *dev);
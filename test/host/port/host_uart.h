@@ -0,0 +1,21 @@
+// SPDX-License-Identifier: MIT
+// Other end of host UART. Bytes written by host are received by driver, bytes
+// written by driver are read by host. Receive buffer has size given to first
+// uart_driver_install and host waits when it is full.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "driver/uart.h"
+
+
+#define HOST_UART_TX_BUFFER_SIZE 4096
+
+bool host_uart_is_installed(uart_port_t uart_num);
+// Returns bytes written before timeout
+size_t host_uart_write(uart_port_t uart_num, const uint8_t *data, size_t length, TickType_t ticks_to_wait);
+// Returns bytes read, waits only for first byte
+size_t host_uart_read(uart_port_t uart_num, uint8_t *data, size_t length, TickType_t ticks_to_wait);
@@ -0,0 +1,249 @@
+// SPDX-License-Identifier: MIT
+// Model of I2S LCD mode DMA and interrupt allocator
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include "driver/periph_ctrl.h"
+#include "esp32/rom/lldesc.h"
+#include "esp_heap_caps.h"
+#include "esp_intr_alloc.h"
+#include "freertos/FreeRTOS.h"
+#include "host_gpio.h"
+#include "host_i2s.h"
+#include "soc/gpio_sig_map.h"
+
+
+struct host_intr {
+	int source;
+	intr_handler_t handler;
+	void *arg;
+	bool enabled;
+};
+
+typedef struct i2s_model {
+	struct host_intr intr;
+	bool allocated;
+	lldesc_t *desc; // Descriptor being sent
+	size_t pos; // Bytes of descriptor already sent
+	bool active;
+	host_i2s_stats_t stats;
+	pthread_t thread;
+	volatile bool thread_running;
+	size_t step_bytes;
+} i2s_model_t;
+
+
+i2s_dev_t I2S0;
+i2s_dev_t I2S1;
+
+static i2s_model_t models[2];
+
+
+static int get_index(i2s_dev_t *dev) {
+	return dev == &I2S0 ? 0 : 1;
+}
+
+
+static void reset_device(i2s_dev_t *dev) {
+	memset((void *)dev, 0, sizeof(*dev));
+	dev->state.tx_idle = 1;
+}
+
+
+void host_i2s_reset(void) {
+	reset_device(&I2S0);
+	reset_device(&I2S1);
+	memset(models, 0, sizeof(models));
+}
+
+
+// Interrupt status is raw status masked by enable, clear bits are written by
+// driver and take effect on next access
+static void update_interrupts(i2s_dev_t *dev) {
+	dev->int_raw.val &= ~dev->int_clr.val;
+	dev->int_clr.val = 0;
+	dev->int_st.val = dev->int_raw.val & dev->int_ena.val;
+}
+
+
+// Upper 16-bit half of word leaves FIFO first, 8-bit mode sends its low byte
+// first (see i2s_swap_halfwords and i2s_swap_bytes)
+static void send_word(i2s_dev_t *dev, i2s_model_t *model, const volatile uint8_t *data) {
+	const int index = get_index(dev);
+	const int wr_signal = index == 0 ? I2S0O_WS_OUT_IDX : I2S1O_WS_OUT_IDX;
+	const int data_signal = index == 0 ? I2S0O_DATA_OUT0_IDX : I2S1O_DATA_OUT0_IDX;
+	uint32_t samples[4];
+	size_t count;
+	if (dev->conf2.lcd_tx_wrx2_en) {
+		samples[0] = data[2];
+		samples[1] = data[3];
+		samples[2] = data[0];
+		samples[3] = data[1];
+		count = 4;
+	}
+	else {
+		samples[0] = data[2] | (data[3] << 8);
+		samples[1] = data[0] | (data[1] << 8);
+		count = 2;
+	}
+	for (size_t i = 0; i < count; ++i) {
+		if (!host_gpio_signal_strobe(wr_signal, data_signal, samples[i])) {
+			model->stats.detached_bytes += 4 / count;
+		}
+	}
+	model->stats.bytes += 4;
+}
+
+
+static void finish_descriptor(i2s_dev_t *dev, i2s_model_t *model) {
+	lldesc_t *desc = model->desc;
+	model->stats.descriptors++;
+	if (dev->lc_conf.out_auto_wrback) {
+		desc->owner = 0;
+	}
+	if (desc->eof) {
+		dev->int_raw.out_eof = 1;
+		dev->out_eof_des_addr = (uint32_t)(uintptr_t)desc;
+	}
+	if (desc->qe.stqe_next == NULL) {
+		dev->int_raw.out_total_eof = 1;
+		model->active = false;
+		return;
+	}
+	model->desc = desc->qe.stqe_next;
+	model->pos = 0;
+	// Next descriptor is fetched right away, owner set later is not seen
+	if (dev->lc_conf.check_owner && !model->desc->owner) {
+		dev->int_raw.out_dscr_err = 1;
+		model->active = false;
+		model->stats.owner_errors++;
+	}
+}
+
+
+size_t host_i2s_run(i2s_dev_t *dev, size_t max_bytes) {
+	i2s_model_t *model = &models[get_index(dev)];
+	if (dev->out_link.stop) {
+		dev->out_link.stop = 0;
+		model->active = false;
+	}
+	if (dev->out_link.start) {
+		dev->out_link.start = 0;
+		model->desc = (lldesc_t *)host_heap_dma_address(dev->out_link.addr);
+		model->pos = 0;
+		model->active = true;
+		model->stats.starts++;
+	}
+
+	size_t sent = 0;
+	while (model->active && dev->conf.tx_start && sent < max_bytes) {
+		lldesc_t *desc = model->desc;
+		if (model->pos == 0 && dev->lc_conf.check_owner && !desc->owner) {
+			dev->int_raw.out_dscr_err = 1;
+			model->active = false;
+			model->stats.owner_errors++;
+			break;
+		}
+		while (model->pos < desc->length && sent < max_bytes) {
+			send_word(dev, model, desc->buf + model->pos);
+			model->pos += 4;
+			sent += 4;
+		}
+		if (model->pos >= desc->length) {
+			finish_descriptor(dev, model);
+		}
+	}
+	dev->state.tx_idle = !model->active;
+	update_interrupts(dev);
+	return sent;
+}
+
+
+bool host_i2s_interrupt(i2s_dev_t *dev) {
+	i2s_model_t *model = &models[get_index(dev)];
+	update_interrupts(dev);
+	if (dev->int_st.val == 0 || !model->allocated || !model->intr.enabled) {
+		return false;
+	}
+	model->intr.handler(model->intr.arg);
+	update_interrupts(dev);
+	return true;
+}
+
+
+bool host_i2s_is_active(i2s_dev_t *dev) {
+	return models[get_index(dev)].active || dev->out_link.start;
+}
+
+
+void host_i2s_get_stats(i2s_dev_t *dev, host_i2s_stats_t *stats) {
+	*stats = models[get_index(dev)].stats;
+}
+
+
+static void *dma_thread(void *arg) {
+	i2s_dev_t *dev = (i2s_dev_t *)arg;
+	i2s_model_t *model = &models[get_index(dev)];
+	const struct timespec pause = {0, 20000};
+	while (model->thread_running) {
+		host_enter_critical();
+		const size_t sent = host_i2s_run(dev, model->step_bytes);
+		const bool called = host_i2s_interrupt(dev);
+		host_exit_critical();
+		if (sent == 0 && !called) {
+			nanosleep(&pause, NULL);
+		}
+	}
+	return NULL;
+}
+
+
+void host_i2s_start_dma(i2s_dev_t *dev, size_t step_bytes) {
+	i2s_model_t *model = &models[get_index(dev)];
+	model->step_bytes = step_bytes;
+	model->thread_running = true;
+	pthread_create(&model->thread, NULL, dma_thread, (void *)dev);
+}
+
+
+void host_i2s_stop_dma(i2s_dev_t *dev) {
+	i2s_model_t *model = &models[get_index(dev)];
+	model->thread_running = false;
+	pthread_join(model->thread, NULL);
+}
+
+
+esp_err_t esp_intr_alloc(int source, int flags, intr_handler_t handler, void *arg, intr_handle_t *handle) {
+	if (source != ETS_I2S0_INTR_SOURCE && source != ETS_I2S1_INTR_SOURCE) {
+		return ESP_ERR_NOT_FOUND;
+	}
+	i2s_model_t *model = &models[source == ETS_I2S0_INTR_SOURCE ? 0 : 1];
+	if (model->allocated) {
+		return ESP_ERR_INVALID_STATE;
+	}
+	model->intr.source = source;
+	model->intr.handler = handler;
+	model->intr.arg = arg;
+	model->intr.enabled = false;
+	model->allocated = true;
+	*handle = &model->intr;
+	return ESP_OK;
+}
+
+
+esp_err_t esp_intr_enable(intr_handle_t handle) {
+	handle->enabled = true;
+	return ESP_OK;
+}
+
+
+esp_err_t esp_intr_free(intr_handle_t handle) {
+	models[handle->source == ETS_I2S0_INTR_SOURCE ? 0 : 1].allocated = false;
+	return ESP_OK;
+}
+
+
+void periph_module_enable(periph_module_t periph) {
+}
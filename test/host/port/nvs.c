@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: MIT
+// Host port of NVS, handle is index of namespace and values are u8 entries
+
+#include <pthread.h>
+#include <string.h>
+
+#include "nvs.h"
+
+
+#define MAX_NAMESPACES 8
+#define MAX_ENTRIES 32
+#define MAX_NAME 16 // Including terminator as on ESP32
+
+
+typedef struct nvs_entry {
+	nvs_handle_t handle;
+	char key[MAX_NAME];
+	uint8_t value;
+} nvs_entry_t;
+
+
+static pthread_mutex_t nvs_lock = PTHREAD_MUTEX_INITIALIZER;
+static char namespaces[MAX_NAMESPACES][MAX_NAME];
+static size_t namespace_count;
+static nvs_entry_t entries[MAX_ENTRIES];
+static size_t entry_count;
+
+
+static nvs_entry_t *find_entry(nvs_handle_t handle, const char *key) {
+	for (size_t i = 0; i < entry_count; ++i) {
+		if (entries[i].handle == handle && strcmp(entries[i].key, key) == 0) {
+			return &entries[i];
+		}
+	}
+	return NULL;
+}
+
+
+// Read only namespace must exist
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle) {
+	if (strlen(name) >= MAX_NAME) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	esp_err_t ret = ESP_OK;
+	pthread_mutex_lock(&nvs_lock);
+	size_t index = 0;
+	while (index < namespace_count && strcmp(namespaces[index], name) != 0) {
+		index++;
+	}
+	if (index == namespace_count) {
+		if (open_mode == NVS_READONLY) {
+			ret = ESP_ERR_NVS_NOT_FOUND;
+		}
+		else if (namespace_count == MAX_NAMESPACES) {
+			ret = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+		}
+		else {
+			strcpy(namespaces[namespace_count++], name);
+		}
+	}
+	pthread_mutex_unlock(&nvs_lock);
+	*out_handle = index;
+	return ret;
+}
+
+
+void nvs_close(nvs_handle_t handle) {
+}
+
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char *key, uint8_t *out_value) {
+	pthread_mutex_lock(&nvs_lock);
+	const nvs_entry_t *entry = find_entry(handle, key);
+	if (entry != NULL) {
+		*out_value = entry->value;
+	}
+	pthread_mutex_unlock(&nvs_lock);
+	return entry != NULL ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char *key, uint8_t value) {
+	if (strlen(key) >= MAX_NAME) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	esp_err_t ret = ESP_OK;
+	pthread_mutex_lock(&nvs_lock);
+	nvs_entry_t *entry = find_entry(handle, key);
+	if (entry == NULL && entry_count < MAX_ENTRIES) {
+		entry = &entries[entry_count++];
+		entry->handle = handle;
+		strcpy(entry->key, key);
+	}
+	if (entry != NULL) {
+		entry->value = value;
+	}
+	else {
+		ret = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+	}
+	pthread_mutex_unlock(&nvs_lock);
+	return ret;
+}
+
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+	return ESP_OK;
+}
@@ -0,0 +1,383 @@
+// SPDX-License-Identifier: MIT
+// Host port of ESP-IDF and FreeRTOS services used by component
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <time.h>
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "soc/cpu.h"
+#include "soc/soc_memory_layout.h"
+
+
+// Largest DMA capable block of ESP32 after boot
+#define LARGEST_FREE_BLOCK (112 * 1024)
+
+
+// Internal memory of ESP32 fits to 1 MB window, so 20-bit descriptor
+// addresses are unique. DMA capable memory is allocated from arena aligned
+// to 1 MB, blocks are kept sorted by address.
+#define DMA_ARENA_SIZE (1 << 20)
+#define DMA_ALIGN 16
+
+
+typedef struct dma_block {
+	struct dma_block *next;
+	uintptr_t start;
+	size_t size;
+} dma_block_t;
+
+struct host_task {
+	TaskFunction_t function;
+	void *arg;
+};
+
+struct host_queue {
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	size_t length;
+	size_t item_size;
+	size_t count;
+	size_t head;
+	uint8_t *items;
+};
+
+
+static pthread_mutex_t critical_lock;
+static pthread_mutex_t dma_lock = PTHREAD_MUTEX_INITIALIZER;
+static dma_block_t *dma_blocks;
+static uint8_t *dma_arena;
+static pthread_once_t critical_once = PTHREAD_ONCE_INIT;
+
+
+void host_log(char level, const char *tag, const char *format, ...) {
+	if ((level == 'I' || level == 'D') && getenv("HOST_LOG") == NULL) {
+		return;
+	}
+	va_list args;
+	va_start(args, format);
+	fprintf(stderr, "%c (%s) ", level, tag);
+	vfprintf(stderr, format, args);
+	fputc('\n', stderr);
+	va_end(args);
+}
+
+
+// First fit in gaps between blocks
+static void *dma_malloc(size_t size) {
+	dma_block_t *block = (dma_block_t *)malloc(sizeof(dma_block_t));
+	if (block == NULL) {
+		return NULL;
+	}
+	block->size = (MAX(size, 1) + DMA_ALIGN - 1) & ~(size_t)(DMA_ALIGN - 1);
+	pthread_mutex_lock(&dma_lock);
+	if (dma_arena == NULL && posix_memalign((void **)&dma_arena, DMA_ARENA_SIZE, DMA_ARENA_SIZE) != 0) {
+		dma_arena = NULL;
+	}
+	uintptr_t start = (uintptr_t)dma_arena;
+	dma_block_t **link = &dma_blocks;
+	while (*link != NULL && (*link)->start - start < block->size) {
+		start = (*link)->start + (*link)->size;
+		link = &(*link)->next;
+	}
+	if (dma_arena == NULL || start + block->size > (uintptr_t)dma_arena + DMA_ARENA_SIZE) {
+		pthread_mutex_unlock(&dma_lock);
+		free(block);
+		return NULL;
+	}
+	block->start = start;
+	block->next = *link;
+	*link = block;
+	pthread_mutex_unlock(&dma_lock);
+	return (void *)start;
+}
+
+
+// Called with dma_lock held
+static dma_block_t **find_dma_block(uintptr_t address) {
+	for (dma_block_t **block = &dma_blocks; *block != NULL; block = &(*block)->next) {
+		if (address >= (*block)->start && address < (*block)->start + (*block)->size) {
+			return block;
+		}
+	}
+	return NULL;
+}
+
+
+void *heap_caps_malloc(size_t size, uint32_t caps) {
+	if (caps & MALLOC_CAP_DMA) {
+		return dma_malloc(size);
+	}
+	return malloc(size);
+}
+
+
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps) {
+	if (caps & MALLOC_CAP_DMA) {
+		void *ptr = dma_malloc(n * size);
+		if (ptr != NULL) {
+			memset(ptr, 0, n * size);
+		}
+		return ptr;
+	}
+	return calloc(n, size);
+}
+
+
+void heap_caps_free(void *ptr) {
+	pthread_mutex_lock(&dma_lock);
+	dma_block_t **block = find_dma_block((uintptr_t)ptr);
+	if (block != NULL && (*block)->start == (uintptr_t)ptr) {
+		dma_block_t *found = *block;
+		*block = found->next;
+		free(found);
+		pthread_mutex_unlock(&dma_lock);
+		return;
+	}
+	pthread_mutex_unlock(&dma_lock);
+	free(ptr);
+}
+
+
+bool esp_ptr_dma_capable(const void *ptr) {
+	pthread_mutex_lock(&dma_lock);
+	const bool found = find_dma_block((uintptr_t)ptr) != NULL;
+	pthread_mutex_unlock(&dma_lock);
+	return found;
+}
+
+
+void *host_heap_dma_address(uint32_t address) {
+	pthread_mutex_lock(&dma_lock);
+	const uintptr_t resolved = (uintptr_t)dma_arena + (address & (DMA_ARENA_SIZE - 1));
+	const bool found = dma_arena != NULL && find_dma_block(resolved) != NULL;
+	pthread_mutex_unlock(&dma_lock);
+	if (!found) {
+		fprintf(stderr, "DMA address 0x%05x is not in DMA capable memory\n", (unsigned)address);
+		abort();
+	}
+	return (void *)resolved;
+}
+
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+	return LARGEST_FREE_BLOCK;
+}
+
+
+int64_t esp_timer_get_time(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+
+uint32_t esp_cpu_get_ccount(void) {
+	return (uint32_t)esp_timer_get_time();
+}
+
+
+static void init_critical_lock(void) {
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&critical_lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+}
+
+
+void host_enter_critical(void) {
+	pthread_once(&critical_once, init_critical_lock);
+	pthread_mutex_lock(&critical_lock);
+}
+
+
+void host_exit_critical(void) {
+	pthread_mutex_unlock(&critical_lock);
+}
+
+
+static void *run_task(void *arg) {
+	struct host_task task = *(struct host_task *)arg;
+	free(arg);
+	task.function(task.arg);
+	return NULL;
+}
+
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stack_size, void *arg, UBaseType_t priority, TaskHandle_t *task, BaseType_t core) {
+	struct host_task *start = (struct host_task *)malloc(sizeof(struct host_task));
+	if (start == NULL) {
+		return pdFAIL;
+	}
+	start->function = function;
+	start->arg = arg;
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, run_task, start) != 0) {
+		free(start);
+		return pdFAIL;
+	}
+	pthread_detach(thread);
+	if (task != NULL) {
+		*task = NULL;
+	}
+	return pdPASS;
+}
+
+
+void vTaskDelete(TaskHandle_t task) {
+	if (task == NULL) {
+		pthread_exit(NULL);
+	}
+}
+
+
+void vTaskDelay(TickType_t ticks) {
+	const int64_t us = (int64_t)ticks * portTICK_PERIOD_MS * 1000;
+	const struct timespec delay = {us / 1000000, (us % 1000000) * 1000};
+	nanosleep(&delay, NULL);
+}
+
+
+TickType_t xTaskGetTickCount(void) {
+	return (TickType_t)(esp_timer_get_time() / 1000 / portTICK_PERIOD_MS);
+}
+
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+	QueueHandle_t queue = (QueueHandle_t)calloc(1, sizeof(struct host_queue));
+	if (queue == NULL) {
+		return NULL;
+	}
+	queue->items = (uint8_t *)malloc(length * item_size + 1);
+	if (queue->items == NULL) {
+		free(queue);
+		return NULL;
+	}
+	queue->length = length;
+	queue->item_size = item_size;
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&queue->changed, &attr);
+	pthread_condattr_destroy(&attr);
+	pthread_mutex_init(&queue->lock, NULL);
+	return queue;
+}
+
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count) {
+	QueueHandle_t queue = xQueueCreate(max_count, 0);
+	if (queue != NULL) {
+		queue->count = initial_count;
+	}
+	return queue;
+}
+
+
+void vQueueDelete(QueueHandle_t queue) {
+	pthread_cond_destroy(&queue->changed);
+	pthread_mutex_destroy(&queue->lock);
+	free(queue->items);
+	free(queue);
+}
+
+
+// Called with lock held, returns false on timeout
+static bool wait_changed(QueueHandle_t queue, TickType_t ticks, const struct timespec *deadline) {
+	if (ticks == 0) {
+		return false;
+	}
+	if (ticks == portMAX_DELAY) {
+		pthread_cond_wait(&queue->changed, &queue->lock);
+		return true;
+	}
+	return pthread_cond_timedwait(&queue->changed, &queue->lock, deadline) != ETIMEDOUT;
+}
+
+
+static struct timespec get_deadline(TickType_t ticks) {
+	struct timespec deadline;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	if (ticks != portMAX_DELAY) {
+		const int64_t ns = deadline.tv_nsec + (int64_t)ticks * portTICK_PERIOD_MS * 1000000;
+		deadline.tv_sec += ns / 1000000000;
+		deadline.tv_nsec = ns % 1000000000;
+	}
+	return deadline;
+}
+
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks) {
+	const struct timespec deadline = get_deadline(ticks);
+	pthread_mutex_lock(&queue->lock);
+	while (queue->count == queue->length) {
+		if (!wait_changed(queue, ticks, &deadline)) {
+			pthread_mutex_unlock(&queue->lock);
+			return pdFALSE;
+		}
+	}
+	if (queue->item_size > 0) {
+		const size_t tail = (queue->head + queue->count) % queue->length;
+		memcpy(queue->items + tail * queue->item_size, item, queue->item_size);
+	}
+	queue->count++;
+	pthread_cond_broadcast(&queue->changed);
+	pthread_mutex_unlock(&queue->lock);
+	return pdTRUE;
+}
+
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks) {
+	const struct timespec deadline = get_deadline(ticks);
+	pthread_mutex_lock(&queue->lock);
+	while (queue->count == 0) {
+		if (!wait_changed(queue, ticks, &deadline)) {
+			pthread_mutex_unlock(&queue->lock);
+			return pdFALSE;
+		}
+	}
+	if (queue->item_size > 0) {
+		memcpy(item, queue->items + queue->head * queue->item_size, queue->item_size);
+		queue->head = (queue->head + 1) % queue->length;
+	}
+	queue->count--;
+	pthread_cond_broadcast(&queue->changed);
+	pthread_mutex_unlock(&queue->lock);
+	return pdTRUE;
+}
+
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *woken) {
+	if (woken != NULL) {
+		*woken = pdFALSE;
+	}
+	return xQueueSend(queue, item, 0);
+}
+
+
+BaseType_t xQueueReceiveFromISR(QueueHandle_t queue, void *item, BaseType_t *woken) {
+	if (woken != NULL) {
+		*woken = pdFALSE;
+	}
+	return xQueueReceive(queue, item, 0);
+}
+
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+	pthread_mutex_lock(&queue->lock);
+	const UBaseType_t count = queue->count;
+	pthread_mutex_unlock(&queue->lock);
+	return count;
+}
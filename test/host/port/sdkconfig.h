@@ -0,0 +1,4 @@
+// SPDX-License-Identifier: MIT
+// Host build has no menuconfig options
+
+#pragma once
@@ -0,0 +1,9 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdint.h>
+
+
+// Cycle counter runs at 1 MHz on host
+uint32_t esp_cpu_get_ccount(void);
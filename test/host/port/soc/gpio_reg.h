@@ -0,0 +1,26 @@
+// SPDX-License-Identifier: MIT
+// Register addresses of ESP32, accesses go to mocked register file
+
+#pragma once
+
+#include <stdint.h>
+
+
+#define GPIO_OUT_REG 0x3ff44004
+#define GPIO_OUT_W1TS_REG 0x3ff44008
+#define GPIO_OUT_W1TC_REG 0x3ff4400c
+#define GPIO_OUT1_REG 0x3ff44010
+#define GPIO_OUT1_W1TS_REG 0x3ff44014
+#define GPIO_OUT1_W1TC_REG 0x3ff44018
+#define GPIO_ENABLE_W1TS_REG 0x3ff44024
+#define GPIO_ENABLE_W1TC_REG 0x3ff44028
+#define GPIO_ENABLE1_W1TS_REG 0x3ff44030
+#define GPIO_ENABLE1_W1TC_REG 0x3ff44034
+#define GPIO_IN_REG 0x3ff4403c
+#define GPIO_IN1_REG 0x3ff44040
+
+void host_gpio_reg_write(uint32_t address, uint32_t value);
+uint32_t host_gpio_reg_read(uint32_t address);
+
+#define REG_WRITE(address, value) host_gpio_reg_write((address), (value))
+#define REG_READ(address) host_gpio_reg_read(address)
@@ -0,0 +1,11 @@
+// SPDX-License-Identifier: MIT
+// Output signals of GPIO matrix used by I2S LCD mode
+
+#pragma once
+
+
+#define I2S0O_WS_OUT_IDX 12
+#define I2S1O_WS_OUT_IDX 28
+#define I2S0O_DATA_OUT0_IDX 140
+#define I2S1O_DATA_OUT0_IDX 166
+#define SIG_GPIO_OUT_IDX 256
@@ -0,0 +1,4 @@
+// SPDX-License-Identifier: MIT
+// Registers are accessed only through i2s_dev_t on host
+
+#pragma once
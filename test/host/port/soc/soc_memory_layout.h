@@ -0,0 +1,9 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdbool.h>
+
+
+// Memory allocated with MALLOC_CAP_DMA
+bool esp_ptr_dma_capable(const void *ptr);
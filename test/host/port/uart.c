@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: MIT
+// Host port of UART driver, both directions are queues of bytes
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "driver/uart.h"
+#include "host_uart.h"
+
+
+typedef struct host_uart {
+	QueueHandle_t rx;
+	QueueHandle_t tx;
+	uint32_t baud_rate;
+	volatile bool installed;
+} host_uart_t;
+
+
+static host_uart_t uarts[UART_NUM_MAX] = {
+	{NULL, NULL, 115200, false},
+	{NULL, NULL, 115200, false},
+	{NULL, NULL, 115200, false},
+};
+
+
+static size_t receive(QueueHandle_t queue, uint8_t *data, size_t length, TickType_t ticks_to_wait) {
+	size_t count = 0;
+	while (count < length && xQueueReceive(queue, &data[count], count == 0 ? ticks_to_wait : 0)) {
+		count++;
+	}
+	return count;
+}
+
+
+// Queues stay allocated after delete, so host can still read last replies
+esp_err_t uart_driver_install(uart_port_t uart_num, int rx_buffer_size, int tx_buffer_size, int queue_size, QueueHandle_t *uart_queue, int intr_alloc_flags) {
+	if (uart_num < 0 || uart_num >= UART_NUM_MAX || rx_buffer_size <= 0) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	host_uart_t *uart = &uarts[uart_num];
+	if (uart->installed) {
+		return ESP_FAIL;
+	}
+	if (uart->rx == NULL) {
+		uart->rx = xQueueCreate(rx_buffer_size, 1);
+		uart->tx = xQueueCreate(HOST_UART_TX_BUFFER_SIZE, 1);
+		if (uart->rx == NULL || uart->tx == NULL) {
+			return ESP_ERR_NO_MEM;
+		}
+	}
+	uint8_t byte;
+	while (xQueueReceive(uart->rx, &byte, 0)) {
+	}
+	uart->installed = true;
+	return ESP_OK;
+}
+
+
+esp_err_t uart_driver_delete(uart_port_t uart_num) {
+	uarts[uart_num].installed = false;
+	return ESP_OK;
+}
+
+
+esp_err_t uart_get_baudrate(uart_port_t uart_num, uint32_t *baud_rate) {
+	*baud_rate = uarts[uart_num].baud_rate;
+	return ESP_OK;
+}
+
+
+esp_err_t uart_set_baudrate(uart_port_t uart_num, uint32_t baud_rate) {
+	uarts[uart_num].baud_rate = baud_rate;
+	return ESP_OK;
+}
+
+
+esp_err_t uart_get_buffered_data_len(uart_port_t uart_num, size_t *size) {
+	if (!uarts[uart_num].installed) {
+		return ESP_FAIL;
+	}
+	*size = uxQueueMessagesWaiting(uarts[uart_num].rx);
+	return ESP_OK;
+}
+
+
+int uart_read_bytes(uart_port_t uart_num, void *buf, uint32_t length, TickType_t ticks_to_wait) {
+	if (!uarts[uart_num].installed) {
+		return -1;
+	}
+	return (int)receive(uarts[uart_num].rx, (uint8_t *)buf, length, ticks_to_wait);
+}
+
+
+int uart_write_bytes(uart_port_t uart_num, const void *src, size_t size) {
+	if (!uarts[uart_num].installed) {
+		return -1;
+	}
+	const uint8_t *data = (const uint8_t *)src;
+	for (size_t i = 0; i < size; ++i) {
+		xQueueSend(uarts[uart_num].tx, &data[i], portMAX_DELAY);
+	}
+	return (int)size;
+}
+
+
+esp_err_t uart_wait_tx_done(uart_port_t uart_num, TickType_t ticks_to_wait) {
+	return ESP_OK;
+}
+
+
+bool host_uart_is_installed(uart_port_t uart_num) {
+	return uarts[uart_num].installed;
+}
+
+
+size_t host_uart_write(uart_port_t uart_num, const uint8_t *data, size_t length, TickType_t ticks_to_wait) {
+	if (uarts[uart_num].rx == NULL) {
+		return 0;
+	}
+	size_t count = 0;
+	while (count < length && xQueueSend(uarts[uart_num].rx, &data[count], ticks_to_wait)) {
+		count++;
+	}
+	return count;
+}
+
+
+size_t host_uart_read(uart_port_t uart_num, uint8_t *data, size_t length, TickType_t ticks_to_wait) {
+	if (uarts[uart_num].tx == NULL) {
+		return 0;
+	}
+	return receive(uarts[uart_num].tx, data, length, ticks_to_wait);
+}
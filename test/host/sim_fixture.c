@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: MIT
+
+#include <string.h>
+
+#include "sim_fixture.h"
+
+#include "test.h"
+
+
+void sim_init(ili9481_driver_t *driver, const ili9481_bus_t *bus, uint16_t width, uint16_t height, uint8_t pixel_format) {
+	memset(driver, 0, sizeof(*driver));
+	driver->bus = bus;
+	driver->pin_rst = -1;
+	driver->display_width = width;
+	driver->display_height = height;
+	driver->pixel_format = pixel_format;
+	CHECK_EQ(ili9481_init(driver), ESP_OK);
+	ili9481_set_pixel_format(driver, pixel_format);
+}
+
+
+ili9481_color_t sim_gram_color(const ili9481_driver_t *driver, uint16_t x, uint16_t line) {
+	const ili9481_sim_t *sim = (const ili9481_sim_t *)driver->bus_data;
+	const uint8_t *pixel = sim->gram + ((size_t)line * driver->display_width + x) * 3;
+	return ((pixel[0] & 0xf8) << 8) | ((pixel[1] & 0xfc) << 3) | (pixel[2] >> 3);
+}
+
+
+ili9481_color_t sim_content(uint16_t x, uint16_t y, uint16_t seed) {
+	return (ili9481_color_t)((x * 2246822519U + y * 3266489917U + seed * 668265263U) >> 16);
+}
@@ -0,0 +1,15 @@
+// SPDX-License-Identifier: MIT
+// Driver over simulator bus and colors of simulated GRAM
+
+#pragma once
+
+#include "ili9481.h"
+
+
+// Bus is ili9481_bus_sim or bus wrapping its functions, pixel format is sent
+// to display
+void sim_init(ili9481_driver_t *driver, const ili9481_bus_t *bus, uint16_t width, uint16_t height, uint8_t pixel_format);
+// 18-bit GRAM pixel as RGB565 color
+ili9481_color_t sim_gram_color(const ili9481_driver_t *driver, uint16_t x, uint16_t line);
+// Color of pixel, which differs between neighbours and seeds
+ili9481_color_t sim_content(uint16_t x, uint16_t y, uint16_t seed);
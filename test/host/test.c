@@ -0,0 +1,18 @@
+// SPDX-License-Identifier: MIT
+// Helpers shared by host tests
+
+#include "test.h"
+
+
+static uint32_t random_state = 1;
+
+
+void random_seed(uint32_t seed) {
+	random_state = seed;
+}
+
+
+uint32_t random_next(void) {
+	random_state = random_state * 1103515245 + 12345;
+	return random_state >> 8;
+}
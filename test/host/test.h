@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: MIT
+// Checks abort test with location of failed condition, random numbers are
+// reproducible from seed set by test
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+#define CHECK(condition) do { \
+		if (!(condition)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			exit(1); \
+		} \
+	} while (0)
+
+#define CHECK_EQ(actual, expected) do { \
+		const long long actual_ = (long long)(actual); \
+		const long long expected_ = (long long)(expected); \
+		if (actual_ != expected_) { \
+			fprintf(stderr, "%s:%d: check failed: %s == %s (%lld != %lld)\n", __FILE__, __LINE__, #actual, #expected, actual_, expected_); \
+			exit(1); \
+		} \
+	} while (0)
+
+void random_seed(uint32_t seed);
+uint32_t random_next(void);
@@ -0,0 +1,149 @@
+// SPDX-License-Identifier: MIT
+// Write clock calibration over simulator bus with data lines, which are too
+// slow below given divider. Calibration must not pick divider, at which any
+// of 8 data lines fails, and must restore pixel format.
+
+#include <string.h>
+
+#include "ili9481.h"
+#include "ili9481_calibrate.h"
+
+#include "sim_fixture.h"
+#include "test.h"
+
+
+#define WIDTH 64
+#define HEIGHT 8
+
+
+typedef struct slow_lines {
+	uint8_t min_div[8]; // Line keeps previous level below this divider
+	uint32_t set_count; // Calls of set_clock_div
+} slow_lines_t;
+
+
+static ili9481_bus_t slow_bus;
+static slow_lines_t lines;
+static uint8_t previous_byte;
+
+
+static esp_err_t slow_set_clock_div(ili9481_driver_t *driver, uint8_t clock_div) {
+	lines.set_count++;
+	return ESP_OK;
+}
+
+
+// Slow line of data byte has level of previous byte
+static void slow_write_data(ili9481_driver_t *driver, const uint8_t *data, size_t length) {
+	for (size_t i = 0; i < length; ++i) {
+		uint8_t value = data[i];
+		for (int bit = 0; bit < 8; ++bit) {
+			if (driver->clock_div < lines.min_div[bit]) {
+				value = (value & ~(1 << bit)) | (previous_byte & (1 << bit));
+			}
+		}
+		previous_byte = data[i];
+		ili9481_bus_sim.write_data(driver, &value, 1);
+	}
+}
+
+
+static void init_slow(ili9481_driver_t *driver, const uint8_t min_div[8]) {
+	memcpy(lines.min_div, min_div, sizeof(lines.min_div));
+	lines.set_count = 0;
+	slow_bus = ili9481_bus_sim;
+	slow_bus.write_data = slow_write_data;
+	slow_bus.set_clock_div = slow_set_clock_div;
+	sim_init(driver, &slow_bus, WIDTH, HEIGHT, ILI9481_PIXEL_FORMAT_16);
+	driver->clock_div = 10;
+}
+
+
+static uint8_t calibrate(const uint8_t min_div[8], esp_err_t expected) {
+	ili9481_driver_t driver;
+	init_slow(&driver, min_div);
+	const ili9481_calibration_config_t config = {
+		.min_div = 2,
+		.max_div = 16,
+		.repeat = 2,
+	};
+	CHECK_EQ(ili9481_calibrate_clock(&driver, &config), expected);
+	CHECK_EQ(driver.pixel_format, ILI9481_PIXEL_FORMAT_16);
+	const uint8_t clock_div = driver.clock_div;
+	ili9481_deinit(&driver);
+	return clock_div;
+}
+
+
+// Every line alone decides divider, also D0 and D1, which 18-bit pixels don't
+// use
+static void test_slow_line(void) {
+	for (int bit = 0; bit < 8; ++bit) {
+		uint8_t min_div[8] = {0};
+		min_div[bit] = 7;
+		CHECK_EQ(calibrate(min_div, ESP_OK), 7);
+	}
+	const uint8_t mixed[8] = {5, 3, 0, 0, 0, 0, 4, 0};
+	CHECK_EQ(calibrate(mixed, ESP_OK), 5);
+	const uint8_t fast[8] = {0};
+	CHECK_EQ(calibrate(fast, ESP_OK), 2);
+	const uint8_t too_slow[8] = {0, 17, 0, 0, 0, 0, 0, 0};
+	CHECK_EQ(calibrate(too_slow, ESP_ERR_NOT_FOUND), 10);
+}
+
+
+static void test_cache(void) {
+	ili9481_driver_t driver;
+	const uint8_t min_div[8] = {0, 6, 0, 0, 0, 0, 0, 0};
+	init_slow(&driver, min_div);
+	ili9481_calibration_config_t config = {
+		.min_div = 2,
+		.max_div = 16,
+		.margin = 1,
+		.nvs_namespace = "calibrate",
+	};
+	CHECK_EQ(ili9481_calibrate_clock(&driver, &config), ESP_OK);
+	CHECK_EQ(driver.clock_div, 7);
+	CHECK_EQ(lines.set_count, 6);
+
+	// Cached divider is set without test
+	lines.set_count = 0;
+	lines.min_div[1] = 0;
+	CHECK_EQ(ili9481_calibrate_clock(&driver, &config), ESP_OK);
+	CHECK_EQ(driver.clock_div, 7);
+	CHECK_EQ(lines.set_count, 1);
+
+	config.force = true;
+	CHECK_EQ(ili9481_calibrate_clock(&driver, &config), ESP_OK);
+	CHECK_EQ(driver.clock_div, 3);
+	config.force = false;
+	CHECK_EQ(ili9481_calibrate_clock(&driver, &config), ESP_OK);
+	CHECK_EQ(driver.clock_div, 3);
+	ili9481_deinit(&driver);
+}
+
+
+static void test_unsupported(void) {
+	ili9481_driver_t driver;
+	const uint8_t min_div[8] = {0};
+	init_slow(&driver, min_div);
+	ili9481_calibration_config_t config = {
+		.min_div = 4,
+		.max_div = 3,
+	};
+	CHECK_EQ(ili9481_calibrate_clock(&driver, &config), ESP_ERR_INVALID_ARG);
+	ili9481_deinit(&driver);
+
+	sim_init(&driver, &ili9481_bus_sim, WIDTH, HEIGHT, ILI9481_PIXEL_FORMAT_18);
+	config.max_div = 8;
+	CHECK_EQ(ili9481_calibrate_clock(&driver, &config), ESP_ERR_NOT_SUPPORTED);
+	ili9481_deinit(&driver);
+}
+
+
+int main(void) {
+	test_slow_line();
+	test_cache();
+	test_unsupported();
+	return 0;
+}
@@ -0,0 +1,169 @@
+// SPDX-License-Identifier: MIT
+// Dirty rectangle tracker over simulator bus, every invalidated pixel must
+// be repainted and nothing outside of reported windows may change
+
+#include <string.h>
+
+#include "ili9481.h"
+#include "ili9481_dirty.h"
+
+#include "sim_fixture.h"
+#include "test.h"
+
+
+#define WIDTH 96
+#define HEIGHT 64
+#define WINDOW_BYTES 14
+#define RANDOM_ROUNDS 400
+
+
+typedef struct painter {
+	uint16_t seed;
+	uint8_t painted[HEIGHT][WIDTH]; // Times pixel was rendered
+	uint32_t pixels;
+} painter_t;
+
+
+static void render(ili9481_driver_t *driver, ili9481_color_t *buffer, uint16_t x, uint16_t y, uint16_t width, uint16_t lines, void *user_data) {
+	painter_t *painter = (painter_t *)user_data;
+	CHECK(x + width <= WIDTH && y + lines <= HEIGHT);
+	for (uint16_t line = 0; line < lines; ++line) {
+		for (uint16_t column = 0; column < width; ++column) {
+			buffer[line * width + column] = sim_content(x + column, y + line, painter->seed);
+			painter->painted[y + line][x + column]++;
+		}
+	}
+	painter->pixels += (uint32_t)width * lines;
+}
+
+
+static void test_random_invalidation(void) {
+	ili9481_driver_t driver;
+	sim_init(&driver, &ili9481_bus_sim, WIDTH, HEIGHT, ILI9481_PIXEL_FORMAT_16);
+	const ili9481_sim_t *sim = (const ili9481_sim_t *)driver.bus_data;
+	static painter_t painter;
+	const ili9481_dirty_config_t config = {
+		.window_cost = 32,
+		.buffer_pixels = WIDTH * 2,
+		.render = render,
+		.user_data = &painter,
+	};
+	ili9481_dirty_t *dirty;
+	CHECK_EQ(ili9481_dirty_create(&driver, &config, &dirty), ESP_OK);
+	ili9481_dirty_invalidate_all(dirty);
+	ili9481_dirty_flush(dirty, NULL);
+
+	static uint8_t invalid[HEIGHT][WIDTH];
+	for (int round = 0; round < RANDOM_ROUNDS; ++round) {
+		memset(invalid, 0, sizeof(invalid));
+		memset(painter.painted, 0, sizeof(painter.painted));
+		painter.pixels = 0;
+		painter.seed = round + 1;
+
+		// Rectangles may reach past display and are clipped
+		const size_t count = 1 + random_next() % 40;
+		for (size_t i = 0; i < count; ++i) {
+			const uint16_t x = random_next() % (WIDTH + 8);
+			const uint16_t y = random_next() % (HEIGHT + 8);
+			const uint16_t width = random_next() % 24;
+			const uint16_t height = random_next() % 24;
+			ili9481_dirty_invalidate(dirty, x, y, width, height);
+			for (uint16_t row = y; row < y + height && row < HEIGHT; ++row) {
+				for (uint16_t column = x; column < x + width && column < WIDTH; ++column) {
+					invalid[row][column] = 1;
+				}
+			}
+		}
+
+		const uint64_t pixels_written = sim->pixels_written;
+		ili9481_dirty_report_t report;
+		ili9481_dirty_flush(dirty, &report);
+		CHECK(report.rects <= ILI9481_DIRTY_MAX_RECTS);
+		CHECK_EQ(report.pixels, painter.pixels);
+		CHECK_EQ(sim->pixels_written - pixels_written, report.pixels);
+		CHECK_EQ(report.bytes_written, report.pixels * 2 + report.rects * WINDOW_BYTES);
+
+		for (uint16_t y = 0; y < HEIGHT; ++y) {
+			for (uint16_t x = 0; x < WIDTH; ++x) {
+				if (invalid[y][x]) {
+					CHECK(painter.painted[y][x] > 0);
+				}
+				// Pixels outside of rendered windows are not touched
+				CHECK_EQ(sim_gram_color(&driver, x, y), sim_content(x, y, painter.painted[y][x] > 0 ? painter.seed : 0));
+			}
+		}
+
+		// Next round starts from known content
+		ili9481_dirty_invalidate_all(dirty);
+		painter.seed = 0;
+		ili9481_dirty_flush(dirty, NULL);
+	}
+	ili9481_dirty_destroy(dirty);
+	ili9481_deinit(&driver);
+}
+
+
+static void test_merging(void) {
+	ili9481_driver_t driver;
+	sim_init(&driver, &ili9481_bus_sim, WIDTH, HEIGHT, ILI9481_PIXEL_FORMAT_16);
+	static painter_t painter;
+	const ili9481_dirty_config_t config = {
+		.window_cost = 32,
+		.buffer_pixels = WIDTH,
+		.render = render,
+		.user_data = &painter,
+	};
+	ili9481_dirty_t *dirty;
+	CHECK_EQ(ili9481_dirty_create(&driver, &config, &dirty), ESP_OK);
+	ili9481_dirty_report_t report;
+
+	// Nothing to flush
+	ili9481_dirty_flush(dirty, &report);
+	CHECK_EQ(report.rects, 0);
+	CHECK_EQ(report.pixels, 0);
+
+	// Distant rectangles stay separate
+	ili9481_dirty_invalidate(dirty, 0, 0, 8, 8);
+	ili9481_dirty_invalidate(dirty, 80, 50, 8, 8);
+	ili9481_dirty_flush(dirty, &report);
+	CHECK_EQ(report.rects, 2);
+	CHECK_EQ(report.pixels, 128);
+
+	// Neighbours are joined without extra pixels
+	ili9481_dirty_invalidate(dirty, 10, 10, 8, 8);
+	ili9481_dirty_invalidate(dirty, 18, 10, 8, 8);
+	ili9481_dirty_flush(dirty, &report);
+	CHECK_EQ(report.rects, 1);
+	CHECK_EQ(report.pixels, 128);
+
+	// Near rectangles are joined when gap is cheaper than window
+	ili9481_dirty_invalidate(dirty, 10, 10, 8, 8);
+	ili9481_dirty_invalidate(dirty, 10, 20, 8, 8);
+	ili9481_dirty_flush(dirty, &report);
+	CHECK_EQ(report.rects, 1);
+	CHECK_EQ(report.pixels, 8 * 18);
+
+	// Rectangles over limit are merged
+	for (uint16_t i = 0; i < ILI9481_DIRTY_MAX_RECTS + 4; ++i) {
+		ili9481_dirty_invalidate(dirty, (i % 6) * 16, (i / 6) * 16, 2, 2);
+	}
+	ili9481_dirty_flush(dirty, &report);
+	CHECK(report.rects <= ILI9481_DIRTY_MAX_RECTS);
+
+	ili9481_dirty_invalidate_all(dirty);
+	ili9481_dirty_flush(dirty, &report);
+	CHECK_EQ(report.rects, 1);
+	CHECK_EQ(report.pixels, WIDTH * HEIGHT);
+	CHECK_EQ(report.bytes_saved, 0);
+
+	ili9481_dirty_destroy(dirty);
+	ili9481_deinit(&driver);
+}
+
+
+int main(void) {
+	random_seed(5);
+	test_random_invalidation();
+	test_merging();
+	return 0;
+}
@@ -0,0 +1,249 @@
+// SPDX-License-Identifier: MIT
+// Glyph cache against list model of least recently used glyphs, cached
+// bitmaps must survive eviction and compaction of other glyphs
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "bitmap_font.h"
+#include "glyph_cache.h"
+
+#include "test.h"
+
+
+#define ARENA_SIZE 600
+#define MAX_GLYPHS 20
+#define RANDOM_ROUNDS 50000
+
+
+typedef struct model_entry {
+	const void *face;
+	uint16_t pixel_size;
+	uint32_t codepoint;
+	size_t size;
+} model_entry_t;
+
+// Most recently used first
+typedef struct model {
+	model_entry_t entries[MAX_GLYPHS];
+	size_t count;
+	size_t used;
+} model_t;
+
+typedef struct rasterizer {
+	uint16_t pixel_size;
+	uint32_t calls;
+	uint8_t bitmap[2048];
+} rasterizer_t;
+
+
+static uint16_t glyph_width(uint32_t codepoint, uint16_t pixel_size) {
+	// Space is empty, codepoint 100 does not fit arena
+	if (codepoint == ' ') {
+		return 0;
+	}
+	return codepoint == 100 ? 400 : codepoint % 7 + pixel_size / 4;
+}
+
+
+static uint8_t bitmap_byte(uint32_t codepoint, uint16_t pixel_size, size_t pos) {
+	return (uint8_t)(codepoint * 31 + pos * 7 + pixel_size);
+}
+
+
+static size_t bitmap_size(uint16_t width, uint16_t height) {
+	return ((size_t)width * height * 2 + 7) / 8;
+}
+
+
+static esp_err_t rasterize(uint32_t codepoint, glyph_t *glyph, void *user_data) {
+	rasterizer_t *rasterizer = (rasterizer_t *)user_data;
+	const uint16_t pixel_size = rasterizer->pixel_size;
+	rasterizer->calls++;
+	glyph->bitmap_width = glyph_width(codepoint, pixel_size);
+	glyph->bitmap_height = pixel_size;
+	glyph->bitmap_left = codepoint & 0x03;
+	glyph->bitmap_top = pixel_size;
+	glyph->advance = codepoint % 11;
+	const size_t size = bitmap_size(glyph->bitmap_width, glyph->bitmap_height);
+	for (size_t i = 0; i < size; ++i) {
+		rasterizer->bitmap[i] = bitmap_byte(codepoint, pixel_size, i);
+	}
+	glyph->bitmap = rasterizer->bitmap;
+	return ESP_OK;
+}
+
+
+static void check_glyph(const glyph_t *glyph, uint32_t codepoint, uint16_t pixel_size) {
+	CHECK(glyph != NULL);
+	CHECK_EQ(glyph->bitmap_width, glyph_width(codepoint, pixel_size));
+	CHECK_EQ(glyph->bitmap_height, pixel_size);
+	CHECK_EQ(glyph->bitmap_left, codepoint & 0x03);
+	CHECK_EQ(glyph->advance, codepoint % 11);
+	const size_t size = bitmap_size(glyph->bitmap_width, glyph->bitmap_height);
+	for (size_t i = 0; i < size; ++i) {
+		CHECK_EQ(glyph->bitmap[i], bitmap_byte(codepoint, pixel_size, i));
+	}
+}
+
+
+static void model_remove(model_t *model, size_t index) {
+	model->used -= model->entries[index].size;
+	memmove(&model->entries[index], &model->entries[index + 1], (model->count - index - 1) * sizeof(model_entry_t));
+	model->count--;
+}
+
+
+// Returns true on hit, evicts like cache on miss: one entry, when all are
+// taken, then until bitmap fits arena
+static bool model_get(model_t *model, const void *face, uint16_t pixel_size, uint32_t codepoint, size_t size, uint32_t *evictions) {
+	for (size_t i = 0; i < model->count; ++i) {
+		const model_entry_t entry = model->entries[i];
+		if (entry.face == face && entry.pixel_size == pixel_size && entry.codepoint == codepoint) {
+			model_remove(model, i);
+			memmove(&model->entries[1], &model->entries[0], model->count * sizeof(model_entry_t));
+			model->entries[0] = entry;
+			model->used += entry.size;
+			model->count++;
+			return true;
+		}
+	}
+	if (size > ARENA_SIZE) {
+		return false;
+	}
+	if (model->count == MAX_GLYPHS) {
+		model_remove(model, model->count - 1);
+		(*evictions)++;
+	}
+	while (ARENA_SIZE - model->used < size) {
+		model_remove(model, model->count - 1);
+		(*evictions)++;
+	}
+	memmove(&model->entries[1], &model->entries[0], model->count * sizeof(model_entry_t));
+	const model_entry_t entry = {face, pixel_size, codepoint, size};
+	model->entries[0] = entry;
+	model->used += size;
+	model->count++;
+	return false;
+}
+
+
+static void test_random_access(void) {
+	glyph_cache_t *cache;
+	CHECK_EQ(glyph_cache_create(ARENA_SIZE, MAX_GLYPHS, &cache), ESP_OK);
+	model_t model = {0};
+	rasterizer_t rasterizer = {0};
+	const int faces[2] = {0, 0};
+	uint32_t hits = 0;
+	uint32_t misses = 0;
+	uint32_t evictions = 0;
+
+	for (int round = 0; round < RANDOM_ROUNDS; ++round) {
+		// Small working set hits often, codepoint 100 is too large for arena
+		const uint32_t codepoint = random_next() % 4 == 0 ? random_next() % 101 : 32 + random_next() % 12;
+		const uint16_t pixel_size = random_next() % 2 ? 8 : 12;
+		const void *face = &faces[random_next() % 2];
+		rasterizer.pixel_size = pixel_size;
+		const uint32_t calls = rasterizer.calls;
+
+		const glyph_t *glyph = glyph_cache_get(cache, face, pixel_size, codepoint, rasterize, &rasterizer);
+		check_glyph(glyph, codepoint, pixel_size);
+		const size_t size = bitmap_size(glyph->bitmap_width, glyph->bitmap_height);
+		const bool hit = model_get(&model, face, pixel_size, codepoint, size, &evictions);
+		CHECK_EQ(rasterizer.calls - calls, hit ? 0 : 1);
+		hits += hit;
+		misses += !hit;
+
+		// Cached glyphs are intact after moves in arena, they are visited
+		// from least recent, so order of cache and model is kept
+		if (round % 97 == 0) {
+			for (size_t i = model.count; i > 0; --i) {
+				const model_entry_t entry = model.entries[model.count - 1];
+				rasterizer.pixel_size = entry.pixel_size;
+				check_glyph(glyph_cache_get(cache, entry.face, entry.pixel_size, entry.codepoint, rasterize, &rasterizer), entry.codepoint, entry.pixel_size);
+				CHECK(model_get(&model, entry.face, entry.pixel_size, entry.codepoint, entry.size, &evictions));
+				hits++;
+			}
+			CHECK_EQ(rasterizer.calls, misses);
+		}
+	}
+
+	glyph_cache_stats_t stats;
+	glyph_cache_get_stats(cache, &stats);
+	CHECK_EQ(stats.hits, hits);
+	CHECK_EQ(stats.misses, misses);
+	CHECK_EQ(stats.evictions, evictions);
+	CHECK_EQ(stats.used, model.used);
+	CHECK(stats.compactions > 0);
+	glyph_cache_destroy(cache);
+}
+
+
+static void test_clear(void) {
+	glyph_cache_t *cache;
+	CHECK_EQ(glyph_cache_create(ARENA_SIZE, MAX_GLYPHS, &cache), ESP_OK);
+	rasterizer_t rasterizer = {.pixel_size = 8};
+	const int face = 0;
+	for (uint32_t codepoint = 'a'; codepoint <= 'z'; ++codepoint) {
+		glyph_cache_get(cache, &face, 8, codepoint, rasterize, &rasterizer);
+	}
+	glyph_cache_clear(cache);
+	glyph_cache_stats_t stats;
+	glyph_cache_get_stats(cache, &stats);
+	CHECK_EQ(stats.hits, 0);
+	CHECK_EQ(stats.misses, 0);
+	CHECK_EQ(stats.evictions, 0);
+	CHECK_EQ(stats.compactions, 0);
+	CHECK_EQ(stats.used, 0);
+
+	// Glyphs cached before clear are rasterized again
+	rasterizer.calls = 0;
+	check_glyph(glyph_cache_get(cache, &face, 8, 'z', rasterize, &rasterizer), 'z', 8);
+	CHECK_EQ(rasterizer.calls, 1);
+	glyph_cache_destroy(cache);
+}
+
+
+typedef struct counted_font {
+	bitmap_font_t font;
+	uint32_t calls;
+} counted_font_t;
+
+
+static esp_err_t rasterize_counted(uint32_t codepoint, glyph_t *glyph, void *user_data) {
+	counted_font_t *counted = (counted_font_t *)user_data;
+	counted->calls++;
+	return bitmap_font_rasterize(codepoint, glyph, &counted->font);
+}
+
+
+// Text drawn repeatedly with built-in font is rasterized once
+static void test_repeated_text(void) {
+	glyph_cache_t *cache;
+	CHECK_EQ(glyph_cache_create(4096, 64, &cache), ESP_OK);
+	counted_font_t counted = {.font = {.scale = 2}};
+	const char *text = "Lorem ipsum dolor sit amet";
+	for (int frame = 0; frame < 100; ++frame) {
+		for (const char *c = text; *c != 0; ++c) {
+			const glyph_t *glyph = glyph_cache_get(cache, &counted.font, counted.font.scale, *c, rasterize_counted, &counted);
+			CHECK(glyph != NULL);
+			CHECK(glyph->advance > 0);
+		}
+	}
+	glyph_cache_stats_t stats;
+	glyph_cache_get_stats(cache, &stats);
+	CHECK_EQ(counted.calls, 14); // Distinct characters
+	CHECK_EQ(stats.misses, 14);
+	CHECK_EQ(stats.hits, 100 * strlen(text) - 14);
+	CHECK_EQ(stats.evictions, 0);
+	glyph_cache_destroy(cache);
+}
+
+
+int main(void) {
+	random_seed(3);
+	test_random_access();
+	test_clear();
+	test_repeated_text();
+	return 0;
+}
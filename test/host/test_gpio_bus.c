@@ -0,0 +1,220 @@
+// SPDX-License-Identifier: MIT
+// Register writer of reg bus against gpio_set_level bus on mocked GPIO
+// register file. Both must produce same strobes for same drawing, benchmark
+// prints bytes per second and register accesses per byte of both writers.
+
+#include <string.h>
+#include <time.h>
+
+#include "ili9481.h"
+#include "host_gpio.h"
+
+#include "test.h"
+
+
+#define WIDTH 320
+#define HEIGHT 480
+#define MAX_STROBES (1 << 20)
+#define BENCH_SIZE (64 * 1024)
+#define BENCH_ROUNDS 16
+
+
+typedef struct pin_config {
+	const char *name;
+	int pin_rd;
+	int pin_wr;
+	int pin_cs;
+	int pin_dc;
+	uint8_t bus_width;
+	int data_pins[16];
+} pin_config_t;
+
+static const pin_config_t configs[] = {
+	// Data pins in order, reg bus writes shifted byte
+	{"shift", 2, 0, 21, 1, 8, {12, 13, 14, 15, 16, 17, 18, 19}},
+	{"table", 2, 4, 5, 25, 8, {12, 13, 26, 27, 14, 22, 21, 19}},
+	{"table16", 2, 4, 5, 25, 16, {12, 13, 26, 27, 14, 22, 21, 19, 18, 23, 15, 16, 17, 0, 1, 3}},
+};
+
+
+static void init_driver(ili9481_driver_t *driver, const ili9481_bus_t *bus, const pin_config_t *config) {
+	memset(driver, 0, sizeof(*driver));
+	host_gpio_bus_t gpio_bus = {
+		.pin_wr = config->pin_wr,
+		.pin_dc = config->pin_dc,
+		.width = config->bus_width,
+	};
+	memcpy(gpio_bus.data_pins, config->data_pins, sizeof(gpio_bus.data_pins));
+	host_gpio_reset(&gpio_bus);
+
+	driver->bus = bus;
+	driver->pin_rst = -1;
+	driver->pin_rd = config->pin_rd;
+	driver->pin_wr = config->pin_wr;
+	driver->pin_cs = config->pin_cs;
+	driver->pin_dc = config->pin_dc;
+	int *pins[16] = {
+		&driver->pin_d0, &driver->pin_d1, &driver->pin_d2, &driver->pin_d3,
+		&driver->pin_d4, &driver->pin_d5, &driver->pin_d6, &driver->pin_d7,
+		&driver->pin_d8, &driver->pin_d9, &driver->pin_d10, &driver->pin_d11,
+		&driver->pin_d12, &driver->pin_d13, &driver->pin_d14, &driver->pin_d15,
+	};
+	for (size_t i = 0; i < 16; ++i) {
+		*pins[i] = i < config->bus_width ? config->data_pins[i] : -1;
+	}
+	driver->bus_width = config->bus_width;
+	driver->display_width = WIDTH;
+	driver->display_height = HEIGHT;
+	CHECK_EQ(ili9481_init(driver), ESP_OK);
+}
+
+
+// Returns number of strobes
+static size_t draw(const ili9481_bus_t *bus, const pin_config_t *config, uint32_t *strobes) {
+	ili9481_driver_t driver;
+	init_driver(&driver, bus, config);
+	host_gpio_record(strobes, MAX_STROBES);
+
+	static uint8_t pixels[999];
+	random_seed(17);
+	for (size_t i = 0; i < sizeof(pixels); ++i) {
+		pixels[i] = random_next();
+	}
+	const uint8_t formats[2] = {ILI9481_PIXEL_FORMAT_16, ILI9481_PIXEL_FORMAT_18};
+	for (size_t i = 0; i < (config->bus_width == 16 ? 1 : 2); ++i) {
+		ili9481_set_pixel_format(&driver, formats[i]);
+		ili9481_fill_area(&driver, ili9481_rgb_to_color(200, 100, 50), 3, 7, 40, 30);
+		ili9481_set_window(&driver, 100, 200, 100 + 332, 200);
+		ili9481_write_data(&driver, pixels, sizeof(pixels) - (sizeof(pixels) % 2));
+	}
+	const size_t count = host_gpio_get_strobes();
+	CHECK(count < MAX_STROBES);
+	ili9481_deinit(&driver);
+	return count;
+}
+
+
+static void test_same_strobes(const pin_config_t *config) {
+	static uint32_t gpio_strobes[MAX_STROBES];
+	static uint32_t reg_strobes[MAX_STROBES];
+	const size_t count = draw(&ili9481_bus_gpio, config, gpio_strobes);
+	CHECK(count > 0);
+	CHECK_EQ(draw(&ili9481_bus_reg, config, reg_strobes), count);
+	CHECK(memcmp(gpio_strobes, reg_strobes, count * sizeof(uint32_t)) == 0);
+}
+
+
+// Command with DC low, data with DC high, words on 16-bit bus
+static void test_decoded_strobes(const ili9481_bus_t *bus, const pin_config_t *config) {
+	ili9481_driver_t driver;
+	init_driver(&driver, bus, config);
+	if (config->bus_width == 16) {
+		ili9481_set_pixel_format(&driver, ILI9481_PIXEL_FORMAT_16);
+	}
+	uint32_t strobes[8];
+	const uint8_t data[6] = {0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc};
+	host_gpio_record(strobes, 8);
+	ili9481_write_command(&driver, ILI9481_SET_PARTIAL_AREA);
+	ili9481_write_data(&driver, data, sizeof(data));
+	CHECK_EQ(host_gpio_get_strobes(), 1 + sizeof(data));
+	CHECK_EQ(strobes[0], ILI9481_SET_PARTIAL_AREA);
+	for (size_t i = 0; i < sizeof(data); ++i) {
+		CHECK_EQ(strobes[1 + i], HOST_GPIO_STROBE_DC | data[i]);
+	}
+
+	if (config->bus_width == 16) {
+		host_gpio_record(strobes, 8);
+		ili9481_write_command(&driver, ILI9481_WRITE_MEMORY_START);
+		ili9481_write_data(&driver, data, sizeof(data));
+		CHECK_EQ(host_gpio_get_strobes(), 1 + sizeof(data) / 2);
+		for (size_t i = 0; i < sizeof(data) / 2; ++i) {
+			CHECK_EQ(strobes[1 + i], HOST_GPIO_STROBE_DC | (data[i * 2] << 8) | data[i * 2 + 1]);
+		}
+	}
+	ili9481_deinit(&driver);
+}
+
+
+static void test_read(const ili9481_bus_t *bus, const pin_config_t *config) {
+	ili9481_driver_t driver;
+	init_driver(&driver, bus, config);
+	uint64_t levels = 0;
+	for (size_t bit = 0; bit < 8; ++bit) {
+		if (0xa5 & (1 << bit)) {
+			levels |= 1ULL << config->data_pins[bit];
+		}
+	}
+	host_gpio_set_input(levels);
+	uint8_t data[4];
+	ili9481_write_command(&driver, ILI9481_DEVICE_CODE_READ);
+	ili9481_read_data(&driver, data, sizeof(data));
+	for (size_t i = 0; i < sizeof(data); ++i) {
+		CHECK_EQ(data[i], 0xa5);
+	}
+	// Data pins are outputs again
+	host_gpio_set_input(0);
+	uint32_t strobe;
+	host_gpio_record(&strobe, 1);
+	ili9481_write_data(&driver, data, 1);
+	CHECK_EQ(strobe, HOST_GPIO_STROBE_DC | 0xa5);
+	ili9481_deinit(&driver);
+}
+
+
+typedef struct bench_result {
+	double rate; // Bytes per second
+	double accesses; // Per byte
+} bench_result_t;
+
+
+static bench_result_t bench_bus(const ili9481_bus_t *bus, const pin_config_t *config, const uint8_t *data) {
+	ili9481_driver_t driver;
+	init_driver(&driver, bus, config);
+	host_gpio_record(NULL, 0);
+	struct timespec start;
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int round = 0; round < BENCH_ROUNDS; ++round) {
+		ili9481_write_data(&driver, data, BENCH_SIZE);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	const size_t bytes = (size_t)BENCH_SIZE * BENCH_ROUNDS;
+	CHECK_EQ(host_gpio_get_strobes(), bytes);
+	const bench_result_t result = {
+		bytes / ((end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9),
+		(double)host_gpio_get_accesses() / bytes,
+	};
+	ili9481_deinit(&driver);
+	return result;
+}
+
+
+// Decoder of mocked register file costs more than bus writes, so accesses per
+// byte are closer to gain on hardware than bytes per second
+static void bench(void) {
+	static uint8_t data[BENCH_SIZE];
+	for (size_t i = 0; i < BENCH_SIZE; ++i) {
+		data[i] = random_next();
+	}
+	for (size_t i = 0; i < 2; ++i) {
+		const bench_result_t gpio = bench_bus(&ili9481_bus_gpio, &configs[i], data);
+		const bench_result_t reg = bench_bus(&ili9481_bus_reg, &configs[i], data);
+		CHECK(reg.accesses <= 3.0);
+		CHECK(gpio.accesses >= 10.0);
+		printf("%-6s gpio %7.2f MB/s %5.1f accesses/byte  reg %7.2f MB/s %5.1f accesses/byte  gain %.1fx\n", configs[i].name, gpio.rate / 1e6, gpio.accesses, reg.rate / 1e6, reg.accesses, reg.rate / gpio.rate);
+	}
+}
+
+
+int main(void) {
+	random_seed(17);
+	for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); ++i) {
+		test_same_strobes(&configs[i]);
+		test_decoded_strobes(&ili9481_bus_gpio, &configs[i]);
+		test_decoded_strobes(&ili9481_bus_reg, &configs[i]);
+		test_read(&ili9481_bus_gpio, &configs[i]);
+		test_read(&ili9481_bus_reg, &configs[i]);
+	}
+	bench();
+	return 0;
+}
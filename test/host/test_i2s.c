@@ -0,0 +1,310 @@
+// SPDX-License-Identifier: MIT
+// I2S LCD mode driver over model of DMA and GPIO matrix. Descriptor chains,
+// FIFO order of samples and routing of pins are checked with interrupt
+// stepped by test, I2S bus is compared with register writer of reg bus with
+// DMA running in background thread.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ili9481.h"
+#include "ili9481_i2s.h"
+#include "esp_heap_caps.h"
+#include "host_gpio.h"
+#include "host_i2s.h"
+
+#include "test.h"
+
+
+#define WIDTH 320
+#define HEIGHT 480
+#define MAX_STROBES (1 << 20)
+#define PIN_WR 4
+#define DMA_STEP 256
+
+
+typedef struct pin_config {
+	const char *name;
+	int pin_rd;
+	int pin_wr;
+	int pin_cs;
+	int pin_dc;
+	uint8_t bus_width;
+	int data_pins[16];
+} pin_config_t;
+
+static const pin_config_t configs[] = {
+	{"shift", 2, 0, 21, 1, 8, {12, 13, 14, 15, 16, 17, 18, 19}},
+	{"table", 2, 4, 5, 25, 8, {12, 13, 26, 27, 14, 22, 21, 19}},
+	{"table16", 2, 4, 5, 25, 16, {12, 13, 26, 27, 14, 22, 21, 19, 18, 23, 15, 16, 17, 0, 1, 3}},
+};
+
+
+static void test_build_chain(void) {
+	static const size_t lengths[] = {4, 4088, 4092, 4096, 8184, 12000};
+	lldesc_t desc[4];
+	static uint8_t data[12000];
+	for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); ++i) {
+		const size_t length = lengths[i];
+		const size_t count = i2s_dma_desc_count(length);
+		CHECK_EQ(count, (length + I2S_DMA_MAX_LENGTH - 1) / I2S_DMA_MAX_LENGTH);
+		memset(desc, 0, sizeof(desc));
+		CHECK(i2s_build_dma_chain(desc, count, data, length) == desc);
+		size_t total = 0;
+		for (size_t j = 0; j < count; ++j) {
+			CHECK(desc[j].buf == data + total);
+			CHECK_EQ(desc[j].length, desc[j].size);
+			CHECK(desc[j].length <= I2S_DMA_MAX_LENGTH);
+			CHECK_EQ(desc[j].owner, 1);
+			CHECK_EQ(desc[j].eof, j == count - 1);
+			CHECK(desc[j].qe.stqe_next == (j == count - 1 ? NULL : &desc[j + 1]));
+			total += desc[j].length;
+		}
+		CHECK_EQ(total, length);
+		if (count > 1) {
+			CHECK(i2s_build_dma_chain(desc, count - 1, data, length) == NULL);
+		}
+	}
+	CHECK(i2s_build_dma_chain(desc, 4, data, 0) == NULL);
+}
+
+
+static void init_i2s(int data_bits, int pin_dc) {
+	host_gpio_bus_t gpio_bus = {
+		.pin_wr = PIN_WR,
+		.pin_dc = pin_dc,
+		.width = data_bits,
+	};
+	i2s_driver_config_t config = {
+		.queue_size = 2,
+		.max_transfer_size = I2S_DMA_MAX_LENGTH * 2,
+		.data_bits = data_bits,
+		.pin_wr = PIN_WR,
+	};
+	for (int i = 0; i < data_bits; ++i) {
+		gpio_bus.data_pins[i] = config.pin_data[i] = 12 + i;
+	}
+	host_gpio_reset(&gpio_bus);
+	host_i2s_reset();
+	CHECK_EQ(i2s_init(&I2S1, &config), ESP_OK);
+}
+
+
+// Runs DMA in small steps, interrupt is handled between steps
+static void run_until_idle(void) {
+	for (int step = 0; step < 100000 && host_i2s_is_active(&I2S1); ++step) {
+		host_i2s_run(&I2S1, 64);
+		host_i2s_interrupt(&I2S1);
+	}
+	CHECK(!host_i2s_is_active(&I2S1));
+}
+
+
+// Bus order bytes leave FIFO in order after swap
+static void test_fifo_order(int data_bits) {
+	init_i2s(data_bits, -1);
+	const size_t length = I2S_DMA_MAX_LENGTH + 100;
+	uint8_t *expected = (uint8_t *)malloc(length);
+	uint8_t *data = (uint8_t *)heap_caps_malloc(length, MALLOC_CAP_DMA);
+	for (size_t i = 0; i < length; ++i) {
+		expected[i] = data[i] = random_next();
+	}
+	if (data_bits == 8) {
+		i2s_swap_halfwords(data, length);
+	}
+	else {
+		i2s_swap_bytes(data, length);
+	}
+
+	static uint32_t strobes[MAX_STROBES];
+	host_gpio_record(strobes, MAX_STROBES);
+	i2s_transaction_t transaction = {
+		.data = data,
+		.length = length,
+	};
+	CHECK_EQ(i2s_trans_enqueue(&I2S1, &transaction, 0), ESP_OK);
+	CHECK(host_i2s_is_active(&I2S1));
+	i2s_transaction_t *done;
+	CHECK_EQ(i2s_trans_get_result(&I2S1, &done, 0), ESP_ERR_TIMEOUT);
+	run_until_idle();
+	CHECK_EQ(i2s_trans_get_result(&I2S1, &done, 0), ESP_OK);
+	CHECK(done == &transaction);
+	i2s_wait_idle(&I2S1);
+
+	const size_t samples = length * 8 / data_bits;
+	CHECK_EQ(host_gpio_get_strobes(), samples);
+	for (size_t i = 0; i < samples; ++i) {
+		const uint32_t value = data_bits == 8 ? expected[i] : (expected[i * 2] << 8) | expected[i * 2 + 1];
+		CHECK_EQ(strobes[i], value);
+	}
+	host_i2s_stats_t stats;
+	host_i2s_get_stats(&I2S1, &stats);
+	CHECK_EQ(stats.starts, 1);
+	CHECK_EQ(stats.descriptors, 2);
+	CHECK_EQ(stats.bytes, length);
+	CHECK_EQ(stats.owner_errors, 0);
+
+	// Detached pins are driven by GPIO, DMA output is lost
+	i2s_detach_pins(&I2S1);
+	host_gpio_record(strobes, MAX_STROBES);
+	CHECK_EQ(i2s_trans_enqueue(&I2S1, &transaction, 0), ESP_OK);
+	run_until_idle();
+	CHECK_EQ(i2s_trans_get_result(&I2S1, &done, 0), ESP_OK);
+	CHECK_EQ(host_gpio_get_strobes(), 0);
+	host_i2s_get_stats(&I2S1, &stats);
+	CHECK_EQ(stats.detached_bytes, length);
+
+	i2s_deinit(&I2S1);
+	heap_caps_free(data);
+	free(expected);
+}
+
+
+static void test_invalid(void) {
+	init_i2s(8, -1);
+	uint32_t *data = (uint32_t *)heap_caps_malloc(I2S_DMA_MAX_LENGTH * 3, MALLOC_CAP_DMA);
+	i2s_transaction_t transaction = {
+		.data = data,
+		.length = 6,
+	};
+	CHECK_EQ(i2s_trans_enqueue(&I2S1, &transaction, 0), ESP_ERR_INVALID_SIZE);
+	transaction.length = 0;
+	CHECK_EQ(i2s_trans_enqueue(&I2S1, &transaction, 0), ESP_ERR_INVALID_SIZE);
+	// Driver descriptors cover max_transfer_size
+	transaction.length = I2S_DMA_MAX_LENGTH * 3;
+	CHECK_EQ(i2s_trans_enqueue(&I2S1, &transaction, 0), ESP_ERR_INVALID_SIZE);
+	CHECK(!host_i2s_is_active(&I2S1));
+	i2s_deinit(&I2S1);
+	heap_caps_free(data);
+
+	const i2s_driver_config_t config = {
+		.queue_size = 1,
+		.data_bits = 12,
+	};
+	CHECK_EQ(i2s_init(&I2S1, &config), ESP_ERR_INVALID_ARG);
+}
+
+
+static void init_driver(ili9481_driver_t *driver, const ili9481_bus_t *bus, const pin_config_t *config) {
+	memset(driver, 0, sizeof(*driver));
+	host_gpio_bus_t gpio_bus = {
+		.pin_wr = config->pin_wr,
+		.pin_dc = config->pin_dc,
+		.width = config->bus_width,
+	};
+	memcpy(gpio_bus.data_pins, config->data_pins, sizeof(gpio_bus.data_pins));
+	host_gpio_reset(&gpio_bus);
+	host_i2s_reset();
+
+	driver->bus = bus;
+	driver->pin_rst = -1;
+	driver->pin_rd = config->pin_rd;
+	driver->pin_wr = config->pin_wr;
+	driver->pin_cs = config->pin_cs;
+	driver->pin_dc = config->pin_dc;
+	int *pins[16] = {
+		&driver->pin_d0, &driver->pin_d1, &driver->pin_d2, &driver->pin_d3,
+		&driver->pin_d4, &driver->pin_d5, &driver->pin_d6, &driver->pin_d7,
+		&driver->pin_d8, &driver->pin_d9, &driver->pin_d10, &driver->pin_d11,
+		&driver->pin_d12, &driver->pin_d13, &driver->pin_d14, &driver->pin_d15,
+	};
+	for (size_t i = 0; i < 16; ++i) {
+		*pins[i] = i < config->bus_width ? config->data_pins[i] : -1;
+	}
+	driver->bus_width = config->bus_width;
+	driver->display_width = WIDTH;
+	driver->display_height = HEIGHT;
+	CHECK_EQ(ili9481_init(driver), ESP_OK);
+}
+
+
+// Caller memory in FIFO order, bus without DMA writes same data in bus order
+static void write_dma(ili9481_driver_t *driver, const uint8_t *data, size_t length, uint32_t caps) {
+	uint8_t *buffer = (uint8_t *)heap_caps_malloc(length, caps);
+	memcpy(buffer, data, length);
+	const esp_err_t ret = ili9481_prepare_dma(driver, buffer, length);
+	if (ret == ESP_ERR_NOT_SUPPORTED) {
+		ili9481_write_data(driver, data, length);
+	}
+	else {
+		CHECK_EQ(ret, ESP_OK);
+		CHECK_EQ(ili9481_write_dma(driver, buffer, length), ESP_OK);
+		ili9481_wait_until_queue_empty(driver);
+	}
+	heap_caps_free(buffer);
+}
+
+
+// Returns number of strobes
+static size_t draw(const ili9481_bus_t *bus, const pin_config_t *config, uint32_t *strobes) {
+	ili9481_driver_t driver;
+	init_driver(&driver, bus, config);
+	const bool dma = bus == &ili9481_bus_i2s;
+	if (dma) {
+		host_i2s_start_dma(&I2S1, DMA_STEP);
+	}
+	host_gpio_record(strobes, MAX_STROBES);
+
+	// Longer than both bounce buffers, odd lengths leave bytes for GPIO
+	static uint8_t pixels[3 * I2S_DMA_MAX_LENGTH * 2 + 998];
+	random_seed(23);
+	for (size_t i = 0; i < sizeof(pixels); ++i) {
+		pixels[i] = random_next();
+	}
+	const uint8_t formats[2] = {ILI9481_PIXEL_FORMAT_16, ILI9481_PIXEL_FORMAT_18};
+	for (size_t i = 0; i < (config->bus_width == 16 ? 1 : 2); ++i) {
+		ili9481_set_pixel_format(&driver, formats[i]);
+		ili9481_fill_area(&driver, ili9481_rgb_to_color(200, 100, 50), 3, 7, 140, 90);
+		ili9481_set_window(&driver, 0, 100, WIDTH - 1, HEIGHT - 1);
+		ili9481_write_data(&driver, pixels, 998 - i * 3);
+		ili9481_write_data(&driver, pixels, sizeof(pixels) - (sizeof(pixels) % 2));
+		ili9481_set_window(&driver, 0, 0, WIDTH - 1, HEIGHT - 1);
+		// Internal memory is sent by DMA directly, other memory through bounce buffers
+		write_dma(&driver, pixels, 4096, MALLOC_CAP_DMA);
+		write_dma(&driver, pixels + 4096, I2S_DMA_MAX_LENGTH * 2 + 12, MALLOC_CAP_DMA);
+		write_dma(&driver, pixels + 100, I2S_DMA_MAX_LENGTH * 3 + 8, MALLOC_CAP_SPIRAM);
+		// Command right after DMA data
+		ili9481_write_command(&driver, ILI9481_WRITE_MEMORY_CONTINUE);
+		ili9481_write_data(&driver, pixels, 400);
+		ili9481_write_command(&driver, ILI9481_WRITE_MEMORY_CONTINUE);
+		ili9481_write_data(&driver, pixels, 6);
+	}
+	ili9481_wait_until_queue_empty(&driver);
+	const size_t count = host_gpio_get_strobes();
+	CHECK(count < MAX_STROBES);
+	if (dma) {
+		host_i2s_stop_dma(&I2S1);
+		host_i2s_stats_t stats;
+		host_i2s_get_stats(&I2S1, &stats);
+		CHECK(stats.starts > 0);
+		CHECK_EQ(stats.owner_errors, 0);
+		CHECK_EQ(stats.detached_bytes, 0);
+	}
+	ili9481_deinit(&driver);
+	return count;
+}
+
+
+static void test_same_strobes(const pin_config_t *config) {
+	static uint32_t reg_strobes[MAX_STROBES];
+	static uint32_t i2s_strobes[MAX_STROBES];
+	const size_t count = draw(&ili9481_bus_reg, config, reg_strobes);
+	CHECK(count > 0);
+	CHECK_EQ(draw(&ili9481_bus_i2s, config, i2s_strobes), count);
+	for (size_t i = 0; i < count; ++i) {
+		CHECK_EQ(i2s_strobes[i], reg_strobes[i]);
+	}
+}
+
+
+int main(void) {
+	random_seed(23);
+	test_build_chain();
+	test_fifo_order(8);
+	test_fifo_order(16);
+	test_invalid();
+	for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); ++i) {
+		test_same_strobes(&configs[i]);
+	}
+	return 0;
+}
@@ -0,0 +1,284 @@
+// SPDX-License-Identifier: MIT
+// Transaction queue of I2S driver with interrupt stepped by test and with
+// DMA in background thread. Transactions must finish in order of enqueue,
+// every byte must reach the bus and DMA must continue to next transaction
+// without stop.
+
+#include <string.h>
+
+#include "ili9481_i2s.h"
+#include "esp_heap_caps.h"
+#include "host_gpio.h"
+#include "host_i2s.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "test.h"
+
+
+#define PIN_WR 4
+#define QUEUE_SIZE 3
+#define SLOTS 8 // Transactions owned by test, more than queue holds
+#define MAX_LENGTH (I2S_DMA_MAX_LENGTH * 2)
+#define TRANSACTIONS 300
+#define MAX_STROBES (TRANSACTIONS * MAX_LENGTH)
+#define MAX_EVENTS (TRANSACTIONS * 2)
+
+
+typedef struct slot {
+	i2s_transaction_t transaction;
+	uint8_t *data;
+} slot_t;
+
+typedef struct queue_test {
+	slot_t slots[SLOTS];
+	uint8_t *expected; // Bus order bytes of enqueued transactions
+	size_t expected_length;
+	uint32_t *strobes;
+	uint32_t enqueued;
+	volatile uint32_t finished;
+} queue_test_t;
+
+
+static int events[MAX_EVENTS]; // Callbacks, pre_cb as sequence number, post_cb as -1 - sequence number
+static size_t event_count;
+
+
+static void pre_cb(i2s_transaction_t *transaction) {
+	CHECK(event_count < MAX_EVENTS);
+	events[event_count++] = (int)(intptr_t)transaction->user_data;
+}
+
+
+static void post_cb(i2s_transaction_t *transaction) {
+	CHECK(event_count < MAX_EVENTS);
+	events[event_count++] = -1 - (int)(intptr_t)transaction->user_data;
+}
+
+
+static void init_test(queue_test_t *test, transaction_cb_t pre, transaction_cb_t post) {
+	host_gpio_bus_t gpio_bus = {
+		.pin_wr = PIN_WR,
+		.pin_dc = -1,
+		.width = 8,
+	};
+	i2s_driver_config_t config = {
+		.queue_size = QUEUE_SIZE,
+		.pre_cb = pre,
+		.post_cb = post,
+		.max_transfer_size = MAX_LENGTH,
+		.data_bits = 8,
+		.pin_wr = PIN_WR,
+	};
+	for (int i = 0; i < 8; ++i) {
+		gpio_bus.data_pins[i] = config.pin_data[i] = 12 + i;
+	}
+	host_gpio_reset(&gpio_bus);
+	host_i2s_reset();
+	CHECK_EQ(i2s_init(&I2S1, &config), ESP_OK);
+
+	memset(test, 0, sizeof(*test));
+	for (size_t i = 0; i < SLOTS; ++i) {
+		test->slots[i].data = (uint8_t *)heap_caps_malloc(MAX_LENGTH, MALLOC_CAP_DMA);
+		CHECK(test->slots[i].data != NULL);
+	}
+	test->expected = (uint8_t *)malloc(MAX_STROBES);
+	test->strobes = (uint32_t *)malloc(MAX_STROBES * sizeof(uint32_t));
+	host_gpio_record(test->strobes, MAX_STROBES);
+	event_count = 0;
+}
+
+
+static void finish_test(queue_test_t *test) {
+	CHECK_EQ(host_gpio_get_strobes(), test->expected_length);
+	for (size_t i = 0; i < test->expected_length; ++i) {
+		CHECK_EQ(test->strobes[i], test->expected[i]);
+	}
+	i2s_deinit(&I2S1);
+	for (size_t i = 0; i < SLOTS; ++i) {
+		heap_caps_free(test->slots[i].data);
+	}
+	free(test->expected);
+	free(test->strobes);
+}
+
+
+// Transaction of random length with sequence number in user_data, slot
+// can't be in use, because queue holds fewer transactions than there are
+// slots
+static i2s_transaction_t *prepare(queue_test_t *test) {
+	slot_t *slot = &test->slots[test->enqueued % SLOTS];
+	const size_t length = 4 * (1 + random_next() % (MAX_LENGTH / 4));
+	for (size_t i = 0; i < length; ++i) {
+		slot->data[i] = random_next();
+	}
+	memcpy(test->expected + test->expected_length, slot->data, length);
+	i2s_swap_halfwords(slot->data, length);
+	slot->transaction.data = slot->data;
+	slot->transaction.length = length;
+	slot->transaction.user_data = (void *)(intptr_t)test->enqueued;
+	slot->transaction.desc = NULL;
+	return &slot->transaction;
+}
+
+
+static esp_err_t enqueue(queue_test_t *test, TickType_t ticks_to_wait) {
+	i2s_transaction_t *transaction = prepare(test);
+	const esp_err_t ret = i2s_trans_enqueue(&I2S1, transaction, ticks_to_wait);
+	if (ret == ESP_OK) {
+		test->expected_length += transaction->length;
+		test->enqueued++;
+	}
+	return ret;
+}
+
+
+// Results come in order of enqueue
+static bool collect(queue_test_t *test, TickType_t ticks_to_wait) {
+	i2s_transaction_t *done;
+	if (i2s_trans_get_result(&I2S1, &done, ticks_to_wait) != ESP_OK) {
+		return false;
+	}
+	CHECK_EQ((intptr_t)done->user_data, test->finished);
+	slot_t *slot = &test->slots[test->finished % SLOTS];
+	CHECK(done == &slot->transaction);
+	test->finished++;
+	return true;
+}
+
+
+// CPU enqueues and collects between random DMA steps and interrupts, queue
+// is full after queue_size transactions besides one on bus, finished
+// transactions occupy queue until their results are retrieved. DMA stops only
+// after all enqueued data or when transaction was linked after DMA fetched
+// end of chain, interrupt restarts DMA then.
+static void test_stepped(void) {
+	static queue_test_t test;
+	init_test(&test, pre_cb, NULL);
+	uint32_t linked = 0;
+	uint32_t late = 0;
+	uint32_t starts = 0;
+	bool restart = false;
+	host_i2s_stats_t stats;
+	while (test.finished < TRANSACTIONS) {
+		const uint32_t action = random_next() % 4;
+		if (action == 0 && test.enqueued < TRANSACTIONS) {
+			const bool active = host_i2s_is_active(&I2S1);
+			const bool stopped = I2S1.int_raw.out_total_eof;
+			const esp_err_t ret = enqueue(&test, 0);
+			if (ret == ESP_ERR_TIMEOUT) {
+				CHECK_EQ(test.enqueued - test.finished, QUEUE_SIZE + 1);
+			}
+			else {
+				CHECK_EQ(ret, ESP_OK);
+				CHECK(test.enqueued - test.finished <= QUEUE_SIZE + 1);
+				linked += active;
+				late += stopped;
+				starts += !active && !stopped;
+				restart |= stopped;
+				CHECK(host_i2s_is_active(&I2S1) != restart);
+			}
+		}
+		else if (action == 1) {
+			while (collect(&test, 0));
+		}
+		else if (action == 2) {
+			host_i2s_run(&I2S1, 4 * (1 + random_next() % 1024));
+		}
+		else {
+			host_i2s_interrupt(&I2S1);
+			starts += restart;
+			restart = false;
+		}
+		host_i2s_get_stats(&I2S1, &stats);
+		if (stats.bytes < test.expected_length && !restart) {
+			CHECK(host_i2s_is_active(&I2S1));
+		}
+	}
+	CHECK(linked > 0);
+	CHECK(late > 0);
+	CHECK(!host_i2s_is_active(&I2S1));
+	host_i2s_interrupt(&I2S1);
+	i2s_wait_idle(&I2S1);
+	CHECK_EQ(event_count, TRANSACTIONS);
+	for (size_t i = 0; i < event_count; ++i) {
+		CHECK_EQ(events[i], i);
+	}
+	host_i2s_get_stats(&I2S1, &stats);
+	CHECK_EQ(stats.starts, starts);
+	CHECK_EQ(stats.owner_errors, 0);
+	finish_test(&test);
+}
+
+
+// Transactions are passed to DMA at enqueue, queue is sent with single DMA
+// start and post_cb replaces result queue
+static void test_callbacks(void) {
+	static queue_test_t test;
+	init_test(&test, pre_cb, post_cb);
+	for (int i = 0; i < QUEUE_SIZE + 1; ++i) {
+		CHECK_EQ(enqueue(&test, 0), ESP_OK);
+	}
+	CHECK_EQ(enqueue(&test, 0), ESP_ERR_TIMEOUT);
+	i2s_transaction_t *done;
+	CHECK_EQ(i2s_trans_get_result(&I2S1, &done, 0), ESP_ERR_INVALID_STATE);
+	while (host_i2s_is_active(&I2S1)) {
+		host_i2s_run(&I2S1, 256);
+		host_i2s_interrupt(&I2S1);
+	}
+	static const int order[] = {0, 1, 2, 3, -1, -2, -3, -4};
+	CHECK_EQ(event_count, sizeof(order) / sizeof(order[0]));
+	for (size_t i = 0; i < event_count; ++i) {
+		CHECK_EQ(events[i], order[i]);
+	}
+	host_i2s_stats_t stats;
+	host_i2s_get_stats(&I2S1, &stats);
+	CHECK_EQ(stats.starts, 1);
+	i2s_wait_idle(&I2S1);
+	CHECK_EQ(enqueue(&test, 0), ESP_OK);
+	CHECK(host_i2s_is_active(&I2S1));
+	while (host_i2s_is_active(&I2S1)) {
+		host_i2s_run(&I2S1, 256);
+		host_i2s_interrupt(&I2S1);
+	}
+	finish_test(&test);
+}
+
+
+static void collect_task(void *arg) {
+	queue_test_t *test = (queue_test_t *)arg;
+	while (test->finished < TRANSACTIONS) {
+		CHECK(collect(test, portMAX_DELAY));
+	}
+	vTaskDelete(NULL);
+}
+
+
+// DMA and interrupt on other thread, enqueue blocks until results are
+// retrieved by other task
+static void test_threaded(void) {
+	static queue_test_t test;
+	init_test(&test, NULL, NULL);
+	host_i2s_start_dma(&I2S1, 64);
+	CHECK_EQ(xTaskCreatePinnedToCore(collect_task, "collect", 4096, &test, 5, NULL, 1), pdPASS);
+	while (test.enqueued < TRANSACTIONS) {
+		CHECK_EQ(enqueue(&test, portMAX_DELAY), ESP_OK);
+	}
+	i2s_wait_idle(&I2S1);
+	while (test.finished < TRANSACTIONS) {
+		vTaskDelay(1);
+	}
+	host_i2s_stop_dma(&I2S1);
+	finish_test(&test);
+}
+
+
+int main(void) {
+	random_seed(29);
+	test_stepped();
+	test_callbacks();
+	test_threaded();
+	return 0;
+}
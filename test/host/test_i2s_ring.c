@@ -0,0 +1,358 @@
+// SPDX-License-Identifier: MIT
+// Descriptor ring of I2S driver. Ownership races between DMA, interrupt and
+// CPU are replayed step by step, stress run streams with DMA in background
+// thread. Every submitted byte must reach the bus once and in order.
+
+#include <stdint.h>
+#include <string.h>
+
+#include "ili9481.h"
+#include "ili9481_i2s.h"
+#include "esp_heap_caps.h"
+#include "host_gpio.h"
+#include "host_i2s.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "test.h"
+
+
+#define PIN_WR 4
+#define DESC_COUNT 4
+#define BUFFER_SIZE 64
+#define STRESS_BUFFERS 3000
+#define MAX_STROBES (STRESS_BUFFERS * BUFFER_SIZE)
+#define WIDTH 320
+#define HEIGHT 480
+
+
+typedef struct stream {
+	uint8_t *expected; // Bus order bytes of submitted buffers
+	size_t length;
+	uint32_t *strobes;
+} stream_t;
+
+
+static void init_stream(stream_t *stream) {
+	host_gpio_bus_t gpio_bus = {
+		.pin_wr = PIN_WR,
+		.pin_dc = -1,
+		.width = 8,
+	};
+	i2s_driver_config_t config = {
+		.queue_size = 2,
+		.max_transfer_size = I2S_DMA_MAX_LENGTH,
+		.data_bits = 8,
+		.pin_wr = PIN_WR,
+	};
+	for (int i = 0; i < 8; ++i) {
+		gpio_bus.data_pins[i] = config.pin_data[i] = 12 + i;
+	}
+	host_gpio_reset(&gpio_bus);
+	host_i2s_reset();
+	CHECK_EQ(i2s_init(&I2S1, &config), ESP_OK);
+
+	stream->expected = (uint8_t *)malloc(MAX_STROBES);
+	stream->strobes = (uint32_t *)malloc(MAX_STROBES * sizeof(uint32_t));
+	stream->length = 0;
+	host_gpio_record(stream->strobes, MAX_STROBES);
+}
+
+
+static void finish_stream(stream_t *stream) {
+	CHECK_EQ(host_gpio_get_strobes(), stream->length);
+	for (size_t i = 0; i < stream->length; ++i) {
+		CHECK_EQ(stream->strobes[i], stream->expected[i]);
+	}
+	i2s_deinit(&I2S1);
+	free(stream->expected);
+	free(stream->strobes);
+}
+
+
+static void start_ring(size_t prefill) {
+	const i2s_ring_config_t config = {
+		.desc_count = DESC_COUNT,
+		.buffer_size = BUFFER_SIZE,
+		.prefill = prefill,
+	};
+	CHECK_EQ(i2s_ring_start(&I2S1, &config), ESP_OK);
+}
+
+
+// Returns false if no buffer is free
+static bool submit(stream_t *stream, TickType_t ticks_to_wait) {
+	uint8_t *buffer = i2s_ring_get_buffer(&I2S1, ticks_to_wait);
+	if (buffer == NULL) {
+		return false;
+	}
+	const size_t length = 4 * (1 + random_next() % (BUFFER_SIZE / 4));
+	for (size_t i = 0; i < length; ++i) {
+		buffer[i] = random_next();
+	}
+	memcpy(stream->expected + stream->length, buffer, length);
+	stream->length += length;
+	i2s_swap_halfwords(buffer, length);
+	i2s_ring_submit(&I2S1, length);
+	return true;
+}
+
+
+// Free descriptors, ring is left with all of them submitted
+static size_t count_free(stream_t *stream) {
+	size_t count = 0;
+	while (submit(stream, 0)) {
+		count++;
+	}
+	return count;
+}
+
+
+static host_i2s_stats_t get_stats(void) {
+	host_i2s_stats_t stats;
+	host_i2s_get_stats(&I2S1, &stats);
+	return stats;
+}
+
+
+static void run_all(void) {
+	for (int step = 0; step < 1000 && host_i2s_is_active(&I2S1); ++step) {
+		host_i2s_run(&I2S1, SIZE_MAX);
+		host_i2s_interrupt(&I2S1);
+	}
+	CHECK(!host_i2s_is_active(&I2S1));
+}
+
+
+// Buffer submitted after DMA found its descriptor owned by CPU, but before
+// interrupt handled the stall, is started by interrupt
+static void test_submit_before_interrupt(void) {
+	static stream_t stream;
+	init_stream(&stream);
+	start_ring(1);
+	CHECK(submit(&stream, 0));
+	CHECK(host_i2s_is_active(&I2S1));
+	host_i2s_run(&I2S1, SIZE_MAX);
+	CHECK(!host_i2s_is_active(&I2S1));
+	CHECK_EQ(get_stats().owner_errors, 1);
+
+	// Ring still runs for CPU, submit doesn't restart DMA
+	CHECK(submit(&stream, 0));
+	CHECK(!host_i2s_is_active(&I2S1));
+	CHECK(host_i2s_interrupt(&I2S1));
+	CHECK(host_i2s_is_active(&I2S1));
+	run_all();
+	CHECK_EQ(get_stats().starts, 2);
+	CHECK_EQ(get_stats().descriptors, 2);
+
+	i2s_ring_stop(&I2S1);
+	finish_stream(&stream);
+}
+
+
+// Buffer submitted after interrupt handled the stall restarts DMA itself
+static void test_submit_after_interrupt(void) {
+	static stream_t stream;
+	init_stream(&stream);
+	start_ring(1);
+	CHECK(submit(&stream, 0));
+	run_all();
+	CHECK_EQ(count_free(&stream), DESC_COUNT);
+	CHECK(host_i2s_is_active(&I2S1));
+	run_all();
+	CHECK_EQ(get_stats().starts, 2);
+	CHECK_EQ(get_stats().descriptors, DESC_COUNT + 1);
+	i2s_ring_stop(&I2S1);
+	finish_stream(&stream);
+}
+
+
+// Interrupt handled after several descriptors returns all of them, but not
+// the one being sent
+static void test_merged_eof(void) {
+	static stream_t stream;
+	init_stream(&stream);
+	start_ring(1);
+	CHECK_EQ(count_free(&stream), DESC_COUNT);
+	CHECK_EQ(count_free(&stream), 0);
+	// Two descriptors and first word of third one
+	while (get_stats().descriptors < 2) {
+		host_i2s_run(&I2S1, 4);
+	}
+	host_i2s_run(&I2S1, 4);
+	CHECK_EQ(get_stats().descriptors, 2);
+	CHECK(host_i2s_interrupt(&I2S1));
+	CHECK_EQ(count_free(&stream), 2);
+	run_all();
+	CHECK_EQ(get_stats().owner_errors, 1);
+	i2s_ring_stop(&I2S1);
+	finish_stream(&stream);
+}
+
+
+// DMA waits for prefill before first start and after every stall
+static void test_prefill(void) {
+	static stream_t stream;
+	init_stream(&stream);
+	start_ring(3);
+	CHECK(submit(&stream, 0));
+	CHECK(submit(&stream, 0));
+	CHECK(!host_i2s_is_active(&I2S1));
+	CHECK(submit(&stream, 0));
+	CHECK(host_i2s_is_active(&I2S1));
+	run_all();
+	CHECK(submit(&stream, 0));
+	CHECK(!host_i2s_is_active(&I2S1));
+	host_i2s_start_dma(&I2S1, 16);
+	// Stop starts buffers below prefill
+	i2s_ring_stop(&I2S1);
+	host_i2s_stop_dma(&I2S1);
+	CHECK_EQ(get_stats().descriptors, 4);
+	finish_stream(&stream);
+}
+
+
+// Producer is sometimes slower than DMA, so DMA stalls and restarts, and
+// sometimes faster, so it waits for free buffers
+static void test_stress(size_t step_bytes) {
+	static stream_t stream;
+	init_stream(&stream);
+	start_ring(2);
+	host_i2s_start_dma(&I2S1, step_bytes);
+	for (int i = 0; i < STRESS_BUFFERS; ++i) {
+		CHECK(submit(&stream, portMAX_DELAY));
+		if (random_next() % 64 == 0) {
+			vTaskDelay(1);
+		}
+	}
+	i2s_ring_stop(&I2S1);
+	const host_i2s_stats_t stats = get_stats();
+	CHECK_EQ(stats.descriptors, STRESS_BUFFERS);
+	CHECK(stats.starts > 1);
+
+	// Transaction queue works again after ring
+	uint32_t *data = (uint32_t *)heap_caps_malloc(BUFFER_SIZE, MALLOC_CAP_DMA);
+	for (size_t i = 0; i < BUFFER_SIZE; ++i) {
+		stream.expected[stream.length++] = i;
+	}
+	memcpy(data, stream.expected + stream.length - BUFFER_SIZE, BUFFER_SIZE);
+	i2s_swap_halfwords(data, BUFFER_SIZE);
+	i2s_transaction_t transaction = {
+		.data = data,
+		.length = BUFFER_SIZE,
+	};
+	CHECK_EQ(i2s_trans_enqueue(&I2S1, &transaction, portMAX_DELAY), ESP_OK);
+	i2s_transaction_t *done;
+	CHECK_EQ(i2s_trans_get_result(&I2S1, &done, portMAX_DELAY), ESP_OK);
+	CHECK(done == &transaction);
+	host_i2s_stop_dma(&I2S1);
+	heap_caps_free(data);
+	finish_stream(&stream);
+}
+
+
+static void init_driver(ili9481_driver_t *driver, const ili9481_bus_t *bus) {
+	static const int data_pins[8] = {12, 13, 26, 27, 14, 22, 21, 19};
+	memset(driver, 0, sizeof(*driver));
+	host_gpio_bus_t gpio_bus = {
+		.pin_wr = 4,
+		.pin_dc = 25,
+		.width = 8,
+	};
+	memcpy(gpio_bus.data_pins, data_pins, sizeof(data_pins));
+	host_gpio_reset(&gpio_bus);
+	host_i2s_reset();
+	driver->bus = bus;
+	driver->pin_rst = -1;
+	driver->pin_rd = 2;
+	driver->pin_wr = 4;
+	driver->pin_cs = 5;
+	driver->pin_dc = 25;
+	driver->pin_d0 = data_pins[0];
+	driver->pin_d1 = data_pins[1];
+	driver->pin_d2 = data_pins[2];
+	driver->pin_d3 = data_pins[3];
+	driver->pin_d4 = data_pins[4];
+	driver->pin_d5 = data_pins[5];
+	driver->pin_d6 = data_pins[6];
+	driver->pin_d7 = data_pins[7];
+	driver->pin_d8 = driver->pin_d9 = driver->pin_d10 = driver->pin_d11 = -1;
+	driver->pin_d12 = driver->pin_d13 = driver->pin_d14 = driver->pin_d15 = -1;
+	driver->bus_width = 8;
+	driver->display_width = WIDTH;
+	driver->display_height = HEIGHT;
+	CHECK_EQ(ili9481_init(driver), ESP_OK);
+}
+
+
+// Stream of I2S bus gives same strobes as data written by reg bus
+static size_t draw_stream(const ili9481_bus_t *bus, uint32_t *strobes, size_t capacity) {
+	ili9481_driver_t driver;
+	init_driver(&driver, bus);
+	const bool dma = bus == &ili9481_bus_i2s;
+	if (dma) {
+		host_i2s_start_dma(&I2S1, 64);
+	}
+	host_gpio_record(strobes, capacity);
+	ili9481_set_pixel_format(&driver, ILI9481_PIXEL_FORMAT_16);
+	ili9481_set_window(&driver, 0, 0, WIDTH - 1, HEIGHT - 1);
+	const ili9481_stream_config_t config = {
+		.buffer_count = 3,
+		.buffer_size = 480,
+		.prefill = 2,
+	};
+	random_seed(31);
+	const esp_err_t ret = ili9481_stream_begin(&driver, &config);
+	for (int line = 0; line < 100; ++line) {
+		uint8_t data[480];
+		const size_t length = 4 * (1 + random_next() % 120);
+		for (size_t i = 0; i < length; ++i) {
+			data[i] = random_next();
+		}
+		if (ret == ESP_ERR_NOT_SUPPORTED) {
+			ili9481_write_data(&driver, data, length);
+		}
+		else {
+			CHECK_EQ(ret, ESP_OK);
+			memcpy(ili9481_stream_get_buffer(&driver), data, length);
+			ili9481_stream_submit(&driver, length);
+		}
+	}
+	if (ret == ESP_OK) {
+		ili9481_stream_end(&driver);
+	}
+	ili9481_write_command(&driver, ILI9481_NOP);
+	ili9481_wait_until_queue_empty(&driver);
+	const size_t count = host_gpio_get_strobes();
+	if (dma) {
+		host_i2s_stop_dma(&I2S1);
+	}
+	ili9481_deinit(&driver);
+	return count;
+}
+
+
+static void test_bus_stream(void) {
+	static uint32_t reg_strobes[MAX_STROBES];
+	static uint32_t i2s_strobes[MAX_STROBES];
+	const size_t count = draw_stream(&ili9481_bus_reg, reg_strobes, MAX_STROBES);
+	CHECK(count > 0 && count < MAX_STROBES);
+	CHECK_EQ(draw_stream(&ili9481_bus_i2s, i2s_strobes, MAX_STROBES), count);
+	for (size_t i = 0; i < count; ++i) {
+		CHECK_EQ(i2s_strobes[i], reg_strobes[i]);
+	}
+}
+
+
+int main(void) {
+	random_seed(31);
+	test_submit_before_interrupt();
+	test_submit_after_interrupt();
+	test_merged_eof();
+	test_prefill();
+	test_stress(4);
+	test_stress(256);
+	test_bus_stream();
+	return 0;
+}
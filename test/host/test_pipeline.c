@@ -0,0 +1,200 @@
+// SPDX-License-Identifier: MIT
+// Render and bus tasks of strip pipeline on pthreads over simulator bus.
+// Strips must reach display memory in order for every frame and with slow
+// render and slow bus both stages must overlap.
+
+#include <unistd.h>
+
+#include "ili9481.h"
+#include "ili9481_pipeline.h"
+#include "esp_timer.h"
+
+#include "sim_fixture.h"
+#include "test.h"
+
+
+#define WIDTH 64
+#define HEIGHT 60
+#define STRIP_LINES 8 // Last strip is shorter
+#define FRAMES 20
+#define SLOW_FRAMES 5
+#define SLOW_STRIP_US 2000
+
+
+typedef struct renderer {
+	uint16_t frame;
+	uint16_t next_y; // Expected start of next strip
+	uint32_t strips;
+	int64_t delay_us; // Render time per strip
+} renderer_t;
+
+
+static ili9481_bus_t slow_bus;
+static int64_t bus_delay_us; // Per strip of pixel data
+
+
+// Strips of frame are rendered from top to bottom
+static void render(ili9481_driver_t *driver, ili9481_color_t *buffer, uint16_t y, uint16_t lines, void *user_data) {
+	renderer_t *renderer = (renderer_t *)user_data;
+	CHECK_EQ(y, renderer->next_y);
+	CHECK_EQ(lines, y + STRIP_LINES <= HEIGHT ? STRIP_LINES : HEIGHT - y);
+	for (uint16_t line = 0; line < lines; ++line) {
+		for (uint16_t x = 0; x < WIDTH; ++x) {
+			buffer[line * WIDTH + x] = sim_content(x, y + line, renderer->frame);
+		}
+	}
+	renderer->strips++;
+	renderer->next_y = y + lines;
+	if (renderer->next_y >= HEIGHT) {
+		renderer->next_y = 0;
+		renderer->frame++;
+	}
+	// Sleep instead of busy wait, so stages overlap on host with single CPU
+	if (renderer->delay_us > 0) {
+		usleep(renderer->delay_us);
+	}
+}
+
+
+// Simulator bus waiting for transfer of every strip
+static void slow_write_data(ili9481_driver_t *driver, const uint8_t *data, size_t length) {
+	ili9481_bus_sim.write_data(driver, data, length);
+	if (driver->memory_write) {
+		usleep(bus_delay_us * length / (WIDTH * STRIP_LINES * 2));
+	}
+}
+
+
+static ili9481_pipeline_t *create_pipeline(ili9481_driver_t *driver, renderer_t *renderer, size_t buffer_count) {
+	const ili9481_pipeline_config_t config = {
+		.buffer_count = buffer_count,
+		.strip_lines = STRIP_LINES,
+		.render_core = 0,
+		.bus_core = 1,
+		.priority = 5,
+		.pixel_format = ILI9481_PIXEL_FORMAT_16,
+		.render = render,
+		.user_data = renderer,
+	};
+	ili9481_pipeline_t *pipeline;
+	CHECK_EQ(ili9481_pipeline_create(driver, &config, &pipeline), ESP_OK);
+	return pipeline;
+}
+
+
+static void check_frame(const ili9481_driver_t *driver, uint16_t frame) {
+	for (uint16_t y = 0; y < HEIGHT; ++y) {
+		for (uint16_t x = 0; x < WIDTH; ++x) {
+			CHECK_EQ(sim_gram_color(driver, x, y), sim_content(x, y, frame));
+		}
+	}
+}
+
+
+static void test_frames(size_t buffer_count) {
+	ili9481_driver_t driver;
+	sim_init(&driver, &ili9481_bus_sim, WIDTH, HEIGHT, ILI9481_PIXEL_FORMAT_16);
+	const ili9481_sim_t *sim = (const ili9481_sim_t *)driver.bus_data;
+	renderer_t renderer = {0};
+	ili9481_pipeline_t *pipeline = create_pipeline(&driver, &renderer, buffer_count);
+	const uint32_t strips_per_frame = (HEIGHT + STRIP_LINES - 1) / STRIP_LINES;
+
+	// Frame by frame
+	for (uint16_t frame = 0; frame < 3; ++frame) {
+		ili9481_pipeline_render_frame(pipeline);
+		ili9481_pipeline_wait_transferred(pipeline);
+		check_frame(&driver, frame);
+	}
+
+	// Frames rendered while previous ones are transferred
+	for (uint16_t frame = 3; frame < FRAMES; ++frame) {
+		ili9481_pipeline_render_frame(pipeline);
+	}
+	ili9481_pipeline_wait_transferred(pipeline);
+	check_frame(&driver, FRAMES - 1);
+	for (uint16_t y = 0; y < HEIGHT; ++y) {
+		CHECK_EQ(sim->line_generation[y], FRAMES);
+	}
+	CHECK_EQ(sim->pixels_written, (uint64_t)FRAMES * WIDTH * HEIGHT);
+
+	ili9481_pipeline_stats_t stats;
+	ili9481_pipeline_get_stats(pipeline, &stats);
+	CHECK_EQ(stats.frames, FRAMES);
+	CHECK_EQ(stats.strips, FRAMES * strips_per_frame);
+	CHECK_EQ(renderer.strips, FRAMES * strips_per_frame);
+	CHECK(stats.elapsed_us >= 0);
+	ili9481_pipeline_reset_stats(pipeline);
+	ili9481_pipeline_get_stats(pipeline, &stats);
+	CHECK_EQ(stats.frames, 0);
+	CHECK_EQ(stats.strips, 0);
+	CHECK_EQ(stats.render_busy_us, 0);
+	CHECK_EQ(stats.bus_busy_us, 0);
+
+	ili9481_pipeline_destroy(pipeline);
+	ili9481_deinit(&driver);
+}
+
+
+// Render and transfer of strip take same time, frame takes about half of
+// their sum
+static void test_overlap(void) {
+	ili9481_driver_t driver;
+	slow_bus = ili9481_bus_sim;
+	slow_bus.write_data = slow_write_data;
+	bus_delay_us = SLOW_STRIP_US;
+	sim_init(&driver, &slow_bus, WIDTH, HEIGHT, ILI9481_PIXEL_FORMAT_16);
+	renderer_t renderer = {
+		.delay_us = SLOW_STRIP_US,
+	};
+	ili9481_pipeline_t *pipeline = create_pipeline(&driver, &renderer, 3);
+	ili9481_pipeline_reset_stats(pipeline);
+	for (int frame = 0; frame < SLOW_FRAMES; ++frame) {
+		ili9481_pipeline_render_frame(pipeline);
+	}
+	ili9481_pipeline_wait_transferred(pipeline);
+	ili9481_pipeline_stats_t stats;
+	ili9481_pipeline_get_stats(pipeline, &stats);
+	check_frame(&driver, SLOW_FRAMES - 1);
+
+	const int64_t strips = stats.strips;
+	CHECK_EQ(stats.frames, SLOW_FRAMES);
+	CHECK(stats.render_busy_us >= strips * SLOW_STRIP_US);
+	CHECK(stats.bus_busy_us >= (strips - SLOW_FRAMES) * SLOW_STRIP_US);
+	CHECK(stats.elapsed_us < (stats.render_busy_us + stats.bus_busy_us) * 3 / 4);
+	printf("frame %lld us, render busy %lld us, wait %lld us, bus busy %lld us, wait %lld us\n",
+		(long long)(stats.elapsed_us / SLOW_FRAMES),
+		(long long)(stats.render_busy_us / SLOW_FRAMES),
+		(long long)(stats.render_wait_us / SLOW_FRAMES),
+		(long long)(stats.bus_busy_us / SLOW_FRAMES),
+		(long long)(stats.bus_wait_us / SLOW_FRAMES));
+	ili9481_pipeline_destroy(pipeline);
+	ili9481_deinit(&driver);
+}
+
+
+static void test_invalid(void) {
+	ili9481_driver_t driver;
+	sim_init(&driver, &ili9481_bus_sim, WIDTH, HEIGHT, ILI9481_PIXEL_FORMAT_16);
+	renderer_t renderer = {0};
+	ili9481_pipeline_config_t config = {
+		.buffer_count = 1,
+		.strip_lines = STRIP_LINES,
+		.render = render,
+		.user_data = &renderer,
+	};
+	ili9481_pipeline_t *pipeline;
+	CHECK_EQ(ili9481_pipeline_create(&driver, &config, &pipeline), ESP_ERR_INVALID_ARG);
+	config.buffer_count = 2;
+	config.strip_lines = 0;
+	CHECK_EQ(ili9481_pipeline_create(&driver, &config, &pipeline), ESP_ERR_INVALID_ARG);
+	ili9481_deinit(&driver);
+}
+
+
+int main(void) {
+	test_frames(2);
+	test_frames(4);
+	test_overlap();
+	test_invalid();
+	return 0;
+}
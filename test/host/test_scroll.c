@@ -0,0 +1,218 @@
+// SPDX-License-Identifier: MIT
+// Logical line drawing with hardware scrolling, display rows are read through
+// scroll model of simulator
+
+#include <string.h>
+
+#include "ili9481.h"
+#include "ili9481_asset.h"
+#include "ili9481_dirty.h"
+
+#include "sim_fixture.h"
+#include "test.h"
+
+
+#define WIDTH 320
+#define HEIGHT 480
+#define TOP_FIXED 40
+#define BOTTOM_FIXED 60
+
+
+// Color of pixel shown on display
+static ili9481_color_t display_color(ili9481_driver_t *driver, uint16_t x, uint16_t row) {
+	const ili9481_sim_t *sim = (const ili9481_sim_t *)driver->bus_data;
+	return sim_gram_color(driver, x, ili9481_sim_display_line(sim, row));
+}
+
+
+static void draw_lines(ili9481_driver_t *driver, uint16_t y, uint16_t height, uint16_t seed) {
+	static ili9481_color_t pixels[WIDTH * HEIGHT];
+	for (uint16_t line = 0; line < height; ++line) {
+		for (uint16_t x = 0; x < WIDTH; ++x) {
+			pixels[line * WIDTH + x] = sim_content(x, y + line, seed);
+		}
+	}
+	ili9481_draw_area(driver, 0, y, WIDTH, height, pixels);
+}
+
+
+static void check_lines(ili9481_driver_t *driver, uint16_t y, uint16_t height, uint16_t seed) {
+	for (uint16_t row = y; row < y + height; ++row) {
+		for (uint16_t x = 0; x < WIDTH; x += 7) {
+			CHECK_EQ(display_color(driver, x, row), sim_content(x, row, seed));
+		}
+	}
+}
+
+
+static void test_scroll_model(void) {
+	ili9481_driver_t driver;
+	sim_init(&driver, &ili9481_bus_sim, WIDTH, HEIGHT, ILI9481_PIXEL_FORMAT_16);
+	const ili9481_sim_t *sim = (const ili9481_sim_t *)driver.bus_data;
+	CHECK_EQ(ili9481_set_scroll_area(&driver, TOP_FIXED, BOTTOM_FIXED), ESP_OK);
+	CHECK_EQ(sim->scroll_top, TOP_FIXED);
+	CHECK_EQ(sim->scroll_height, HEIGHT - TOP_FIXED - BOTTOM_FIXED);
+	CHECK_EQ(sim->scroll_start, TOP_FIXED);
+
+	// Every row of simulator matches mapping of driver
+	uint16_t exposed_y;
+	uint16_t exposed_height;
+	const int steps[] = {1, 100, -37, 379, -380, 200};
+	for (size_t i = 0; i < sizeof(steps) / sizeof(steps[0]); ++i) {
+		ili9481_scroll(&driver, steps[i], &exposed_y, &exposed_height);
+		for (uint16_t row = 0; row < HEIGHT; ++row) {
+			CHECK_EQ(ili9481_sim_display_line(sim, row), ili9481_scroll_map_line(&driver, row));
+		}
+	}
+	ili9481_deinit(&driver);
+}
+
+
+static void test_scroll_exposed(void) {
+	ili9481_driver_t driver;
+	sim_init(&driver, &ili9481_bus_sim, WIDTH, HEIGHT, ILI9481_PIXEL_FORMAT_16);
+	CHECK_EQ(ili9481_set_scroll_area(&driver, TOP_FIXED, BOTTOM_FIXED), ESP_OK);
+	draw_lines(&driver, 0, HEIGHT, 0);
+	check_lines(&driver, 0, HEIGHT, 0);
+
+	const uint16_t area = HEIGHT - TOP_FIXED - BOTTOM_FIXED;
+	const int steps[] = {50, -13, 211, -379};
+	for (size_t i = 0; i < sizeof(steps) / sizeof(steps[0]); ++i) {
+		const int lines = steps[i];
+		uint16_t exposed_y;
+		uint16_t exposed_height;
+		ili9481_scroll(&driver, lines, &exposed_y, &exposed_height);
+		CHECK_EQ(exposed_height, lines > 0 ? lines : -lines);
+
+		// Content moved by lines, except exposed lines
+		for (uint16_t row = TOP_FIXED; row < TOP_FIXED + area; ++row) {
+			if (row >= exposed_y && row < exposed_y + exposed_height) {
+				continue;
+			}
+			const uint16_t old_row = row + lines;
+			for (uint16_t x = 0; x < WIDTH; x += 13) {
+				CHECK_EQ(display_color(&driver, x, row), sim_content(x, old_row, i));
+			}
+		}
+		check_lines(&driver, 0, TOP_FIXED, i);
+		check_lines(&driver, TOP_FIXED + area, BOTTOM_FIXED, i);
+
+		// Whole screen drawn in logical lines is shown unchanged
+		draw_lines(&driver, 0, HEIGHT, i + 1);
+		check_lines(&driver, 0, HEIGHT, i + 1);
+	}
+	ili9481_deinit(&driver);
+}
+
+
+static void test_fill_across_wrap(void) {
+	ili9481_driver_t driver;
+	sim_init(&driver, &ili9481_bus_sim, WIDTH, HEIGHT, ILI9481_PIXEL_FORMAT_16);
+	CHECK_EQ(ili9481_set_scroll_area(&driver, TOP_FIXED, BOTTOM_FIXED), ESP_OK);
+	ili9481_clear(&driver, 0x0000);
+	uint16_t exposed_y;
+	uint16_t exposed_height;
+	ili9481_scroll(&driver, 123, &exposed_y, &exposed_height);
+
+	// Area covers fixed top, both parts of scroll area and fixed bottom
+	const ili9481_color_t color = ili9481_rgb_to_color(255, 128, 0);
+	ili9481_fill_area(&driver, color, 10, 20, 30, 450);
+	for (uint16_t row = 0; row < HEIGHT; ++row) {
+		for (uint16_t x = 0; x < 50; ++x) {
+			const bool inside = x >= 10 && x < 40 && row >= 20 && row < 470;
+			CHECK_EQ(display_color(&driver, x, row), inside ? color : 0);
+		}
+	}
+	ili9481_deinit(&driver);
+}
+
+
+static void render_content(ili9481_driver_t *driver, ili9481_color_t *buffer, uint16_t x, uint16_t y, uint16_t width, uint16_t lines, void *user_data) {
+	const uint16_t seed = *(const uint16_t *)user_data;
+	for (uint16_t line = 0; line < lines; ++line) {
+		for (uint16_t column = 0; column < width; ++column) {
+			buffer[line * width + column] = sim_content(x + column, y + line, seed);
+		}
+	}
+}
+
+
+static void test_dirty_across_wrap(void) {
+	ili9481_driver_t driver;
+	sim_init(&driver, &ili9481_bus_sim, WIDTH, HEIGHT, ILI9481_PIXEL_FORMAT_16);
+	CHECK_EQ(ili9481_set_scroll_area(&driver, TOP_FIXED, BOTTOM_FIXED), ESP_OK);
+	uint16_t exposed_y;
+	uint16_t exposed_height;
+	ili9481_scroll(&driver, 200, &exposed_y, &exposed_height);
+	draw_lines(&driver, 0, HEIGHT, 0);
+
+	uint16_t seed = 1;
+	const ili9481_dirty_config_t config = {
+		.window_cost = 64,
+		.buffer_pixels = WIDTH * 3,
+		.render = render_content,
+		.user_data = &seed,
+	};
+	ili9481_dirty_t *dirty;
+	CHECK_EQ(ili9481_dirty_create(&driver, &config, &dirty), ESP_OK);
+	ili9481_dirty_invalidate(dirty, 0, 150, WIDTH, 100);
+	ili9481_dirty_report_t report;
+	ili9481_dirty_flush(dirty, &report);
+	CHECK_EQ(report.pixels, WIDTH * 100);
+	CHECK_EQ(report.rects, 2);
+
+	check_lines(&driver, 0, 150, 0);
+	check_lines(&driver, 150, 100, 1);
+	check_lines(&driver, 250, HEIGHT - 250, 0);
+	ili9481_dirty_destroy(dirty);
+	ili9481_deinit(&driver);
+}
+
+
+static void test_asset_across_wrap(void) {
+	ili9481_driver_t driver;
+	sim_init(&driver, &ili9481_bus_sim, WIDTH, HEIGHT, ILI9481_PIXEL_FORMAT_16);
+	CHECK_EQ(ili9481_set_scroll_area(&driver, TOP_FIXED, BOTTOM_FIXED), ESP_OK);
+	ili9481_clear(&driver, 0x0000);
+	uint16_t exposed_y;
+	uint16_t exposed_height;
+	ili9481_scroll(&driver, -75, &exposed_y, &exposed_height);
+
+	enum { ASSET_WIDTH = 24, ASSET_HEIGHT = 40, ASSET_X = 100, ASSET_Y = 80 };
+	static uint8_t asset[ILI9481_ASSET_HEADER_SIZE + ASSET_WIDTH * ASSET_HEIGHT * 2];
+	const ili9481_asset_header_t header = {
+		.magic = ILI9481_ASSET_MAGIC,
+		.width = ASSET_WIDTH,
+		.height = ASSET_HEIGHT,
+		.pixel_format = ILI9481_PIXEL_FORMAT_16,
+		.size = ASSET_WIDTH * ASSET_HEIGHT * 2,
+	};
+	memcpy(asset, &header, sizeof(header));
+	uint8_t *pixels = asset + ILI9481_ASSET_HEADER_SIZE;
+	for (uint16_t y = 0; y < ASSET_HEIGHT; ++y) {
+		for (uint16_t x = 0; x < ASSET_WIDTH; ++x) {
+			const ili9481_color_t color = sim_content(x, y, 2);
+			*pixels++ = color >> 8;
+			*pixels++ = color & 0xff;
+		}
+	}
+	CHECK_EQ(ili9481_draw_asset(&driver, asset, sizeof(asset), ASSET_X, ASSET_Y), ESP_OK);
+
+	for (uint16_t row = ASSET_Y - 5; row < ASSET_Y + ASSET_HEIGHT + 5; ++row) {
+		for (uint16_t x = ASSET_X - 2; x < ASSET_X + ASSET_WIDTH + 2; ++x) {
+			const bool inside = x >= ASSET_X && x < ASSET_X + ASSET_WIDTH && row >= ASSET_Y && row < ASSET_Y + ASSET_HEIGHT;
+			CHECK_EQ(display_color(&driver, x, row), inside ? sim_content(x - ASSET_X, row - ASSET_Y, 2) : 0);
+		}
+	}
+	ili9481_deinit(&driver);
+}
+
+
+int main(void) {
+	test_scroll_model();
+	test_scroll_exposed();
+	test_fill_across_wrap();
+	test_dirty_across_wrap();
+	test_asset_across_wrap();
+	return 0;
+}
@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: MIT
+// Drawing API over simulator bus, checked against simulated GRAM
+
+#include <string.h>
+
+#include "ili9481.h"
+
+#include "sim_fixture.h"
+#include "test.h"
+
+
+#define WIDTH 320
+#define HEIGHT 480
+
+
+static void test_device_code(void) {
+	ili9481_driver_t driver;
+	sim_init(&driver, &ili9481_bus_sim, WIDTH, HEIGHT, ILI9481_PIXEL_FORMAT_18);
+	uint8_t code[7]; // Dummy byte first
+	ili9481_write_command(&driver, ILI9481_DEVICE_CODE_READ);
+	ili9481_read_data(&driver, code, sizeof(code));
+	CHECK_EQ(code[4], 0x94);
+	CHECK_EQ(code[5], 0x81);
+	ili9481_deinit(&driver);
+}
+
+
+static void test_fill_area(uint8_t pixel_format) {
+	ili9481_driver_t driver;
+	sim_init(&driver, &ili9481_bus_sim, WIDTH, HEIGHT, pixel_format);
+	const ili9481_color_t color = ili9481_rgb_to_color(200, 100, 50);
+	ili9481_clear(&driver, 0x0000);
+	ili9481_fill_area(&driver, color, 10, 20, 30, 40);
+	for (uint16_t y = 0; y < 80; ++y) {
+		for (uint16_t x = 0; x < 60; ++x) {
+			const bool inside = x >= 10 && x < 40 && y >= 20 && y < 60;
+			CHECK_EQ(sim_gram_color(&driver, x, y), inside ? color : 0);
+		}
+	}
+	ili9481_deinit(&driver);
+}
+
+
+static void test_draw_and_read(uint8_t pixel_format) {
+	ili9481_driver_t driver;
+	sim_init(&driver, &ili9481_bus_sim, WIDTH, HEIGHT, pixel_format);
+	enum { AREA_WIDTH = 37, AREA_HEIGHT = 11 };
+	static ili9481_color_t pixels[AREA_WIDTH * AREA_HEIGHT];
+	static ili9481_color_t read[AREA_WIDTH * AREA_HEIGHT];
+	for (size_t i = 0; i < AREA_WIDTH * AREA_HEIGHT; ++i) {
+		pixels[i] = (ili9481_color_t)(i * 2654435761U >> 16);
+	}
+	ili9481_draw_area(&driver, 100, 200, AREA_WIDTH, AREA_HEIGHT, pixels);
+	ili9481_read_pixels(&driver, 100, 200, AREA_WIDTH, AREA_HEIGHT, read);
+	CHECK(memcmp(pixels, read, sizeof(pixels)) == 0);
+	for (size_t i = 0; i < AREA_WIDTH * AREA_HEIGHT; ++i) {
+		CHECK_EQ(sim_gram_color(&driver, 100 + i % AREA_WIDTH, 200 + i / AREA_WIDTH), pixels[i]);
+	}
+	ili9481_deinit(&driver);
+}
+
+
+static void test_command_list(void) {
+	ili9481_driver_t driver;
+	sim_init(&driver, &ili9481_bus_sim, WIDTH, HEIGHT, ILI9481_PIXEL_FORMAT_18);
+	const ili9481_command_t sequence[] = {
+		{ILI9481_SET_ADDRESS_MODE, 0, 1, (const uint8_t *)"\x40"},
+		{ILI9481_SET_PIXEL_FORMAT, 0, 1, (const uint8_t *)"\x55"},
+		{ILI9481_SET_DISPLAY_ON, 1, 0, NULL},
+		{ILI9481_CMDLIST_END, 0, 0, NULL},
+	};
+	ili9481_run_commands(&driver, sequence);
+	CHECK_EQ(driver.pixel_format, ILI9481_PIXEL_FORMAT_16);
+
+	uint8_t format[2];
+	ili9481_write_command(&driver, ILI9481_GET_PIXEL_FORMAT);
+	ili9481_read_data(&driver, format, sizeof(format));
+	CHECK_EQ(format[1], 0x55);
+
+	// Pixels after command list use tracked format
+	const ili9481_color_t color = ili9481_rgb_to_color(0, 255, 0);
+	ili9481_fill_area(&driver, color, 0, 0, 4, 4);
+	CHECK_EQ(sim_gram_color(&driver, 3, 3), color);
+	ili9481_deinit(&driver);
+}
+
+
+int main(void) {
+	test_device_code();
+	test_fill_area(ILI9481_PIXEL_FORMAT_16);
+	test_fill_area(ILI9481_PIXEL_FORMAT_18);
+	test_draw_and_read(ILI9481_PIXEL_FORMAT_16);
+	test_draw_and_read(ILI9481_PIXEL_FORMAT_18);
+	test_command_list();
+	return 0;
+}
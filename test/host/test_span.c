@@ -0,0 +1,312 @@
+// SPDX-License-Identifier: MIT
+// Span kernels against scalar per-pixel loops at every alignment, followed by
+// throughput of both on host
+
+#include <string.h>
+#include <time.h>
+
+#include "ili9481_span.h"
+
+#include "test.h"
+
+
+#define MAX_PIXELS 67
+#define ALPHA_TARGET_W 16
+#define ALPHA_TARGET_H 12
+#define BENCH_PIXELS 4096
+#define BENCH_ROUNDS 2000
+
+
+static void scalar_pack16(uint8_t *dst, const ili9481_color_t *src, size_t count) {
+	for (size_t i = 0; i < count; ++i) {
+		*dst++ = src[i] >> 8;
+		*dst++ = src[i] & 0xff;
+	}
+}
+
+
+static void scalar_pack18(uint8_t *dst, const ili9481_color_t *src, size_t count) {
+	for (size_t i = 0; i < count; ++i) {
+		*dst++ = (src[i] >> 8) & 0xf8;
+		*dst++ = (src[i] >> 3) & 0xfc;
+		*dst++ = (src[i] << 3) & 0xf8;
+	}
+}
+
+
+static ili9481_color_t scalar_mix(ili9481_color_t dst, ili9481_color_t src, uint32_t alpha) {
+	const uint32_t r = (((src >> 11) & 0x1f) * alpha + ((dst >> 11) & 0x1f) * (32 - alpha)) >> 5;
+	const uint32_t g = (((src >> 5) & 0x3f) * alpha + ((dst >> 5) & 0x3f) * (32 - alpha)) >> 5;
+	const uint32_t b = ((src & 0x1f) * alpha + (dst & 0x1f) * (32 - alpha)) >> 5;
+	return (r << 11) | (g << 5) | b;
+}
+
+
+static void scalar_blend(ili9481_color_t *dst, const ili9481_color_t *src, uint8_t alpha, size_t count) {
+	const uint32_t alpha5 = (alpha + 4) >> 3;
+	for (size_t i = 0; i < count; ++i) {
+		dst[i] = scalar_mix(dst[i], src[i], alpha5);
+	}
+}
+
+
+static void test_pack_and_fill(void) {
+	ili9481_color_t src[MAX_PIXELS + 2] __attribute__((aligned(4)));
+	uint8_t actual[MAX_PIXELS * 3 + 8] __attribute__((aligned(4)));
+	uint8_t expected[MAX_PIXELS * 3 + 8] __attribute__((aligned(4)));
+	ili9481_color_t same[MAX_PIXELS];
+	for (size_t i = 0; i < MAX_PIXELS + 2; ++i) {
+		src[i] = random_next();
+	}
+
+	for (size_t dst_offset = 0; dst_offset < 4; ++dst_offset) {
+		for (size_t src_offset = 0; src_offset < 2; ++src_offset) {
+			for (size_t count = 0; count <= MAX_PIXELS; ++count) {
+				const ili9481_color_t *in = src + src_offset;
+				const ili9481_color_t color = in[0];
+				for (size_t i = 0; i < count; ++i) {
+					same[i] = color;
+				}
+
+				// Guard bytes around output must survive
+				memset(actual, 0xaa, sizeof(actual));
+				memset(expected, 0xaa, sizeof(expected));
+				CHECK_EQ(ili9481_span_pack16(actual + dst_offset, in, count), count * 2);
+				scalar_pack16(expected + dst_offset, in, count);
+				CHECK(memcmp(actual, expected, sizeof(actual)) == 0);
+
+				memset(actual, 0xaa, sizeof(actual));
+				memset(expected, 0xaa, sizeof(expected));
+				CHECK_EQ(ili9481_span_pack18(actual + dst_offset, in, count), count * 3);
+				scalar_pack18(expected + dst_offset, in, count);
+				CHECK(memcmp(actual, expected, sizeof(actual)) == 0);
+
+				memset(actual, 0xaa, sizeof(actual));
+				memset(expected, 0xaa, sizeof(expected));
+				ili9481_span_fill_packed16(actual + dst_offset, color, count);
+				scalar_pack16(expected + dst_offset, same, count);
+				CHECK(memcmp(actual, expected, sizeof(actual)) == 0);
+
+				memset(actual, 0xaa, sizeof(actual));
+				memset(expected, 0xaa, sizeof(expected));
+				ili9481_span_fill_packed18(actual + dst_offset, color, count);
+				scalar_pack18(expected + dst_offset, same, count);
+				CHECK(memcmp(actual, expected, sizeof(actual)) == 0);
+
+				ili9481_color_t filled[MAX_PIXELS + 4] __attribute__((aligned(4)));
+				for (size_t i = 0; i < MAX_PIXELS + 4; ++i) {
+					filled[i] = 0xaaaa;
+				}
+				ili9481_span_fill(filled + src_offset, color, count);
+				for (size_t i = 0; i < MAX_PIXELS + 4; ++i) {
+					const bool inside = i >= src_offset && i < src_offset + count;
+					CHECK_EQ(filled[i], inside ? color : 0xaaaa);
+				}
+			}
+		}
+	}
+}
+
+
+static void test_blend(void) {
+	ili9481_color_t src[MAX_PIXELS];
+	ili9481_color_t actual[MAX_PIXELS];
+	ili9481_color_t expected[MAX_PIXELS];
+	ili9481_color_t original[MAX_PIXELS];
+	for (unsigned alpha = 0; alpha <= 255; ++alpha) {
+		const size_t count = random_next() % MAX_PIXELS;
+		for (size_t i = 0; i < count; ++i) {
+			src[i] = random_next();
+			actual[i] = expected[i] = original[i] = random_next();
+		}
+		ili9481_span_blend(actual, src, alpha, count);
+		scalar_blend(expected, src, alpha, count);
+		CHECK(memcmp(actual, expected, count * sizeof(ili9481_color_t)) == 0);
+		// Ends of alpha range keep or copy exactly
+		if (alpha == 0 || alpha == 255) {
+			CHECK(memcmp(actual, alpha == 0 ? original : src, count * sizeof(ili9481_color_t)) == 0);
+		}
+	}
+}
+
+
+// Levels map mask values to alpha 0..32, NULL for linear levels
+static void scalar_alpha_bitmap(const uint8_t *src, uint8_t bits, const uint8_t *levels, ili9481_color_t *target, ili9481_color_t color, int x, int y, int src_w, int src_h, int target_w, int target_h) {
+	const uint32_t value_mask = (1U << bits) - 1;
+	for (int sy = 0; sy < src_h; ++sy) {
+		for (int sx = 0; sx < src_w; ++sx) {
+			const int tx = x + sx;
+			const int ty = y + sy;
+			if (tx < 0 || ty < 0 || tx >= target_w || ty >= target_h) {
+				continue;
+			}
+			const size_t bit = ((size_t)sy * src_w + sx) * bits;
+			const uint32_t value = (src[bit >> 3] >> (bit & 0x07)) & value_mask;
+			// Value scaled to 0..255 and rounded to 0..32
+			const uint32_t alpha = levels != NULL ? levels[value] : (value * (255 / value_mask) * 33 + 16) >> 8;
+			ili9481_color_t *pixel = &target[ty * target_w + tx];
+			*pixel = scalar_mix(*pixel, color, alpha);
+		}
+	}
+}
+
+
+// Target filled with random colors and mask with random transparent, opaque
+// and mixed bytes
+typedef struct bitmap_case {
+	int src_w;
+	int src_h;
+	int x;
+	int y;
+	uint8_t src[256];
+	ili9481_color_t color;
+	ili9481_color_t actual[ALPHA_TARGET_W * ALPHA_TARGET_H];
+	ili9481_color_t expected[ALPHA_TARGET_W * ALPHA_TARGET_H];
+} bitmap_case_t;
+
+
+static void random_case(bitmap_case_t *bitmap) {
+	bitmap->src_w = random_next() % 20 + 1;
+	bitmap->src_h = random_next() % 10 + 1;
+	bitmap->x = (int)(random_next() % 30) - 10;
+	bitmap->y = (int)(random_next() % 20) - 8;
+	// Transparent and opaque bytes take fast path
+	for (size_t i = 0; i < sizeof(bitmap->src); ++i) {
+		const uint32_t kind = random_next() % 3;
+		bitmap->src[i] = kind == 0 ? 0x00 : kind == 1 ? 0xff : random_next();
+	}
+	for (size_t i = 0; i < ALPHA_TARGET_W * ALPHA_TARGET_H; ++i) {
+		bitmap->actual[i] = bitmap->expected[i] = random_next();
+	}
+	bitmap->color = random_next();
+}
+
+
+static void test_alpha_bitmap(void) {
+	static bitmap_case_t bitmap;
+	for (uint8_t bits = 1; bits <= 8; bits *= 2) {
+		for (int round = 0; round < 500; ++round) {
+			random_case(&bitmap);
+			ili9481_draw_alpha_bitmap(bitmap.src, bits, bitmap.actual, bitmap.color, bitmap.x, bitmap.y, bitmap.src_w, bitmap.src_h, ALPHA_TARGET_W, ALPHA_TARGET_H);
+			scalar_alpha_bitmap(bitmap.src, bits, NULL, bitmap.expected, bitmap.color, bitmap.x, bitmap.y, bitmap.src_w, bitmap.src_h, ALPHA_TARGET_W, ALPHA_TARGET_H);
+			CHECK(memcmp(bitmap.actual, bitmap.expected, sizeof(bitmap.actual)) == 0);
+		}
+	}
+}
+
+
+// Levels 1 and 2 keep blending of original gray2 renderer
+static void test_gray2_bitmap(void) {
+	static const uint8_t levels[4] = {0, 16, 24, 32};
+	static bitmap_case_t bitmap;
+	for (int round = 0; round < 500; ++round) {
+		random_case(&bitmap);
+		uint8_t r, g, b;
+		ili9481_color_to_rgb(bitmap.color, &r, &g, &b);
+		ili9481_draw_gray2_bitmap(bitmap.src, bitmap.actual, r, g, b, bitmap.x, bitmap.y, bitmap.src_w, bitmap.src_h, ALPHA_TARGET_W, ALPHA_TARGET_H);
+		scalar_alpha_bitmap(bitmap.src, 2, levels, bitmap.expected, bitmap.color, bitmap.x, bitmap.y, bitmap.src_w, bitmap.src_h, ALPHA_TARGET_W, ALPHA_TARGET_H);
+		CHECK(memcmp(bitmap.actual, bitmap.expected, sizeof(bitmap.actual)) == 0);
+	}
+}
+
+
+static double elapsed_s(const struct timespec *start) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+
+// Output is summed, so compiler keeps every round
+static uint32_t checksum(const uint8_t *data, size_t length) {
+	uint32_t sum = 0;
+	for (size_t i = 0; i < length; i += 61) {
+		sum += data[i];
+	}
+	return sum;
+}
+
+
+static void bench_report(const char *name, double kernel_s, double scalar_s, size_t bytes) {
+	const double total = (double)bytes * BENCH_ROUNDS / 1e6;
+	printf("%-10s kernel %8.1f MB/s  scalar %8.1f MB/s  %.2fx\n", name, total / kernel_s, total / scalar_s, scalar_s / kernel_s);
+}
+
+
+static void bench(void) {
+	static ili9481_color_t src[BENCH_PIXELS] __attribute__((aligned(4)));
+	static ili9481_color_t same[BENCH_PIXELS] __attribute__((aligned(4)));
+	static uint8_t dst[BENCH_PIXELS * 3] __attribute__((aligned(4)));
+	for (size_t i = 0; i < BENCH_PIXELS; ++i) {
+		src[i] = random_next();
+		same[i] = 0x07e0;
+	}
+	uint32_t sum = 0;
+	struct timespec start;
+	double kernel_s;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int round = 0; round < BENCH_ROUNDS; ++round) {
+		ili9481_span_pack18(dst, src, BENCH_PIXELS);
+		sum += checksum(dst, sizeof(dst));
+	}
+	kernel_s = elapsed_s(&start);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int round = 0; round < BENCH_ROUNDS; ++round) {
+		scalar_pack18(dst, src, BENCH_PIXELS);
+		sum += checksum(dst, sizeof(dst));
+	}
+	bench_report("pack18", kernel_s, elapsed_s(&start), BENCH_PIXELS * 3);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int round = 0; round < BENCH_ROUNDS; ++round) {
+		ili9481_span_fill_packed18(dst, 0x07e0, BENCH_PIXELS);
+		sum += checksum(dst, sizeof(dst));
+	}
+	kernel_s = elapsed_s(&start);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int round = 0; round < BENCH_ROUNDS; ++round) {
+		scalar_pack18(dst, same, BENCH_PIXELS);
+		sum += checksum(dst, sizeof(dst));
+	}
+	bench_report("fill18", kernel_s, elapsed_s(&start), BENCH_PIXELS * 3);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int round = 0; round < BENCH_ROUNDS; ++round) {
+		ili9481_span_pack16(dst, src, BENCH_PIXELS);
+		sum += checksum(dst, BENCH_PIXELS * 2);
+	}
+	kernel_s = elapsed_s(&start);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int round = 0; round < BENCH_ROUNDS; ++round) {
+		scalar_pack16(dst, src, BENCH_PIXELS);
+		sum += checksum(dst, BENCH_PIXELS * 2);
+	}
+	bench_report("pack16", kernel_s, elapsed_s(&start), BENCH_PIXELS * 2);
+
+	ili9481_color_t *blended = (ili9481_color_t *)dst;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int round = 0; round < BENCH_ROUNDS; ++round) {
+		ili9481_span_blend(blended, src, round, BENCH_PIXELS);
+		sum += checksum(dst, BENCH_PIXELS * 2);
+	}
+	kernel_s = elapsed_s(&start);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int round = 0; round < BENCH_ROUNDS; ++round) {
+		scalar_blend(blended, src, round, BENCH_PIXELS);
+		sum += checksum(dst, BENCH_PIXELS * 2);
+	}
+	bench_report("blend", kernel_s, elapsed_s(&start), BENCH_PIXELS * 2);
+	printf("checksum %08x\n", (unsigned)sum);
+}
+
+
+int main(void) {
+	random_seed(1);
+	test_pack_and_fill();
+	test_blend();
+	test_alpha_bitmap();
+	test_gray2_bitmap();
+	bench();
+	return 0;
+}
@@ -0,0 +1,165 @@
+// SPDX-License-Identifier: MIT
+// Tear synchronized presentation over simulator bus. Refresh pointer of
+// simulator advances with bus traffic, so write and refresh speed ratio is
+// fixed by scan_bytes. Refresh passes must never show lines of two frames.
+
+#include "ili9481.h"
+#include "ili9481_tear.h"
+#include "host_gpio.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "sim_fixture.h"
+#include "test.h"
+
+
+#define WIDTH 80
+#define HEIGHT 60
+#define FRAMES 40
+#define PIN_TE 4
+
+
+typedef struct frame_writer {
+	uint32_t frame;
+	uint32_t draws;
+} frame_writer_t;
+
+
+static void init_sim(ili9481_driver_t *driver, uint32_t scan_bytes) {
+	sim_init(driver, &ili9481_bus_sim, WIDTH, HEIGHT, ILI9481_PIXEL_FORMAT_16);
+	ili9481_sim_t *sim = (ili9481_sim_t *)driver->bus_data;
+	sim->scan_bytes = scan_bytes;
+}
+
+
+static void draw_frame(ili9481_driver_t *driver, uint16_t y, uint16_t height, void *user_data) {
+	frame_writer_t *writer = (frame_writer_t *)user_data;
+	ili9481_fill_area(driver, (ili9481_color_t)(writer->frame * 0x0841), 0, y, WIDTH, height);
+	writer->draws++;
+}
+
+
+static void run_frames(ili9481_tear_mode_t mode, uint32_t scan_bytes) {
+	ili9481_driver_t driver;
+	init_sim(&driver, scan_bytes);
+	const ili9481_sim_t *sim = (const ili9481_sim_t *)driver.bus_data;
+	const ili9481_tear_config_t config = {
+		.pin_te = -1,
+		.mode = mode,
+	};
+	ili9481_tear_t *tear;
+	CHECK_EQ(ili9481_tear_create(&driver, &config, &tear), ESP_OK);
+
+	frame_writer_t writer = {0};
+	for (writer.frame = 0; writer.frame < FRAMES; ++writer.frame) {
+		CHECK_EQ(ili9481_tear_present(tear, draw_frame, &writer), ESP_OK);
+	}
+	CHECK_EQ(writer.draws, mode == ILI9481_TEAR_FULL ? FRAMES : FRAMES * 2);
+	CHECK(sim->frames_scanned >= FRAMES);
+	CHECK_EQ(sim->tears, 0);
+	ili9481_tear_destroy(tear);
+	ili9481_deinit(&driver);
+}
+
+
+// Same frames written at any time show tears, checks that simulator detects
+// them at these speeds
+static void run_unsynchronized(uint32_t scan_bytes) {
+	ili9481_driver_t driver;
+	init_sim(&driver, scan_bytes);
+	const ili9481_sim_t *sim = (const ili9481_sim_t *)driver.bus_data;
+	frame_writer_t writer = {0};
+	for (writer.frame = 0; writer.frame < FRAMES; ++writer.frame) {
+		draw_frame(&driver, 0, HEIGHT, &writer);
+	}
+	CHECK(sim->tears > 0);
+	ili9481_deinit(&driver);
+}
+
+
+static void test_scanline(void) {
+	ili9481_driver_t driver;
+	init_sim(&driver, WIDTH);
+	ili9481_sim_t *sim = (ili9481_sim_t *)driver.bus_data;
+	const ili9481_tear_config_t config = {
+		.pin_te = -1,
+		.mode = ILI9481_TEAR_FULL,
+	};
+	ili9481_tear_t *tear;
+	CHECK_EQ(ili9481_tear_create(&driver, &config, &tear), ESP_OK);
+
+	// Scanline is read without advancing refresh
+	sim->scan_bytes = 0;
+	sim->scanline = 0x123 % HEIGHT;
+	CHECK_EQ(ili9481_tear_get_scanline(tear), 0x123 % HEIGHT);
+
+	// Waits end exactly at requested line
+	sim->scan_bytes = 4; // One scanline read per line
+	for (uint16_t line = 0; line < HEIGHT; line += 7) {
+		CHECK_EQ(ili9481_tear_wait_scanline(tear, line), ESP_OK);
+		CHECK_EQ(sim->scanline, line);
+	}
+	CHECK_EQ(ili9481_tear_wait_vsync(tear), ESP_OK);
+	CHECK_EQ(sim->scanline, 0);
+
+	// Stopped refresh times out
+	sim->scan_bytes = 0;
+	sim->scanline = 1;
+	CHECK_EQ(ili9481_tear_wait_vsync(tear), ESP_ERR_TIMEOUT);
+	ili9481_tear_destroy(tear);
+	ili9481_deinit(&driver);
+}
+
+
+static volatile bool pulses_running;
+
+
+static void te_pulse_task(void *arg) {
+	while (pulses_running) {
+		host_gpio_trigger(PIN_TE);
+		vTaskDelay(pdMS_TO_TICKS(2));
+	}
+	vTaskDelete(NULL);
+}
+
+
+// Vertical blank is signalled by TE interrupt
+static void test_te_pin(void) {
+	ili9481_driver_t driver;
+	init_sim(&driver, 0);
+	host_gpio_reset(NULL);
+	const ili9481_tear_config_t config = {
+		.pin_te = PIN_TE,
+		.mode = ILI9481_TEAR_FULL,
+	};
+	ili9481_tear_t *tear;
+	CHECK_EQ(ili9481_tear_create(&driver, &config, &tear), ESP_OK);
+	frame_writer_t writer = {0};
+	CHECK_EQ(ili9481_tear_present(tear, draw_frame, &writer), ESP_ERR_TIMEOUT);
+	CHECK_EQ(writer.draws, 0);
+
+	pulses_running = true;
+	CHECK_EQ(xTaskCreatePinnedToCore(te_pulse_task, "te", 2048, NULL, 5, NULL, 0), pdPASS);
+	for (int frame = 0; frame < 5; ++frame) {
+		CHECK_EQ(ili9481_tear_present(tear, draw_frame, &writer), ESP_OK);
+	}
+	CHECK_EQ(writer.draws, 5);
+	pulses_running = false;
+	vTaskDelay(pdMS_TO_TICKS(10));
+	ili9481_tear_destroy(tear);
+	ili9481_deinit(&driver);
+}
+
+
+int main(void) {
+	// Full frame write takes 4/3 of refresh period
+	run_frames(ILI9481_TEAR_FULL, WIDTH * 3 / 2);
+	run_unsynchronized(WIDTH * 3 / 2);
+	// Half frame write takes 2/3 of half refresh period
+	run_frames(ILI9481_TEAR_SPLIT, WIDTH * 3);
+	run_unsynchronized(WIDTH * 3);
+	test_scanline();
+	test_te_pin();
+	return 0;
+}
@@ -0,0 +1,225 @@
+// SPDX-License-Identifier: MIT
+// Glyphs visited by band queries of text layout against brute force shaping
+// of whole text filtered by band
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "glyph_cache.h"
+#include "text_layout.h"
+#include "unicode.h"
+
+#include "test.h"
+
+
+#define MAX_TEXT 256
+#define MAX_PLACED MAX_TEXT
+#define TEXT_ROUNDS 300
+#define LAYOUT_X 8
+#define LAYOUT_Y 5
+
+
+typedef struct placed {
+	int x;
+	int y;
+	int width;
+	int height;
+} placed_t;
+
+typedef struct placed_list {
+	placed_t items[MAX_PLACED];
+	size_t count;
+} placed_list_t;
+
+
+static const uint8_t bitmap[256];
+static uint32_t rasterize_calls;
+
+
+// Glyph heights and tops vary, so tall glyphs reach into next lines
+static void glyph_metrics(uint32_t codepoint, glyph_t *glyph) {
+	glyph->bitmap_width = codepoint == ' ' ? 0 : 3 + codepoint % 5;
+	glyph->bitmap_height = codepoint == ' ' ? 0 : 4 + codepoint % 13;
+	glyph->bitmap_left = codepoint % 3 - 1;
+	glyph->bitmap_top = 3 + codepoint % 9;
+	glyph->advance = 2 + codepoint % 6;
+	glyph->bitmap = bitmap;
+}
+
+
+static esp_err_t rasterize(uint32_t codepoint, glyph_t *glyph, void *user_data) {
+	rasterize_calls++;
+	glyph_metrics(codepoint, glyph);
+	return ESP_OK;
+}
+
+
+static void collect(const glyph_t *glyph, int x, int y, void *user_data) {
+	placed_list_t *list = (placed_list_t *)user_data;
+	CHECK(list->count < MAX_PLACED);
+	const placed_t placed = {x, y, glyph->bitmap_width, glyph->bitmap_height};
+	list->items[list->count++] = placed;
+}
+
+
+static int compare_placed(const void *a, const void *b) {
+	return memcmp(a, b, sizeof(placed_t));
+}
+
+
+// Every visible glyph of text placed at x, y
+static void shape_reference(const char *text, const text_layout_font_t *font, int x, int y, placed_list_t *list) {
+	uint32_t codes[MAX_TEXT];
+	const size_t count = u8_decode_string(codes, MAX_TEXT, text);
+	int pen_x = 0;
+	int line_top = 0;
+	list->count = 0;
+	for (size_t i = 0; i < count; ++i) {
+		if (codes[i] == '\n') {
+			pen_x = 0;
+			line_top += font->line_height;
+			continue;
+		}
+		glyph_t glyph;
+		glyph_metrics(codes[i], &glyph);
+		if (glyph.bitmap_width > 0 && glyph.bitmap_height > 0) {
+			const placed_t placed = {
+				x + pen_x + glyph.bitmap_left,
+				y + line_top + font->ascent - glyph.bitmap_top,
+				glyph.bitmap_width,
+				glyph.bitmap_height,
+			};
+			list->items[list->count++] = placed;
+		}
+		pen_x += glyph.advance;
+	}
+}
+
+
+static void filter_band(const placed_list_t *all, int band_y, int band_height, placed_list_t *band) {
+	band->count = 0;
+	for (size_t i = 0; i < all->count; ++i) {
+		const placed_t *placed = &all->items[i];
+		if (placed->y < band_y + band_height && placed->y + placed->height > band_y) {
+			band->items[band->count++] = *placed;
+		}
+	}
+}
+
+
+static void check_same(placed_list_t *actual, placed_list_t *expected) {
+	CHECK_EQ(actual->count, expected->count);
+	qsort(actual->items, actual->count, sizeof(placed_t), compare_placed);
+	qsort(expected->items, expected->count, sizeof(placed_t), compare_placed);
+	CHECK(memcmp(actual->items, expected->items, actual->count * sizeof(placed_t)) == 0);
+}
+
+
+static void random_text(char *text) {
+	static const uint32_t codes[] = {
+		' ', ' ', '\n', 'a', 'g', 'T', 'y', 'L', '.', 0xe9, 0x17e, 0x20ac, 0x1f600,
+	};
+	const size_t length = random_next() % 60;
+	size_t pos = 0;
+	for (size_t i = 0; i < length; ++i) {
+		pos += u8_encode(text + pos, codes[random_next() % (sizeof(codes) / sizeof(codes[0]))]);
+	}
+	text[pos] = 0;
+}
+
+
+static void test_band_queries(void) {
+	glyph_cache_t *cache;
+	text_layout_t *layout;
+	CHECK_EQ(glyph_cache_create(4096, 64, &cache), ESP_OK);
+	CHECK_EQ(text_layout_create(cache, &layout), ESP_OK);
+	const int face = 0;
+	const text_layout_font_t font = {&face, 14, 12, 10, rasterize, NULL};
+	char text[MAX_TEXT];
+	placed_list_t expected_all;
+	placed_list_t expected;
+	placed_list_t actual;
+
+	for (int round = 0; round < TEXT_ROUNDS; ++round) {
+		random_text(text);
+		CHECK_EQ(text_layout_set_text(layout, &font, text), ESP_OK);
+		shape_reference(text, &font, LAYOUT_X, LAYOUT_Y, &expected_all);
+
+		actual.count = 0;
+		text_layout_draw(layout, LAYOUT_X, LAYOUT_Y, -1000, 3000, collect, &actual);
+		expected = expected_all;
+		check_same(&actual, &expected);
+
+		for (int band_y = -20; band_y < 120; band_y += 3) {
+			const int band_height = 1 + random_next() % 24;
+			actual.count = 0;
+			text_layout_draw(layout, LAYOUT_X, LAYOUT_Y, band_y, band_height, collect, &actual);
+			filter_band(&expected_all, band_y, band_height, &expected);
+			check_same(&actual, &expected);
+		}
+	}
+	text_layout_destroy(layout);
+	glyph_cache_destroy(cache);
+}
+
+
+static void test_reshape(void) {
+	glyph_cache_t *cache;
+	text_layout_t *layout;
+	CHECK_EQ(glyph_cache_create(4096, 64, &cache), ESP_OK);
+	CHECK_EQ(text_layout_create(cache, &layout), ESP_OK);
+	const int face = 0;
+	text_layout_font_t font = {&face, 14, 12, 20, rasterize, NULL};
+	placed_list_t placed;
+	glyph_cache_stats_t before;
+	glyph_cache_stats_t after;
+
+	CHECK_EQ(text_layout_set_text(layout, &font, "Lorem ipsum\ndolor"), ESP_OK);
+	glyph_cache_get_stats(cache, &before);
+
+	// Same text from other buffer is not shaped again
+	char copy[] = "Lorem ipsum\ndolor";
+	CHECK_EQ(text_layout_set_text(layout, &font, copy), ESP_OK);
+	glyph_cache_get_stats(cache, &after);
+	CHECK_EQ(after.hits + after.misses, before.hits + before.misses);
+
+	// Layout keeps own copy of text
+	copy[0] = 'X';
+	CHECK_EQ(text_layout_set_text(layout, &font, "Lorem ipsum\ndolor"), ESP_OK);
+	glyph_cache_get_stats(cache, &before);
+	CHECK_EQ(before.hits + before.misses, after.hits + after.misses);
+
+	// Line height changes positions
+	font.line_height = 30;
+	CHECK_EQ(text_layout_set_text(layout, &font, "Lorem ipsum\ndolor"), ESP_OK);
+	glyph_cache_get_stats(cache, &after);
+	CHECK(after.hits + after.misses > before.hits + before.misses);
+	placed.count = 0;
+	text_layout_draw(layout, 0, 0, 30, 30, collect, &placed);
+	CHECK_EQ(placed.count, 5); // "dolor"
+
+	text_layout_invalidate(layout);
+	CHECK_EQ(text_layout_set_text(layout, &font, "Lorem ipsum\ndolor"), ESP_OK);
+	glyph_cache_get_stats(cache, &before);
+	CHECK(before.hits + before.misses > after.hits + after.misses);
+
+	// Band queries of shaped text only blit cached glyphs
+	const uint32_t calls = rasterize_calls;
+	for (int band_y = 0; band_y < 60; band_y += 8) {
+		placed.count = 0;
+		text_layout_draw(layout, 0, 0, band_y, 8, collect, &placed);
+	}
+	CHECK_EQ(rasterize_calls, calls);
+
+	text_layout_destroy(layout);
+	glyph_cache_destroy(cache);
+}
+
+
+int main(void) {
+	random_seed(11);
+	test_band_queries();
+	test_reshape();
+	return 0;
+}
@@ -0,0 +1,268 @@
+// SPDX-License-Identifier: MIT
+// UTF-8 decoder against table of well-formed byte sequences (Unicode table
+// 3-7) with maximal subparts replaced, chunked decoding must match whole
+// input. Inputs are copied to buffers of exact size, so sanitizer catches
+// reads past end.
+
+#include <string.h>
+#include <sys/param.h>
+#include <time.h>
+
+#include "unicode.h"
+
+#include "test.h"
+
+
+#define FUZZ_ROUNDS 40000
+#define INPUT_SIZE 64
+#define BENCH_SIZE (1 << 20)
+#define BENCH_ROUNDS 20
+
+
+typedef struct byte_range {
+	uint8_t low;
+	uint8_t high;
+} byte_range_t;
+
+typedef struct sequence_form {
+	size_t length;
+	byte_range_t bytes[4];
+} sequence_form_t;
+
+static const sequence_form_t forms[] = {
+	{1, {{0x00, 0x7f}}},
+	{2, {{0xc2, 0xdf}, {0x80, 0xbf}}},
+	{3, {{0xe0, 0xe0}, {0xa0, 0xbf}, {0x80, 0xbf}}},
+	{3, {{0xe1, 0xec}, {0x80, 0xbf}, {0x80, 0xbf}}},
+	{3, {{0xed, 0xed}, {0x80, 0x9f}, {0x80, 0xbf}}},
+	{3, {{0xee, 0xef}, {0x80, 0xbf}, {0x80, 0xbf}}},
+	{4, {{0xf0, 0xf0}, {0x90, 0xbf}, {0x80, 0xbf}, {0x80, 0xbf}}},
+	{4, {{0xf1, 0xf3}, {0x80, 0xbf}, {0x80, 0xbf}, {0x80, 0xbf}}},
+	{4, {{0xf4, 0xf4}, {0x80, 0x8f}, {0x80, 0xbf}, {0x80, 0xbf}}},
+};
+
+// Valid and broken sequences, which are glued to fuzz inputs
+static const char *const pieces[] = {
+	"a", "\xc2\x80", "\xe0\xa0\x80", "\xf0\x90\x80\x80", "\xf4\x8f\xbf\xbf",
+	"\xed\xa0\x80", "\xf4\x90", "\xc0\xaf", "\xff", "\x80", "\xe2\x82",
+	"\xf0\x9f\x98", "\xef\xbf\xbd", "\xe0\x80", "\xf5\x80",
+};
+
+
+static size_t reference_decode(uint32_t *codes, const uint8_t *str, size_t length) {
+	size_t count = 0;
+	size_t pos = 0;
+	while (pos < length) {
+		// Longest prefix of any well-formed sequence
+		size_t matched = 0;
+		const sequence_form_t *match = NULL;
+		for (size_t i = 0; i < sizeof(forms) / sizeof(forms[0]); ++i) {
+			size_t prefix = 0;
+			while (prefix < forms[i].length && pos + prefix < length && str[pos + prefix] >= forms[i].bytes[prefix].low && str[pos + prefix] <= forms[i].bytes[prefix].high) {
+				prefix++;
+			}
+			if (prefix > matched) {
+				matched = prefix;
+				match = &forms[i];
+			}
+		}
+		if (match == NULL || matched < match->length) {
+			codes[count++] = U8_REPLACEMENT;
+			pos += matched > 0 ? matched : 1;
+			continue;
+		}
+		static const uint8_t lead_mask[] = {0, 0x7f, 0x1f, 0x0f, 0x07};
+		uint32_t code = str[pos] & lead_mask[match->length];
+		for (size_t i = 1; i < match->length; ++i) {
+			code = (code << 6) | (str[pos + i] & 0x3f);
+		}
+		codes[count++] = code;
+		pos += match->length;
+	}
+	return count;
+}
+
+
+static void test_round_trip(void) {
+	char str[4];
+	uint32_t code;
+	for (uint32_t value = 0; value < 0x110000; ++value) {
+		if (value >= 0xd800 && value <= 0xdfff) {
+			continue;
+		}
+		const uint8_t length = u8_encode(str, value);
+		CHECK(length >= 1 && length <= 4);
+		size_t consumed;
+		CHECK_EQ(u8_decode_chunk(&code, 1, str, length, true, &consumed), 1);
+		CHECK_EQ(code, value);
+		CHECK_EQ(consumed, length);
+	}
+	CHECK_EQ(u8_encode(str, 0x110000), 0);
+}
+
+
+static size_t fuzz_input(uint8_t *input) {
+	size_t length = 0;
+	if (random_next() % 2) {
+		const size_t target = random_next() % INPUT_SIZE;
+		while (length < target) {
+			input[length++] = random_next();
+		}
+		return length;
+	}
+	for (;;) {
+		const char *piece;
+		char ascii[2] = {(char)(random_next() % 0x80), 0};
+		if (random_next() % 3 == 0) {
+			piece = ascii[0] != 0 ? ascii : "z";
+		}
+		else {
+			piece = pieces[random_next() % (sizeof(pieces) / sizeof(pieces[0]))];
+		}
+		const size_t piece_length = strlen(piece);
+		if (length + piece_length > INPUT_SIZE || random_next() % 24 == 0) {
+			return length;
+		}
+		memcpy(input + length, piece, piece_length);
+		length += piece_length;
+	}
+}
+
+
+// Input arrives in random pieces into limited code buffer, undecoded tail is
+// carried to next call
+static size_t decode_in_chunks(uint32_t *codes, const uint8_t *input, size_t length) {
+	uint8_t pending[INPUT_SIZE];
+	size_t pending_length = 0;
+	size_t pos = 0;
+	size_t count = 0;
+	while (pos < length || pending_length > 0) {
+		const size_t piece = random_next() % 7 + 1;
+		const size_t step = MIN(length - pos, piece);
+		memcpy(pending + pending_length, input + pos, step);
+		pending_length += step;
+		pos += step;
+
+		char *chunk = (char *)malloc(pending_length);
+		memcpy(chunk, pending, pending_length);
+		size_t consumed;
+		const size_t decoded = u8_decode_chunk(codes + count, random_next() % 5 + 1, chunk, pending_length, pos == length, &consumed);
+		free(chunk);
+		CHECK(consumed <= pending_length);
+		// Final chunk always makes progress
+		CHECK(pos < length || decoded > 0 || pending_length == 0);
+		count += decoded;
+		memmove(pending, pending + consumed, pending_length - consumed);
+		pending_length -= consumed;
+	}
+	return count;
+}
+
+
+static void test_fuzz(void) {
+	uint8_t input[INPUT_SIZE];
+	uint32_t expected[INPUT_SIZE];
+	uint32_t actual[INPUT_SIZE];
+	for (int round = 0; round < FUZZ_ROUNDS; ++round) {
+		const size_t length = fuzz_input(input);
+		const size_t count = reference_decode(expected, input, length);
+
+		char *exact = (char *)malloc(length + 1);
+		memcpy(exact, input, length);
+		size_t consumed;
+		CHECK_EQ(u8_decode_chunk(actual, INPUT_SIZE, exact, length, true, &consumed), count);
+		CHECK_EQ(consumed, length);
+		CHECK(memcmp(actual, expected, count * sizeof(uint32_t)) == 0);
+
+		CHECK_EQ(decode_in_chunks(actual, input, length), count);
+		CHECK(memcmp(actual, expected, count * sizeof(uint32_t)) == 0);
+
+		// Single code decoder stops at terminator, even inside of sequence
+		exact[length] = 0;
+		if (memchr(input, 0, length) == NULL) {
+			CHECK_EQ(u8_decode_string(actual, INPUT_SIZE, exact), count);
+			CHECK(memcmp(actual, expected, count * sizeof(uint32_t)) == 0);
+			const char *str = exact;
+			size_t decoded = 0;
+			uint32_t code;
+			uint8_t step;
+			while ((step = u8_decode(&code, str)) != 0) {
+				CHECK(decoded < count);
+				CHECK_EQ(code, expected[decoded]);
+				decoded++;
+				str += step;
+			}
+			CHECK_EQ(decoded, count);
+		}
+		free(exact);
+	}
+}
+
+
+static double elapsed_s(const struct timespec *start) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+
+static void bench_text(const char *name, const char *text, uint32_t *codes) {
+	const size_t length = strlen(text);
+	size_t total = 0;
+	struct timespec start;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int round = 0; round < BENCH_ROUNDS; ++round) {
+		total += u8_decode_string(codes, BENCH_SIZE, text);
+	}
+	const double bulk_s = elapsed_s(&start);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int round = 0; round < BENCH_ROUNDS; ++round) {
+		const char *str = text;
+		uint8_t step;
+		size_t count = 0;
+		while ((step = u8_decode(&codes[count], str)) != 0) {
+			str += step;
+			count++;
+		}
+		total += count;
+	}
+	const double single_s = elapsed_s(&start);
+
+	const double megabytes = (double)length * BENCH_ROUNDS / 1e6;
+	printf("%-6s bulk %7.1f MB/s  per code %7.1f MB/s  (%zu codes)\n", name, megabytes / bulk_s, megabytes / single_s, total);
+}
+
+
+static void bench(void) {
+	char *text = (char *)malloc(BENCH_SIZE + 1);
+	uint32_t *codes = (uint32_t *)malloc((BENCH_SIZE + 1) * sizeof(uint32_t)); // Terminator is decoded too
+	CHECK(text != NULL && codes != NULL);
+
+	for (size_t i = 0; i < BENCH_SIZE; ++i) {
+		text[i] = ' ' + (i * 7) % 90;
+	}
+	text[BENCH_SIZE] = 0;
+	bench_text("ascii", text, codes);
+
+	// Latin text with accented letters every few characters
+	size_t length = 0;
+	while (length + 3 < BENCH_SIZE) {
+		length += random_next() % 6 == 0 ? u8_encode(text + length, 0xe0 + random_next() % 0x20) : u8_encode(text + length, 'a' + random_next() % 26);
+	}
+	text[length] = 0;
+	bench_text("latin", text, codes);
+
+	free(text);
+	free(codes);
+}
+
+
+int main(void) {
+	random_seed(7);
+	test_round_trip();
+	test_fuzz();
+	bench();
+	return 0;
+}
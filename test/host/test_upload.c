@@ -0,0 +1,434 @@
+// SPDX-License-Identifier: MIT
+// Image upload protocol in loopback with go-back-N sender. Link corrupts,
+// drops and adds bytes, image in simulated GRAM must still match. Receiver
+// task over host UART is run with real timeouts.
+
+#include <string.h>
+
+#include "ili9481.h"
+#include "image_upload.h"
+#include "host_uart.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "sim_fixture.h"
+#include "test.h"
+
+
+#define WIDTH 96
+#define HEIGHT 64
+#define HEADER_SIZE 13 // See IMAGE_UPLOAD_HEADER
+#define MAX_FRAME (IMAGE_UPLOAD_MAX_PAYLOAD + IMAGE_UPLOAD_FRAME_OVERHEAD)
+#define MAX_ROUNDS 100000
+#define UPLOAD_UART UART_NUM_1
+#define REPLY_TIMEOUT_MS 20
+
+
+typedef struct sender {
+	const uint8_t *image;
+	uint8_t header[HEADER_SIZE];
+	uint32_t size;
+	size_t payload_size;
+	uint32_t frames; // Header and data frames
+	uint32_t base; // Oldest frame not acked
+	uint32_t next; // Next frame to send
+	uint32_t sent; // Frames including repeated
+	uint32_t naks;
+	uint8_t reply[IMAGE_UPLOAD_FRAME_OVERHEAD];
+	size_t reply_pos;
+} sender_t;
+
+// Probabilities in 1/1000
+typedef struct link {
+	uint32_t corrupt;
+	uint32_t drop;
+	uint32_t noise;
+	uint32_t drop_reply;
+} link_t;
+
+typedef struct loopback {
+	sender_t *sender;
+	const link_t *link;
+	uint32_t replies;
+} loopback_t;
+
+typedef struct receiver {
+	ili9481_driver_t *driver;
+	uint32_t baud_rate;
+	esp_err_t result;
+	SemaphoreHandle_t done;
+} receiver_t;
+
+
+static bool random_chance(uint32_t permille) {
+	return random_next() % 1000 < permille;
+}
+
+
+static void write_u16(uint8_t *data, uint16_t value) {
+	data[0] = value & 0xff;
+	data[1] = value >> 8;
+}
+
+
+static void init_sender(sender_t *sender, const uint8_t *image, uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint8_t pixel_format, size_t payload_size) {
+	memset(sender, 0, sizeof(*sender));
+	sender->image = image;
+	sender->size = (uint32_t)width * height * (pixel_format == ILI9481_PIXEL_FORMAT_16 ? 2 : 3);
+	sender->payload_size = payload_size;
+	sender->frames = 1 + (sender->size + payload_size - 1) / payload_size;
+	write_u16(sender->header, x);
+	write_u16(sender->header + 2, y);
+	write_u16(sender->header + 4, width);
+	write_u16(sender->header + 6, height);
+	sender->header[8] = pixel_format;
+	write_u16(sender->header + 9, sender->size & 0xffff);
+	write_u16(sender->header + 11, sender->size >> 16);
+}
+
+
+static size_t build_frame(uint8_t *frame, uint8_t type, uint8_t seq, const uint8_t *payload, size_t length) {
+	frame[0] = IMAGE_UPLOAD_SYNC;
+	frame[1] = type;
+	frame[2] = seq;
+	write_u16(frame + 3, length);
+	memcpy(frame + 5, payload, length);
+	write_u16(frame + 5 + length, image_upload_crc(0xffff, frame + 1, length + 4));
+	return length + IMAGE_UPLOAD_FRAME_OVERHEAD;
+}
+
+
+static size_t sender_frame(sender_t *sender, uint32_t index, uint8_t *frame) {
+	if (index == 0) {
+		return build_frame(frame, IMAGE_UPLOAD_HEADER, 0, sender->header, HEADER_SIZE);
+	}
+	const uint32_t offset = (index - 1) * sender->payload_size;
+	const size_t length = sender->size - offset < sender->payload_size ? sender->size - offset : sender->payload_size;
+	return build_frame(frame, IMAGE_UPLOAD_DATA, index & 0xff, sender->image + offset, length);
+}
+
+
+// Reply carries low byte of frame index, replies for frames outside of
+// window are stale
+static void sender_process_reply(sender_t *sender) {
+	const uint8_t *reply = sender->reply;
+	const uint16_t crc = image_upload_crc(0xffff, reply + 1, 4);
+	CHECK(reply[3] == 0 && reply[4] == 0);
+	CHECK_EQ(reply[5] | (reply[6] << 8), crc);
+	const uint32_t index = sender->base + (uint8_t)(reply[2] - sender->base);
+	if (index > sender->next) {
+		return;
+	}
+	if (index > sender->base) {
+		sender->base = index;
+	}
+	if (reply[1] == IMAGE_UPLOAD_NAK) {
+		sender->naks++;
+		sender->next = sender->base;
+	}
+	else {
+		CHECK_EQ(reply[1], IMAGE_UPLOAD_ACK);
+	}
+}
+
+
+static void sender_receive(sender_t *sender, const uint8_t *data, size_t length) {
+	for (size_t i = 0; i < length; ++i) {
+		if (sender->reply_pos == 0 && data[i] != IMAGE_UPLOAD_SYNC) {
+			continue;
+		}
+		sender->reply[sender->reply_pos++] = data[i];
+		if (sender->reply_pos == IMAGE_UPLOAD_FRAME_OVERHEAD) {
+			sender->reply_pos = 0;
+			sender_process_reply(sender);
+		}
+	}
+}
+
+
+static void loopback_reply(const uint8_t *data, size_t length, void *user_data) {
+	loopback_t *loopback = (loopback_t *)user_data;
+	CHECK_EQ(length, IMAGE_UPLOAD_FRAME_OVERHEAD);
+	loopback->replies++;
+	if (!random_chance(loopback->link->drop_reply)) {
+		sender_receive(loopback->sender, data, length);
+	}
+}
+
+
+// Frame passes link and is fed in random pieces, returns true when image is
+// written
+static bool transmit(image_upload_t *upload, const link_t *link, uint8_t *frame, size_t length) {
+	if (random_chance(link->drop)) {
+		return false;
+	}
+	if (random_chance(link->corrupt)) {
+		frame[random_next() % length] ^= 1 << (random_next() % 8);
+	}
+	if (random_chance(link->noise)) {
+		uint8_t noise[8];
+		for (size_t i = 0; i < sizeof(noise); ++i) {
+			noise[i] = random_next() % 2 ? IMAGE_UPLOAD_SYNC : random_next();
+		}
+		if (image_upload_feed(upload, noise, random_next() % sizeof(noise) + 1)) {
+			return true;
+		}
+	}
+	size_t pos = 0;
+	while (pos < length) {
+		size_t piece = random_next() % 300 + 1;
+		if (piece > length - pos) {
+			piece = length - pos;
+		}
+		if (image_upload_feed(upload, frame + pos, piece)) {
+			return true;
+		}
+		pos += piece;
+	}
+	return false;
+}
+
+
+static void fill_image(uint8_t *image, size_t size, uint8_t pixel_format) {
+	for (size_t i = 0; i < size; ++i) {
+		// 18-bit GRAM keeps high 6 bits of every byte
+		image[i] = random_next() & (pixel_format == ILI9481_PIXEL_FORMAT_18 ? 0xfc : 0xff);
+	}
+}
+
+
+static void check_gram(ili9481_driver_t *driver, const uint8_t *image, uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint8_t pixel_format) {
+	const ili9481_sim_t *sim = (const ili9481_sim_t *)driver->bus_data;
+	for (uint16_t row = 0; row < driver->display_height; ++row) {
+		for (uint16_t column = 0; column < driver->display_width; ++column) {
+			const uint8_t *pixel = sim->gram + ((size_t)row * driver->display_width + column) * 3;
+			uint8_t expected[3] = {0, 0, 0};
+			if (column >= x && column < x + width && row >= y && row < y + height) {
+				const size_t index = (size_t)(row - y) * width + (column - x);
+				if (pixel_format == ILI9481_PIXEL_FORMAT_18) {
+					memcpy(expected, image + index * 3, 3);
+				}
+				else {
+					const uint16_t color = (image[index * 2] << 8) | image[index * 2 + 1];
+					expected[0] = (color >> 8) & 0xf8;
+					expected[1] = (color >> 3) & 0xfc;
+					expected[2] = (color << 3) & 0xf8;
+				}
+			}
+			CHECK(memcmp(pixel, expected, 3) == 0);
+		}
+	}
+}
+
+
+static void run_loopback(uint8_t pixel_format, size_t payload_size, const link_t *link) {
+	ili9481_driver_t driver;
+	sim_init(&driver, &ili9481_bus_sim, WIDTH, HEIGHT, ILI9481_PIXEL_FORMAT_16);
+	const uint16_t x = 5;
+	const uint16_t y = 3;
+	const uint16_t width = WIDTH - 9;
+	const uint16_t height = HEIGHT - 7;
+	static uint8_t image[WIDTH * HEIGHT * 3];
+	static uint8_t frame[MAX_FRAME];
+	static image_upload_t upload;
+	sender_t sender;
+	init_sender(&sender, image, x, y, width, height, pixel_format, payload_size);
+	fill_image(image, sender.size, pixel_format);
+	loopback_t loopback = {&sender, link, 0};
+	image_upload_init(&upload, &driver, loopback_reply, &loopback);
+
+	// Every round sends window, frames not acked by end of round are lost
+	// and sent again
+	bool done = false;
+	uint32_t rounds = 0;
+	while (!done) {
+		CHECK(rounds++ < MAX_ROUNDS);
+		while (!done && sender.next < sender.base + IMAGE_UPLOAD_WINDOW && sender.next < sender.frames) {
+			const size_t length = sender_frame(&sender, sender.next++, frame);
+			sender.sent++;
+			done = transmit(&upload, link, frame, length);
+		}
+		sender.next = sender.base;
+	}
+
+	check_gram(&driver, image, x, y, width, height, pixel_format);
+	CHECK(sender.frames > 256); // Sequence numbers wrap
+	if (link->corrupt == 0 && link->drop == 0 && link->noise == 0 && link->drop_reply == 0) {
+		CHECK_EQ(upload.errors, 0);
+		CHECK_EQ(sender.naks, 0);
+		CHECK_EQ(loopback.replies, sender.frames);
+	}
+	else {
+		CHECK(upload.errors > 0 || link->corrupt == 0);
+		CHECK(sender.sent > sender.frames);
+	}
+	ili9481_deinit(&driver);
+}
+
+
+// Without errors only frame overhead is added to image
+static void test_overhead(void) {
+	ili9481_driver_t driver;
+	sim_init(&driver, &ili9481_bus_sim, 320, 480, ILI9481_PIXEL_FORMAT_16);
+	static uint8_t image[320 * 480 * 2];
+	static uint8_t frame[MAX_FRAME];
+	static image_upload_t upload;
+	sender_t sender;
+	init_sender(&sender, image, 0, 0, 320, 480, ILI9481_PIXEL_FORMAT_16, IMAGE_UPLOAD_MAX_PAYLOAD);
+	fill_image(image, sender.size, ILI9481_PIXEL_FORMAT_16);
+	const link_t link = {0};
+	loopback_t loopback = {&sender, &link, 0};
+	image_upload_init(&upload, &driver, loopback_reply, &loopback);
+
+	size_t wire_bytes = 0;
+	bool done = false;
+	while (!done) {
+		CHECK(sender.next < sender.base + IMAGE_UPLOAD_WINDOW);
+		const size_t length = sender_frame(&sender, sender.next++, frame);
+		wire_bytes += length;
+		done = image_upload_feed(&upload, frame, length);
+	}
+	CHECK_EQ(sender.next, sender.frames);
+	CHECK_EQ(sender.base, sender.frames);
+	CHECK_EQ(wire_bytes, sender.size + HEADER_SIZE + sender.frames * IMAGE_UPLOAD_FRAME_OVERHEAD);
+	CHECK(sender.size * 1000ULL / wire_bytes >= 998);
+	check_gram(&driver, image, 0, 0, 320, 480, ILI9481_PIXEL_FORMAT_16);
+	ili9481_deinit(&driver);
+}
+
+
+static void feed_frame(image_upload_t *upload, uint8_t type, uint8_t seq, const uint8_t *payload, size_t length) {
+	uint8_t frame[64];
+	CHECK(!image_upload_feed(upload, frame, build_frame(frame, type, seq, payload, length)));
+}
+
+
+static void record_reply(const uint8_t *data, size_t length, void *user_data) {
+	memcpy(user_data, data, length);
+}
+
+
+static void test_rejected_frames(void) {
+	ili9481_driver_t driver;
+	sim_init(&driver, &ili9481_bus_sim, WIDTH, HEIGHT, ILI9481_PIXEL_FORMAT_16);
+	const ili9481_sim_t *sim = (const ili9481_sim_t *)driver.bus_data;
+	static image_upload_t upload;
+	uint8_t reply[IMAGE_UPLOAD_FRAME_OVERHEAD];
+	image_upload_init(&upload, &driver, record_reply, reply);
+	sender_t sender;
+	const uint8_t pixels[4] = {0xff, 0xff, 0xff, 0xff};
+
+	// Image outside of display, unknown pixel format, wrong size
+	init_sender(&sender, pixels, WIDTH - 1, 0, 2, 1, ILI9481_PIXEL_FORMAT_16, 64);
+	feed_frame(&upload, IMAGE_UPLOAD_HEADER, 0, sender.header, HEADER_SIZE);
+	CHECK(reply[1] == IMAGE_UPLOAD_NAK && reply[2] == 0);
+	init_sender(&sender, pixels, 0, 0, 2, 1, 0x77, 64);
+	feed_frame(&upload, IMAGE_UPLOAD_HEADER, 0, sender.header, HEADER_SIZE);
+	CHECK(reply[1] == IMAGE_UPLOAD_NAK && reply[2] == 0);
+	init_sender(&sender, pixels, 0, 0, 2, 1, ILI9481_PIXEL_FORMAT_16, 64);
+	sender.header[9]++;
+	feed_frame(&upload, IMAGE_UPLOAD_HEADER, 0, sender.header, HEADER_SIZE);
+	CHECK(reply[1] == IMAGE_UPLOAD_NAK && reply[2] == 0);
+	CHECK_EQ(upload.errors, 3);
+
+	// Data before header
+	feed_frame(&upload, IMAGE_UPLOAD_DATA, 1, pixels, 4);
+	CHECK(reply[1] == IMAGE_UPLOAD_ACK && reply[2] == 0);
+	feed_frame(&upload, IMAGE_UPLOAD_DATA, 0, pixels, 4);
+	CHECK(reply[1] == IMAGE_UPLOAD_NAK && reply[2] == 0);
+	CHECK_EQ(upload.errors, 4);
+	CHECK_EQ(sim->pixels_written, 0);
+
+	// Data past end of image
+	init_sender(&sender, pixels, 0, 0, 2, 1, ILI9481_PIXEL_FORMAT_16, 64);
+	feed_frame(&upload, IMAGE_UPLOAD_HEADER, 0, sender.header, HEADER_SIZE);
+	CHECK(reply[1] == IMAGE_UPLOAD_ACK && reply[2] == 1);
+	const uint8_t too_long[6] = {0};
+	feed_frame(&upload, IMAGE_UPLOAD_DATA, 1, too_long, sizeof(too_long));
+	CHECK(reply[1] == IMAGE_UPLOAD_NAK && reply[2] == 1);
+	CHECK_EQ(sim->pixels_written, 0);
+
+	uint8_t frame[64];
+	CHECK(image_upload_feed(&upload, frame, build_frame(frame, IMAGE_UPLOAD_DATA, 1, pixels, 4)));
+	CHECK(reply[1] == IMAGE_UPLOAD_ACK && reply[2] == 2);
+	CHECK_EQ(sim->pixels_written, 2);
+	ili9481_deinit(&driver);
+}
+
+
+static void receive_task(void *arg) {
+	receiver_t *receiver = (receiver_t *)arg;
+	receiver->result = image_upload_receive(receiver->driver, UPLOAD_UART, receiver->baud_rate);
+	xSemaphoreGive(receiver->done);
+	vTaskDelete(NULL);
+}
+
+
+// Receiver reads UART driver in own task, sender goes back to oldest frame
+// not acked after reply timeout
+static void test_uart_receive(void) {
+	ili9481_driver_t driver;
+	sim_init(&driver, &ili9481_bus_sim, WIDTH, HEIGHT, ILI9481_PIXEL_FORMAT_16);
+	const uint16_t width = 64;
+	const uint16_t height = 40;
+	static uint8_t image[64 * 40 * 3];
+	static uint8_t frame[MAX_FRAME];
+	sender_t sender;
+	init_sender(&sender, image, 16, 12, width, height, ILI9481_PIXEL_FORMAT_18, 512);
+	fill_image(image, sender.size, ILI9481_PIXEL_FORMAT_18);
+
+	CHECK_EQ(uart_set_baudrate(UPLOAD_UART, 115200), ESP_OK);
+	receiver_t receiver = {&driver, 921600, ESP_FAIL, xSemaphoreCreateBinary()};
+	CHECK(receiver.done != NULL);
+	CHECK_EQ(xTaskCreatePinnedToCore(receive_task, "upload", 4096, &receiver, 5, NULL, 0), pdPASS);
+	while (!host_uart_is_installed(UPLOAD_UART)) {
+		vTaskDelay(1);
+	}
+
+	uint32_t rounds = 0;
+	while (!xSemaphoreTake(receiver.done, 0)) {
+		CHECK(rounds++ < 1000);
+		while (sender.next < sender.base + IMAGE_UPLOAD_WINDOW && sender.next < sender.frames) {
+			const size_t length = sender_frame(&sender, sender.next++, frame);
+			sender.sent++;
+			// Every fifth frame is lost
+			if (sender.sent % 5 != 0) {
+				CHECK_EQ(host_uart_write(UPLOAD_UART, frame, length, pdMS_TO_TICKS(1000)), length);
+			}
+		}
+		uint8_t reply[IMAGE_UPLOAD_FRAME_OVERHEAD * IMAGE_UPLOAD_WINDOW];
+		const size_t count = host_uart_read(UPLOAD_UART, reply, sizeof(reply), pdMS_TO_TICKS(REPLY_TIMEOUT_MS));
+		if (count == 0) {
+			sender.next = sender.base;
+		}
+		sender_receive(&sender, reply, count);
+	}
+
+	CHECK_EQ(receiver.result, ESP_OK);
+	CHECK(sender.sent > sender.frames);
+	uint32_t baud_rate;
+	CHECK_EQ(uart_get_baudrate(UPLOAD_UART, &baud_rate), ESP_OK);
+	CHECK_EQ(baud_rate, 115200);
+	CHECK(!host_uart_is_installed(UPLOAD_UART));
+	check_gram(&driver, image, 16, 12, width, height, ILI9481_PIXEL_FORMAT_18);
+	vSemaphoreDelete(receiver.done);
+	ili9481_deinit(&driver);
+}
+
+
+int main(void) {
+	random_seed(13);
+	const link_t clean = {0};
+	const link_t lossy = {.corrupt = 30, .drop = 30, .noise = 20, .drop_reply = 50};
+	const link_t replies_lost = {.drop_reply = 300};
+	run_loopback(ILI9481_PIXEL_FORMAT_16, 32, &clean);
+	run_loopback(ILI9481_PIXEL_FORMAT_16, 32, &lossy);
+	run_loopback(ILI9481_PIXEL_FORMAT_18, 48, &lossy);
+	run_loopback(ILI9481_PIXEL_FORMAT_18, 48, &replies_lost);
+	test_overhead();
+	test_rejected_frames();
+	test_uart_receive();
+	return 0;
+}
@@ -1,31 +1,198 @@
 # -*- coding: utf-8 -*-
 from PIL import Image
-import random
 import argparse
+import binascii
+import struct
 import sys
+import time
 
 
+SYNC = 0xa5
+HEADER = 0x01
+DATA = 0x02
+ACK = 0x80
+NAK = 0x81
+MAX_PAYLOAD = 4096
+WINDOW = 4
+MAX_RETRIES = 8
+PIXEL_FORMAT_16 = 0x55
+PIXEL_FORMAT_18 = 0x66
 
-def convert(input_file, output_file):
-	im = Image.open(input_file)
+
+ASSET_MAGIC = b'I9A1'
+BAYER_4X4 = (
+	(0, 8, 2, 10),
+	(12, 4, 14, 6),
+	(3, 11, 1, 9),
+	(15, 7, 13, 5),
+)
+
+
+def channel_bits(pixel_format):
+	# Bits of blue, green and red in bus order
+	return (5, 6, 5) if pixel_format == PIXEL_FORMAT_16 else (6, 6, 6)
+
+
+def quantize(value, bits):
+	levels = (1 << bits) - 1
+	level = min(max(int(round(value * levels / 255.0)), 0), levels)
+	return level, level * 255.0 / levels
+
+
+def quantize_image(im, pixel_format, dither):
+	"""Returns rows of (blue, green, red) levels"""
 	im = im.convert('RGB')
+	bits = channel_bits(pixel_format)
+	width, height = im.width, im.height
+	rows = [[list(im.getpixel((x, y)))[::-1] for x in range(width)] for y in range(height)]
+	levels = []
+	for y in range(height):
+		row = []
+		for x in range(width):
+			pixel = rows[y][x]
+			out = []
+			for channel in range(3):
+				value = pixel[channel]
+				if dither == 'ordered':
+					step = 255.0 / ((1 << bits[channel]) - 1)
+					value += ((BAYER_4X4[y & 3][x & 3] + 0.5) / 16.0 - 0.5) * step
+				level, shown = quantize(value, bits[channel])
+				out.append(level)
+				if dither == 'diffusion':
+					# Floyd-Steinberg
+					error = value - shown
+					for dx, dy, weight in ((1, 0, 7), (-1, 1, 3), (0, 1, 5), (1, 1, 1)):
+						if 0 <= x + dx < width and y + dy < height:
+							rows[y + dy][x + dx][channel] += error * weight / 16.0
+			row.append(out)
+		levels.append(row)
+	return levels
+
+
+def convert(im, pixel_format, dither='none'):
+	"""Pixels in bus order of pixel format"""
+	data = bytearray()
+	for row in quantize_image(im, pixel_format, dither):
+		for b, g, r in row:
+			if pixel_format == PIXEL_FORMAT_16:
+				# Blue is in high bits of 16-bit pixel
+				data += struct.pack('>H', (b << 11) | (g << 5) | r)
+			else:
+				# Only 6 upper bits are stored
+				data += bytes((b << 2, g << 2, r << 2))
+	return bytes(data)
+
+
+def asset(width, height, pixel_format, data):
+	"""Blob drawn by ili9481_draw_asset"""
+	return ASSET_MAGIC + struct.pack('<HHB3xI', width, height, pixel_format, len(data)) + data
+
+
+def frame(frame_type, seq, payload):
+	body = struct.pack('<BBH', frame_type, seq & 0xff, len(payload)) + payload
+	return bytes((SYNC,)) + body + struct.pack('<H', binascii.crc_hqx(body, 0xffff))
 
-	output_file.write('U')
-	for y in range(480):
-		for x in range(320):
-			r, g, b = im.getpixel((x, y))
-			r = r*252//256 + random.randint(0, 4)
-			g = g*252//256 + random.randint(0, 4)
-			b = b*252//256 + random.randint(0, 4)
-			output_file.write('{:02x}{:02x}{:02x}'.format(r, g, b))
+
+def build_frames(width, height, pixel_format, data):
+	header = struct.pack('<HHHHBI', 0, 0, width, height, pixel_format, len(data))
+	frames = [frame(HEADER, 0, header)]
+	for pos in range(0, len(data), MAX_PAYLOAD):
+		frames.append(frame(DATA, len(frames), data[pos:pos + MAX_PAYLOAD]))
+	return frames
+
+
+def read_reply(port):
+	while True:
+		c = port.read(1)
+		if not c:
+			return None
+		if c[0] != SYNC:
+			continue
+		reply = port.read(6)
+		if len(reply) != 6 or binascii.crc_hqx(reply[:4], 0xffff) != struct.unpack('<H', reply[4:])[0]:
+			continue
+		return reply[0], reply[1]
+
+
+class UploadError(Exception):
+	pass
+
+
+def upload(port, frames, timeout):
+	# Go back N, sequence numbers are 8-bit. Device leaves upload mode after
+	# last frame, so lost final acknowledgement ends in retry limit.
+	deadline = time.time() + timeout
+	base = 0
+	sent = 0
+	retries = 0
+	while base < len(frames):
+		if time.time() > deadline:
+			raise UploadError('timeout after {} of {} frames'.format(base, len(frames)))
+		while sent < len(frames) and sent < base + WINDOW:
+			port.write(frames[sent])
+			sent += 1
+		reply = read_reply(port)
+		if reply is not None:
+			reply_type, seq = reply
+			acked = base + ((seq - base) & 0xff)
+			if base < acked <= sent:
+				base = acked
+				retries = 0
+			if reply_type == ACK:
+				continue
+		retries += 1
+		if retries > MAX_RETRIES:
+			raise UploadError('frame {} of {} not acknowledged after {} retries'.format(base, len(frames), MAX_RETRIES))
+		sent = base
+
+
+def parse_size(value):
+	width, height = value.lower().split('x')
+	return int(width), int(height)
 
 
 def main():
-	parser = argparse.ArgumentParser(description='Convert image to uploadable data (cat data.raw > /dev/ttyUSB0)')
+	parser = argparse.ArgumentParser(description='Compile image to panel native pixel stream, send it with --port or save it')
 	parser.add_argument('infile', type=argparse.FileType('rb'), default=sys.stdin)
-	parser.add_argument('outfile', type=argparse.FileType('w'), default=sys.stdout)
+	parser.add_argument('outfile', type=argparse.FileType('wb'), nargs='?')
+	parser.add_argument('--port', help='serial port, upload is started with U command')
+	parser.add_argument('--baud', type=int, default=921600, help='baud rate of upload')
+	parser.add_argument('--format', choices=('16', '18'), default='18', help='bits per pixel')
+	parser.add_argument('--dither', choices=('none', 'ordered', 'diffusion'), default='ordered')
+	parser.add_argument('--size', type=parse_size, help='resize image to WIDTHxHEIGHT')
+	parser.add_argument('--timeout', type=float, default=60, help='seconds until upload is aborted')
+	parser.add_argument('--output', choices=('asset', 'raw'), default='asset', help='asset with header or raw pixels')
 	args = parser.parse_args()
-	convert(args.infile, args.outfile)
+
+	im = Image.open(args.infile)
+	if args.size:
+		im = im.convert('RGB').resize(args.size, Image.LANCZOS)
+	pixel_format = PIXEL_FORMAT_16 if args.format == '16' else PIXEL_FORMAT_18
+	data = convert(im, pixel_format, args.dither)
+
+	if args.port:
+		import serial
+		frames = build_frames(im.width, im.height, pixel_format, data)
+		with serial.Serial(args.port, 115200, timeout=0.5) as port:
+			port.write(b'U')
+			port.flush()
+			time.sleep(0.1)
+			port.baudrate = args.baud
+			port.reset_input_buffer()
+			start = time.time()
+			try:
+				upload(port, frames, args.timeout)
+			except UploadError as e:
+				sys.exit('upload failed: {}'.format(e))
+			print('uploaded in {:.2f} s'.format(time.time() - start))
+	elif args.outfile:
+		if args.output == 'asset':
+			args.outfile.write(asset(im.width, im.height, pixel_format, data))
+		else:
+			args.outfile.write(data)
+	else:
+		parser.error('outfile or --port is required')
+
 
 if __name__ == "__main__":
 	main()